@@ -1,13 +1,26 @@
 #pragma once
 
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 #include "../Shared/Player.h"
+#include "../Shared/EventLatency.h"
+#include "../Shared/Profiler.h"
 
 
+// builds without rpclib (the headless Linux build) define MINIMALVR_NO_NETWORK and
+// always play offline; c stays null, so nothing below reaches the network
+#ifndef MINIMALVR_NO_NETWORK
 #include "pch.h"
 #include "rpc/client.h"
+#else
+namespace rpc { class client; }
+#endif
 
 #include <glm/gtx/string_cast.hpp>
 
@@ -18,14 +31,30 @@ Always test in release mode
 Set the IP address
 */
 
-rpc::client* c;
+rpc::client* c = nullptr;
 string s;
 int player_num;
 
 vector<bool> weapons;
 PlayerInfo op;
+// when each weapon broke and a player died, already in this client's clock (0 if unknown),
+// and when the last reply arrived; see EventLatency
+vector<int64_t> weapon_break_us;
+int64_t death_us = 0;
+int64_t receive_us = 0;
+
+// No server: play as 1P against an opponent that never moves (headless runs)
+int init_offline_client() {
+	std::cout << "Running without a server" << std::endl;
+	player_num = 1;
+	weapons = vector<bool>(6, true);
+	return player_num;
+}
 
 int init_client() {
+#ifdef MINIMALVR_NO_NETWORK
+	return init_offline_client();
+#else
 	// Setup an rpc client that connects to "localhost:8080"
 	std::cout << "This is Client" << std::endl;
 	std::cout << "Connecting..." << std::endl;
@@ -33,16 +62,125 @@ int init_client() {
 	player_num = c->call("handshake", "Nabi").get().as<int>();
 	std::cout << "Connected to server, and I am: " << player_num << "P" << std::endl;
 	return player_num;
+#endif
 }
 
-void run_client(Player* me, Player * oppo)
+// The push exchange runs on a thread of its own, so a frame never waits on the
+// network: push_player hands it the latest PlayerInfo, which it sends once the
+// previous reply is in, and take_server_reply picks up whatever reply arrived since
+// the last frame. The clock sync happens on that thread, where the send and receive
+// times are exact.
+struct ServerReply {
+	PlayerInfo op;
+	vector<bool> weapons;
+	vector<int64_t> weapon_break_us;
+	int64_t death_us = 0;
+	int64_t receive_us = 0;
+};
+
+std::thread exchange_thread;
+std::mutex exchange_mutex;
+std::condition_variable exchange_wake;
+PlayerInfo exchange_outgoing;
+bool exchange_has_outgoing = false;
+bool exchange_stop = false;
+// filled by the exchange thread, swapped out by take_server_reply; both keep their capacity
+ServerReply exchange_incoming;
+bool exchange_has_incoming = false;
+ServerReply exchange_taken;
+
+void exchange_loop()
 {
-	PlayerInfo* myInfo = me->getPlayerInfo();
-	std::tie(op, weapons) = c->call("push", *myInfo, player_num).get().as<std::tuple<PlayerInfo, vector<bool>>/*cast back the respond message to string and Player*/>();
-	
-	//printf("ME: %d\n", me->heldWeapon);
-	//printf("MYWEAPON: %d\n", weapon_p1);
-	//printf("OPPO: %d\n", op.heldWeapon);
+	ServerReply reply;
+	std::tuple<PlayerInfo, vector<bool>, vector<int64_t>, int64_t, int64_t> decoded;
+	while (true)
+	{
+		PlayerInfo myInfo;
+		{
+			std::unique_lock<std::mutex> lock(exchange_mutex);
+			exchange_wake.wait(lock, [] { return exchange_has_outgoing || exchange_stop; });
+			if (exchange_stop)
+				return;
+			myInfo = exchange_outgoing;
+			exchange_has_outgoing = false;
+		}
+
+		// the round trip and the decode, on the exchange's own trace track
+		ThreadProfileScope zone("server exchange", "push");
+		int64_t sent_us = latencyClockUs();
+		try
+		{
+#ifndef MINIMALVR_NO_NETWORK
+			c->call("push", myInfo, player_num).get().convert(decoded);
+#endif
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << "Push failed: " << e.what() << std::endl;
+			continue;
+		}
+		reply.receive_us = latencyClockUs();
+		eventLatency.clockSync(sent_us, std::get<4>(decoded), reply.receive_us);
+		reply.op = std::get<0>(decoded);
+		reply.weapons.swap(std::get<1>(decoded));
+		reply.weapon_break_us.swap(std::get<2>(decoded));
+		for (int64_t& us : reply.weapon_break_us)
+			us = eventLatency.serverToLocal(us);
+		reply.death_us = eventLatency.serverToLocal(std::get<3>(decoded));
 
+		std::lock_guard<std::mutex> lock(exchange_mutex);
+		std::swap(reply, exchange_incoming);
+		exchange_has_incoming = true;
+	}
+}
 
+void start_server_exchange()
+{
+	if (c != nullptr)
+		exchange_thread = std::thread(exchange_loop);
+}
+
+// waits for a push in flight, which times out with the client (5 s by default)
+void stop_server_exchange()
+{
+	if (!exchange_thread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(exchange_mutex);
+		exchange_stop = true;
+	}
+	exchange_wake.notify_one();
+	exchange_thread.join();
+}
+
+// queues this frame's state, replacing one the exchange thread has not picked up yet
+void push_player(Player* me)
+{
+	if (c == nullptr)
+		return;
+	PlayerInfo* myInfo = me->getPlayerInfo();
+	{
+		std::lock_guard<std::mutex> lock(exchange_mutex);
+		exchange_outgoing = *myInfo;
+		exchange_has_outgoing = true;
+	}
+	exchange_wake.notify_one();
+}
+
+// moves the newest reply into op, weapons and the stamps; false when none came in
+bool take_server_reply()
+{
+	{
+		std::lock_guard<std::mutex> lock(exchange_mutex);
+		if (!exchange_has_incoming)
+			return false;
+		std::swap(exchange_taken, exchange_incoming);
+		exchange_has_incoming = false;
+	}
+	op = exchange_taken.op;
+	weapons.assign(exchange_taken.weapons.begin(), exchange_taken.weapons.end());
+	weapon_break_us.assign(exchange_taken.weapon_break_us.begin(), exchange_taken.weapon_break_us.end());
+	death_us = exchange_taken.death_us;
+	receive_us = exchange_taken.receive_us;
+	return true;
 }
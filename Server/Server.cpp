@@ -4,6 +4,7 @@
 #include "../Shared/Player.h"
 #include <glm/gtx/string_cast.hpp>
 #include "Scene.h"
+#include "../Shared/FrameArena.h"
 
 // Shared struct
 Scene * new_game;
@@ -53,11 +54,33 @@ int main() {
 		return std::make_tuple(string("> ") + s, p);
 	});
 
+	// the event stamps and the server time let the client time its sounds, see EventLatency.
+	// The reply's vectors are copies in the frame arena, which the next push resets; the
+	// server runs one handler at a time, and a reply is sent before the next push starts.
 	srv->bind("push", [](PlayerInfo & p, int player_no) {
+		static size_t ticks = 0;
+		static size_t tickAllocations = 0;
+		frameArena.reset();
+		size_t allocationsStart = heapAllocations();
+
 		new_game->update(p, player_no);
 		//printf("HELLO: %d\n", player_no);
 		
-		return std::make_tuple(new_game->players[player_no == 1 ? 1 : 0], new_game->render_weapons);
+		auto reply = std::make_tuple(new_game->players[player_no == 1 ? 1 : 0],
+			ArenaVector<bool>(new_game->render_weapons.begin(), new_game->render_weapons.end()),
+			ArenaVector<int64_t>(new_game->weapon_break_us.begin(), new_game->weapon_break_us.end()),
+			new_game->death_us, latencyClockUs());
+
+		// operator new only: rpclib's msgpack zones and buffers come from malloc and are
+		// not part of the count
+		tickAllocations += heapAllocations() - allocationsStart;
+		if (HEAP_ALLOCATIONS_COUNTED && ++ticks % 1000 == 0)
+		{
+			std::cout << "Ticks " << ticks - 999 << "-" << ticks << ": " << tickAllocations / 1000.0
+				<< " heap allocations per tick in the handler, frame arena " << frameArena.highWater() / 1024 << " KB" << std::endl;
+			tickAllocations = 0;
+		}
+		return reply;
 	});
 
 	// Blocking call to start the server: non-blocking call is srv.async_run(threadsCount);
@@ -0,0 +1,372 @@
+#include "AssetArchive.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+#include "Lz4.h"
+#include "MeshCache.h"
+#include "ResourceCache.h"
+
+namespace
+{
+	const char ASSET_ARCHIVE_MAGIC[4] = { 'M', 'V', 'R', 'P' };
+
+	uint64_t alignUp(uint64_t offset)
+	{
+		return (offset + ASSET_ARCHIVE_ALIGNMENT - 1) & ~(uint64_t)(ASSET_ARCHIVE_ALIGNMENT - 1);
+	}
+
+	bool writePadded(FILE* file, const void* data, size_t bytes, uint64_t& offset)
+	{
+		static const char zeros[ASSET_ARCHIVE_ALIGNMENT] = {};
+		if (bytes && fwrite(data, 1, bytes, file) != bytes)
+			return false;
+		offset += bytes;
+		size_t pad = (size_t)(alignUp(offset) - offset);
+		if (pad && fwrite(zeros, 1, pad, file) != pad)
+			return false;
+		offset += pad;
+		return true;
+	}
+
+	struct PackedFile {
+		std::string key;
+		std::vector<uint8_t> stored;
+		AssetArchiveEntry entry;
+	};
+
+	AssetArchive mounted;
+}
+
+std::string assetArchiveKey(const std::string& path)
+{
+	std::string key = normalizeResourcePath(path);
+	for (char& c : key)
+		c = (char)tolower((unsigned char)c);
+	return key;
+}
+
+bool writeAssetArchive(const std::string& path, const std::vector<std::string>& files, AssetPackReport* report)
+{
+	std::vector<PackedFile> packed;
+	std::set<std::string> keys;
+	for (const std::string& file : files)
+	{
+		std::string key = assetArchiveKey(file);
+		if (!keys.insert(key).second)
+			continue;
+
+		MappedFile source;
+		uint64_t sourceSize;
+		PackedFile item = {};
+		if (!source.open(file) || !sourceFileStamp(file, sourceSize, item.entry.sourceTime))
+		{
+			std::cout << "Pack: skipping " << file << ", it is missing or empty" << std::endl;
+			continue;
+		}
+
+		item.key = key;
+		item.entry.keyHash = hashResourceBytes(key.data(), key.size());
+		item.entry.size = source.size();
+		item.entry.contentHash = hashResourceBytes(source.data(), source.size());
+		lz4Compress(source.data(), source.size(), item.stored);
+		if (item.stored.size() <= source.size() - source.size() / 8)
+			item.entry.flags = ASSET_ENTRY_LZ4;
+		else
+			item.stored.assign(source.data(), source.data() + source.size());
+		item.entry.storedSize = item.stored.size();
+		packed.push_back(std::move(item));
+	}
+
+	std::sort(packed.begin(), packed.end(), [](const PackedFile& a, const PackedFile& b)
+	{
+		return a.entry.keyHash != b.entry.keyHash ? a.entry.keyHash < b.entry.keyHash : a.key < b.key;
+	});
+
+	AssetArchiveHeader header = {};
+	memcpy(header.magic, ASSET_ARCHIVE_MAGIC, sizeof(header.magic));
+	header.version = ASSET_ARCHIVE_VERSION;
+	header.entryCount = (uint32_t)packed.size();
+
+	std::string names;
+	for (PackedFile& item : packed)
+	{
+		item.entry.nameOffset = (uint32_t)names.size();
+		names.append(item.key);
+		names.push_back('\0');
+	}
+	header.entryTableOffset = alignUp(sizeof(AssetArchiveHeader));
+	header.nameTableOffset = alignUp(header.entryTableOffset + packed.size() * sizeof(AssetArchiveEntry));
+	header.nameTableSize = names.size();
+	uint64_t dataOffset = alignUp(header.nameTableOffset + names.size());
+
+	std::vector<AssetArchiveEntry> entries;
+	for (PackedFile& item : packed)
+	{
+		item.entry.offset = dataOffset;
+		dataOffset = alignUp(dataOffset + item.entry.storedSize);
+		entries.push_back(item.entry);
+	}
+
+	// write next to the target and rename, so a half written archive is never mounted
+	std::string tmpPath = path + ".tmp";
+	FILE* file = fopen(tmpPath.c_str(), "wb");
+	if (!file)
+	{
+		std::cout << "Pack: cannot write " << tmpPath << std::endl;
+		return false;
+	}
+	uint64_t offset = 0;
+	bool ok = writePadded(file, &header, sizeof(header), offset)
+		&& writePadded(file, entries.data(), entries.size() * sizeof(AssetArchiveEntry), offset)
+		&& writePadded(file, names.data(), names.size(), offset);
+	for (size_t i = 0; ok && i < packed.size(); i++)
+		ok = writePadded(file, packed[i].stored.data(), packed[i].stored.size(), offset);
+	ok = (fclose(file) == 0) && ok;
+
+	if (ok)
+	{
+		remove(path.c_str());
+		ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+	}
+	if (!ok)
+	{
+		std::cout << "Pack: failed writing " << path << std::endl;
+		remove(tmpPath.c_str());
+		return false;
+	}
+
+	AssetArchive archive;
+	if (!archive.open(path) || !archive.verify())
+	{
+		std::cout << "Pack: " << path << " does not read back" << std::endl;
+		return false;
+	}
+
+	if (report)
+	{
+		report->files = packed.size();
+		for (const PackedFile& item : packed)
+		{
+			report->compressedFiles += (item.entry.flags & ASSET_ENTRY_LZ4) ? 1 : 0;
+			report->bytes += item.entry.size;
+			report->storedBytes += item.entry.storedSize;
+		}
+	}
+	return true;
+}
+
+void appendAssetDependencies(const std::string& path, std::vector<std::string>& files)
+{
+	std::string directory = path.substr(0, path.find_last_of('/') + 1);
+	std::string extension = path.substr(path.find_last_of('.') + 1);
+	for (char& c : extension)
+		c = (char)tolower((unsigned char)c);
+	bool obj = extension == "obj";
+	if (!obj && extension != "mtl")
+		return;
+
+	std::ifstream stream(path);
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		std::istringstream tokens(line);
+		std::string keyword;
+		tokens >> keyword;
+		bool textureMap = !obj && (keyword.compare(0, 4, "map_") == 0 || keyword == "bump" || keyword == "disp"
+			|| keyword == "decal" || keyword == "norm" || keyword == "refl");
+		if ((obj && keyword == "mtllib") || textureMap)
+		{
+			// the file name is the last token, options like -bm 0.5 come before it
+			std::string name, token;
+			while (tokens >> token)
+				name = token;
+			if (name.empty())
+				continue;
+			std::string dependency = directory + name;
+			if (std::find(files.begin(), files.end(), dependency) != files.end())
+				continue;
+			files.push_back(dependency);
+			if (obj)
+				appendAssetDependencies(dependency, files);
+		}
+	}
+}
+
+bool AssetArchive::open(const std::string& path)
+{
+	close();
+	if (!_file.open(path))
+		return false;
+
+	uint64_t fileSize = _file.size();
+	const AssetArchiveHeader* header = reinterpret_cast<const AssetArchiveHeader*>(_file.data());
+	if (fileSize < sizeof(AssetArchiveHeader)
+		|| memcmp(header->magic, ASSET_ARCHIVE_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != ASSET_ARCHIVE_VERSION)
+	{
+		std::cout << "Asset archive: " << path << " has an unsupported format, ignoring it" << std::endl;
+		_file.close();
+		return false;
+	}
+
+	bool valid = header->entryTableOffset % ASSET_ARCHIVE_ALIGNMENT == 0
+		&& header->entryTableOffset <= fileSize
+		&& (uint64_t)header->entryCount * sizeof(AssetArchiveEntry) <= fileSize - header->entryTableOffset
+		&& header->nameTableOffset <= fileSize && header->nameTableSize <= fileSize - header->nameTableOffset
+		&& header->nameTableSize > 0 && _file.data()[header->nameTableOffset + header->nameTableSize - 1] == '\0';
+
+	const AssetArchiveEntry* entries = reinterpret_cast<const AssetArchiveEntry*>(_file.data() + header->entryTableOffset);
+	for (uint32_t i = 0; valid && i < header->entryCount; i++)
+	{
+		const AssetArchiveEntry& entry = entries[i];
+		valid = entry.offset % ASSET_ARCHIVE_ALIGNMENT == 0
+			&& entry.offset <= fileSize && entry.storedSize <= fileSize - entry.offset
+			&& entry.nameOffset < header->nameTableSize
+			&& ((entry.flags & ASSET_ENTRY_LZ4) || entry.storedSize == entry.size)
+			&& (i == 0 || entries[i - 1].keyHash <= entry.keyHash);
+	}
+	if (!valid)
+	{
+		std::cout << "Asset archive: " << path << " is corrupt, ignoring it" << std::endl;
+		_file.close();
+		return false;
+	}
+
+	_header = header;
+	_entries = entries;
+	_names = reinterpret_cast<const char*>(_file.data() + header->nameTableOffset);
+	return true;
+}
+
+const AssetArchiveEntry* AssetArchive::find(const std::string& path) const
+{
+	if (!_header)
+		return nullptr;
+	std::string key = assetArchiveKey(path);
+	uint64_t hash = hashResourceBytes(key.data(), key.size());
+	const AssetArchiveEntry* end = _entries + _header->entryCount;
+	const AssetArchiveEntry* entry = std::lower_bound(_entries, end, hash,
+		[](const AssetArchiveEntry& e, uint64_t h) { return e.keyHash < h; });
+	for (; entry != end && entry->keyHash == hash; entry++)
+		if (key == name(*entry))
+			return entry;
+	return nullptr;
+}
+
+bool AssetArchive::read(const AssetArchiveEntry& entry, std::vector<uint8_t>& data) const
+{
+	data.resize((size_t)entry.size);
+	const uint8_t* stored = storedData(entry);
+	if (entry.flags & ASSET_ENTRY_LZ4)
+	{
+		if (!lz4Decompress(stored, (size_t)entry.storedSize, data.data(), data.size()))
+			return false;
+	}
+	else if (entry.size)
+		memcpy(data.data(), stored, (size_t)entry.size);
+	return hashResourceBytes(data.data(), data.size()) == entry.contentHash;
+}
+
+bool AssetArchive::verify() const
+{
+	std::vector<uint8_t> data;
+	for (uint32_t i = 0; i < entryCount(); i++)
+	{
+		if (!read(_entries[i], data))
+		{
+			std::cout << "Asset archive: " << name(_entries[i]) << " does not match its hash" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool mountAssetArchive(const std::string& path)
+{
+	return mounted.open(path);
+}
+
+const AssetArchive* mountedAssetArchive()
+{
+	return mounted.isOpen() ? &mounted : nullptr;
+}
+
+bool AssetFile::open(const std::string& path)
+{
+	close();
+	const AssetArchive* archive = mountedAssetArchive();
+	const AssetArchiveEntry* entry = archive ? archive->find(path) : nullptr;
+	if (entry && entry->size)
+	{
+		if (!(entry->flags & ASSET_ENTRY_LZ4))
+		{
+			_data = archive->storedData(*entry);
+		}
+		else if (archive->read(*entry, _decompressed))
+		{
+			_data = _decompressed.data();
+		}
+		else
+		{
+			std::cout << "Asset archive: " << path << " is corrupt" << std::endl;
+			return false;
+		}
+		_size = (size_t)entry->size;
+		_fromArchive = true;
+		return true;
+	}
+
+	if (!_mapped.open(path))
+		return false;
+	_data = _mapped.data();
+	_size = _mapped.size();
+	return true;
+}
+
+void AssetFile::close()
+{
+	_mapped.close();
+	std::vector<uint8_t>().swap(_decompressed);
+	_data = nullptr;
+	_size = 0;
+	_fromArchive = false;
+}
+
+void AssetFile::prefetch() const
+{
+	const size_t PAGE = 4096;
+	volatile unsigned char sink = 0;
+	for (size_t offset = 0; offset < _size; offset += PAGE)
+		sink += _data[offset];
+	(void)sink;
+}
+
+bool assetFileExists(const std::string& path)
+{
+	const AssetArchive* archive = mountedAssetArchive();
+	if (archive && archive->find(path))
+		return true;
+	uint64_t size;
+	int64_t time;
+	return sourceFileStamp(path, size, time);
+}
+
+bool assetFileStamp(const std::string& path, uint64_t& size, int64_t& time)
+{
+	const AssetArchive* archive = mountedAssetArchive();
+	const AssetArchiveEntry* entry = archive ? archive->find(path) : nullptr;
+	if (entry)
+	{
+		size = entry->size;
+		time = entry->sourceTime;
+		return true;
+	}
+	return sourceFileStamp(path, size, time);
+}
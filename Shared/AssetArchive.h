@@ -0,0 +1,128 @@
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+// Every file the client reads, packed into one archive by `Minimal.exe --pack` and
+// mapped once at startup, so a cold start opens a single file.
+//
+//   header | entry table (sorted by key hash) | name table | entry data
+//
+// The entry table and every entry's data start on a 16 byte boundary. Entries stored
+// as is are read straight from the mapping, so cooked blobs still go to GL without a
+// copy; the others are LZ4 blocks, decompressed when opened. Each entry records the
+// FNV-1a hash of its contents, checked whenever it is decompressed, and the size and
+// modification time of the file it was packed from, which stand in for the loose
+// file's when a cooked file is checked for staleness.
+const uint32_t ASSET_ARCHIVE_VERSION = 1;
+const uint32_t ASSET_ARCHIVE_ALIGNMENT = 16;
+const uint32_t ASSET_ENTRY_LZ4 = 1;
+
+struct AssetArchiveHeader {
+	char magic[4]; // "MVRP"
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+	uint64_t entryTableOffset;
+	uint64_t nameTableOffset;
+	uint64_t nameTableSize;
+};
+
+struct AssetArchiveEntry {
+	uint64_t keyHash;
+	uint64_t offset;
+	uint64_t storedSize;
+	uint64_t size;
+	uint64_t contentHash;
+	int64_t sourceTime;
+	uint32_t nameOffset;
+	uint32_t flags; // ASSET_ENTRY_LZ4
+};
+
+// What --pack did
+struct AssetPackReport {
+	size_t files = 0;
+	size_t compressedFiles = 0;
+	uint64_t bytes = 0;
+	uint64_t storedBytes = 0;
+};
+
+// the name a path is stored under: normalized, forward slashes, lower case, so any
+// spelling the game opens a file by finds the same entry
+std::string assetArchiveKey(const std::string& path);
+
+// Packs the files (duplicates and missing files are skipped with a note), compressing
+// those LZ4 shrinks by at least an eighth, then reads the archive back and verifies it
+bool writeAssetArchive(const std::string& path, const std::vector<std::string>& files, AssetPackReport* report = nullptr);
+
+// appends what a model references: the MTL libraries of an OBJ and the texture maps of
+// each MTL, as paths next to the referencing file
+void appendAssetDependencies(const std::string& path, std::vector<std::string>& files);
+
+class AssetArchive
+{
+public:
+	// Maps and validates the archive's tables; entry data is checked when it is read
+	bool open(const std::string& path);
+	void close() { _file.close(); _header = nullptr; }
+	bool isOpen() const { return _header != nullptr; }
+
+	uint32_t entryCount() const { return _header->entryCount; }
+	const AssetArchiveEntry& entry(uint32_t i) const { return _entries[i]; }
+	const char* name(const AssetArchiveEntry& entry) const { return _names + entry.nameOffset; }
+	size_t fileSize() const { return _file.size(); }
+
+	const AssetArchiveEntry* find(const std::string& path) const;
+	// the entry as stored, valid while the archive is open; LZ4 entries need read()
+	const uint8_t* storedData(const AssetArchiveEntry& entry) const { return _file.data() + entry.offset; }
+	// decompresses if needed and checks the content hash
+	bool read(const AssetArchiveEntry& entry, std::vector<uint8_t>& data) const;
+	// reads every entry, false if any of them doesn't match its hash
+	bool verify() const;
+
+private:
+	MappedFile _file;
+	const AssetArchiveHeader* _header = nullptr;
+	const AssetArchiveEntry* _entries = nullptr;
+	const char* _names = nullptr;
+};
+
+// The asset file system. Once an archive is mounted every AssetFile, and whatever else
+// asks mountedAssetArchive(), resolves paths in it first and falls back to loose files.
+// Mount at startup, before any asset worker runs; the archive then stays mapped.
+bool mountAssetArchive(const std::string& path);
+const AssetArchive* mountedAssetArchive();
+
+// A whole file from the mounted archive or the disk: a pointer into the archive for
+// entries stored as is, a decompressed copy for LZ4 entries, else a mapped loose file.
+class AssetFile
+{
+public:
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return _data != nullptr; }
+	const unsigned char* data() const { return _data; }
+	size_t size() const { return _size; }
+	bool fromArchive() const { return _fromArchive; }
+
+	// touches every page, see MappedFile::prefetch
+	void prefetch() const;
+
+private:
+	MappedFile _mapped;
+	std::vector<uint8_t> _decompressed;
+	const unsigned char* _data = nullptr;
+	size_t _size = 0;
+	bool _fromArchive = false;
+};
+
+bool assetFileExists(const std::string& path);
+// sourceFileStamp through the file system: for a packed file, its stamp when packed
+bool assetFileStamp(const std::string& path, uint64_t& size, int64_t& time);
+
+#endif
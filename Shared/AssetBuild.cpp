@@ -0,0 +1,233 @@
+#include "AssetBuild.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "ResourceCache.h"
+
+namespace
+{
+	const char* const COOK_MANIFEST_HEADER = "mvr-cook-manifest 1";
+
+	// a file as the manifest remembers it; hash 0 is a missing file
+	struct FileRecord {
+		uint64_t size = 0;
+		int64_t time = 0;
+		uint64_t hash = 0;
+	};
+
+	struct JobRecord {
+		std::string settings;
+		FileRecord output;
+		std::vector<std::pair<std::string, FileRecord>> inputs;
+	};
+
+	// output <path>
+	// settings <text>
+	// made <size> <time>
+	// input <size> <time> <hash> <path>
+	// end
+	std::map<std::string, JobRecord> readManifest(const std::string& path)
+	{
+		std::map<std::string, JobRecord> records;
+		std::ifstream stream(path);
+		std::string line;
+		if (!std::getline(stream, line) || line != COOK_MANIFEST_HEADER)
+			return records;
+
+		std::string output;
+		JobRecord record;
+		while (std::getline(stream, line))
+		{
+			size_t space = line.find(' ');
+			std::string keyword = line.substr(0, space);
+			std::string value = space == std::string::npos ? std::string() : line.substr(space + 1);
+			std::istringstream fields(value);
+			if (keyword == "output")
+			{
+				output = value;
+				record = JobRecord();
+			}
+			else if (keyword == "settings")
+				record.settings = value;
+			else if (keyword == "made")
+				fields >> record.output.size >> record.output.time;
+			else if (keyword == "input")
+			{
+				FileRecord input;
+				std::string name;
+				fields >> input.size >> input.time >> std::hex >> input.hash >> std::dec;
+				std::getline(fields >> std::ws, name);
+				record.inputs.push_back(std::make_pair(name, input));
+			}
+			else if (keyword == "end" && !output.empty())
+				records[output] = record;
+		}
+		return records;
+	}
+
+	bool writeManifest(const std::string& path, const std::map<std::string, JobRecord>& records)
+	{
+		std::string tmpPath = path + ".tmp";
+		{
+			std::ofstream stream(tmpPath, std::ios::trunc);
+			stream << COOK_MANIFEST_HEADER << "\n";
+			for (const auto& entry : records)
+			{
+				const JobRecord& record = entry.second;
+				stream << "output " << entry.first << "\n";
+				stream << "settings " << record.settings << "\n";
+				stream << "made " << record.output.size << " " << record.output.time << "\n";
+				for (const auto& input : record.inputs)
+					stream << "input " << input.second.size << " " << input.second.time << " " << std::hex << input.second.hash
+						<< std::dec << " " << input.first << "\n";
+				stream << "end\n";
+			}
+			if (!stream.good())
+				return false;
+		}
+		remove(path.c_str());
+		return rename(tmpPath.c_str(), path.c_str()) == 0;
+	}
+
+	// the current state of a file, hashed only when its stamp differs from the one known
+	FileRecord inspect(const std::string& path, const FileRecord* known)
+	{
+		FileRecord record;
+		if (!sourceFileStamp(path, record.size, record.time))
+			return record;
+		if (known && known->hash && known->size == record.size && known->time == record.time)
+		{
+			record.hash = known->hash;
+			return record;
+		}
+		MappedFile file;
+		record.hash = file.open(path) ? hashResourceBytes(file.data(), file.size()) : 0;
+		// an empty file can't be mapped, but it exists
+		record.hash = record.hash ? record.hash : 1;
+		return record;
+	}
+
+	const FileRecord* findInput(const JobRecord* record, const std::string& path)
+	{
+		if (!record)
+			return nullptr;
+		for (const auto& input : record->inputs)
+			if (input.first == path)
+				return &input.second;
+		return nullptr;
+	}
+
+	enum class JobState { Stale, UpToDate, Touched };
+}
+
+bool runCookJobs(const std::string& manifestPath, const std::vector<CookJob>& jobs, bool force, unsigned int threads,
+	CookReport& report)
+{
+	auto start = std::chrono::steady_clock::now();
+	report = CookReport();
+	std::map<std::string, JobRecord> known = readManifest(manifestPath);
+
+	// what every job is made from now; a file shared by several jobs is inspected once
+	std::map<std::string, FileRecord> files;
+	std::vector<JobRecord> current(jobs.size());
+	std::vector<JobState> states(jobs.size(), JobState::Stale);
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		const CookJob& job = jobs[i];
+		auto found = known.find(job.output);
+		const JobRecord* previous = found != known.end() ? &found->second : nullptr;
+
+		current[i].settings = job.settings;
+		bool sameInputs = previous && previous->inputs.size() == job.inputs.size();
+		bool touched = false;
+		for (size_t k = 0; k < job.inputs.size(); k++)
+		{
+			const std::string& path = job.inputs[k];
+			const FileRecord* before = findInput(previous, path);
+			auto file = files.find(path);
+			if (file == files.end())
+				file = files.insert(std::make_pair(path, inspect(path, before))).first;
+			current[i].inputs.push_back(std::make_pair(path, file->second));
+			sameInputs = sameInputs && before && before->hash == file->second.hash;
+			touched = touched || (before && (before->size != file->second.size || before->time != file->second.time));
+		}
+
+		FileRecord output;
+		bool outputIntact = sourceFileStamp(job.output, output.size, output.time) && previous
+			&& output.size == previous->output.size && output.time == previous->output.time;
+		if (!force && sameInputs && outputIntact && previous->settings == job.settings)
+		{
+			states[i] = touched ? JobState::Touched : JobState::UpToDate;
+			current[i].output = output;
+		}
+	}
+
+	// every worker takes the next job until none are left
+	std::atomic<size_t> next(0);
+	std::mutex mutex;
+	std::vector<bool> succeeded(jobs.size(), false);
+	auto work = [&]()
+	{
+		for (size_t i = next++; i < jobs.size(); i = next++)
+		{
+			const CookJob& job = jobs[i];
+			bool ok = true;
+			if (states[i] == JobState::Stale)
+				ok = job.cook();
+			else if (states[i] == JobState::Touched)
+				ok = job.restamp ? job.restamp() : job.cook();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			succeeded[i] = ok;
+			if (!ok)
+				report.failed++;
+			else if (states[i] == JobState::Stale || (states[i] == JobState::Touched && !job.restamp))
+				report.cooked++;
+			else if (states[i] == JobState::Touched)
+				report.restamped++;
+			else
+				report.upToDate++;
+			if (!ok)
+				std::cout << "Failed to cook " << job.output << std::endl;
+		}
+	};
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::future<void>> workers;
+	for (unsigned int t = 1; t < threads; t++)
+		workers.push_back(std::async(std::launch::async, work));
+	work();
+	for (std::future<void>& worker : workers)
+		worker.get();
+
+	// a failed job loses its record, so it is cooked again next time
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		if (!succeeded[i])
+		{
+			known.erase(jobs[i].output);
+			continue;
+		}
+		if (states[i] != JobState::UpToDate)
+			sourceFileStamp(jobs[i].output, current[i].output.size, current[i].output.time);
+		known[jobs[i].output] = current[i];
+	}
+	bool written = writeManifest(manifestPath, known);
+	if (!written)
+		std::cout << "Cook: failed writing " << manifestPath << std::endl;
+
+	report.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return report.failed == 0 && written;
+}
@@ -0,0 +1,43 @@
+#ifndef ASSET_BUILD_H
+#define ASSET_BUILD_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Incremental --cook. Every cooked file is a job with the files it is made from and
+// the importer settings it was made with; the manifest keeps, per output, the content
+// hash of each input and the settings of the last successful cook. A job is cooked
+// again only when one of those changed or its output is gone or was replaced, and the
+// stale jobs are cooked side by side.
+//
+// Inputs are hashed only when their size or modification time differ from the
+// manifest, so an up to date tree is checked without reading it. An input touched
+// without changing keeps its output; restamp then records the new time in the output,
+// whose own stale check compares it.
+
+// One cooked file and everything it is made from
+struct CookJob {
+	std::string output;
+	std::vector<std::string> inputs;	// the source first, then what it references (OBJ -> MTL -> maps)
+	std::string settings;				// format versions and importer options; a change re-cooks
+	std::function<bool()> cook;
+	std::function<bool()> restamp;		// optional, see above
+};
+
+struct CookReport {
+	size_t cooked = 0;
+	size_t upToDate = 0;
+	size_t restamped = 0;
+	size_t failed = 0;
+	double ms = 0.0;
+};
+
+// Runs the stale jobs on up to `threads` threads (0: one per hardware thread) and
+// rewrites the manifest; force cooks every job. Jobs must not share outputs.
+// False if any job failed, its output is then cooked again next time.
+bool runCookJobs(const std::string& manifestPath, const std::vector<CookJob>& jobs, bool force, unsigned int threads,
+	CookReport& report);
+
+#endif
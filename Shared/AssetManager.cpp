@@ -0,0 +1,127 @@
+#include "AssetManager.h"
+
+#include <chrono>
+
+AssetManager assets;
+
+AssetManager::AssetManager(unsigned int workerCount) : _workerCount(workerCount)
+{
+	if (_workerCount == 0)
+	{
+		unsigned int hardware = std::thread::hardware_concurrency();
+		_workerCount = hardware > 1 ? hardware - 1 : 1;
+	}
+}
+
+AssetManager::~AssetManager()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+		_decodeQueue.clear();
+	}
+	_decodeReady.notify_all();
+	for (auto& worker : _workers)
+		worker.join();
+}
+
+void AssetManager::startWorkers()
+{
+	// started on first use, so the global instance costs nothing in tools and at exit
+	for (unsigned int i = 0; i < _workerCount; i++)
+		_workers.emplace_back(&AssetManager::workerMain, this);
+}
+
+void AssetManager::load(std::function<void()> decode, std::function<void()> upload)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_workers.empty())
+			startWorkers();
+		_decodeQueue.push_back({ std::move(decode), std::move(upload) });
+		_pending++;
+	}
+	_decodeReady.notify_one();
+}
+
+void AssetManager::workerMain()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true)
+	{
+		_decodeReady.wait(lock, [this] { return _stopping || !_decodeQueue.empty(); });
+		if (_stopping)
+			return;
+
+		Job job = std::move(_decodeQueue.front());
+		_decodeQueue.pop_front();
+		_decoding++;
+
+		lock.unlock();
+		job.decode();
+		lock.lock();
+
+		_decoding--;
+		_uploadQueue.push_back(std::move(job.upload));
+		_uploadReady.notify_all();
+	}
+}
+
+int AssetManager::pumpUploads(double budgetMs)
+{
+	auto start = std::chrono::steady_clock::now();
+	int count = 0;
+	while (true)
+	{
+		std::function<void()> upload;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_uploadQueue.empty())
+				break;
+			upload = std::move(_uploadQueue.front());
+			_uploadQueue.pop_front();
+		}
+
+		upload();
+		count++;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pending--;
+		}
+		std::chrono::duration<double, std::milli> spent = std::chrono::steady_clock::now() - start;
+		if (spent.count() >= budgetMs)
+			break;
+	}
+	return count;
+}
+
+void AssetManager::finishAll()
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_uploadReady.wait(lock, [this] { return _pending == 0 || !_uploadQueue.empty(); });
+			if (_pending == 0)
+				return;
+		}
+		pumpUploads(1e9);
+	}
+}
+
+void AssetManager::cancelAll()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_pending -= _decodeQueue.size();
+	_decodeQueue.clear();
+	_uploadReady.wait(lock, [this] { return _decoding == 0; });
+	_pending -= _uploadQueue.size();
+	_uploadQueue.clear();
+}
+
+size_t AssetManager::pending() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _pending;
+}
@@ -0,0 +1,71 @@
+#ifndef ASSET_MANAGER_H
+#define ASSET_MANAGER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Streams assets in without stalling the render thread. A load is split in two:
+// decode (file I/O, parsing, image decode) runs on a worker pool, then upload
+// (everything that touches GL) is queued for the GL thread, which drains the
+// queue in pumpUploads() once per frame within a time budget.
+//
+// Assets are created empty and fill themselves in from their upload step
+// (see the streaming constructors of Model and TexturedCube), so existing
+// pointers stay valid and simply start drawing once their data is ready.
+class AssetManager
+{
+public:
+	// 0 picks one worker less than the hardware threads
+	explicit AssetManager(unsigned int workerCount = 0);
+	~AssetManager();
+
+	AssetManager(const AssetManager&) = delete;
+	AssetManager& operator=(const AssetManager&) = delete;
+
+	// Any thread. upload runs on the GL thread after decode has returned;
+	// objects both touch must be owned by the closures (e.g. a shared_ptr).
+	void load(std::function<void()> decode, std::function<void()> upload);
+
+	// GL thread: runs queued uploads until budgetMs is spent. At least one upload
+	// runs per call so a single large asset can't starve. Returns uploads run.
+	int pumpUploads(double budgetMs);
+
+	// GL thread: blocks until every load submitted so far is uploaded
+	void finishAll();
+
+	// Drops queued work and waits for running decodes, e.g. before the GL
+	// context and the objects the uploads point at go away
+	void cancelAll();
+
+	// loads submitted and not uploaded yet
+	size_t pending() const;
+
+private:
+	void startWorkers();
+	void workerMain();
+
+	unsigned int _workerCount;
+	std::vector<std::thread> _workers;
+	bool _stopping = false;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _decodeReady; // wakes workers
+	std::condition_variable _uploadReady; // wakes finishAll / cancelAll
+
+	struct Job {
+		std::function<void()> decode;
+		std::function<void()> upload;
+	};
+	std::deque<Job> _decodeQueue;
+	std::deque<std::function<void()>> _uploadQueue;
+	size_t _decoding = 0;
+	size_t _pending = 0;
+};
+
+extern AssetManager assets;
+
+#endif
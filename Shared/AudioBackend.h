@@ -0,0 +1,58 @@
+#ifndef AUDIO_BACKEND_H
+#define AUDIO_BACKEND_H
+
+#include <string>
+
+#include <glm/glm.hpp>
+
+// How a sound is kept in memory once loaded
+enum class SoundCache {
+	Decompressed,	// decoded to PCM at load: no decoding when played, the most memory
+	Compressed,		// the file in memory, decoded by each voice playing it
+	Stream,			// read and decoded from the file as it plays, a small buffer per sound
+};
+
+// What CAudioEngine needs from whatever makes the sound: loaded sounds and the
+// channels playing them. The engine keeps the voice table, priorities and
+// virtualization, a backend only starts, moves and stops what it is told to.
+// Sounds and channels are ids; a channel id stays invalid once its channel ended,
+// even when the slot is reused.
+//
+// FmodAudioBackend plays through FMOD Studio. SoftwareAudioBackend mixes into
+// memory or a WAV file on any machine, for headless runs, tests and benchmarks.
+class AudioBackend
+{
+public:
+	virtual ~AudioBackend() {}
+
+	virtual const char* name() const = 0;
+
+	// Opens a sound by the name it ships under (archive entry or file), -1 if it
+	// can't be loaded
+	virtual int createSound(const std::string& name, bool b3d, bool bLooping, SoundCache cache) = 0;
+	virtual void releaseSound(int sound) = 0;
+	virtual unsigned int soundLengthMs(int sound) const = 0;
+	// what the sound holds in memory while loaded, as the backend keeps it
+	virtual size_t soundMemoryBytes(int sound) const = 0;
+	// 0 most important .. 256 least, for a backend that steals channels itself
+	virtual void setSoundPriority(int sound, int priority) {}
+
+	// Starts sound positionMs in, -1 if no channel is free. position is ignored for
+	// 2D sounds, volume is linear.
+	virtual int play(int sound, const glm::vec3& position, float volume, unsigned int positionMs) = 0;
+	virtual bool isPlaying(int channel) = 0;
+	virtual void stop(int channel) = 0;
+	virtual void setPosition(int channel, const glm::vec3& position) = 0;
+	virtual void setVolume(int channel, float volume) = 0;
+
+	// right-handed, as GL: look and up are unit vectors, right is look x up
+	virtual void setListener(const glm::vec3& position, const glm::vec3& look, const glm::vec3& up) = 0;
+
+	// once per engine update
+	virtual void update() = 0;
+
+	// how long a started voice takes to be heard, from the output buffers
+	virtual double outputLatencyMs() const { return 0.0; }
+};
+
+#endif
@@ -1,4 +1,10 @@
 #include "AudioEngine.h"
+#include "AudioBackend.h"
+#include "FmodAudioBackend.h"
+#include "SoftwareAudioBackend.h"
+
+#include <algorithm>
+#include <chrono>
 
 // adopted from: https://codyclaborn.me/tutorials/making-a-basic-fmod-audio-engine-in-c/
 
@@ -6,182 +12,432 @@
  * Implementation
  */
 
-Implementation::Implementation() {
-	mpStudioSystem = NULL;
-	CAudioEngine::ErrorCheck(FMOD::Studio::System::create(&mpStudioSystem));
-	CAudioEngine::ErrorCheck(mpStudioSystem->initialize(32, FMOD_STUDIO_INIT_LIVEUPDATE, FMOD_INIT_PROFILE_ENABLE, NULL));
+namespace {
+	double Now() {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	const char* SoundCacheName(SoundCache eCache) {
+		switch (eCache) {
+		case SoundCache::Decompressed: return "decompressed";
+		case SoundCache::Compressed: return "compressed";
+		default: return "streamed";
+		}
+	}
 
-	mpSystem = NULL;
-	CAudioEngine::ErrorCheck(mpStudioSystem->getCoreSystem(&mpSystem));
+	int VoiceHandle(const Voice& voice, int nIndex) {
+		// masked so a handle stays positive
+		return (int)(((voice.nGeneration & 0xffffff) << VOICE_INDEX_BITS) | (unsigned int)nIndex);
+	}
+}
+
+Implementation::Implementation(AudioBackend* pBackend) {
+	mpBackend = pBackend;
+#ifndef MINIMALVR_NO_FMOD
+	mpFmod = dynamic_cast<FmodAudioBackend*>(pBackend);
+#else
+	mpFmod = nullptr;
+#endif
+
+	for (Voice& voice : mVoices) {
+		voice = Voice();
+		voice.nChannel = -1;
+	}
+	mnRealVoices = 0;
+	mvListenerPosition = glm::vec3(0);
+	mnSoundBytes = 0;
+	mnSoundBudget = 0;
 }
 
 Implementation::~Implementation() {
-	CAudioEngine::ErrorCheck(mpStudioSystem->unloadAll());
-	CAudioEngine::ErrorCheck(mpStudioSystem->release());
+	delete mpBackend;
+}
+
+float Implementation::Audibility(const Voice& voice) const {
+	float fAudibility = voice.fVolume;
+	if (voice.pSound->b3d) {
+		// inverse rolloff with a 1 m minimum distance
+		float fDistance = glm::length(voice.vPosition - mvListenerPosition);
+		fAudibility /= fDistance > 1.0f ? fDistance : 1.0f;
+	}
+	return fAudibility;
+}
+
+Voice* Implementation::FindVoice(int nHandle) {
+	if (nHandle < 0)
+		return nullptr;
+	Voice& voice = mVoices[nHandle & (MAX_VOICES - 1)];
+	if (!voice.pSound || VoiceHandle(voice, nHandle & (MAX_VOICES - 1)) != nHandle)
+		return nullptr;
+	return &voice;
+}
+
+void Implementation::StartChannel(Voice& voice, double dNow) {
+	// a voice coming back from virtual resumes where it would be by now
+	unsigned int nPositionMs = (unsigned int)((dNow - voice.dStartTime) * 1000.0);
+	if (voice.pSound->nLengthMs > 0)
+		nPositionMs %= voice.pSound->nLengthMs;
+	int nChannel = mpBackend->play(voice.pSound->nSound, voice.vPosition, voice.fVolume, nPositionMs);
+	if (nChannel < 0)
+		return;
+	voice.nChannel = nChannel;
+	mnRealVoices++;
+}
+
+void Implementation::FreeVoice(Voice& voice) {
+	if (voice.nChannel >= 0) {
+		mpBackend->stop(voice.nChannel);
+		voice.nChannel = -1;
+		mnRealVoices--;
+	}
+	voice.pSound->nInstances--;
+	voice.pSound = nullptr;
+	voice.nGeneration++;
 }
 
 void Implementation::Update() {
-	vector<ChannelMap::iterator> pStoppedChannels;
-	for (auto it = mChannels.begin(), itEnd = mChannels.end(); it != itEnd; ++it)
-	{
-		bool bIsPlaying = false;
-		it->second->isPlaying(&bIsPlaying);
-		if (!bIsPlaying)
-		{
-			pStoppedChannels.push_back(it);
+	double dNow = Now();
+
+	// reclaim finished voices, then rank the rest: priority first, then audibility
+	int nOrder[MAX_VOICES];
+	int nActive = 0;
+	for (int i = 0; i < MAX_VOICES; i++) {
+		Voice& voice = mVoices[i];
+		if (!voice.pSound)
+			continue;
+		bool bFinished;
+		if (voice.nChannel >= 0) {
+			bFinished = !mpBackend->isPlaying(voice.nChannel);
 		}
+		else {
+			bFinished = !voice.pSound->bLooping && (dNow - voice.dStartTime) * 1000.0 >= voice.pSound->nLengthMs;
+		}
+		if (bFinished) {
+			FreeVoice(voice);
+			continue;
+		}
+		voice.fAudibility = Audibility(voice);
+		nOrder[nActive++] = i;
 	}
-	for (auto& it : pStoppedChannels)
-	{
-		mChannels.erase(it);
+	std::sort(nOrder, nOrder + nActive, [this](int a, int b) {
+		const Voice& va = mVoices[a];
+		const Voice& vb = mVoices[b];
+		if (va.pSound->nPriority != vb.pSound->nPriority)
+			return va.pSound->nPriority < vb.pSound->nPriority;
+		return va.fAudibility > vb.fAudibility;
+	});
+
+	// give up channels first, so the ones coming back fit in the budget
+	for (int i = 0; i < nActive; i++) {
+		Voice& voice = mVoices[nOrder[i]];
+		if (voice.nChannel >= 0 && (i >= MAX_REAL_VOICES || voice.fAudibility < VIRTUAL_AUDIBILITY)) {
+			mpBackend->stop(voice.nChannel);
+			voice.nChannel = -1;
+			mnRealVoices--;
+			mStats.nVirtualized++;
+		}
+	}
+	for (int i = 0; i < nActive && mnRealVoices < MAX_REAL_VOICES; i++) {
+		Voice& voice = mVoices[nOrder[i]];
+		if (voice.nChannel < 0 && i < MAX_REAL_VOICES && voice.fAudibility >= REAL_AUDIBILITY) {
+			StartChannel(voice, dNow);
+		}
 	}
-	CAudioEngine::ErrorCheck(mpStudioSystem->update());
+
+	mpBackend->update();
 }
 
 /****
 * CAudioEngine
 */
 
-CAudioEngine::CAudioEngine()
-{
-	if (FMOD::System_Create(&m_pSystem) != FMOD_OK)
-	{
-		// Report Error
-		printf("audio error");
-		return;
+Implementation* sgpImplementation = nullptr;
+
+void CAudioEngine::Init(AudioBackend* pBackend) {
+	if (!pBackend) {
+#ifndef MINIMALVR_NO_FMOD
+		pBackend = new FmodAudioBackend(MAX_REAL_VOICES);
+#else
+		pBackend = new SoftwareAudioBackend(MAX_REAL_VOICES);
+#endif
 	}
+	sgpImplementation = new Implementation(pBackend);
+}
 
-	int driverCount = 0;
-	m_pSystem->getNumDrivers(&driverCount);
+void CAudioEngine::Update() {
+	sgpImplementation->Update();
+}
 
-	if (driverCount == 0)
-	{
-		// Report Error
-		printf("audio driver error");
-		return;
+VoiceStats CAudioEngine::GetVoiceStats() {
+	VoiceStats stats = sgpImplementation->mStats;
+	for (const Voice& voice : sgpImplementation->mVoices) {
+		if (voice.pSound && voice.nChannel >= 0)
+			stats.nReal++;
+		else if (voice.pSound)
+			stats.nVirtual++;
 	}
+	return stats;
+}
 
-	// Initialize our Instance with 36 Channels
-	m_pSystem->init(36, FMOD_INIT_NORMAL, NULL);
+const char* CAudioEngine::GetBackendName() {
+	return sgpImplementation->mpBackend->name();
 }
 
-Implementation* sgpImplementation = nullptr;
+SoundId CAudioEngine::LoadSound(const std::string& strSoundName, bool b3d, bool bLooping, SoundCache eCache,
+	int nPriority, int nMaxInstances)
+{
+	Implementation& impl = *sgpImplementation;
+	SoundId nSoundId;
+	auto tFoundIt = impl.mSoundNames.find(strSoundName);
+	if (tFoundIt != impl.mSoundNames.end()) {
+		nSoundId = tFoundIt->second;
+		if (impl.mSounds[nSoundId].nSound >= 0)
+			return nSoundId;
+	}
+	else {
+		nSoundId = (SoundId)impl.mSounds.size();
+		impl.mSounds.emplace_back();
+		impl.mSoundNames[strSoundName] = nSoundId;
+	}
 
-void CAudioEngine::Init() {
-	sgpImplementation = new Implementation;
+	SoundInfo& info = impl.mSounds[nSoundId];
+	info = SoundInfo();
+	info.strName = strSoundName;
+	info.nSound = -1;
+	info.nPriority = nPriority;
+	info.nMaxInstances = nMaxInstances > 0 ? nMaxInstances : 1;
+	info.b3d = b3d;
+	info.bLooping = bLooping;
+
+	AudioBackend* pBackend = impl.mpBackend;
+	while (true) {
+		int nSound = pBackend->createSound(strSoundName, b3d, bLooping, eCache);
+		if (nSound < 0)
+			break;
+		size_t nBytes = pBackend->soundMemoryBytes(nSound);
+		bool bFits = impl.mnSoundBudget == 0 || impl.mnSoundBytes + nBytes <= impl.mnSoundBudget;
+		if (!bFits && eCache != SoundCache::Stream) {
+			SoundCache eCheaper = eCache == SoundCache::Decompressed ? SoundCache::Compressed : SoundCache::Stream;
+			cout << "Audio: " << strSoundName << " doesn't fit the sound budget " << SoundCacheName(eCache)
+				<< ", loading it " << SoundCacheName(eCheaper) << endl;
+			pBackend->releaseSound(nSound);
+			eCache = eCheaper;
+			continue;
+		}
+		if (!bFits) {
+			cout << "Audio: " << strSoundName << " takes the sounds " << (impl.mnSoundBytes + nBytes - impl.mnSoundBudget) / 1024
+				<< " KB past the budget" << endl;
+		}
+		pBackend->setSoundPriority(nSound, nPriority);
+		info.nSound = nSound;
+		info.eCache = eCache;
+		info.nBytes = nBytes;
+		info.nLengthMs = pBackend->soundLengthMs(nSound);
+		impl.mnSoundBytes += nBytes;
+		break;
+	}
+	return nSoundId;
 }
 
-void CAudioEngine::Update() {
-	sgpImplementation->Update();
+void CAudioEngine::PreloadSounds(const SoundManifestEntry* pEntries, size_t nCount, size_t nBudgetBytes)
+{
+	Implementation& impl = *sgpImplementation;
+	impl.mnSoundBudget = nBudgetBytes;
+	size_t nLoaded = 0;
+	for (size_t i = 0; i < nCount; i++) {
+		const SoundManifestEntry& entry = pEntries[i];
+		SoundId nSoundId = LoadSound(entry.strName, entry.b3d, entry.bLooping, entry.eCache, entry.nPriority, entry.nMaxInstances);
+		const SoundInfo& info = impl.mSounds[nSoundId];
+		if (info.nSound < 0)
+			continue;
+		nLoaded++;
+		cout << "Audio: " << entry.strName << " " << SoundCacheName(info.eCache) << ", " << info.nBytes / 1024 << " KB" << endl;
+	}
+	cout << "Audio: preloaded " << nLoaded << " of " << nCount << " sounds, " << impl.mnSoundBytes / 1024 << " KB";
+	if (nBudgetBytes)
+		cout << " of a " << nBudgetBytes / 1024 << " KB budget";
+	cout << endl;
 }
 
-void CAudioEngine::LoadSound(const std::string& strSoundName, bool b3d, bool bLooping, bool bStream)
+SoundId CAudioEngine::FindSound(const char* strSoundName) const
 {
-	auto tFoundIt = sgpImplementation->mSounds.find(strSoundName);
-	if (tFoundIt != sgpImplementation->mSounds.end())
-		return;
-
-	FMOD_MODE eMode = FMOD_DEFAULT;
-	eMode |= b3d ? FMOD_3D : FMOD_2D;
-	eMode |= bLooping ? FMOD_LOOP_NORMAL : FMOD_LOOP_OFF;
-	eMode |= bStream ? FMOD_CREATESTREAM : FMOD_CREATECOMPRESSEDSAMPLE;
+	auto tFoundIt = sgpImplementation->mSoundNames.find(strSoundName);
+	if (tFoundIt == sgpImplementation->mSoundNames.end())
+		return INVALID_SOUND;
+	return tFoundIt->second;
+}
 
-	FMOD::Sound* pSound = nullptr;
-	CAudioEngine::ErrorCheck(sgpImplementation->mpSystem->createSound(strSoundName.c_str(), eMode, nullptr, &pSound));
-	if (pSound) {
-		sgpImplementation->mSounds[strSoundName] = pSound;
-	}
+double CAudioEngine::GetOutputLatencyMs() {
+	return sgpImplementation->mpBackend->outputLatencyMs();
+}
 
+size_t CAudioEngine::GetSoundMemory() {
+	return sgpImplementation->mnSoundBytes;
 }
 
-void CAudioEngine::UnLoadSound(const std::string& strSoundName)
+void CAudioEngine::UnLoadSound(SoundId nSoundId)
 {
-	auto tFoundIt = sgpImplementation->mSounds.find(strSoundName);
-	if (tFoundIt == sgpImplementation->mSounds.end())
+	Implementation& impl = *sgpImplementation;
+	if (nSoundId < 0 || nSoundId >= (SoundId)impl.mSounds.size())
+		return;
+	SoundInfo& info = impl.mSounds[nSoundId];
+	if (info.nSound < 0)
 		return;
 
-	CAudioEngine::ErrorCheck(tFoundIt->second->release());
-	sgpImplementation->mSounds.erase(tFoundIt);
+	for (Voice& voice : impl.mVoices) {
+		if (voice.pSound == &info)
+			impl.FreeVoice(voice);
+	}
+	impl.mpBackend->releaseSound(info.nSound);
+	impl.mnSoundBytes -= info.nBytes;
+	info.nSound = -1;
+	info.nBytes = 0;
 }
 
-int CAudioEngine::PlaySounds(const string& strSoundName, const glm::vec3&vPosition, float fVolumedB)
+int CAudioEngine::PlaySounds(SoundId nSoundId, const glm::vec3&vPosition, float fVolumedB)
 {
+	Implementation& impl = *sgpImplementation;
+	if (nSoundId < 0 || nSoundId >= (SoundId)impl.mSounds.size() || impl.mSounds[nSoundId].nSound < 0)
+		return -1;
+	SoundInfo& sound = impl.mSounds[nSoundId];
+
+	// past its instance limit a sound replaces its own oldest voice, otherwise the
+	// new voice takes a free one or the least important, least audible of the rest
+	Voice candidate = {};
+	candidate.pSound = &sound;
+	candidate.nChannel = -1;
+	candidate.vPosition = vPosition;
+	candidate.fVolume = dbToVolume(fVolumedB);
+	candidate.fAudibility = impl.Audibility(candidate);
+	int nVictim = -1;
+	int nFree = -1;
+	for (int i = 0; i < MAX_VOICES; i++) {
+		const Voice& voice = impl.mVoices[i];
+		if (!voice.pSound) {
+			if (nFree < 0)
+				nFree = i;
+			continue;
+		}
+		if (sound.nInstances >= sound.nMaxInstances) {
+			if (voice.pSound == &sound && (nVictim < 0 || voice.dStartTime < impl.mVoices[nVictim].dStartTime))
+				nVictim = i;
+			continue;
+		}
+		if (nVictim < 0 || voice.pSound->nPriority > impl.mVoices[nVictim].pSound->nPriority
+			|| (voice.pSound->nPriority == impl.mVoices[nVictim].pSound->nPriority
+				&& voice.fAudibility < impl.mVoices[nVictim].fAudibility))
+			nVictim = i;
+	}
 
-	int nChannelId = sgpImplementation->mnNextChannelId++;
-	auto tFoundIt = sgpImplementation->mSounds.find(strSoundName);
-	if (tFoundIt == sgpImplementation->mSounds.end())
-	{
-		LoadSound(strSoundName);
-		tFoundIt = sgpImplementation->mSounds.find(strSoundName);
-		if (tFoundIt == sgpImplementation->mSounds.end())
-		{
-			return nChannelId;
+	int nIndex = nFree;
+	if (sound.nInstances >= sound.nMaxInstances || nFree < 0) {
+		const Voice& victim = impl.mVoices[nVictim];
+		if (sound.nInstances < sound.nMaxInstances
+			&& (victim.pSound->nPriority < sound.nPriority
+				|| (victim.pSound->nPriority == sound.nPriority && victim.fAudibility > candidate.fAudibility))) {
+			impl.mStats.nRejected++;
+			return -1;
 		}
+		impl.FreeVoice(impl.mVoices[nVictim]);
+		impl.mStats.nStolen++;
+		nIndex = nVictim;
 	}
-	FMOD::Channel* pChannel = nullptr;
-	CAudioEngine::ErrorCheck(sgpImplementation->mpSystem->playSound(tFoundIt->second, nullptr, true, &pChannel));
-	if (pChannel)
+
+	Voice& voice = impl.mVoices[nIndex];
+	candidate.nGeneration = voice.nGeneration;
+	candidate.dStartTime = Now();
+	voice = candidate;
+	sound.nInstances++;
+	impl.mStats.nPlayed++;
+	// inaudible or over budget it starts virtual, Update promotes it when it matters
+	if (impl.mnRealVoices < MAX_REAL_VOICES && voice.fAudibility >= REAL_AUDIBILITY) {
+		impl.StartChannel(voice, voice.dStartTime);
+	}
+	return VoiceHandle(voice, nIndex);
+}
+
+void CAudioEngine::StopChannel(int nChannelId)
+{
+	Voice* pVoice = sgpImplementation->FindVoice(nChannelId);
+	if (pVoice)
+		sgpImplementation->FreeVoice(*pVoice);
+}
+
+void CAudioEngine::StopAllChannels()
+{
+	for (Voice& voice : sgpImplementation->mVoices)
 	{
-		FMOD_MODE currMode;
-		tFoundIt->second->getMode(&currMode);
-		if (currMode & FMOD_3D) {
-			FMOD_VECTOR position = VectorToFmod(vPosition);
-			CAudioEngine::ErrorCheck(pChannel->set3DAttributes(&position, nullptr));
-		}
-		CAudioEngine::ErrorCheck(pChannel->setVolume(dbToVolume(fVolumedB)));
-		CAudioEngine::ErrorCheck(pChannel->setPaused(false));
-		sgpImplementation->mChannels[nChannelId] = pChannel;
+		if (voice.pSound)
+			sgpImplementation->FreeVoice(voice);
 	}
-	return nChannelId;
+}
+
+bool CAudioEngine::IsPlaying(int nChannelId) const
+{
+	return sgpImplementation->FindVoice(nChannelId) != nullptr;
 }
 
 void CAudioEngine::SetChannel3dPosition(int nChannelId, const glm::vec3& vPosition)
 {
-	auto tFoundIt = sgpImplementation->mChannels.find(nChannelId);
-	if (tFoundIt == sgpImplementation->mChannels.end())
+	Voice* pVoice = sgpImplementation->FindVoice(nChannelId);
+	if (!pVoice)
 		return;
 
-	FMOD_VECTOR position = VectorToFmod(vPosition);
-	CAudioEngine::ErrorCheck(tFoundIt->second->set3DAttributes(&position, NULL));
+	pVoice->vPosition = vPosition;
+	if (pVoice->nChannel >= 0 && pVoice->pSound->b3d)
+		sgpImplementation->mpBackend->setPosition(pVoice->nChannel, vPosition);
 }
 
 void CAudioEngine::SetChannelVolume(int nChannelId, float fVolumedB)
 {
-	auto tFoundIt = sgpImplementation->mChannels.find(nChannelId);
-	if (tFoundIt == sgpImplementation->mChannels.end())
+	Voice* pVoice = sgpImplementation->FindVoice(nChannelId);
+	if (!pVoice)
 		return;
 
-	CAudioEngine::ErrorCheck(tFoundIt->second->setVolume(dbToVolume(fVolumedB)));
+	pVoice->fVolume = dbToVolume(fVolumedB);
+	if (pVoice->nChannel >= 0)
+		sgpImplementation->mpBackend->setVolume(pVoice->nChannel, pVoice->fVolume);
 }
 
 
-void CAudioEngine::LoadBank(const std::string& strBankName, FMOD_STUDIO_LOAD_BANK_FLAGS flags) {
+void CAudioEngine::LoadBank(const std::string& strBankName, unsigned int flags) {
+#ifndef MINIMALVR_NO_FMOD
+	if (!sgpImplementation->mpFmod) {
+		cout << "Audio: " << strBankName << " needs the FMOD backend" << endl;
+		return;
+	}
 	auto tFoundIt = sgpImplementation->mBanks.find(strBankName);
 	if (tFoundIt != sgpImplementation->mBanks.end())
 		return;
-	FMOD::Studio::Bank* pBank;
-	CAudioEngine::ErrorCheck(sgpImplementation->mpStudioSystem->loadBankFile(strBankName.c_str(), flags, &pBank));
+	FMOD::Studio::Bank* pBank = NULL;
+	FmodAudioBackend::ErrorCheck(sgpImplementation->mpFmod->studio()->loadBankFile(strBankName.c_str(), flags, &pBank));
 	if (pBank) {
 		sgpImplementation->mBanks[strBankName] = pBank;
 	}
+#endif
 }
 
 void CAudioEngine::LoadEvent(const std::string& strEventName) {
+#ifndef MINIMALVR_NO_FMOD
+	if (!sgpImplementation->mpFmod)
+		return;
 	auto tFoundit = sgpImplementation->mEvents.find(strEventName);
 	if (tFoundit != sgpImplementation->mEvents.end())
 		return;
 	FMOD::Studio::EventDescription* pEventDescription = NULL;
-	CAudioEngine::ErrorCheck(sgpImplementation->mpStudioSystem->getEvent(strEventName.c_str(), &pEventDescription));
+	FmodAudioBackend::ErrorCheck(sgpImplementation->mpFmod->studio()->getEvent(strEventName.c_str(), &pEventDescription));
 	if (pEventDescription) {
 		FMOD::Studio::EventInstance* pEventInstance = NULL;
-		CAudioEngine::ErrorCheck(pEventDescription->createInstance(&pEventInstance));
+		FmodAudioBackend::ErrorCheck(pEventDescription->createInstance(&pEventInstance));
 		if (pEventInstance) {
 			sgpImplementation->mEvents[strEventName] = pEventInstance;
 		}
 	}
+#endif
 }
 
 void CAudioEngine::PlayEvent(const string &strEventName) {
+#ifndef MINIMALVR_NO_FMOD
 	auto tFoundit = sgpImplementation->mEvents.find(strEventName);
 	if (tFoundit == sgpImplementation->mEvents.end()) {
 		LoadEvent(strEventName);
@@ -190,18 +446,22 @@ void CAudioEngine::PlayEvent(const string &strEventName) {
 			return;
 	}
 	tFoundit->second->start();
+#endif
 }
 
 void CAudioEngine::StopEvent(const string &strEventName, bool bImmediate) {
+#ifndef MINIMALVR_NO_FMOD
 	auto tFoundIt = sgpImplementation->mEvents.find(strEventName);
 	if (tFoundIt == sgpImplementation->mEvents.end())
 		return;
 	FMOD_STUDIO_STOP_MODE eMode;
 	eMode = bImmediate ? FMOD_STUDIO_STOP_IMMEDIATE : FMOD_STUDIO_STOP_ALLOWFADEOUT;
-	CAudioEngine::ErrorCheck(tFoundIt->second->stop(eMode));
+	FmodAudioBackend::ErrorCheck(tFoundIt->second->stop(eMode));
+#endif
 }
 
 bool CAudioEngine::IsEventPlaying(const string &strEventName) const {
+#ifndef MINIMALVR_NO_FMOD
 	auto tFoundIt = sgpImplementation->mEvents.find(strEventName);
 	if (tFoundIt == sgpImplementation->mEvents.end())
 		return false;
@@ -210,26 +470,10 @@ bool CAudioEngine::IsEventPlaying(const string &strEventName) const {
 	if (tFoundIt->second->getPlaybackState(state) == FMOD_STUDIO_PLAYBACK_PLAYING) {
 		return true;
 	}
+#endif
 	return false;
 }
 
-FMOD_VECTOR CAudioEngine::VectorToFmod(const glm::vec3& vPosition) {
-	FMOD_VECTOR fVec;
-	fVec.x = vPosition.x;
-	fVec.y = vPosition.y;
-	fVec.z = vPosition.z;
-	return fVec;
-}
-
-int CAudioEngine::ErrorCheck(FMOD_RESULT result) {
-	if (result != FMOD_OK) {
-		cout << "FMOD ERROR " << result << endl;
-		return 1;
-	}
-	// cout << "FMOD all good" << endl;
-	return 0;
-}
-
 float  CAudioEngine::dbToVolume(float dB)
 {
 	return powf(10.0f, 0.05f * dB);
@@ -245,6 +489,6 @@ void CAudioEngine::Shutdown() {
 }
 
 void CAudioEngine::Set3dListenerAndOrientation(const glm::vec3&vPosition, const glm::vec3&vLook, const glm::vec3& vUp) {
-	sgpImplementation->mpSystem->set3DListenerAttributes(0, &VectorToFmod(vPosition), &VectorToFmod(glm::vec3(0)),
-		&VectorToFmod(vLook), &VectorToFmod(vUp));
+	sgpImplementation->mvListenerPosition = vPosition;
+	sgpImplementation->mpBackend->setListener(vPosition, vLook, vUp);
 }
@@ -1,56 +1,150 @@
 #ifndef AUDIO_ENGINE_H
 #define AUDIO_ENGINE_H
 
-#include "Cube.h"
-#include "fmod_studio.hpp"
-#include "fmod.hpp"
+#include <glm/glm.hpp>
 #include <string>
+#include <deque>
 #include <map>
 #include <vector>
 #include <math.h>
 #include <iostream>
 
+#include "AudioBackend.h"
+
+class FmodAudioBackend;
+namespace FMOD { namespace Studio { class Bank; class EventInstance; } }
+
 using namespace std;
 
+// Voices are the sounds playing or waiting to. A voice is real while it has a backend
+// channel and virtual while it only keeps time: the quiet ones, and those past the
+// real voice budget in priority order, give up their channel and get it back (at
+// the position they would have reached) once they are loud and important enough.
+// The table is fixed, so a play allocates nothing and collision spam can't grow it;
+// a full table steals the least important voice or turns the new one down.
+const int MAX_VOICES = 64;
+const int MAX_REAL_VOICES = 32;		// the channels the backend is created with
+const int VOICE_INDEX_BITS = 6;		// a voice handle is (generation << 6) | index
+// below -60 dB a voice goes virtual, it comes back above -54 dB
+const float VIRTUAL_AUDIBILITY = 0.001f;
+const float REAL_AUDIBILITY = 0.002f;
+
+// Sounds are interned: LoadSound and PreloadSounds hand out a SoundId once at startup,
+// and plays name the sound by it, so triggering one never looks up a name or opens a
+// file. An id stays valid after its sound is unloaded or failed to load; playing it
+// is then a no-op.
+typedef int SoundId;
+const SoundId INVALID_SOUND = -1;
+
+// A sound to load at startup and how to keep it; see CAudioEngine::PreloadSounds
+struct SoundManifestEntry {
+	const char* strName;
+	bool b3d;
+	bool bLooping;
+	SoundCache eCache;
+	int nPriority;
+	int nMaxInstances;
+};
+
+struct SoundInfo {
+	string strName;
+	int nSound;				// the backend's id, -1 while not loaded
+	SoundCache eCache;		// as loaded, which the budget may have made cheaper
+	size_t nBytes;
+	int nPriority;			// 0 most important .. 256 least, as FMOD counts
+	int nMaxInstances;		// another play steals the oldest instance
+	unsigned int nLengthMs;
+	bool b3d;
+	bool bLooping;
+	int nInstances;
+};
+
+struct Voice {
+	SoundInfo* pSound;		// nullptr while the voice is free
+	int nChannel;			// the backend's channel, -1 while virtual
+	unsigned int nGeneration;	// bumped on free, so old handles miss
+	glm::vec3 vPosition;
+	float fVolume;
+	float fAudibility;
+	double dStartTime;		// seconds, where a virtual voice is in its sound
+};
+
+struct VoiceStats {
+	int nReal = 0;
+	int nVirtual = 0;
+	size_t nPlayed = 0;
+	size_t nStolen = 0;		// voices ended early for a new play
+	size_t nRejected = 0;	// plays turned down by a full table
+	size_t nVirtualized = 0;
+};
+
 struct Implementation {
-	Implementation();
+	explicit Implementation(AudioBackend* pBackend);
 	~Implementation();
 
 	void Update();
 
-	FMOD::Studio::System* mpStudioSystem;
-	FMOD::System* mpSystem;
+	// volume times the distance rolloff FMOD applies by default
+	float Audibility(const Voice& voice) const;
+	Voice* FindVoice(int nHandle);
+	void StartChannel(Voice& voice, double dNow);
+	void FreeVoice(Voice& voice);
 
-	int mnNextChannelId;
+	AudioBackend* mpBackend;
+	FmodAudioBackend* mpFmod;	// the same backend when it is FMOD, banks and events need it
 
-	typedef map<string, FMOD::Sound*> SoundMap;
-	typedef map<int, FMOD::Channel*> ChannelMap;
+	// names are looked up while loading only; std::less<> finds them by const char*
+	typedef map<string, SoundId, less<>> SoundNameMap;
 	typedef map<string, FMOD::Studio::EventInstance*> EventMap;
 	typedef map<string, FMOD::Studio::Bank*> BankMap;
 
 	BankMap mBanks;
 	EventMap mEvents;
-	SoundMap mSounds;
-	ChannelMap mChannels;
+	// by SoundId; a deque keeps the voices' pointers valid as sounds are added
+	deque<SoundInfo> mSounds;
+	SoundNameMap mSoundNames;
+	size_t mnSoundBytes;
+	size_t mnSoundBudget;	// 0 for none
+
+	Voice mVoices[MAX_VOICES];
+	int mnRealVoices;
+	glm::vec3 mvListenerPosition;
+	VoiceStats mStats;
 };
 
 class CAudioEngine {
 public:
-	static void Init();
+	// takes the backend over; by default FMOD, or the software mixer in builds without it
+	static void Init(AudioBackend* pBackend = nullptr);
 	static void Update();
 	static void Shutdown();
-	static int ErrorCheck(FMOD_RESULT result); 
-
-	void LoadBank(const string& strBankName, FMOD_STUDIO_LOAD_BANK_FLAGS flags);
+	static VoiceStats GetVoiceStats();
+	static const char* GetBackendName();
+	static double GetOutputLatencyMs();
+	// what the loaded sounds hold, as the backend reports it
+	static size_t GetSoundMemory();
+
+	// banks and events are FMOD Studio's, other backends ignore them
+	void LoadBank(const string& strBankName, unsigned int flags);
 	void LoadEvent(const string& strEventName);
-	void LoadSound(const string& strSoundName, bool b3d = true, bool bLooping = false, bool bStream = false);
-	void UnLoadSound(const string& strSoundName);
+	// Interns the sound and loads it unless it is loaded. A sound that would take the
+	// sounds past the budget is kept the next cheaper way, decompressed -> compressed
+	// -> streamed; a stream is loaded even over the budget, with a warning.
+	SoundId LoadSound(const string& strSoundName, bool b3d = true, bool bLooping = false,
+		SoundCache eCache = SoundCache::Compressed, int nPriority = 128, int nMaxInstances = 4);
+	// loads the manifest in order within nBudgetBytes (0 for no budget) and reports it
+	void PreloadSounds(const SoundManifestEntry* pEntries, size_t nCount, size_t nBudgetBytes);
+	// INVALID_SOUND if the name was never loaded; for startup, not the frame loop
+	SoundId FindSound(const char* strSoundName) const;
+	void UnLoadSound(SoundId nSoundId);
 	void Set3dListenerAndOrientation(const glm::vec3&vPosition, const glm::vec3&vLook, const glm::vec3& vUp);
 	
 	void SetChannel3dPosition(int nChannelId, const glm::vec3& vPosition);
 	void SetChannelVolume(int nChannelId, float fVolumedB);
 
-	int PlaySounds(const string& strSoundName, const glm::vec3&vPosition = glm::vec3(0), float fVolumedB = 0.0f);
+	// returns the voice handle for the channel calls, -1 if the sound isn't loaded or
+	// every voice is more important
+	int PlaySounds(SoundId nSoundId, const glm::vec3&vPosition = glm::vec3(0), float fVolumedB = 0.0f);
 	void PlayEvent(const string &strEventName);
 	void StopChannel(int nChannelId);
 	void StopEvent(const string &strEventName, bool bImmediate = false);
@@ -60,15 +154,8 @@ public:
 	bool IsPlaying(int nChannelId) const;
 	bool IsEventPlaying(const string &strEventName) const;
 
-	FMOD_VECTOR VectorToFmod(const glm::vec3& vPosition);
-	float dbToVolume(float db);
+	static float dbToVolume(float db);
 	float VolumeTodB(float volume);
-	
-
-
-	FMOD::System *m_pSystem;
-	CAudioEngine();
-
 };
 
 #endif
\ No newline at end of file
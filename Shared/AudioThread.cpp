@@ -0,0 +1,169 @@
+#include "AudioThread.h"
+
+#include <iostream>
+
+#include "AudioEngine.h"
+
+AudioThread::~AudioThread()
+{
+	stop();
+}
+
+void AudioThread::start(CAudioEngine* engine, std::chrono::milliseconds period)
+{
+	stop();
+	_engine = engine;
+	_period = period;
+	_stopping = false;
+	for (int i = 0; i < PLAY_TICKETS; i++)
+		_ticketIds[i] = -1;
+	_started = std::chrono::steady_clock::now();
+	_thread = std::thread(&AudioThread::threadMain, this);
+}
+
+void AudioThread::stop()
+{
+	if (!_thread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(_wakeMutex);
+		_stopping = true;
+	}
+	_wakeCondition.notify_one();
+	_thread.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _started).count();
+	std::cout << "Audio thread: " << _updates << " updates, " << _executed << " commands, " << _dropped << " dropped, busy "
+		<< (seconds > 0.0 ? 100.0 * _busySeconds / seconds : 0.0) << "% of one core" << std::endl;
+	VoiceStats voices = CAudioEngine::GetVoiceStats();
+	std::cout << "Audio voices: " << voices.nPlayed << " played, " << voices.nStolen << " stolen, " << voices.nRejected
+		<< " rejected, " << voices.nVirtualized << " virtualized" << std::endl;
+}
+
+int AudioThread::play(int sound, const glm::vec3& position, float volumedB, const GameEventStamp* stamp)
+{
+	Command command = {};
+	command.type = CommandType::Play;
+	command.channel = _nextTicket++ & 0x7fffffff;
+	command.volumedB = volumedB;
+	command.position = position;
+	command.sound = sound;
+	if (stamp)
+	{
+		command.timed = true;
+		command.stamp = *stamp;
+		command.stamp.enqueuedUs = latencyClockUs();
+	}
+	return post(command, true) ? command.channel : -1;
+}
+
+void AudioThread::stopChannel(int ticket)
+{
+	Command command = {};
+	command.type = CommandType::Stop;
+	command.channel = ticket;
+	post(command, true);
+}
+
+void AudioThread::stopAll()
+{
+	Command command = {};
+	command.type = CommandType::StopAll;
+	post(command, true);
+}
+
+void AudioThread::setListener(const glm::vec3& position, const glm::vec3& look, const glm::vec3& up)
+{
+	Command command = {};
+	command.type = CommandType::Listener;
+	command.position = position;
+	command.look = look;
+	command.up = up;
+	// a pose can wait for the next period, and a dropped one is replaced next frame
+	post(command, false);
+}
+
+bool AudioThread::post(const Command& command, bool wake)
+{
+	if (!_commands.push(command))
+	{
+		_dropped++;
+		return false;
+	}
+	// The notify isn't under the mutex, so the game thread never blocks on it. A wake
+	// racing the audio thread going to sleep is lost; the command then runs within a period.
+	if (wake && !_wake.exchange(true))
+		_wakeCondition.notify_one();
+	return true;
+}
+
+void AudioThread::drain()
+{
+	Command command;
+	Command listener;
+	bool haveListener = false;
+	while (_commands.pop(command))
+	{
+		switch (command.type)
+		{
+		case CommandType::Play:
+		{
+			int slot = command.channel & (PLAY_TICKETS - 1);
+			_ticketIds[slot] = command.channel;
+			_ticketVoices[slot] = _engine->PlaySounds(command.sound, command.position, command.volumedB);
+			if (command.timed && _ticketVoices[slot] >= 0)
+				eventLatency.record(command.stamp, latencyClockUs());
+			break;
+		}
+		case CommandType::Stop:
+		{
+			int slot = command.channel & (PLAY_TICKETS - 1);
+			if (command.channel >= 0 && _ticketIds[slot] == command.channel)
+				_engine->StopChannel(_ticketVoices[slot]);
+			break;
+		}
+		case CommandType::StopAll:
+			_engine->StopAllChannels();
+			break;
+		case CommandType::Listener:
+			listener = command;
+			haveListener = true;
+			continue;
+		}
+		_executed++;
+	}
+	if (haveListener)
+	{
+		_engine->Set3dListenerAndOrientation(listener.position, listener.look, listener.up);
+		_executed++;
+	}
+}
+
+void AudioThread::threadMain()
+{
+	auto nextUpdate = std::chrono::steady_clock::now();
+	while (true)
+	{
+		auto busyStart = std::chrono::steady_clock::now();
+		_wake = false;
+		drain();
+		if (busyStart >= nextUpdate)
+		{
+			// reclaims finished channels and advances FMOD's mixer state
+			_engine->Update();
+			_updates++;
+			nextUpdate += _period;
+			if (nextUpdate < busyStart)
+				nextUpdate = busyStart + _period;
+		}
+		auto busyEnd = std::chrono::steady_clock::now();
+		_busySeconds += std::chrono::duration<double>(busyEnd - busyStart).count();
+
+		std::unique_lock<std::mutex> lock(_wakeMutex);
+		if (_stopping)
+			break;
+		_wakeCondition.wait_until(lock, nextUpdate, [this] { return _wake.load() || _stopping.load(); });
+	}
+	drain();
+	_engine->Update();
+}
@@ -0,0 +1,91 @@
+#ifndef AUDIO_THREAD_H
+#define AUDIO_THREAD_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <glm/glm.hpp>
+
+#include "EventLatency.h"
+#include "MpscQueue.h"
+
+class CAudioEngine;
+
+// Owns CAudioEngine once started: the audio thread updates the engine every period
+// and runs the commands other threads post, so the game thread never calls into FMOD
+// or waits on it. Posting is lock-free and allocation-free; play and stop also wake
+// the thread so they aren't held back for the rest of a period. The listener is
+// posted by value each frame and only the latest pose of a period is applied.
+class AudioThread
+{
+public:
+	AudioThread() {}
+	~AudioThread();
+
+	AudioThread(const AudioThread&) = delete;
+	AudioThread& operator=(const AudioThread&) = delete;
+
+	// after CAudioEngine::Init; from here on only the audio thread touches engine
+	void start(CAudioEngine* engine, std::chrono::milliseconds period = std::chrono::milliseconds(10));
+	// runs what is still queued, then prints the thread's load and the voice counts
+	void stop();
+
+	// Any thread, never blocks. play takes a SoundId from CAudioEngine and returns a
+	// ticket for stopChannel, -1 if the queue was full and the sound dropped. Commands
+	// posted before start() wait for it. A play for a gameplay event passes the event's
+	// stamp; it is enqueued now and recorded in eventLatency once the voice starts.
+	int play(int sound, const glm::vec3& position = glm::vec3(0), float volumedB = 0.0f,
+		const GameEventStamp* stamp = nullptr);
+	void stopChannel(int ticket);
+	void stopAll();
+	void setListener(const glm::vec3& position, const glm::vec3& look, const glm::vec3& up);
+
+private:
+	enum class CommandType { Play, Stop, StopAll, Listener };
+
+	struct Command {
+		CommandType type;
+		int channel;			// play ticket
+		int sound;				// SoundId
+		float volumedB;
+		glm::vec3 position;
+		glm::vec3 look;
+		glm::vec3 up;
+		bool timed;
+		GameEventStamp stamp;
+	};
+
+	// false if the queue is full; wake for commands that shouldn't wait for the period
+	bool post(const Command& command, bool wake);
+	void threadMain();
+	// runs the queued commands
+	void drain();
+
+	CAudioEngine* _engine = nullptr;
+	std::chrono::milliseconds _period{ 10 };
+	std::thread _thread;
+	std::atomic<bool> _stopping{ false };
+
+	MpscQueue<Command, 256> _commands;
+	std::atomic<int> _nextTicket{ 0 };
+	// the voice handle of each recent ticket, audio thread only; a ticket more than
+	// PLAY_TICKETS plays old can't be stopped anymore
+	static const int PLAY_TICKETS = 1024;
+	int _ticketIds[PLAY_TICKETS];
+	int _ticketVoices[PLAY_TICKETS];
+	std::atomic<bool> _wake{ false };
+	std::mutex _wakeMutex;
+	std::condition_variable _wakeCondition;
+
+	// counters of the audio thread, reported by stop()
+	std::chrono::steady_clock::time_point _started;
+	size_t _updates = 0;
+	size_t _executed = 0;
+	std::atomic<size_t> _dropped{ 0 };
+	double _busySeconds = 0.0;
+};
+
+#endif
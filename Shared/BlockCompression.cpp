@@ -0,0 +1,452 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	struct Color565 {
+		uint16_t packed;
+		int r, g, b; // expanded back to 8 bits
+	};
+
+	Color565 quantize565(float r, float g, float b)
+	{
+		int r5 = std::min(31, std::max(0, (int)(r * 31.0f / 255.0f + 0.5f)));
+		int g6 = std::min(63, std::max(0, (int)(g * 63.0f / 255.0f + 0.5f)));
+		int b5 = std::min(31, std::max(0, (int)(b * 31.0f / 255.0f + 0.5f)));
+		Color565 c;
+		c.packed = (uint16_t)((r5 << 11) | (g6 << 5) | b5);
+		c.r = (r5 << 3) | (r5 >> 2);
+		c.g = (g6 << 2) | (g6 >> 4);
+		c.b = (b5 << 3) | (b5 >> 2);
+		return c;
+	}
+
+	Color565 unpack565(uint16_t packed)
+	{
+		int r5 = (packed >> 11) & 31, g6 = (packed >> 5) & 63, b5 = packed & 31;
+		Color565 c;
+		c.packed = packed;
+		c.r = (r5 << 3) | (r5 >> 2);
+		c.g = (g6 << 2) | (g6 >> 4);
+		c.b = (b5 << 3) | (b5 >> 2);
+		return c;
+	}
+
+	// BC1 palette in index order: c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+	// (three colors and black when c0 <= c1)
+	void colorPalette(const Color565& c0, const Color565& c1, int palette[4][3])
+	{
+		int a[3] = { c0.r, c0.g, c0.b };
+		int b[3] = { c1.r, c1.g, c1.b };
+		for (int ch = 0; ch < 3; ch++)
+		{
+			palette[0][ch] = a[ch];
+			palette[1][ch] = b[ch];
+			if (c0.packed > c1.packed)
+			{
+				palette[2][ch] = (2 * a[ch] + b[ch]) / 3;
+				palette[3][ch] = (a[ch] + 2 * b[ch]) / 3;
+			}
+			else
+			{
+				palette[2][ch] = (a[ch] + b[ch]) / 2;
+				palette[3][ch] = 0;
+			}
+		}
+	}
+
+	// picks the closest palette entry per pixel, returns the summed squared error
+	int chooseColorIndices(const uint8_t block[16][4], const int palette[4][3], uint8_t indices[16])
+	{
+		int total = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestError = 1 << 30;
+			for (int p = 0; p < 4; p++)
+			{
+				int dr = block[i][0] - palette[p][0];
+				int dg = block[i][1] - palette[p][1];
+				int db = block[i][2] - palette[p][2];
+				int error = dr * dr + dg * dg + db * db;
+				if (error < bestError)
+				{
+					bestError = error;
+					best = p;
+				}
+			}
+			indices[i] = (uint8_t)best;
+			total += bestError;
+		}
+		return total;
+	}
+
+	// orders the endpoints so c0 > c1 (four color mode) and encodes the indices
+	int encodeColorEndpoints(const uint8_t block[16][4], Color565 c0, Color565 c1, uint8_t out[8])
+	{
+		if (c0.packed < c1.packed)
+			std::swap(c0, c1);
+
+		uint8_t indices[16] = {};
+		int error;
+		if (c0.packed == c1.packed)
+		{
+			int palette[4][3];
+			colorPalette(c0, c1, palette);
+			error = 0;
+			for (int i = 0; i < 16; i++)
+				for (int ch = 0; ch < 3; ch++)
+					error += (block[i][ch] - palette[0][ch]) * (block[i][ch] - palette[0][ch]);
+		}
+		else
+		{
+			int palette[4][3];
+			colorPalette(c0, c1, palette);
+			error = chooseColorIndices(block, palette, indices);
+		}
+
+		uint32_t bits = 0;
+		for (int i = 0; i < 16; i++)
+			bits |= (uint32_t)indices[i] << (2 * i);
+		out[0] = (uint8_t)(c0.packed & 0xFF);
+		out[1] = (uint8_t)(c0.packed >> 8);
+		out[2] = (uint8_t)(c1.packed & 0xFF);
+		out[3] = (uint8_t)(c1.packed >> 8);
+		for (int i = 0; i < 4; i++)
+			out[4 + i] = (uint8_t)(bits >> (8 * i));
+		return error;
+	}
+
+	void encodeColorBlock(const uint8_t block[16][4], uint8_t out[8])
+	{
+		// principal axis of the block's colors by power iteration on the covariance
+		float mean[3] = {};
+		for (int i = 0; i < 16; i++)
+			for (int ch = 0; ch < 3; ch++)
+				mean[ch] += block[i][ch] / 16.0f;
+
+		float cov[6] = {}; // rr rg rb gg gb bb
+		float lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			float d[3] = { block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2] };
+			cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+			cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+			for (int ch = 0; ch < 3; ch++)
+			{
+				lo[ch] = std::min(lo[ch], (float)block[i][ch]);
+				hi[ch] = std::max(hi[ch], (float)block[i][ch]);
+			}
+		}
+
+		float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[3] = {
+				cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+				cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+				cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+			};
+			float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+			if (length < 1e-6f)
+				break;
+			for (int ch = 0; ch < 3; ch++)
+				axis[ch] = next[ch] / length;
+		}
+		float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		if (axisLength < 1e-6f)
+		{
+			// flat block
+			Color565 c = quantize565(mean[0], mean[1], mean[2]);
+			encodeColorEndpoints(block, c, c, out);
+			return;
+		}
+		for (int ch = 0; ch < 3; ch++)
+			axis[ch] /= axisLength;
+
+		float tMin = 1e9f, tMax = -1e9f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+			tMin = std::min(tMin, t);
+			tMax = std::max(tMax, t);
+		}
+		// pull the endpoints in a little, the extremes are rarely worth a whole palette entry
+		float inset = (tMax - tMin) / 16.0f;
+		tMin += inset;
+		tMax -= inset;
+
+		float e0[3], e1[3];
+		for (int ch = 0; ch < 3; ch++)
+		{
+			e0[ch] = mean[ch] + axis[ch] * tMax;
+			e1[ch] = mean[ch] + axis[ch] * tMin;
+		}
+		Color565 c0 = quantize565(e0[0], e0[1], e0[2]);
+		Color565 c1 = quantize565(e1[0], e1[1], e1[2]);
+		uint8_t best[8];
+		int bestError = encodeColorEndpoints(block, c0, c1, best);
+
+		// one least squares refit of the endpoints to the chosen indices
+		uint32_t bits = best[4] | (best[5] << 8) | (best[6] << 16) | ((uint32_t)best[7] << 24);
+		static const float weight[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		float aa = 0, ab = 0, bb = 0, ax[3] = {}, bx[3] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			float w = weight[(bits >> (2 * i)) & 3];
+			aa += w * w;
+			ab += w * (1 - w);
+			bb += (1 - w) * (1 - w);
+			for (int ch = 0; ch < 3; ch++)
+			{
+				ax[ch] += w * block[i][ch];
+				bx[ch] += (1 - w) * block[i][ch];
+			}
+		}
+		float det = aa * bb - ab * ab;
+		if (std::fabs(det) > 1e-6f)
+		{
+			float r0[3], r1[3];
+			for (int ch = 0; ch < 3; ch++)
+			{
+				r0[ch] = (ax[ch] * bb - bx[ch] * ab) / det;
+				r1[ch] = (bx[ch] * aa - ax[ch] * ab) / det;
+			}
+			uint8_t refit[8];
+			int refitError = encodeColorEndpoints(block, quantize565(r0[0], r0[1], r0[2]), quantize565(r1[0], r1[1], r1[2]), refit);
+			if (refitError < bestError)
+				memcpy(best, refit, sizeof(best));
+		}
+		memcpy(out, best, 8);
+	}
+
+	void channelPalette(int a0, int a1, int palette[8])
+	{
+		palette[0] = a0;
+		palette[1] = a1;
+		if (a0 > a1)
+		{
+			for (int i = 1; i < 7; i++)
+				palette[1 + i] = ((7 - i) * a0 + i * a1 + 3) / 7;
+		}
+		else
+		{
+			for (int i = 1; i < 5; i++)
+				palette[1 + i] = ((5 - i) * a0 + i * a1 + 2) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	void encodeChannelBlock(const uint8_t block[16][4], int channel, uint8_t out[8])
+	{
+		int lo = 255, hi = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			lo = std::min(lo, (int)block[i][channel]);
+			hi = std::max(hi, (int)block[i][channel]);
+		}
+
+		uint64_t bits = 0;
+		if (hi > lo)
+		{
+			int palette[8];
+			channelPalette(hi, lo, palette);
+			for (int i = 0; i < 16; i++)
+			{
+				int best = 0, bestError = 1 << 30;
+				for (int p = 0; p < 8; p++)
+				{
+					int error = std::abs(block[i][channel] - palette[p]);
+					if (error < bestError)
+					{
+						bestError = error;
+						best = p;
+					}
+				}
+				bits |= (uint64_t)best << (3 * i);
+			}
+		}
+		out[0] = (uint8_t)hi;
+		out[1] = (uint8_t)lo;
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = (uint8_t)(bits >> (8 * i));
+	}
+
+	void decodeColorBlock(const uint8_t* in, uint8_t block[16][4])
+	{
+		Color565 c0 = unpack565((uint16_t)(in[0] | (in[1] << 8)));
+		Color565 c1 = unpack565((uint16_t)(in[2] | (in[3] << 8)));
+		int palette[4][3];
+		colorPalette(c0, c1, palette);
+		uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+		for (int i = 0; i < 16; i++)
+		{
+			int index = (bits >> (2 * i)) & 3;
+			for (int ch = 0; ch < 3; ch++)
+				block[i][ch] = (uint8_t)palette[index][ch];
+			block[i][3] = (c0.packed <= c1.packed && index == 3) ? 0 : 255;
+		}
+	}
+
+	void decodeChannelBlock(const uint8_t* in, int channel, uint8_t block[16][4])
+	{
+		int palette[8];
+		channelPalette(in[0], in[1], palette);
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; i++)
+			bits |= (uint64_t)in[2 + i] << (8 * i);
+		for (int i = 0; i < 16; i++)
+			block[i][channel] = (uint8_t)palette[(bits >> (3 * i)) & 7];
+	}
+}
+
+size_t blockBytes(BlockFormat format)
+{
+	return format == BlockFormat::BC3 ? 16 : 8;
+}
+
+uint32_t glFormatOf(BlockFormat format)
+{
+	switch (format)
+	{
+	case BlockFormat::BC1: return GL_FORMAT_BC1;
+	case BlockFormat::BC3: return GL_FORMAT_BC3;
+	case BlockFormat::BC4: return GL_FORMAT_BC4;
+	}
+	return 0;
+}
+
+size_t compressedSize(BlockFormat format, int width, int height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+void compressImage(const uint8_t* rgba, int width, int height, BlockFormat format, std::vector<uint8_t>& blocks)
+{
+	blocks.resize(compressedSize(format, width, height));
+	uint8_t* out = blocks.data();
+	for (int by = 0; by < height; by += 4)
+	{
+		for (int bx = 0; bx < width; bx += 4)
+		{
+			uint8_t block[16][4];
+			for (int y = 0; y < 4; y++)
+			{
+				for (int x = 0; x < 4; x++)
+				{
+					int sx = std::min(bx + x, width - 1), sy = std::min(by + y, height - 1);
+					memcpy(block[y * 4 + x], rgba + ((size_t)sy * width + sx) * 4, 4);
+				}
+			}
+
+			switch (format)
+			{
+			case BlockFormat::BC1:
+				encodeColorBlock(block, out);
+				break;
+			case BlockFormat::BC3:
+				encodeChannelBlock(block, 3, out);
+				encodeColorBlock(block, out + 8);
+				break;
+			case BlockFormat::BC4:
+				encodeChannelBlock(block, 0, out);
+				break;
+			}
+			out += blockBytes(format);
+		}
+	}
+}
+
+void decompressImage(const uint8_t* blocks, int width, int height, BlockFormat format, std::vector<uint8_t>& rgba)
+{
+	rgba.resize((size_t)width * height * 4);
+	const uint8_t* in = blocks;
+	for (int by = 0; by < height; by += 4)
+	{
+		for (int bx = 0; bx < width; bx += 4)
+		{
+			uint8_t block[16][4];
+			switch (format)
+			{
+			case BlockFormat::BC1:
+				decodeColorBlock(in, block);
+				break;
+			case BlockFormat::BC3:
+				decodeColorBlock(in + 8, block);
+				decodeChannelBlock(in, 3, block);
+				break;
+			case BlockFormat::BC4:
+				decodeChannelBlock(in, 0, block);
+				for (int i = 0; i < 16; i++)
+				{
+					block[i][1] = block[i][2] = 0;
+					block[i][3] = 255;
+				}
+				break;
+			}
+			in += blockBytes(format);
+
+			for (int y = 0; y < 4 && by + y < height; y++)
+				for (int x = 0; x < 4 && bx + x < width; x++)
+					memcpy(rgba.data() + ((size_t)(by + y) * width + bx + x) * 4, block[y * 4 + x], 4);
+		}
+	}
+}
+
+void downsampleRgba(const uint8_t* rgba, int width, int height, std::vector<uint8_t>& out)
+{
+	int w = std::max(1, width / 2), h = std::max(1, height / 2);
+	out.resize((size_t)w * h * 4);
+	for (int y = 0; y < h; y++)
+	{
+		int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+		for (int x = 0; x < w; x++)
+		{
+			int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+			for (int ch = 0; ch < 4; ch++)
+			{
+				int sum = rgba[((size_t)y0 * width + x0) * 4 + ch] + rgba[((size_t)y0 * width + x1) * 4 + ch]
+					+ rgba[((size_t)y1 * width + x0) * 4 + ch] + rgba[((size_t)y1 * width + x1) * 4 + ch];
+				out[((size_t)y * w + x) * 4 + ch] = (uint8_t)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+void expandToRgba(const uint8_t* pixels, int width, int height, int components, std::vector<uint8_t>& rgba)
+{
+	size_t count = (size_t)width * height;
+	rgba.resize(count * 4);
+	for (size_t i = 0; i < count; i++)
+	{
+		const uint8_t* p = pixels + i * components;
+		uint8_t* o = rgba.data() + i * 4;
+		switch (components)
+		{
+		case 1: o[0] = o[1] = o[2] = p[0]; o[3] = 255; break;
+		case 2: o[0] = o[1] = o[2] = p[0]; o[3] = p[1]; break;
+		case 3: o[0] = p[0]; o[1] = p[1]; o[2] = p[2]; o[3] = 255; break;
+		default: memcpy(o, p, 4); break;
+		}
+	}
+}
+
+double imagePsnr(const uint8_t* a, const uint8_t* b, int width, int height, BlockFormat format)
+{
+	int channels = format == BlockFormat::BC4 ? 1 : (format == BlockFormat::BC3 ? 4 : 3);
+	double squared = 0.0;
+	size_t count = (size_t)width * height;
+	for (size_t i = 0; i < count; i++)
+	{
+		for (int ch = 0; ch < channels; ch++)
+		{
+			double d = (double)a[i * 4 + ch] - b[i * 4 + ch];
+			squared += d * d;
+		}
+	}
+	double mse = squared / (count * channels);
+	return mse <= 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
@@ -0,0 +1,42 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CPU encoder and decoder for the BCn block formats the cooked textures use.
+// Pure functions over RGBA8 pixels, no GL, so they can be checked offline.
+//
+//   BC1  RGB, 8 bytes per 4x4 block (GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+//   BC3  RGBA, 16 bytes per block: BC4-style alpha + BC1 color (GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+//   BC4  single channel, 8 bytes per block (GL_COMPRESSED_RED_RGTC1)
+enum class BlockFormat : uint32_t {
+	BC1 = 1,
+	BC3 = 3,
+	BC4 = 4,
+};
+
+// GL internal format enums, spelled out so this header doesn't need GL
+const uint32_t GL_FORMAT_BC1 = 0x83F0;
+const uint32_t GL_FORMAT_BC3 = 0x83F3;
+const uint32_t GL_FORMAT_BC4 = 0x8DBB;
+
+size_t blockBytes(BlockFormat format);
+uint32_t glFormatOf(BlockFormat format);
+size_t compressedSize(BlockFormat format, int width, int height);
+
+// rgba is width * height * 4 bytes; partial edge blocks repeat the edge pixels
+void compressImage(const uint8_t* rgba, int width, int height, BlockFormat format, std::vector<uint8_t>& blocks);
+void decompressImage(const uint8_t* blocks, int width, int height, BlockFormat format, std::vector<uint8_t>& rgba);
+
+// 2x2 box filter to the next mip level (each side halved, at least 1)
+void downsampleRgba(const uint8_t* rgba, int width, int height, std::vector<uint8_t>& out);
+
+// expands 1, 2 or 3 channel pixels to RGBA8 (grey, grey+alpha, rgb)
+void expandToRgba(const uint8_t* pixels, int width, int height, int components, std::vector<uint8_t>& rgba);
+
+// peak signal to noise ratio over the channels a format keeps (RGB, RGBA or R)
+double imagePsnr(const uint8_t* a, const uint8_t* b, int width, int height, BlockFormat format);
+
+#endif
@@ -0,0 +1,211 @@
+#include "CubemapContainer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "MeshCache.h"
+
+namespace
+{
+	const char CUBEMAP_CONTAINER_MAGIC[4] = { 'M', 'V', 'R', 'C' };
+	const uint64_t CUBEMAP_CONTAINER_ALIGNMENT = 16;
+	const uint32_t MAX_LEVELS = 16;
+	const uint32_t GL_FORMAT_RGB8 = 0x8051;
+
+	uint64_t alignUp(uint64_t offset)
+	{
+		return (offset + CUBEMAP_CONTAINER_ALIGNMENT - 1) & ~(CUBEMAP_CONTAINER_ALIGNMENT - 1);
+	}
+
+	size_t levelBytes(uint32_t blockFormat, uint32_t size)
+	{
+		return blockFormat ? compressedSize((BlockFormat)blockFormat, size, size) : (size_t)size * size * 3;
+	}
+}
+
+std::string cubemapContainerPath(const std::string& directory)
+{
+	return directory + "cubemap.mvrcube";
+}
+
+bool writeCubemapContainer(const std::string& path, const std::string sourcePaths[CUBEMAP_FACES],
+	const uint8_t* const faces[CUBEMAP_FACES], int faceSize, bool compress)
+{
+	CubemapContainerHeader header = {};
+	memcpy(header.magic, CUBEMAP_CONTAINER_MAGIC, sizeof(header.magic));
+	header.version = CUBEMAP_CONTAINER_VERSION;
+	header.blockFormat = compress ? (uint32_t)BlockFormat::BC1 : 0;
+	header.glInternalFormat = compress ? glFormatOf(BlockFormat::BC1) : GL_FORMAT_RGB8;
+	header.faceSize = (uint32_t)faceSize;
+	for (uint32_t face = 0; face < CUBEMAP_FACES; face++)
+	{
+		if (!sourceFileStamp(sourcePaths[face], header.sourceSize[face], header.sourceTime[face]))
+		{
+			std::cout << "Cubemap cook: cannot stat " << sourcePaths[face] << std::endl;
+			return false;
+		}
+	}
+
+	// per face: RGBA working copy, downsampled level by level
+	std::vector<std::vector<uint8_t>> data; // level major, like the index
+	std::vector<CubemapContainerLevel> levels;
+	std::vector<uint8_t> rgba[CUBEMAP_FACES];
+	for (uint32_t face = 0; face < CUBEMAP_FACES; face++)
+		expandToRgba(faces[face], faceSize, faceSize, 3, rgba[face]);
+
+	int size = faceSize;
+	while (header.levelCount < MAX_LEVELS)
+	{
+		for (uint32_t face = 0; face < CUBEMAP_FACES; face++)
+		{
+			data.push_back(std::vector<uint8_t>());
+			if (compress)
+			{
+				compressImage(rgba[face].data(), size, size, BlockFormat::BC1, data.back());
+			}
+			else
+			{
+				data.back().resize((size_t)size * size * 3);
+				for (size_t i = 0; i < (size_t)size * size; i++)
+					memcpy(&data.back()[i * 3], &rgba[face][i * 4], 3);
+			}
+			CubemapContainerLevel entry = {};
+			entry.size = data.back().size();
+			entry.faceSize = (uint32_t)size;
+			levels.push_back(entry);
+		}
+		header.levelCount++;
+		if (size == 1)
+			break;
+
+		for (uint32_t face = 0; face < CUBEMAP_FACES; face++)
+		{
+			std::vector<uint8_t> next;
+			downsampleRgba(rgba[face].data(), size, size, next);
+			rgba[face].swap(next);
+		}
+		size = std::max(1, size / 2);
+	}
+
+	uint64_t offset = alignUp(sizeof(header) + levels.size() * sizeof(CubemapContainerLevel));
+	for (auto& entry : levels)
+	{
+		entry.offset = offset;
+		offset = alignUp(offset + entry.size);
+	}
+
+	std::string tmpPath = path + ".tmp";
+	FILE* file = fopen(tmpPath.c_str(), "wb");
+	if (!file)
+	{
+		std::cout << "Cubemap cook: cannot write " << tmpPath << std::endl;
+		return false;
+	}
+	static const uint8_t zeros[CUBEMAP_CONTAINER_ALIGNMENT] = {};
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(levels.data(), sizeof(CubemapContainerLevel), levels.size(), file) == levels.size();
+	uint64_t written = sizeof(header) + levels.size() * sizeof(CubemapContainerLevel);
+	for (size_t i = 0; ok && i < levels.size(); i++)
+	{
+		size_t pad = (size_t)(levels[i].offset - written);
+		ok = (!pad || fwrite(zeros, 1, pad, file) == pad)
+			&& fwrite(data[i].data(), 1, data[i].size(), file) == data[i].size();
+		written = levels[i].offset + levels[i].size;
+	}
+	ok = (fclose(file) == 0) && ok;
+	if (ok)
+	{
+		remove(path.c_str());
+		ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+	}
+	if (!ok)
+	{
+		std::cout << "Cubemap cook: failed writing " << path << std::endl;
+		remove(tmpPath.c_str());
+	}
+	return ok;
+}
+
+bool restampCubemapContainer(const std::string& path, const std::string sourcePaths[CUBEMAP_FACES])
+{
+	CubemapContainerHeader header;
+	if (!readCookedHeader(path, &header, sizeof(header))
+		|| memcmp(header.magic, CUBEMAP_CONTAINER_MAGIC, sizeof(header.magic)) != 0 || header.version != CUBEMAP_CONTAINER_VERSION)
+		return false;
+	for (uint32_t face = 0; face < CUBEMAP_FACES; face++)
+		if (!sourceFileStamp(sourcePaths[face], header.sourceSize[face], header.sourceTime[face]))
+			return false;
+	return writeCookedHeader(path, &header, sizeof(header));
+}
+
+bool CubemapContainerFile::open(const std::string& path, const std::string sourcePaths[CUBEMAP_FACES])
+{
+	close();
+	if (!_file.open(path))
+		return false;
+
+	uint64_t fileSize = _file.size();
+	const CubemapContainerHeader* header = reinterpret_cast<const CubemapContainerHeader*>(_file.data());
+	bool valid = fileSize >= sizeof(CubemapContainerHeader)
+		&& memcmp(header->magic, CUBEMAP_CONTAINER_MAGIC, sizeof(header->magic)) == 0
+		&& header->version == CUBEMAP_CONTAINER_VERSION;
+	if (!valid)
+	{
+		std::cout << "Cubemap container: " << path << " has an unsupported format, ignoring it" << std::endl;
+		_file.close();
+		return false;
+	}
+
+	for (uint32_t face = 0; face < CUBEMAP_FACES; face++)
+	{
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		if (assetFileStamp(sourcePaths[face], sourceSize, sourceTime)
+			&& (sourceSize != header->sourceSize[face] || sourceTime != header->sourceTime[face]))
+		{
+			std::cout << "Cubemap container: " << path << " is stale, re-run --cook" << std::endl;
+			_file.close();
+			return false;
+		}
+	}
+
+	valid = (header->blockFormat == 0 ? header->glInternalFormat == GL_FORMAT_RGB8
+			: header->blockFormat == (uint32_t)BlockFormat::BC1 && header->glInternalFormat == glFormatOf(BlockFormat::BC1))
+		&& header->faceSize > 0 && header->levelCount > 0 && header->levelCount <= MAX_LEVELS
+		&& sizeof(CubemapContainerHeader) + header->levelCount * CUBEMAP_FACES * sizeof(CubemapContainerLevel) <= fileSize;
+
+	const CubemapContainerLevel* levels = reinterpret_cast<const CubemapContainerLevel*>(_file.data() + sizeof(CubemapContainerHeader));
+	uint32_t size = header->faceSize;
+	for (uint32_t level = 0; valid && level < header->levelCount; level++)
+	{
+		for (uint32_t face = 0; valid && face < CUBEMAP_FACES; face++)
+		{
+			const CubemapContainerLevel& entry = levels[level * CUBEMAP_FACES + face];
+			valid = entry.faceSize == size && entry.size == levelBytes(header->blockFormat, size)
+				&& entry.offset % CUBEMAP_CONTAINER_ALIGNMENT == 0
+				&& entry.offset <= fileSize && entry.size <= fileSize - entry.offset;
+		}
+		size = std::max(1u, size / 2);
+	}
+	if (!valid)
+	{
+		std::cout << "Cubemap container: " << path << " is corrupt, ignoring it" << std::endl;
+		_file.close();
+		return false;
+	}
+
+	_header = header;
+	_levels = levels;
+	return true;
+}
+
+size_t CubemapContainerFile::dataBytes() const
+{
+	size_t bytes = 0;
+	for (uint32_t i = 0; i < levelCount() * CUBEMAP_FACES; i++)
+		bytes += (size_t)_levels[i].size;
+	return bytes;
+}
@@ -0,0 +1,75 @@
+#ifndef CUBEMAP_CONTAINER_H
+#define CUBEMAP_CONTAINER_H
+
+#include <cstdint>
+#include <string>
+
+#include "BlockCompression.h"
+#include "AssetArchive.h"
+
+// All six faces of a cubemap with their mip chains in one file, cooked from the
+// face images of a cubemap directory (skybox/left.ppm ... -> skybox/cubemap.mvrcube).
+//
+//   header | level index (level major, faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X order) | data
+//
+// Faces are raw RGB8 or BC1, every face level starts on a 16 byte boundary so it can
+// be uploaded straight from the mapping. The size and modification time of each
+// source face is recorded; the container is ignored once any of them changes.
+const uint32_t CUBEMAP_CONTAINER_VERSION = 1;
+const uint32_t CUBEMAP_FACES = 6;
+
+struct CubemapContainerHeader {
+	char magic[4]; // "MVRC"
+	uint32_t version;
+	uint32_t glInternalFormat; // GL_RGB8 or a compressed format
+	uint32_t blockFormat; // BlockFormat, 0 when raw RGB8
+	uint32_t faceSize;
+	uint32_t levelCount;
+	uint32_t reserved[2];
+	uint64_t sourceSize[CUBEMAP_FACES];
+	int64_t sourceTime[CUBEMAP_FACES];
+};
+
+struct CubemapContainerLevel {
+	uint64_t offset;
+	uint64_t size;
+	uint32_t faceSize;
+	uint32_t reserved;
+};
+
+std::string cubemapContainerPath(const std::string& directory);
+
+// faces are faceSize x faceSize RGB8 in GL_TEXTURE_CUBE_MAP_POSITIVE_X order;
+// compress selects BC1 over raw RGB8
+bool writeCubemapContainer(const std::string& path, const std::string sourcePaths[CUBEMAP_FACES],
+	const uint8_t* const faces[CUBEMAP_FACES], int faceSize, bool compress);
+
+// see restampMeshCache
+bool restampCubemapContainer(const std::string& path, const std::string sourcePaths[CUBEMAP_FACES]);
+
+class CubemapContainerFile
+{
+public:
+	// Maps and validates the file; fails when it is missing, malformed or stale
+	bool open(const std::string& path, const std::string sourcePaths[CUBEMAP_FACES]);
+	void close() { _file.close(); _header = nullptr; }
+
+	bool isCompressed() const { return _header->blockFormat != 0; }
+	uint32_t glInternalFormat() const { return _header->glInternalFormat; }
+	uint32_t faceSize() const { return _header->faceSize; }
+	uint32_t levelCount() const { return _header->levelCount; }
+
+	const CubemapContainerLevel& level(uint32_t level, uint32_t face) const { return _levels[level * CUBEMAP_FACES + face]; }
+	const uint8_t* data(uint32_t level, uint32_t face) const { return _file.data() + this->level(level, face).offset; }
+
+	size_t dataBytes() const;
+	// touches every page so a loader thread takes the page faults instead of the uploader
+	void prefetch() const { _file.prefetch(); }
+
+private:
+	AssetFile _file;
+	const CubemapContainerHeader* _header = nullptr;
+	const CubemapContainerLevel* _levels = nullptr;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef DETERMINISTIC_H
+#define DETERMINISTIC_H
+
+// Included first by the translation units of the simulation (Simulation.cpp,
+// Weapons.cpp), whose results must come out bit for bit the same on the client, the
+// server and a replay, whichever compiler built them. Plain IEEE single precision
+// does that as long as every operation is rounded where the source says: no fast
+// math, no fused multiply-adds and no x87 excess precision. The code keeps its own
+// operation order and calls no sin or cos, whose results differ between C runtimes:
+// fixed rotations are written out as constants, glm::rotate and glm::angleAxis are
+// for the rest of the client.
+
+#if defined(__FAST_MATH__) || defined(_M_FP_FAST)
+#error "the simulation must not be built with fast math (/fp:fast, -ffast-math)"
+#endif
+
+#if (defined(_M_IX86_FP) && _M_IX86_FP < 2) || (defined(__i386__) && !defined(__SSE2_MATH__))
+#error "the simulation needs SSE2 floating point, x87 rounds differently"
+#endif
+
+#if defined(_MSC_VER)
+#pragma fp_contract(off)
+#elif defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+// GCC contracts across statements unless told not to, and ignores the STDC pragma
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "RigidTransform.h"
+
+// A small entity-component store, the same on the client and the server. An entity is
+// just an id; every component keeps each of its fields in its own dense array
+// (structure of arrays) plus a sparse map from entity to dense slot, so a system
+// sweeps the fields it needs for every entity having the component without touching
+// the others or following pointers. Removing swaps the last slot into the hole: the
+// arrays stay dense, but slots are not stable across removals, entities are.
+typedef uint32_t Entity;
+const Entity NO_ENTITY = 0xffffffffu;
+
+// entity <-> dense slot bookkeeping, the components add their field arrays
+class SparseSet
+{
+public:
+	bool has(Entity e) const { return e < _sparse.size() && _sparse[e] != NO_SLOT; }
+	// the entity must have the component
+	size_t slot(Entity e) const { return _sparse[e]; }
+	size_t size() const { return _dense.size(); }
+	Entity entity(size_t slot) const { return _dense[slot]; }
+
+protected:
+	// the entity's new slot, at the end; it must not have the component yet
+	size_t insert(Entity e)
+	{
+		if (e >= _sparse.size())
+			_sparse.resize(e + 1, (uint32_t)NO_SLOT);
+		_sparse[e] = (uint32_t)_dense.size();
+		_dense.push_back(e);
+		return _dense.size() - 1;
+	}
+
+	// moves the last entity into the removed one's slot, the fields must follow with swapPop
+	size_t erase(Entity e)
+	{
+		size_t slot = _sparse[e];
+		_sparse[_dense.back()] = (uint32_t)slot;
+		_dense[slot] = _dense.back();
+		_dense.pop_back();
+		_sparse[e] = NO_SLOT;
+		return slot;
+	}
+
+	template<typename T>
+	static void swapPop(std::vector<T>& field, size_t slot)
+	{
+		field[slot] = field.back();
+		field.pop_back();
+	}
+
+private:
+	static const uint32_t NO_SLOT = 0xffffffffu;
+	std::vector<uint32_t> _sparse;
+	std::vector<Entity> _dense;
+};
+
+// Where an entity is: the origin of its frame and the rotation about it
+struct Transforms : SparseSet
+{
+	std::vector<glm::vec3> position;
+	std::vector<glm::quat> rotation;
+
+	void add(Entity e, const glm::vec3& p, const glm::quat& r = glm::quat(1, 0, 0, 0))
+	{
+		insert(e);
+		position.push_back(p);
+		rotation.push_back(r);
+	}
+
+	RigidTransform pose(size_t slot) const { return RigidTransform(rotation[slot], position[slot]); }
+
+	void remove(Entity e)
+	{
+		size_t slot = erase(e);
+		swapPop(position, slot);
+		swapPop(rotation, slot);
+	}
+};
+
+// Hit spheres in the entity's frame. The spheres of every entity share one pool, an
+// entity owning [first, first + count) of it; worldCenter is the pool moved by the
+// transforms, see updateColliders. A removed entity's spheres stay in the pool.
+struct Colliders : SparseSet
+{
+	std::vector<uint32_t> first;
+	std::vector<uint32_t> count;
+
+	std::vector<glm::vec3> center;
+	std::vector<float> radius;
+	std::vector<glm::vec3> worldCenter;
+
+	void add(Entity e, const glm::vec3* centers, size_t n, float r)
+	{
+		insert(e);
+		first.push_back((uint32_t)center.size());
+		count.push_back((uint32_t)n);
+		for (size_t i = 0; i < n; i++)
+		{
+			center.push_back(centers[i]);
+			radius.push_back(r);
+			worldCenter.push_back(centers[i]);
+		}
+	}
+
+	void remove(Entity e)
+	{
+		size_t slot = erase(e);
+		swapPop(first, slot);
+		swapPop(count, slot);
+	}
+
+	// whether any sphere of slot a touches one of slot b, in world space
+	bool overlap(size_t a, size_t b) const
+	{
+		for (uint32_t i = first[a]; i < first[a] + count[a]; i++)
+			for (uint32_t j = first[b]; j < first[b] + count[b]; j++)
+			{
+				glm::vec3 d = worldCenter[i] - worldCenter[j];
+				float r = radius[i] + radius[j];
+				if (glm::dot(d, d) < r * r)
+					return true;
+			}
+		return false;
+	}
+};
+
+// What draws an entity: the mesh (an index the renderer gives meaning), the matrix
+// from mesh to entity frame, its color and whether it is shown
+struct Renderables : SparseSet
+{
+	std::vector<int> mesh;
+	std::vector<glm::mat4> model;
+	std::vector<glm::vec3> color;
+	std::vector<uint8_t> visible;
+
+	void add(Entity e, int m, const glm::mat4& toEntity, const glm::vec3& c)
+	{
+		insert(e);
+		mesh.push_back(m);
+		model.push_back(toEntity);
+		color.push_back(c);
+		visible.push_back(1);
+	}
+
+	void remove(Entity e)
+	{
+		size_t slot = erase(e);
+		swapPop(mesh, slot);
+		swapPop(model, slot);
+		swapPop(color, slot);
+		swapPop(visible, slot);
+	}
+};
+
+// Something a player picks up: the grip in the entity's frame, how big the grip is
+// drawn, the player it belongs to and the one holding it, -1 for nobody
+struct Holders : SparseSet
+{
+	std::vector<glm::vec3> handle;
+	std::vector<float> gripRadius;
+	std::vector<int> owner;
+	std::vector<int> heldBy;
+
+	void add(Entity e, const glm::vec3& h, float grip, int player)
+	{
+		insert(e);
+		handle.push_back(h);
+		gripRadius.push_back(grip);
+		owner.push_back(player);
+		heldBy.push_back(-1);
+	}
+
+	void remove(Entity e)
+	{
+		size_t slot = erase(e);
+		swapPop(handle, slot);
+		swapPop(gripRadius, slot);
+		swapPop(owner, slot);
+		swapPop(heldBy, slot);
+	}
+};
+
+class World
+{
+public:
+	Transforms transforms;
+	Colliders colliders;
+	Renderables renderables;
+	Holders holders;
+
+	// ids are never reused
+	Entity create() { return _next++; }
+
+	void destroy(Entity e)
+	{
+		if (transforms.has(e))
+			transforms.remove(e);
+		if (colliders.has(e))
+			colliders.remove(e);
+		if (renderables.has(e))
+			renderables.remove(e);
+		if (holders.has(e))
+			holders.remove(e);
+	}
+
+private:
+	Entity _next = 0;
+};
+
+// System iteration: f(entity, slot in a, slot in b) for every entity having both
+// components, walking a densely; pass the smaller component as a
+template<typename A, typename B, typename F>
+void forEach(const A& a, const B& b, F f)
+{
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		Entity e = a.entity(i);
+		if (b.has(e))
+			f(e, i, b.slot(e));
+	}
+}
+
+#endif
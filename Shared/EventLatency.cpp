@@ -0,0 +1,91 @@
+#include "EventLatency.h"
+
+#include <algorithm>
+#include <cstdio>
+
+EventLatency eventLatency;
+
+namespace {
+	const char* const STAGE_NAMES[EventLatency::STAGES] = {
+		"server -> receive",
+		"receive -> enqueue",
+		"enqueue -> voice",
+		"total",
+	};
+}
+
+void EventLatency::Histogram::add(float ms)
+{
+	if (samples.size() < MAX_SAMPLES)
+		samples.push_back(ms);
+	count++;
+	int bucket = 0;
+	while (bucket < BUCKETS - 1 && ms >= 0.5f * (1 << bucket))
+		bucket++;
+	buckets[bucket]++;
+}
+
+EventLatency::EventLatency()
+{
+	for (Histogram& stage : _stages)
+		stage.samples.reserve(MAX_SAMPLES);
+}
+
+void EventLatency::clockSync(int64_t sentUs, int64_t serverUs, int64_t receivedUs)
+{
+	int64_t roundTripUs = receivedUs - sentUs;
+	if (serverUs == 0 || roundTripUs < 0)
+		return;
+	if (_synced && roundTripUs > _bestRoundTripUs && ++_syncsSinceBest < SYNC_WINDOW)
+		return;
+	_offsetUs = serverUs - (sentUs + roundTripUs / 2);
+	_bestRoundTripUs = roundTripUs;
+	_syncsSinceBest = 0;
+	_synced = true;
+}
+
+int64_t EventLatency::serverToLocal(int64_t serverUs) const
+{
+	if (!_synced || serverUs == 0)
+		return 0;
+	return serverUs - _offsetUs;
+}
+
+void EventLatency::record(const GameEventStamp& stamp, int64_t voiceStartUs)
+{
+	if (stamp.receivedUs)
+		_stages[Client].add((stamp.enqueuedUs - stamp.receivedUs) / 1000.0f);
+	_stages[AudioQueue].add((voiceStartUs - stamp.enqueuedUs) / 1000.0f);
+	if (!stamp.detectedUs)
+	{
+		_unstamped++;
+		return;
+	}
+	// the offset is an estimate, a stamp can land a little after the receive
+	_stages[Network].add(std::max<int64_t>(0, stamp.receivedUs - stamp.detectedUs) / 1000.0f);
+	_stages[Total].add((float)((voiceStartUs - stamp.detectedUs) / 1000.0 + _outputMs));
+}
+
+void EventLatency::report() const
+{
+	if (_stages[AudioQueue].count == 0)
+		return;
+
+	printf("event latency ms: %zu events, %zu without a server stamp, output buffering %.1f, clock round trip %.2f\n",
+		_stages[AudioQueue].count, _unstamped, _outputMs, _bestRoundTripUs / 1000.0);
+	printf("%-20s %6s %8s %8s %8s %8s  buckets <0.5 <1 <2 .. <512 >=512\n", "", "count", "p50", "p90", "p99", "max");
+	for (int i = 0; i < STAGES; i++)
+	{
+		const Histogram& stage = _stages[i];
+		if (stage.count == 0)
+			continue;
+		std::vector<float> sorted = stage.samples;
+		std::sort(sorted.begin(), sorted.end());
+		auto percentile = [&](float p) { return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))]; };
+		printf("%-20s %6zu %8.2f %8.2f %8.2f %8.2f ", STAGE_NAMES[i], stage.count,
+			percentile(0.5f), percentile(0.9f), percentile(0.99f), sorted.back());
+		for (int b = 0; b < BUCKETS; b++)
+			printf(" %zu", stage.buckets[b]);
+		printf("\n");
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef EVENT_LATENCY_H
+#define EVENT_LATENCY_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Microseconds on this process's steady clock. The server stamps gameplay events with
+// it, the client converts those stamps with the offset EventLatency estimates.
+inline int64_t latencyClockUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Where a gameplay event has been, in client clock microseconds; 0 where unknown.
+// Carried from the network reply through the audio command to the voice it starts.
+struct GameEventStamp {
+	int64_t detectedUs = 0;		// the server saw it, converted to the client clock
+	int64_t receivedUs = 0;		// the reply carrying it arrived
+	int64_t enqueuedUs = 0;		// the game thread posted the sound
+};
+
+// From hit to sound, per stage: server detection -> network receive -> audio command
+// enqueue -> voice start, plus the backend's output buffering, which is the same for
+// every voice. The server's clock is mapped to ours from the push round trips: each
+// reply carries the server time, assumed halfway through the round trip. A reply
+// replaces the offset when its round trip is the shortest yet, or the offset is
+// SYNC_WINDOW replies old, so it follows drift without jumping on a slow reply.
+//
+// clockSync and serverToLocal are for the thread talking to the server, record for
+// the audio thread; report once both are done.
+class EventLatency
+{
+public:
+	enum Stage { Network, Client, AudioQueue, Total, STAGES };
+	// samples kept per stage for percentiles, reserved up front so recording never allocates
+	static const int MAX_SAMPLES = 4096;
+	static const int SYNC_WINDOW = 256;
+	// bucket i counts samples under 0.5 ms << i, the last one everything above
+	static const int BUCKETS = 12;
+
+	EventLatency();
+
+	void clockSync(int64_t sentUs, int64_t serverUs, int64_t receivedUs);
+	// 0 stays 0, and so does every stamp before the first reply
+	int64_t serverToLocal(int64_t serverUs) const;
+
+	// an event whose voice started at voiceStartUs
+	void record(const GameEventStamp& stamp, int64_t voiceStartUs);
+	void setOutputLatencyMs(double ms) { _outputMs = ms; }
+
+	// a line per stage: count, percentiles and the buckets; nothing if no event was recorded
+	void report() const;
+
+private:
+	struct Histogram {
+		std::vector<float> samples;		// ms
+		size_t count = 0;
+		size_t buckets[BUCKETS] = {};
+
+		void add(float ms);
+	};
+
+	bool _synced = false;
+	int64_t _offsetUs = 0;			// server minus client
+	int64_t _bestRoundTripUs = 0;
+	int _syncsSinceBest = 0;
+
+	Histogram _stages[STAGES];
+	size_t _unstamped = 0;			// events without a server stamp, only the client stages count them
+	double _outputMs = 0.0;
+};
+
+extern EventLatency eventLatency;
+
+#endif
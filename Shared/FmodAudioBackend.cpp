@@ -0,0 +1,294 @@
+#include "FmodAudioBackend.h"
+
+#ifndef MINIMALVR_NO_FMOD
+
+#include <iostream>
+
+#include "AssetArchive.h"
+#include "SoftwareAudioBackend.h"
+
+namespace {
+	const int CHANNEL_INDEX_BITS = 8;
+
+	int ChannelHandle(unsigned int nGeneration, int nIndex) {
+		return (int)(((nGeneration & 0xffffff) << CHANNEL_INDEX_BITS) | (unsigned int)nIndex);
+	}
+}
+
+FmodAudioBackend::FmodAudioBackend(int nMaxChannels) {
+	ErrorCheck(FMOD::Studio::System::create(&mpStudioSystem));
+	// the game hands over GL coordinates; FMOD is left-handed unless told otherwise
+	ErrorCheck(mpStudioSystem->initialize(nMaxChannels, FMOD_STUDIO_INIT_LIVEUPDATE,
+		FMOD_INIT_PROFILE_ENABLE | FMOD_INIT_3D_RIGHTHANDED, NULL));
+	ErrorCheck(mpStudioSystem->getCoreSystem(&mpSystem));
+	mChannels.resize(nMaxChannels < (1 << CHANNEL_INDEX_BITS) ? nMaxChannels : (1 << CHANNEL_INDEX_BITS));
+}
+
+FmodAudioBackend::~FmodAudioBackend() {
+	ErrorCheck(mpStudioSystem->unloadAll());
+	ErrorCheck(mpStudioSystem->release());
+}
+
+int FmodAudioBackend::createSound(const std::string& strName, bool b3d, bool bLooping, SoundCache eCache) {
+	FMOD_MODE eMode = FMOD_DEFAULT;
+	eMode |= b3d ? FMOD_3D : FMOD_2D;
+	eMode |= bLooping ? FMOD_LOOP_NORMAL : FMOD_LOOP_OFF;
+	switch (eCache) {
+	case SoundCache::Decompressed: eMode |= FMOD_CREATESAMPLE; break;
+	case SoundCache::Compressed: eMode |= FMOD_CREATECOMPRESSEDSAMPLE; break;
+	case SoundCache::Stream: eMode |= FMOD_CREATESTREAM; break;
+	}
+
+	FMOD::Sound* pSound = nullptr;
+	const AssetArchive* pArchive = mountedAssetArchive();
+	const AssetArchiveEntry* pEntry = pArchive ? pArchive->find(strName) : nullptr;
+	if (pEntry) {
+		// packed sounds play from the archive mapping, which stays open for the process;
+		// LZ4 entries are decompressed once and FMOD keeps its own copy, as it does of
+		// what it decodes to PCM
+		FMOD_CREATESOUNDEXINFO exinfo = {};
+		exinfo.cbsize = sizeof(exinfo);
+		exinfo.length = (unsigned int)pEntry->size;
+		std::vector<uint8_t> data;
+		const char* pData = (const char*)pArchive->storedData(*pEntry);
+		if (pEntry->flags & ASSET_ENTRY_LZ4) {
+			if (!pArchive->read(*pEntry, data)) {
+				std::cout << "Asset archive: " << strName << " is corrupt" << std::endl;
+				return -1;
+			}
+			pData = (const char*)data.data();
+			eMode |= FMOD_OPENMEMORY;
+		}
+		else if (eCache == SoundCache::Decompressed) {
+			eMode |= FMOD_OPENMEMORY;
+		}
+		else {
+			eMode |= FMOD_OPENMEMORY_POINT;
+		}
+		ErrorCheck(mpSystem->createSound(pData, eMode, &exinfo, &pSound));
+	}
+	else {
+		ErrorCheck(mpSystem->createSound(strName.c_str(), eMode, nullptr, &pSound));
+	}
+	if (!pSound)
+		return -1;
+
+	Sound sound;
+	sound.pSound = pSound;
+	sound.eCache = eCache;
+	mSounds.push_back(sound);
+	return (int)mSounds.size() - 1;
+}
+
+void FmodAudioBackend::releaseSound(int nSound) {
+	if (nSound < 0 || nSound >= (int)mSounds.size() || !mSounds[nSound].pSound)
+		return;
+	ErrorCheck(mSounds[nSound].pSound->release());
+	mSounds[nSound].pSound = nullptr;
+}
+
+unsigned int FmodAudioBackend::soundLengthMs(int nSound) const {
+	unsigned int nLengthMs = 0;
+	if (nSound >= 0 && nSound < (int)mSounds.size() && mSounds[nSound].pSound)
+		ErrorCheck(mSounds[nSound].pSound->getLength(&nLengthMs, FMOD_TIMEUNIT_MS));
+	return nLengthMs;
+}
+
+size_t FmodAudioBackend::soundMemoryBytes(int nSound) const {
+	if (nSound < 0 || nSound >= (int)mSounds.size() || !mSounds[nSound].pSound)
+		return 0;
+	// FMOD doesn't report it per sound: the PCM, the file, or the stream's file buffer
+	const Sound& sound = mSounds[nSound];
+	unsigned int nBytes = 0;
+	if (sound.eCache == SoundCache::Stream) {
+		FMOD_TIMEUNIT eUnit = FMOD_TIMEUNIT_RAWBYTES;
+		ErrorCheck(mpSystem->getStreamBufferSize(&nBytes, &eUnit));
+		if (eUnit != FMOD_TIMEUNIT_RAWBYTES)
+			nBytes = 16384;
+	}
+	else {
+		FMOD_TIMEUNIT eUnit = sound.eCache == SoundCache::Decompressed ? FMOD_TIMEUNIT_PCMBYTES : FMOD_TIMEUNIT_RAWBYTES;
+		ErrorCheck(sound.pSound->getLength(&nBytes, eUnit));
+	}
+	return nBytes;
+}
+
+void FmodAudioBackend::setSoundPriority(int nSound, int nPriority) {
+	if (nSound < 0 || nSound >= (int)mSounds.size() || !mSounds[nSound].pSound)
+		return;
+	// FMOD steals channels by the same priority, should it ever run out
+	float fFrequency;
+	int nDefaultPriority;
+	ErrorCheck(mSounds[nSound].pSound->getDefaults(&fFrequency, &nDefaultPriority));
+	ErrorCheck(mSounds[nSound].pSound->setDefaults(fFrequency, nPriority));
+}
+
+FMOD::Channel* FmodAudioBackend::FindChannel(int nChannel) {
+	if (nChannel < 0)
+		return nullptr;
+	int nIndex = nChannel & ((1 << CHANNEL_INDEX_BITS) - 1);
+	if (nIndex >= (int)mChannels.size())
+		return nullptr;
+	Channel& channel = mChannels[nIndex];
+	if (!channel.pChannel || ChannelHandle(channel.nGeneration, nIndex) != nChannel)
+		return nullptr;
+	return channel.pChannel;
+}
+
+int FmodAudioBackend::play(int nSound, const glm::vec3& vPosition, float fVolume, unsigned int nPositionMs) {
+	if (nSound < 0 || nSound >= (int)mSounds.size() || !mSounds[nSound].pSound)
+		return -1;
+	int nIndex = 0;
+	while (nIndex < (int)mChannels.size() && mChannels[nIndex].pChannel)
+		nIndex++;
+	if (nIndex == (int)mChannels.size())
+		return -1;
+
+	FMOD::Channel* pChannel = nullptr;
+	ErrorCheck(mpSystem->playSound(mSounds[nSound].pSound, nullptr, true, &pChannel));
+	if (!pChannel)
+		return -1;
+	FMOD_MODE currMode;
+	mSounds[nSound].pSound->getMode(&currMode);
+	if (currMode & FMOD_3D) {
+		FMOD_VECTOR position = VectorToFmod(vPosition);
+		ErrorCheck(pChannel->set3DAttributes(&position, nullptr));
+	}
+	ErrorCheck(pChannel->setVolume(fVolume));
+	if (nPositionMs > 0) {
+		ErrorCheck(pChannel->setPosition(nPositionMs, FMOD_TIMEUNIT_MS));
+	}
+	ErrorCheck(pChannel->setPaused(false));
+
+	mChannels[nIndex].pChannel = pChannel;
+	return ChannelHandle(mChannels[nIndex].nGeneration, nIndex);
+}
+
+bool FmodAudioBackend::isPlaying(int nChannel) {
+	FMOD::Channel* pChannel = FindChannel(nChannel);
+	if (!pChannel)
+		return false;
+	bool bIsPlaying = false;
+	pChannel->isPlaying(&bIsPlaying);
+	if (!bIsPlaying) {
+		// ended (or stolen by FMOD), the slot is free again
+		Channel& channel = mChannels[nChannel & ((1 << CHANNEL_INDEX_BITS) - 1)];
+		channel.pChannel = nullptr;
+		channel.nGeneration++;
+	}
+	return bIsPlaying;
+}
+
+void FmodAudioBackend::stop(int nChannel) {
+	FMOD::Channel* pChannel = FindChannel(nChannel);
+	if (!pChannel)
+		return;
+	// fails harmlessly if FMOD already ended the channel
+	pChannel->stop();
+	Channel& channel = mChannels[nChannel & ((1 << CHANNEL_INDEX_BITS) - 1)];
+	channel.pChannel = nullptr;
+	channel.nGeneration++;
+}
+
+void FmodAudioBackend::setPosition(int nChannel, const glm::vec3& vPosition) {
+	FMOD::Channel* pChannel = FindChannel(nChannel);
+	if (!pChannel)
+		return;
+	FMOD_MODE currMode;
+	pChannel->getMode(&currMode);
+	if (currMode & FMOD_3D) {
+		FMOD_VECTOR position = VectorToFmod(vPosition);
+		ErrorCheck(pChannel->set3DAttributes(&position, NULL));
+	}
+}
+
+void FmodAudioBackend::setVolume(int nChannel, float fVolume) {
+	FMOD::Channel* pChannel = FindChannel(nChannel);
+	if (pChannel)
+		ErrorCheck(pChannel->setVolume(fVolume));
+}
+
+void FmodAudioBackend::setListener(const glm::vec3& vPosition, const glm::vec3& vLook, const glm::vec3& vUp) {
+	FMOD_VECTOR position = VectorToFmod(vPosition);
+	FMOD_VECTOR velocity = VectorToFmod(glm::vec3(0));
+	FMOD_VECTOR forward = VectorToFmod(vLook);
+	FMOD_VECTOR up = VectorToFmod(vUp);
+	ErrorCheck(mpSystem->set3DListenerAttributes(0, &position, &velocity, &forward, &up));
+}
+
+void FmodAudioBackend::update() {
+	ErrorCheck(mpStudioSystem->update());
+}
+
+double FmodAudioBackend::outputLatencyMs() const {
+	// the mixer fills numBuffers buffers ahead of the device
+	unsigned int nBufferLength = 0;
+	int nBuffers = 0;
+	int nRate = 0;
+	if (mpSystem->getDSPBufferSize(&nBufferLength, &nBuffers) != FMOD_OK
+		|| mpSystem->getSoftwareFormat(&nRate, nullptr, nullptr) != FMOD_OK || nRate <= 0)
+		return 0.0;
+	return 1000.0 * nBufferLength * nBuffers / nRate;
+}
+
+int FmodAudioBackend::ErrorCheck(FMOD_RESULT result) {
+	if (result != FMOD_OK) {
+		std::cout << "FMOD ERROR " << result << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+FMOD_VECTOR FmodAudioBackend::VectorToFmod(const glm::vec3& vPosition) {
+	FMOD_VECTOR fVec;
+	fVec.x = vPosition.x;
+	fVec.y = vPosition.y;
+	fVec.z = vPosition.z;
+	return fVec;
+}
+
+bool decodeSoundToWav(const std::string& path, const std::string& wavPath) {
+	// a system of its own without an output device, so cooking works on build machines
+	FMOD::System* pSystem = nullptr;
+	if (FMOD::System_Create(&pSystem) != FMOD_OK)
+		return false;
+	pSystem->setOutput(FMOD_OUTPUTTYPE_NOSOUND_NRT);
+	bool ok = pSystem->init(1, FMOD_INIT_NORMAL, nullptr) == FMOD_OK;
+
+	FMOD::Sound* pSound = nullptr;
+	ok = ok && pSystem->createSound(path.c_str(), FMOD_OPENONLY | FMOD_2D | FMOD_ACCURATETIME, nullptr, &pSound) == FMOD_OK;
+
+	FMOD_SOUND_FORMAT format = FMOD_SOUND_FORMAT_NONE;
+	int nChannels = 0;
+	int nBits = 0;
+	float fFrequency = 0.0f;
+	unsigned int nBytes = 0;
+	if (ok) {
+		ok = pSound->getFormat(nullptr, &format, &nChannels, &nBits) == FMOD_OK
+			&& pSound->getDefaults(&fFrequency, nullptr) == FMOD_OK
+			&& pSound->getLength(&nBytes, FMOD_TIMEUNIT_PCMBYTES) == FMOD_OK;
+		if (ok && format != FMOD_SOUND_FORMAT_PCM16) {
+			std::cout << "Sound decode: " << path << " decodes to an unsupported sample format" << std::endl;
+			ok = false;
+		}
+	}
+
+	std::vector<int16_t> samples;
+	if (ok) {
+		samples.resize(nBytes / sizeof(int16_t));
+		unsigned int nRead = 0;
+		FMOD_RESULT result = pSound->readData(samples.data(), nBytes, &nRead);
+		ok = (result == FMOD_OK || result == FMOD_ERR_FILE_EOF) && nRead > 0;
+		samples.resize(nRead / sizeof(int16_t));
+	}
+	ok = ok && writeWavFile(wavPath, samples.data(), samples.size() / nChannels, nChannels, (int)fFrequency);
+
+	if (pSound)
+		pSound->release();
+	pSystem->release();
+	if (!ok)
+		std::cout << "Sound decode: failed decoding " << path << std::endl;
+	return ok;
+}
+
+#endif
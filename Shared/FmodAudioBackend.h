@@ -0,0 +1,73 @@
+#ifndef FMOD_AUDIO_BACKEND_H
+#define FMOD_AUDIO_BACKEND_H
+
+// builds without the FMOD SDK (Linux build machines) define MINIMALVR_NO_FMOD and
+// get SoftwareAudioBackend only
+#ifndef MINIMALVR_NO_FMOD
+
+#include <string>
+#include <vector>
+
+#include "fmod_studio.hpp"
+#include "fmod.hpp"
+
+#include "AudioBackend.h"
+
+// FMOD Studio's core system, the sounds loaded into it and one slot per channel
+// CAudioEngine may have playing. Studio banks and events are reached through
+// studio(), the engine keeps those by name.
+class FmodAudioBackend : public AudioBackend
+{
+public:
+	explicit FmodAudioBackend(int nMaxChannels);
+	~FmodAudioBackend() override;
+
+	const char* name() const override { return "FMOD"; }
+
+	int createSound(const std::string& strName, bool b3d, bool bLooping, SoundCache eCache) override;
+	void releaseSound(int nSound) override;
+	unsigned int soundLengthMs(int nSound) const override;
+	size_t soundMemoryBytes(int nSound) const override;
+	void setSoundPriority(int nSound, int nPriority) override;
+
+	int play(int nSound, const glm::vec3& vPosition, float fVolume, unsigned int nPositionMs) override;
+	bool isPlaying(int nChannel) override;
+	void stop(int nChannel) override;
+	void setPosition(int nChannel, const glm::vec3& vPosition) override;
+	void setVolume(int nChannel, float fVolume) override;
+
+	void setListener(const glm::vec3& vPosition, const glm::vec3& vLook, const glm::vec3& vUp) override;
+	void update() override;
+	double outputLatencyMs() const override;
+
+	FMOD::Studio::System* studio() const { return mpStudioSystem; }
+
+	static int ErrorCheck(FMOD_RESULT result);
+	static FMOD_VECTOR VectorToFmod(const glm::vec3& vPosition);
+
+private:
+	struct Sound {
+		FMOD::Sound* pSound = nullptr;	// nullptr once released
+		SoundCache eCache = SoundCache::Compressed;
+	};
+
+	struct Channel {
+		FMOD::Channel* pChannel = nullptr;	// nullptr while the slot is free
+		unsigned int nGeneration = 0;
+	};
+
+	FMOD::Channel* FindChannel(int nChannel);
+
+	FMOD::Studio::System* mpStudioSystem = nullptr;
+	FMOD::System* mpSystem = nullptr;
+	std::vector<Sound> mSounds;	// by id
+	std::vector<Channel> mChannels;
+};
+
+// Decodes a sound FMOD reads (the shipped MP3s) to a 16 bit PCM WAV, which
+// SoftwareAudioBackend plays; --cook writes decodedSoundPath() of every sound
+bool decodeSoundToWav(const std::string& path, const std::string& wavPath);
+
+#endif
+
+#endif
@@ -0,0 +1,116 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	// what a client frame's weapon matrices and a server tick's reply take, with room to spare
+	const size_t FRAME_ARENA_CAPACITY = 256 * 1024;
+
+#ifdef MINIMALVR_COUNT_ALLOCATIONS
+	// per thread, so the audio, exchange, asset and job threads stay out of a frame's count
+	thread_local size_t allocationCount = 0;
+
+	void* countedAllocate(size_t bytes)
+	{
+		allocationCount++;
+		void* p = std::malloc(bytes ? bytes : 1);
+		if (!p)
+			throw std::bad_alloc();
+		return p;
+	}
+#endif
+}
+
+FrameArena frameArena(FRAME_ARENA_CAPACITY);
+
+#ifdef MINIMALVR_COUNT_ALLOCATIONS
+
+size_t heapAllocations()
+{
+	return allocationCount;
+}
+
+void* operator new(size_t bytes)
+{
+	return countedAllocate(bytes);
+}
+
+void* operator new[](size_t bytes)
+{
+	return countedAllocate(bytes);
+}
+
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept
+{
+	allocationCount++;
+	return std::malloc(bytes ? bytes : 1);
+}
+
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept
+{
+	allocationCount++;
+	return std::malloc(bytes ? bytes : 1);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+#else
+
+size_t heapAllocations()
+{
+	return 0;
+}
+
+#endif
+
+FrameArena::FrameArena(size_t capacity) : _capacity(capacity)
+{
+	_block = static_cast<char*>(::operator new(_capacity));
+}
+
+FrameArena::~FrameArena()
+{
+	for (void* p : _overflow)
+		::operator delete(p);
+	::operator delete(_block);
+}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment)
+{
+	size_t offset = _used.fetch_add(bytes + alignment - 1, std::memory_order_relaxed);
+	uintptr_t start = ((uintptr_t)_block + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	if (start + bytes <= (uintptr_t)_block + _capacity)
+		return (void*)start;
+
+	// past the block: the heap until the next reset, which grows the block
+	void* p = ::operator new(bytes);
+	std::lock_guard<std::mutex> lock(_overflowMutex);
+	_overflow.push_back(p);
+	return p;
+}
+
+void FrameArena::reset()
+{
+	// overflowed allocations count into _used too, so it is what the frame wanted
+	_highWater = std::max(_highWater, _used.load(std::memory_order_relaxed));
+	if (!_overflow.empty())
+	{
+		for (void* p : _overflow)
+			::operator delete(p);
+		_overflow.clear();
+
+		_capacity = std::max(_capacity, _highWater * 2);
+		::operator delete(_block);
+		_block = static_cast<char*>(::operator new(_capacity));
+	}
+	_used.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,91 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Bump allocator for what lives one client frame or one server tick: allocating is an
+// atomic add, freeing is a no-op, and reset() drops everything at once. A frame that
+// needs more than the block takes the rest from the heap, and the next reset grows
+// the block to twice the high water, so after the first frames nothing reaches the
+// heap. Any thread may allocate; reset only while nothing allocated is in use, i.e.
+// between frames or ticks.
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t capacity);
+	~FrameArena();
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// alignment up to alignof(std::max_align_t), a power of two
+	void* allocate(size_t bytes, size_t alignment);
+	void reset();
+
+	size_t capacity() const { return _capacity; }
+	// the most one frame has used so far
+	size_t highWater() const { return _highWater; }
+
+private:
+	char* _block;
+	size_t _capacity;
+	std::atomic<size_t> _used{ 0 };
+	size_t _highWater = 0;
+
+	std::mutex _overflowMutex;
+	std::vector<void*> _overflow;
+};
+
+// the client's per frame, the server's per tick; main loops reset it
+extern FrameArena frameArena;
+
+// STL allocator on a FrameArena, frameArena unless given another. A container using
+// it must be gone, or at least never touched again, by the arena's next reset.
+template<typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	ArenaAllocator() : _arena(&frameArena) {}
+	explicit ArenaAllocator(FrameArena& arena) : _arena(&arena) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : _arena(other.arena()) {}
+
+	T* allocate(size_t n) { return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t) {}
+
+	FrameArena* arena() const { return _arena; }
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return _arena == other.arena(); }
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return _arena != other.arena(); }
+
+private:
+	FrameArena* _arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+// Heap allocations through operator new so far on the calling thread; what other
+// threads allocate for it, job workers included, is not in it. Only builds that
+// define MINIMALVR_COUNT_ALLOCATIONS (the Debug configurations) count them: there
+// FrameArena.cpp replaces the global operator new, elsewhere this stays 0. The
+// benchmarks and the server compare it around a frame or tick. Memory taken with
+// malloc, which includes rpclib's msgpack zones and buffers, is not counted.
+size_t heapAllocations();
+
+#ifdef MINIMALVR_COUNT_ALLOCATIONS
+const bool HEAP_ALLOCATIONS_COUNTED = true;
+#else
+const bool HEAP_ALLOCATIONS_COUNTED = false;
+#endif
+
+#endif
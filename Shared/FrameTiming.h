@@ -0,0 +1,130 @@
+#ifndef FRAME_TIMING_H
+#define FRAME_TIMING_H
+
+#include <chrono>
+#include <GL/glew.h>
+
+// Where the ResolutionGovernor gets its frame times from.
+// beginFrame/endFrame bracket the rendering of one frame, poll returns true
+// when timings of an earlier frame are ready (GPU results arrive a few frames late).
+class FrameTimingSource
+{
+public:
+	virtual ~FrameTimingSource() {}
+
+	virtual void beginFrame() = 0;
+	virtual void endFrame() = 0;
+	virtual bool poll(float& cpuMs, float& gpuMs) = 0;
+
+	// the viewport scale used for the frame being started, only the simulation cares
+	virtual void setScale(float scale) {}
+};
+
+// GL_TIME_ELAPSED queries in a small ring so reading a result never stalls the pipeline
+class GlFrameTiming : public FrameTimingSource
+{
+public:
+	static const int RING_SIZE = 4;
+
+	GlFrameTiming()
+	{
+		glGenQueries(RING_SIZE, queries);
+	}
+
+	~GlFrameTiming()
+	{
+		glDeleteQueries(RING_SIZE, queries);
+	}
+
+	void beginFrame() override
+	{
+		cpuStart = std::chrono::high_resolution_clock::now();
+		glBeginQuery(GL_TIME_ELAPSED, queries[head]);
+	}
+
+	void endFrame() override
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - cpuStart;
+		cpuMs[head] = elapsed.count();
+		head = (head + 1) % RING_SIZE;
+		if (pending < RING_SIZE)
+			pending++;
+	}
+
+	bool poll(float& outCpuMs, float& outGpuMs) override
+	{
+		if (pending == 0)
+			return false;
+
+		int oldest = (head + RING_SIZE - pending) % RING_SIZE;
+		GLint available = 0;
+		glGetQueryObjectiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return false;
+
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &ns);
+		outGpuMs = ns / 1000000.0f;
+		outCpuMs = cpuMs[oldest];
+		pending--;
+		return true;
+	}
+
+private:
+	GLuint queries[RING_SIZE];
+	float cpuMs[RING_SIZE];
+	int head = 0;
+	int pending = 0;
+	std::chrono::high_resolution_clock::time_point cpuStart;
+};
+
+// Software stand-in for headless runs: GPU cost grows with the pixel count
+// (scale squared), plus optional load spikes. Results are available immediately.
+class SimulatedFrameTiming : public FrameTimingSource
+{
+public:
+	float cpuMs = 4.0f;
+	// GPU time at scale 1.0
+	float gpuMsAtFullScale = 9.0f;
+	float gpuFixedMs = 1.0f;
+
+	// every spikeInterval frames the GPU cost is multiplied by spikeFactor for spikeLength frames
+	int spikeInterval = 0;
+	int spikeLength = 0;
+	float spikeFactor = 1.0f;
+
+	void setScale(float s) override { scale = s; }
+
+	void beginFrame() override {}
+
+	void endFrame() override
+	{
+		float load = 1.0f;
+		if (spikeInterval > 0 && (frame % spikeInterval) < spikeLength)
+			load = spikeFactor;
+		lastGpuMs = gpuFixedMs + gpuMsAtFullScale * scale * scale * load;
+		frame++;
+		ready = true;
+	}
+
+	bool poll(float& outCpuMs, float& outGpuMs) override
+	{
+		if (!ready)
+			return false;
+		outCpuMs = cpuMs;
+		outGpuMs = lastGpuMs;
+		ready = false;
+		return true;
+	}
+
+	int getFrame() const { return frame; }
+
+private:
+	float scale = 1.0f;
+	float lastGpuMs = 0.0f;
+	int frame = 0;
+	bool ready = false;
+};
+
+#endif
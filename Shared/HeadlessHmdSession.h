@@ -0,0 +1,220 @@
+#ifndef HEADLESS_HMD_SESSION_H
+#define HEADLESS_HMD_SESSION_H
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "HmdSession.h"
+
+// A fake headset for render benchmarks and regression runs on machines without a
+// Rift: CV1-like fixed eye FOVs, a three-texture swap chain in plain GL textures,
+// and a static standing pose. The GL context itself is created offscreen by GlfwApp.
+class HeadlessHmdSession : public HmdSession
+{
+public:
+	static const int SWAP_CHAIN_LENGTH = 3;
+
+	// pixels per unit of tan(angle) at pixel density 1.0, about what a CV1 asks for
+	float pixelsPerTanAngle = 600.0f;
+	float ipd = 0.064f;
+
+	HeadlessHmdSession()
+	{
+		memset(&desc, 0, sizeof(desc));
+		desc.Type = ovrHmd_CV1;
+		desc.Resolution.w = 2160;
+		desc.Resolution.h = 1200;
+		desc.DisplayRefreshRate = 90.0f;
+		for (int eye = 0; eye < ovrEye_Count; eye++)
+		{
+			ovrFovPort fov;
+			fov.UpTan = 1.33f;
+			fov.DownTan = 1.33f;
+			// the nasal side is narrower
+			fov.LeftTan = (eye == ovrEye_Left) ? 1.06f : 0.93f;
+			fov.RightTan = (eye == ovrEye_Left) ? 0.93f : 1.06f;
+			desc.DefaultEyeFov[eye] = fov;
+			desc.MaxEyeFov[eye] = fov;
+		}
+	}
+
+	~HeadlessHmdSession()
+	{
+		if (swapTextures[0])
+			glDeleteTextures(SWAP_CHAIN_LENGTH, swapTextures);
+		if (mirrorTexture)
+			glDeleteTextures(1, &mirrorTexture);
+		if (readFbo)
+			glDeleteFramebuffers(1, &readFbo);
+		if (drawFbo)
+			glDeleteFramebuffers(1, &drawFbo);
+	}
+
+	ovrHmdDesc getHmdDesc() override
+	{
+		return desc;
+	}
+
+	ovrEyeRenderDesc getRenderDesc(ovrEyeType eye, const ovrFovPort& fov) override
+	{
+		ovrEyeRenderDesc erd;
+		memset(&erd, 0, sizeof(erd));
+		erd.Eye = eye;
+		erd.Fov = fov;
+		erd.HmdToEyePose.Orientation.w = 1.0f;
+		erd.HmdToEyePose.Position.x = (eye == ovrEye_Left ? -0.5f : 0.5f) * ipd;
+		return erd;
+	}
+
+	ovrSizei getFovTextureSize(ovrEyeType eye, const ovrFovPort& fov, float pixelsPerDisplayPixel) override
+	{
+		ovrSizei size;
+		size.w = (int)std::ceil((fov.LeftTan + fov.RightTan) * pixelsPerTanAngle * pixelsPerDisplayPixel);
+		size.h = (int)std::ceil((fov.UpTan + fov.DownTan) * pixelsPerTanAngle * pixelsPerDisplayPixel);
+		return size;
+	}
+
+	glm::mat4 getProjection(const ovrFovPort& fov, float nearPlane, float farPlane) override
+	{
+		return glm::frustum(-fov.LeftTan * nearPlane, fov.RightTan * nearPlane,
+			-fov.DownTan * nearPlane, fov.UpTan * nearPlane, nearPlane, farPlane);
+	}
+
+	ovrTrackingState getTrackingState(double absTime) override
+	{
+		ovrTrackingState state;
+		memset(&state, 0, sizeof(state));
+		state.HeadPose.ThePose = headPose;
+		state.HandPoses[ovrHand_Left].ThePose = leftHandPose;
+		state.HandPoses[ovrHand_Right].ThePose = rightHandPose;
+		state.StatusFlags = ovrStatus_OrientationTracked | ovrStatus_PositionTracked;
+		state.HandStatusFlags[ovrHand_Left] = state.StatusFlags;
+		state.HandStatusFlags[ovrHand_Right] = state.StatusFlags;
+		return state;
+	}
+
+	bool getInputState(ovrInputState* inputState) override
+	{
+		memset(inputState, 0, sizeof(ovrInputState));
+		inputState->ControllerType = ovrControllerType_Touch;
+		return true;
+	}
+
+	void getEyePoses(long long frame, const ovrPosef hmdToEyePose[2], ovrPosef outEyePoses[2], double* outSensorSampleTime) override
+	{
+		for (int eye = 0; eye < ovrEye_Count; eye++)
+		{
+			outEyePoses[eye] = composePoses(headPose, hmdToEyePose[eye]);
+		}
+		if (outSensorSampleTime)
+			*outSensorSampleTime = frame / (double)desc.DisplayRefreshRate;
+	}
+
+	void recenter() override
+	{
+	}
+
+	bool createSwapChain(int width, int height) override
+	{
+		swapSize = glm::ivec2(width, height);
+		glGenTextures(SWAP_CHAIN_LENGTH, swapTextures);
+		for (int i = 0; i < SWAP_CHAIN_LENGTH; i++)
+		{
+			glBindTexture(GL_TEXTURE_2D, swapTextures[i]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glGenFramebuffers(1, &readFbo);
+		glGenFramebuffers(1, &drawFbo);
+		return true;
+	}
+
+	GLuint getCurrentSwapTexture() override
+	{
+		return swapTextures[current];
+	}
+
+	void commitSwapChain() override
+	{
+		lastCommitted = current;
+		current = (current + 1) % SWAP_CHAIN_LENGTH;
+	}
+
+	// stands in for the compositor: copies the committed texture into the mirror,
+	// upside down like the Oculus mirror texture
+	void submitFrame(long long frame, const ovrViewScaleDesc* viewScaleDesc, ovrLayerEyeFov* layer) override
+	{
+		layer->ColorTexture[0] = nullptr;
+		if (!mirrorTexture || lastCommitted < 0)
+			return;
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, swapTextures[lastCommitted], 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFbo);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mirrorTexture, 0);
+		glBlitFramebuffer(0, 0, swapSize.x, swapSize.y, 0, mirrorSize.y, mirrorSize.x, 0, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	}
+
+	bool createMirrorTexture(int width, int height) override
+	{
+		mirrorSize = glm::ivec2(width, height);
+		glGenTextures(1, &mirrorTexture);
+		glBindTexture(GL_TEXTURE_2D, mirrorTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return true;
+	}
+
+	GLuint getMirrorTexture() override
+	{
+		return mirrorTexture;
+	}
+
+	bool isHeadless() const override { return true; }
+
+	// Reads back the last committed eye texture, for golden-image checksums
+	bool readLastFrame(std::vector<unsigned char>& pixels, int& width, int& height)
+	{
+		if (lastCommitted < 0)
+			return false;
+
+		width = swapSize.x;
+		height = swapSize.y;
+		pixels.resize((size_t)width * height * 4);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, swapTextures[lastCommitted], 0);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		return true;
+	}
+
+private:
+	ovrHmdDesc desc;
+
+	ovrPosef headPose = { { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+	ovrPosef leftHandPose = { { 0.0f, 0.0f, 0.0f, 1.0f }, { -0.2f, -0.3f, -0.3f } };
+	ovrPosef rightHandPose = { { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.2f, -0.3f, -0.3f } };
+
+	GLuint swapTextures[SWAP_CHAIN_LENGTH] = { 0, 0, 0 };
+	int current = 0;
+	int lastCommitted = -1;
+	glm::ivec2 swapSize;
+
+	GLuint mirrorTexture = 0;
+	glm::ivec2 mirrorSize;
+	GLuint readFbo = 0;
+	GLuint drawFbo = 0;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef HMD_SESSION_H
+#define HMD_SESSION_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <OVR_CAPI.h>
+
+// The part of the Oculus runtime RiftApp talks to. OvrHmdSession forwards to LibOVR,
+// HeadlessHmdSession fakes a headset with fixed FOVs and a simulated swap chain so the
+// client can render (and be benchmarked) without a headset or the Oculus service.
+//
+// The calls mirror the ovr_* functions they replace, with the session and swap chain
+// handles hidden inside the implementation.
+class HmdSession
+{
+public:
+	virtual ~HmdSession() {}
+
+	virtual ovrHmdDesc getHmdDesc() = 0;
+	virtual ovrEyeRenderDesc getRenderDesc(ovrEyeType eye, const ovrFovPort& fov) = 0;
+	virtual ovrSizei getFovTextureSize(ovrEyeType eye, const ovrFovPort& fov, float pixelsPerDisplayPixel) = 0;
+	// OpenGL clip range projection for an eye FOV
+	virtual glm::mat4 getProjection(const ovrFovPort& fov, float nearPlane, float farPlane) = 0;
+
+	virtual ovrTrackingState getTrackingState(double absTime) = 0;
+	virtual bool getInputState(ovrInputState* inputState) = 0;
+	virtual void getEyePoses(long long frame, const ovrPosef hmdToEyePose[2], ovrPosef outEyePoses[2], double* outSensorSampleTime) = 0;
+	virtual void recenter() = 0;
+
+	// one sRGB RGBA8 swap chain holding both eyes side by side
+	virtual bool createSwapChain(int width, int height) = 0;
+	virtual GLuint getCurrentSwapTexture() = 0;
+	virtual void commitSwapChain() = 0;
+	// fills in the layer's color texture and hands the frame to the compositor
+	virtual void submitFrame(long long frame, const ovrViewScaleDesc* viewScaleDesc, ovrLayerEyeFov* layer) = 0;
+
+	virtual bool createMirrorTexture(int width, int height) = 0;
+	virtual GLuint getMirrorTexture() = 0;
+
+	// optional runtime features, a fake headset has neither
+	virtual bool getFovStencil(const ovrFovStencilDesc* desc, ovrFovStencilMeshBuffer* meshBuffer) { return false; }
+	virtual bool getPerfStats(ovrPerfStats* stats) { return false; }
+
+	virtual bool isHeadless() const { return false; }
+};
+
+// parent * child for rigid poses, e.g. head pose * HmdToEyePose = eye pose
+inline ovrPosef composePoses(const ovrPosef& parent, const ovrPosef& child)
+{
+	glm::quat parentOrientation = glm::make_quat(&parent.Orientation.x);
+	glm::quat orientation = parentOrientation * glm::make_quat(&child.Orientation.x);
+	glm::vec3 position = glm::make_vec3(&parent.Position.x) + parentOrientation * glm::make_vec3(&child.Position.x);
+
+	ovrPosef result;
+	result.Orientation = { orientation.x, orientation.y, orientation.z, orientation.w };
+	result.Position = { position.x, position.y, position.z };
+	return result;
+}
+
+#endif
@@ -0,0 +1,308 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+JobSystem jobSystem;
+
+namespace
+{
+	// the pool the running thread belongs to and its deque; 0 outside any pool
+	thread_local const JobSystem* currentSystem = nullptr;
+	thread_local unsigned int currentQueue = 0;
+
+	// chunks a parallelFor makes per thread at most, so a slow chunk can be evened out
+	const size_t CHUNKS_PER_THREAD = 4;
+
+	// allocate_shared puts the job and its reference counts in one pool block
+	template<typename T>
+	struct PoolAllocator
+	{
+		typedef T value_type;
+
+		explicit PoolAllocator(JobPool& pool) : pool(&pool) {}
+		template<typename U>
+		PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool) {}
+
+		T* allocate(size_t n) { return static_cast<T*>(pool->allocate(n * sizeof(T))); }
+		void deallocate(T* p, size_t n) { pool->deallocate(p, n * sizeof(T)); }
+
+		template<typename U>
+		bool operator==(const PoolAllocator<U>& other) const { return pool == other.pool; }
+		template<typename U>
+		bool operator!=(const PoolAllocator<U>& other) const { return pool != other.pool; }
+
+		JobPool* pool;
+	};
+}
+
+JobPool::~JobPool()
+{
+	for (void* chunk : _chunks)
+		::operator delete(chunk);
+}
+
+void* JobPool::allocate(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_blockSize == 0)
+		_blockSize = (bytes + 15) & ~(size_t)15;
+	if (bytes > _blockSize)
+		return ::operator new(bytes);
+
+	if (!_free)
+	{
+		char* chunk = static_cast<char*>(::operator new(_blockSize * BLOCKS_PER_CHUNK));
+		_chunks.push_back(chunk);
+		for (size_t i = 0; i < BLOCKS_PER_CHUNK; i++)
+			release(chunk + i * _blockSize);
+	}
+	void* block = _free;
+	_free = *static_cast<void**>(block);
+	return block;
+}
+
+void JobPool::deallocate(void* p, size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (bytes > _blockSize)
+		::operator delete(p);
+	else
+		release(p);
+}
+
+void JobPool::release(void* block)
+{
+	*static_cast<void**>(block) = _free;
+	_free = block;
+}
+
+void JobSystem::WorkQueue::pushBack(const JobHandle& job)
+{
+	if (back - front == ring.size())
+	{
+		std::vector<JobHandle> bigger(std::max<size_t>(16, ring.size() * 2));
+		for (size_t i = front; i < back; i++)
+			bigger[i - front] = std::move(ring[i & (ring.size() - 1)]);
+		back -= front;
+		front = 0;
+		ring.swap(bigger);
+	}
+	ring[back++ & (ring.size() - 1)] = job;
+}
+
+JobSystem::JobHandle JobSystem::WorkQueue::popBack()
+{
+	return std::move(ring[--back & (ring.size() - 1)]);
+}
+
+JobSystem::JobHandle JobSystem::WorkQueue::popFront()
+{
+	return std::move(ring[front++ & (ring.size() - 1)]);
+}
+
+JobSystem::JobSystem(unsigned int threads)
+{
+	setThreads(threads);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(_sleepMutex);
+		_stopping = true;
+	}
+	_wake.notify_all();
+	for (auto& worker : _workers)
+		worker.join();
+}
+
+void JobSystem::setThreads(unsigned int threads)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	_queues.clear();
+	for (unsigned int i = 0; i < threads; i++)
+		_queues.emplace_back(new WorkQueue());
+}
+
+void JobSystem::start()
+{
+	// started on first use, so the global instance costs nothing in tools and at exit
+	for (unsigned int i = 1; i < _queues.size(); i++)
+		_workers.emplace_back(&JobSystem::workerMain, this, i);
+}
+
+JobSystem::JobHandle JobSystem::create(std::function<void()> work)
+{
+	JobHandle job = std::allocate_shared<Job>(PoolAllocator<Job>(_pool));
+	job->work = std::move(work);
+	return job;
+}
+
+void JobSystem::depend(const JobHandle& job, const JobHandle& dependency)
+{
+	std::lock_guard<std::mutex> lock(dependency->mutex);
+	if (dependency->finishing)
+		return;
+	if (dependency->dependentCount < Job::INLINE_DEPENDENTS)
+		dependency->dependents[dependency->dependentCount++] = job;
+	else
+		dependency->moreDependents.push_back(job);
+	job->blockers++;
+}
+
+void JobSystem::submit(const JobHandle& job)
+{
+	if (--job->blockers == 0)
+		push(job);
+}
+
+JobSystem::JobHandle JobSystem::run(std::function<void()> work)
+{
+	JobHandle job = create(std::move(work));
+	submit(job);
+	return job;
+}
+
+bool JobSystem::finished(const JobHandle& job)
+{
+	return job->done.load(std::memory_order_acquire);
+}
+
+void JobSystem::wait(const JobHandle& job)
+{
+	unsigned int index = queueIndex();
+	while (!finished(job))
+	{
+		JobHandle next = take(index);
+		if (next)
+			execute(next);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+	size_t chunks = std::min((count + std::max<size_t>(grain, 1) - 1) / std::max<size_t>(grain, 1),
+		threads() * CHUNKS_PER_THREAD);
+	if (chunks <= 1)
+	{
+		if (count)
+			body(0, count);
+		return;
+	}
+
+	// the chunk jobs capture a pointer and an index, which std::function keeps without allocating
+	struct Split {
+		const std::function<void(size_t, size_t)>* body;
+		size_t count;
+		size_t chunks;
+
+		void run(size_t i) const { (*body)(count * i / chunks, count * (i + 1) / chunks); }
+	} split = { &body, count, chunks };
+
+	JobHandle all = create(nullptr);
+	for (size_t i = 1; i < chunks; i++)
+	{
+		const Split* shared = &split;
+		JobHandle chunk = create([shared, i] { shared->run(i); });
+		depend(all, chunk);
+		submit(chunk);
+	}
+	submit(all);
+	split.run(0);
+	wait(all);
+}
+
+unsigned int JobSystem::queueIndex() const
+{
+	return currentSystem == this ? currentQueue : 0;
+}
+
+void JobSystem::push(const JobHandle& job)
+{
+	std::call_once(_started, [this] { start(); });
+
+	WorkQueue& queue = *_queues[queueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.pushBack(job);
+	}
+	// a worker going to sleep counts itself before it checks _queued, so one of the
+	// two sees the other
+	_queued++;
+	if (_sleepers > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_sleepMutex);
+		}
+		_wake.notify_one();
+	}
+}
+
+JobSystem::JobHandle JobSystem::take(unsigned int index)
+{
+	JobHandle job;
+	{
+		WorkQueue& own = *_queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.empty())
+			job = own.popBack();
+	}
+	for (size_t i = 1; !job && i < _queues.size(); i++)
+	{
+		WorkQueue& victim = *_queues[(index + i) % _queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.empty())
+			job = victim.popFront();
+	}
+	if (job)
+		_queued--;
+	return job;
+}
+
+void JobSystem::execute(const JobHandle& job)
+{
+	if (job->work)
+		job->work();
+
+	JobHandle dependents[Job::INLINE_DEPENDENTS];
+	std::vector<JobHandle> moreDependents;
+	int count;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->finishing = true;
+		count = job->dependentCount;
+		for (int i = 0; i < count; i++)
+			dependents[i] = std::move(job->dependents[i]);
+		moreDependents.swap(job->moreDependents);
+	}
+	job->done.store(true, std::memory_order_release);
+	for (int i = 0; i < count; i++)
+		submit(dependents[i]);
+	for (const JobHandle& dependent : moreDependents)
+		submit(dependent);
+}
+
+void JobSystem::workerMain(unsigned int index)
+{
+	currentSystem = this;
+	currentQueue = index;
+	while (true)
+	{
+		JobHandle job = take(index);
+		if (job)
+		{
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(_sleepMutex);
+		_sleepers++;
+		_wake.wait(lock, [this] { return _stopping || _queued > 0; });
+		_sleepers--;
+		if (_stopping)
+			return;
+	}
+}
@@ -0,0 +1,129 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing scheduler for the short, fine-grained work of a client frame or a
+// server tick. Each pool thread has its own deque, and the threads outside the pool
+// share one: a thread pushes and takes its own jobs at the back, newest first while they
+// are warm in its cache, and once that runs dry steals the oldest job from the front
+// of another's. A job may depend on others and is queued when the last of them
+// finishes. Waiting on a job runs other jobs meanwhile, so waiting inside a job never
+// ties a thread up, and with a single thread everything runs inside wait.
+// Any thread may create, submit and wait.
+// Recycles the memory of finished jobs, blocks of the one size they have, so a
+// steady frame creates its jobs without the heap
+class JobPool
+{
+public:
+	JobPool() = default;
+	~JobPool();
+	JobPool(const JobPool&) = delete;
+	JobPool& operator=(const JobPool&) = delete;
+
+	// other sizes go to the heap
+	void* allocate(size_t bytes);
+	void deallocate(void* p, size_t bytes);
+
+private:
+	static const size_t BLOCKS_PER_CHUNK = 64;
+
+	std::mutex _mutex;
+	size_t _blockSize = 0;			// the first allocation's
+	void* _free = nullptr;			// a freed block holds the next one
+	std::vector<void*> _chunks;
+
+	void release(void* block);
+};
+
+class JobSystem
+{
+public:
+	struct Job;
+	typedef std::shared_ptr<Job> JobHandle;
+
+	// threads counts the one waiting; 0 picks the hardware threads
+	explicit JobSystem(unsigned int threads = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// only before the first job is submitted
+	void setThreads(unsigned int threads);
+	unsigned int threads() const { return (unsigned int)_queues.size(); }
+
+	// work runs once the job is submitted and its dependencies have finished
+	JobHandle create(std::function<void()> work);
+	// both created, job not submitted yet; dependency may be finished already
+	void depend(const JobHandle& job, const JobHandle& dependency);
+	void submit(const JobHandle& job);
+	JobHandle run(std::function<void()> work);
+	// runs jobs, its own or stolen, until job finished
+	void wait(const JobHandle& job);
+	static bool finished(const JobHandle& job);
+
+	// body(begin, end) over [0, count) in chunks of at least grain, a few per thread at
+	// most; the calling thread runs the first and helps with the rest until all ran
+	void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+private:
+	// a ring rather than a std::deque, which allocates as it goes; it only grows
+	struct WorkQueue {
+		std::mutex mutex;
+		std::vector<JobHandle> ring;	// a power of two long
+		size_t front = 0;
+		size_t back = 0;				// one past the newest
+
+		bool empty() const { return front == back; }
+		void pushBack(const JobHandle& job);
+		JobHandle popBack();
+		JobHandle popFront();
+	};
+
+	void start();
+	void workerMain(unsigned int index);
+	unsigned int queueIndex() const;
+	void push(const JobHandle& job);
+	JobHandle take(unsigned int index);
+	void execute(const JobHandle& job);
+
+	// first, so the jobs still queued at exit are released before it goes
+	JobPool _pool;
+	std::vector<std::unique_ptr<WorkQueue>> _queues;
+	std::vector<std::thread> _workers;
+	std::once_flag _started;
+
+	std::atomic<int> _queued{ 0 };
+	std::atomic<int> _sleepers{ 0 };
+	std::mutex _sleepMutex;
+	std::condition_variable _wake;
+	bool _stopping = false;
+};
+
+struct JobSystem::Job {
+	std::function<void()> work;
+	// unfinished dependencies, plus one until submitted
+	std::atomic<int> blockers{ 1 };
+	std::atomic<bool> done{ false };
+
+	std::mutex mutex;				// guards the ones below
+	bool finishing = false;
+	// the jobs waiting on this one, the first few without allocating
+	static const int INLINE_DEPENDENTS = 4;
+	JobHandle dependents[INLINE_DEPENDENTS];
+	int dependentCount = 0;
+	std::vector<JobHandle> moreDependents;
+};
+
+// for work that fans out wide enough to pay for its jobs; the client frame and the
+// server tick, a few players and weapons, run inline
+extern JobSystem jobSystem;
+
+#endif
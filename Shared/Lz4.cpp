@@ -0,0 +1,149 @@
+#include "Lz4.h"
+
+#include <cstring>
+
+namespace
+{
+	const size_t MIN_MATCH = 4;
+	// the last match must start this far before the end, the last 5 bytes are literals
+	const size_t MATCH_START_LIMIT = 12;
+	const size_t LAST_LITERALS = 5;
+	const size_t MAX_OFFSET = 65535;
+	const int HASH_BITS = 16;
+
+	uint32_t read32(const uint8_t* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint32_t hash4(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	void writeLength(std::vector<uint8_t>& out, size_t length)
+	{
+		while (length >= 255)
+		{
+			out.push_back(255);
+			length -= 255;
+		}
+		out.push_back((uint8_t)length);
+	}
+
+	void writeSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+	{
+		size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+		out.push_back((uint8_t)(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15)));
+		if (literalCount >= 15)
+			writeLength(out, literalCount - 15);
+		out.insert(out.end(), literals, literals + literalCount);
+		if (!matchLength)
+			return;
+		out.push_back((uint8_t)(offset & 0xff));
+		out.push_back((uint8_t)(offset >> 8));
+		if (matchCode >= 15)
+			writeLength(out, matchCode - 15);
+	}
+
+	bool readLength(const uint8_t*& p, const uint8_t* end, size_t& length)
+	{
+		uint8_t byte;
+		do
+		{
+			if (p == end)
+				return false;
+			byte = *p++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+}
+
+size_t lz4CompressBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+void lz4Compress(const uint8_t* source, size_t size, std::vector<uint8_t>& compressed)
+{
+	compressed.clear();
+	compressed.reserve(lz4CompressBound(size));
+
+	size_t anchor = 0;
+	if (size > MATCH_START_LIMIT)
+	{
+		// last position a match may start at; positions are stored + 1, 0 is empty
+		size_t matchStartEnd = size - MATCH_START_LIMIT;
+		size_t matchEnd = size - LAST_LITERALS;
+		std::vector<uint32_t> table((size_t)1 << HASH_BITS, 0);
+
+		size_t position = 0;
+		while (position < matchStartEnd)
+		{
+			uint32_t sequence = read32(source + position);
+			uint32_t& slot = table[hash4(sequence)];
+			size_t candidate = slot;
+			slot = (uint32_t)(position + 1);
+			if (!candidate || position - (candidate - 1) > MAX_OFFSET || read32(source + candidate - 1) != sequence)
+			{
+				position++;
+				continue;
+			}
+
+			size_t reference = candidate - 1;
+			size_t length = MIN_MATCH;
+			while (position + length < matchEnd && source[reference + length] == source[position + length])
+				length++;
+
+			writeSequence(compressed, source + anchor, position - anchor, position - reference, length);
+			position += length;
+			anchor = position;
+		}
+	}
+	writeSequence(compressed, source + anchor, size - anchor, 0, 0);
+}
+
+bool lz4Decompress(const uint8_t* compressed, size_t compressedSize, uint8_t* target, size_t size)
+{
+	const uint8_t* p = compressed;
+	const uint8_t* end = compressed + compressedSize;
+	size_t out = 0;
+
+	while (p < end)
+	{
+		uint8_t token = *p++;
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !readLength(p, end, literalCount))
+			return false;
+		if (literalCount > (size_t)(end - p) || literalCount > size - out)
+			return false;
+		memcpy(target + out, p, literalCount);
+		p += literalCount;
+		out += literalCount;
+
+		// the last sequence has literals only
+		if (p == end)
+			break;
+
+		if (end - p < 2)
+			return false;
+		size_t offset = p[0] | ((size_t)p[1] << 8);
+		p += 2;
+		size_t length = token & 15;
+		if (length == 15 && !readLength(p, end, length))
+			return false;
+		length += MIN_MATCH;
+		if (offset == 0 || offset > out || length > size - out)
+			return false;
+
+		// byte by byte, matches may overlap their own output
+		const uint8_t* match = target + out - offset;
+		for (size_t i = 0; i < length; i++)
+			target[out + i] = match[i];
+		out += length;
+	}
+	return out == size;
+}
@@ -0,0 +1,20 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// LZ4 block format (no frame header), compatible with the reference lz4 library's
+// LZ4_compress_default / LZ4_decompress_safe. Greedy single-probe matcher: fast to
+// decode, which is all the asset archive needs; the packer pays for compression once.
+
+// bound on the compressed size of `size` input bytes
+size_t lz4CompressBound(size_t size);
+
+void lz4Compress(const uint8_t* source, size_t size, std::vector<uint8_t>& compressed);
+
+// false when the input is malformed or doesn't decode to exactly `size` bytes
+bool lz4Decompress(const uint8_t* compressed, size_t compressedSize, uint8_t* target, size_t size);
+
+#endif
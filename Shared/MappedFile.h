@@ -0,0 +1,38 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages are faulted in by the OS on
+// first touch, so opening a large file costs nothing until its data is read.
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return _data != nullptr; }
+	const unsigned char* data() const { return _data; }
+	size_t size() const { return _size; }
+
+	// touches every page, so the calling thread takes the page faults instead of
+	// whoever reads the data next (e.g. glBufferData on the GL thread)
+	void prefetch() const;
+
+private:
+	const unsigned char* _data = nullptr;
+	size_t _size = 0;
+#ifdef _WIN32
+	void* _file = nullptr;
+	void* _mapping = nullptr;
+#endif
+};
+
+#endif
@@ -7,7 +7,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "MeshOptimizer.h"
+
 #include <string>
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -27,6 +30,19 @@ struct Vertex {
 	glm::vec3 Bitangent;
 };
 
+// vertex and index data in one of the VertexFormat layouts, owned by the caller
+struct MeshBuffers {
+	VertexFormat format;
+	uint32_t vertexStride;
+	const void* vertices;
+	size_t vertexCount;
+	const void* indices;
+	size_t indexCount;
+	uint32_t indexSize; // 2 or 4 bytes
+	glm::vec3 positionScale;
+	glm::vec3 positionOffset;
+};
+
 struct Texture {
 	unsigned int id;
 	string type;
@@ -40,6 +56,13 @@ public:
 	vector<unsigned int> indices;
 	vector<Texture> textures;
 	unsigned int VAO;
+	GLsizei indexCount;
+	GLenum indexType;
+	size_t bufferBytes; // vertex and index buffer storage on the GPU
+	// how shader.vert decodes the vertices, see MeshOptimizer.h
+	VertexFormat format;
+	glm::vec3 positionScale;
+	glm::vec3 positionOffset;
 
 	/*  Functions  */
 	// constructor
@@ -50,7 +73,17 @@ public:
 		this->textures = textures;
 
 		// now that we have all the required data, set the vertex buffers and its attribute pointers.
-		setupMesh();
+		MeshBuffers buffers = { VertexFormat::Full, sizeof(Vertex), this->vertices.data(), this->vertices.size(),
+			this->indices.data(), this->indices.size(), sizeof(unsigned int), glm::vec3(1.0f), glm::vec3(0.0f) };
+		setupMesh(buffers);
+	}
+
+	// uploads straight from memory the caller owns (e.g. a mapped mesh cache or an
+	// OptimizedMesh) without keeping a CPU copy; vertices and indices stay empty
+	Mesh(const MeshBuffers& buffers, vector<Texture> textures)
+	{
+		this->textures = textures;
+		setupMesh(buffers);
 	}
 
 	// render the mesh
@@ -64,41 +97,82 @@ public:
 		for (unsigned int i = 0; i < textures.size(); i++)
 		{
 			glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-			// retrieve texture number (the N in diffuse_textureN)
-			string number;
-			string name = textures[i].type;
+			// retrieve texture number (the N in diffuse_textureN), the sampler name is
+			// made on the stack so drawing allocates nothing
+			unsigned int number = 0;
+			const string& name = textures[i].type;
 			if (name == "texture_diffuse")
-				number = std::to_string(diffuseNr++);
+				number = diffuseNr++;
 			else if (name == "texture_specular")
-				number = std::to_string(specularNr++); // transfer unsigned int to stream
+				number = specularNr++;
 			else if (name == "texture_normal")
-				number = std::to_string(normalNr++); // transfer unsigned int to stream
+				number = normalNr++;
 			else if (name == "texture_height")
-				number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-													 // now set the sampler to the correct texture unit
-			glUniform1i(glGetUniformLocation(shader, (name + number).c_str()), i);
+				number = heightNr++;
+			char sampler[64];
+			if (number)
+				snprintf(sampler, sizeof(sampler), "%s%u", name.c_str(), number);
+			else
+				snprintf(sampler, sizeof(sampler), "%s", name.c_str());
+
+			// now set the sampler to the correct texture unit
+			glUniform1i(glGetUniformLocation(shader, sampler), i);
 			// and finally bind the texture
 			glBindTexture(GL_TEXTURE_2D, textures[i].id);
 		}
 
+		// the vertex format, for shader.vert to decode positions and normals
+		if (formatUniforms.program != shader)
+		{
+			formatUniforms.program = shader;
+			formatUniforms.positionScale = glGetUniformLocation(shader, "positionScale");
+			formatUniforms.positionOffset = glGetUniformLocation(shader, "positionOffset");
+			formatUniforms.octahedralNormal = glGetUniformLocation(shader, "octahedralNormal");
+		}
+		glUniform3fv(formatUniforms.positionScale, 1, &positionScale[0]);
+		glUniform3fv(formatUniforms.positionOffset, 1, &positionOffset[0]);
+		glUniform1i(formatUniforms.octahedralNormal, format != VertexFormat::Full);
+
 		// draw mesh
 		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
 		glBindVertexArray(0);
 
 		// always good practice to set everything back to defaults once configured.
 		glActiveTexture(GL_TEXTURE0);
 	}
 
+	// deletes the GL objects; copies of a Mesh share them, so only the owner calls this
+	void release()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+	}
+
 private:
 	/*  Render data  */
 	unsigned int VBO, EBO;
+	// where the program Draw last ran with keeps the vertex format uniforms; programs
+	// are linked once and outlive the meshes, so their id is enough to key on
+	struct {
+		GLint program = 0;
+		GLint positionScale = -1;
+		GLint positionOffset = -1;
+		GLint octahedralNormal = -1;
+	} formatUniforms;
 
 	/*  Functions    */
 	// initializes all the buffer objects/arrays
-	void setupMesh()
+	void setupMesh(const MeshBuffers& buffers)
 	{
+		this->format = buffers.format;
+		this->positionScale = buffers.positionScale;
+		this->positionOffset = buffers.positionOffset;
+		this->indexCount = (GLsizei)buffers.indexCount;
+		this->indexType = buffers.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		this->bufferBytes = buffers.vertexCount * buffers.vertexStride + buffers.indexCount * buffers.indexSize;
+
 		// create buffers/arrays
 		glGenVertexArrays(1, &VAO);
 		glGenBuffers(1, &VBO);
@@ -110,27 +184,51 @@ private:
 		// A great thing about structs is that their memory layout is sequential for all its items.
 		// The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
 		// again translates to 3/2 floats which translates to a byte array.
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, buffers.vertexCount * buffers.vertexStride, buffers.vertices, GL_STATIC_DRAW);
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-		// set the vertex attribute pointers
-		// vertex Positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-		// vertex normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-		// vertex texture coords
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-		// vertex tangent
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-		// vertex bitangent
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, buffers.indexCount * buffers.indexSize, buffers.indices, GL_STATIC_DRAW);
+
+		// set the vertex attribute pointers; shader.vert reads locations 0-2 in every format
+		GLsizei stride = (GLsizei)buffers.vertexStride;
+		if (format == VertexFormat::Full)
+		{
+			// vertex Positions
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+			// vertex normals
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Normal));
+			// vertex texture coords
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, TexCoords));
+			// vertex tangent
+			glEnableVertexAttribArray(3);
+			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Tangent));
+			// vertex bitangent
+			glEnableVertexAttribArray(4);
+			glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Bitangent));
+		}
+		else if (format == VertexFormat::Packed)
+		{
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex, position));
+			// octahedral, normal.z reads as 0
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(PackedVertex, normal));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex, texCoords));
+		}
+		else
+		{
+			// 0..1 within the mesh bounds, scaled back by positionScale and positionOffset
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, position));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, normal));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(QuantizedVertex, texCoords));
+		}
 
 		glBindVertexArray(0);
 	}
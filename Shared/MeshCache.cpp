@@ -0,0 +1,250 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace
+{
+	const char MESH_CACHE_MAGIC[4] = { 'M', 'V', 'R', 'M' };
+
+	uint64_t alignUp(uint64_t offset)
+	{
+		return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(uint64_t)(MESH_CACHE_ALIGNMENT - 1);
+	}
+
+	bool inRange(uint64_t offset, uint64_t bytes, uint64_t fileSize)
+	{
+		return offset % MESH_CACHE_ALIGNMENT == 0 && offset <= fileSize && bytes <= fileSize - offset;
+	}
+
+	void copyName(char* dst, size_t capacity, const std::string& src)
+	{
+		memset(dst, 0, capacity);
+		memcpy(dst, src.data(), src.size() < capacity - 1 ? src.size() : capacity - 1);
+	}
+
+	bool writePadded(FILE* file, const void* data, size_t bytes, uint64_t& offset)
+	{
+		static const char zeros[MESH_CACHE_ALIGNMENT] = {};
+		if (bytes && fwrite(data, 1, bytes, file) != bytes)
+			return false;
+		offset += bytes;
+		size_t pad = (size_t)(alignUp(offset) - offset);
+		if (pad && fwrite(zeros, 1, pad, file) != pad)
+			return false;
+		offset += pad;
+		return true;
+	}
+}
+
+std::string meshCachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".mvrmesh";
+}
+
+bool sourceFileStamp(const std::string& path, uint64_t& size, int64_t& time)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(path.c_str(), &st) != 0)
+		return false;
+#else
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+#endif
+	size = (uint64_t)st.st_size;
+	time = (int64_t)st.st_mtime;
+	return true;
+}
+
+bool readCookedHeader(const std::string& path, void* header, size_t size)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	bool ok = fread(header, 1, size, file) == size;
+	fclose(file);
+	return ok;
+}
+
+bool writeCookedHeader(const std::string& path, const void* header, size_t size)
+{
+	FILE* file = fopen(path.c_str(), "r+b");
+	if (!file)
+		return false;
+	bool ok = fwrite(header, 1, size, file) == size;
+	return (fclose(file) == 0) && ok;
+}
+
+bool restampMeshCache(const std::string& path, const std::string& sourcePath)
+{
+	MeshCacheHeader header;
+	return readCookedHeader(path, &header, sizeof(header))
+		&& memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic)) == 0 && header.version == MESH_CACHE_VERSION
+		&& sourceFileStamp(sourcePath, header.sourceSize, header.sourceTime)
+		&& writeCookedHeader(path, &header, sizeof(header));
+}
+
+bool writeMeshCache(const std::string& path, const std::string& sourcePath, uint32_t vertexFormat, uint32_t vertexStride,
+	const std::vector<MeshCacheSource>& meshes,
+	const std::vector<std::vector<MeshCacheTextureRef>>& materials)
+{
+	MeshCacheHeader header = {};
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+	header.version = MESH_CACHE_VERSION;
+	header.vertexFormat = vertexFormat;
+	header.vertexStride = vertexStride;
+	header.meshCount = (uint32_t)meshes.size();
+	header.materialCount = (uint32_t)materials.size();
+	if (!sourceFileStamp(sourcePath, header.sourceSize, header.sourceTime))
+	{
+		std::cout << "Mesh cache: cannot stat " << sourcePath << std::endl;
+		return false;
+	}
+
+	std::vector<MeshCacheMaterial> materialTable;
+	std::vector<MeshCacheTexture> textureTable;
+	for (const auto& textures : materials)
+	{
+		MeshCacheMaterial material = { (uint32_t)textureTable.size(), (uint32_t)textures.size() };
+		materialTable.push_back(material);
+		for (const auto& ref : textures)
+		{
+			MeshCacheTexture texture;
+			copyName(texture.type, sizeof(texture.type), ref.type);
+			copyName(texture.path, sizeof(texture.path), ref.path);
+			textureTable.push_back(texture);
+		}
+	}
+	header.textureCount = (uint32_t)textureTable.size();
+
+	// lay out the tables, then each mesh's vertex and index blob
+	header.meshTableOffset = alignUp(sizeof(MeshCacheHeader));
+	header.materialTableOffset = alignUp(header.meshTableOffset + meshes.size() * sizeof(MeshCacheMesh));
+	header.textureTableOffset = alignUp(header.materialTableOffset + materialTable.size() * sizeof(MeshCacheMaterial));
+	uint64_t blobOffset = alignUp(header.textureTableOffset + textureTable.size() * sizeof(MeshCacheTexture));
+
+	std::vector<MeshCacheMesh> meshTable;
+	for (const auto& source : meshes)
+	{
+		MeshCacheMesh mesh = {};
+		mesh.vertexCount = source.vertexCount;
+		mesh.indexCount = source.indexCount;
+		mesh.material = source.material;
+		mesh.indexSize = source.indexSize;
+		memcpy(mesh.positionScale, source.positionScale, sizeof(mesh.positionScale));
+		memcpy(mesh.positionOffset, source.positionOffset, sizeof(mesh.positionOffset));
+		mesh.vertexOffset = blobOffset;
+		blobOffset = alignUp(blobOffset + (uint64_t)source.vertexCount * vertexStride);
+		mesh.indexOffset = blobOffset;
+		blobOffset = alignUp(blobOffset + (uint64_t)source.indexCount * source.indexSize);
+		meshTable.push_back(mesh);
+	}
+
+	// write next to the target and rename, so a half written file is never picked up
+	std::string tmpPath = path + ".tmp";
+	FILE* file = fopen(tmpPath.c_str(), "wb");
+	if (!file)
+	{
+		std::cout << "Mesh cache: cannot write " << tmpPath << std::endl;
+		return false;
+	}
+
+	uint64_t offset = 0;
+	bool ok = writePadded(file, &header, sizeof(header), offset)
+		&& writePadded(file, meshTable.data(), meshTable.size() * sizeof(MeshCacheMesh), offset)
+		&& writePadded(file, materialTable.data(), materialTable.size() * sizeof(MeshCacheMaterial), offset)
+		&& writePadded(file, textureTable.data(), textureTable.size() * sizeof(MeshCacheTexture), offset);
+	for (size_t i = 0; ok && i < meshes.size(); i++)
+	{
+		ok = writePadded(file, meshes[i].vertices, (size_t)meshes[i].vertexCount * vertexStride, offset)
+			&& writePadded(file, meshes[i].indices, (size_t)meshes[i].indexCount * meshes[i].indexSize, offset);
+	}
+	ok = (fclose(file) == 0) && ok;
+
+	if (ok)
+	{
+		remove(path.c_str());
+		ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+	}
+	if (!ok)
+	{
+		std::cout << "Mesh cache: failed writing " << path << std::endl;
+		remove(tmpPath.c_str());
+	}
+	return ok;
+}
+
+bool MeshCacheFile::open(const std::string& path, const std::string& sourcePath, uint32_t vertexFormat, uint32_t vertexStride)
+{
+	close();
+	if (!_file.open(path))
+		return false;
+
+	uint64_t fileSize = _file.size();
+	const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(_file.data());
+	if (fileSize < sizeof(MeshCacheHeader)
+		|| memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(header->magic)) != 0
+		|| header->version != MESH_CACHE_VERSION
+		|| header->vertexFormat != vertexFormat
+		|| header->vertexStride != vertexStride)
+	{
+		std::cout << "Mesh cache: " << path << " has an unsupported format, ignoring it" << std::endl;
+		_file.close();
+		return false;
+	}
+
+	// a cache may ship without its source; if the source is there it must match
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if (assetFileStamp(sourcePath, sourceSize, sourceTime)
+		&& (sourceSize != header->sourceSize || sourceTime != header->sourceTime))
+	{
+		std::cout << "Mesh cache: " << path << " is stale, re-run --cook" << std::endl;
+		_file.close();
+		return false;
+	}
+
+	bool valid = inRange(header->meshTableOffset, (uint64_t)header->meshCount * sizeof(MeshCacheMesh), fileSize)
+		&& inRange(header->materialTableOffset, (uint64_t)header->materialCount * sizeof(MeshCacheMaterial), fileSize)
+		&& inRange(header->textureTableOffset, (uint64_t)header->textureCount * sizeof(MeshCacheTexture), fileSize);
+
+	const unsigned char* data = _file.data();
+	const MeshCacheMesh* meshes = reinterpret_cast<const MeshCacheMesh*>(data + header->meshTableOffset);
+	const MeshCacheMaterial* materials = reinterpret_cast<const MeshCacheMaterial*>(data + header->materialTableOffset);
+	const MeshCacheTexture* textures = reinterpret_cast<const MeshCacheTexture*>(data + header->textureTableOffset);
+
+	for (uint32_t i = 0; valid && i < header->meshCount; i++)
+	{
+		const MeshCacheMesh& mesh = meshes[i];
+		valid = inRange(mesh.vertexOffset, (uint64_t)mesh.vertexCount * vertexStride, fileSize)
+			&& (mesh.indexSize == 2 || mesh.indexSize == 4)
+			&& inRange(mesh.indexOffset, (uint64_t)mesh.indexCount * mesh.indexSize, fileSize)
+			&& mesh.material < header->materialCount;
+	}
+	for (uint32_t i = 0; valid && i < header->materialCount; i++)
+	{
+		valid = materials[i].firstTexture <= header->textureCount
+			&& materials[i].textureCount <= header->textureCount - materials[i].firstTexture;
+	}
+	for (uint32_t i = 0; valid && i < header->textureCount; i++)
+	{
+		valid = memchr(textures[i].type, 0, sizeof(textures[i].type)) && memchr(textures[i].path, 0, sizeof(textures[i].path));
+	}
+	if (!valid)
+	{
+		std::cout << "Mesh cache: " << path << " is corrupt, ignoring it" << std::endl;
+		_file.close();
+		return false;
+	}
+
+	_header = header;
+	_meshes = meshes;
+	_materials = materials;
+	_textures = textures;
+	return true;
+}
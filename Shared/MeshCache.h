@@ -0,0 +1,126 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+
+// Baked mesh file written by `Minimal.exe --cook` next to each source model
+// (axe.obj -> axe.obj.mvrmesh) and mapped by Model instead of running Assimp.
+//
+//   header | mesh table | material table | texture table | vertex and index blobs
+//
+// Every table and blob starts on a 16 byte boundary so the mapping can be handed
+// to glBufferData as is. Meshes are stored as MeshOptimizer left them: vertices in
+// one VertexFormat, 16 or 32 bit indices. The format and stride are recorded and a
+// file in another format than the one asked for is rejected.
+// The source file size and modification time are recorded as well; a cache whose
+// source changed since it was cooked is treated as missing.
+const uint32_t MESH_CACHE_VERSION = 2;
+const uint32_t MESH_CACHE_ALIGNMENT = 16;
+
+struct MeshCacheHeader {
+	char magic[4]; // "MVRM"
+	uint32_t version;
+	uint32_t vertexFormat; // VertexFormat
+	uint32_t vertexStride;
+	uint32_t meshCount;
+	uint32_t materialCount;
+	uint32_t textureCount;
+	uint32_t reserved;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	uint64_t meshTableOffset;
+	uint64_t materialTableOffset;
+	uint64_t textureTableOffset;
+};
+
+struct MeshCacheMesh {
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t material;
+	uint32_t indexSize; // 2 or 4 bytes
+	float positionScale[3]; // of quantized positions
+	float positionOffset[3];
+};
+
+struct MeshCacheMaterial {
+	uint32_t firstTexture;
+	uint32_t textureCount;
+};
+
+struct MeshCacheTexture {
+	char type[32]; // sampler prefix, e.g. "texture_diffuse"
+	char path[224]; // relative to the model's directory
+};
+
+// Input of writeMeshCache, pointing at data owned by the caller
+struct MeshCacheSource {
+	const void* vertices;
+	uint32_t vertexCount;
+	const void* indices;
+	uint32_t indexCount;
+	uint32_t indexSize;
+	uint32_t material;
+	const float* positionScale;
+	const float* positionOffset;
+};
+
+struct MeshCacheTextureRef {
+	std::string type;
+	std::string path;
+};
+
+std::string meshCachePath(const std::string& sourcePath);
+
+// Size and modification time used to detect a stale cache
+bool sourceFileStamp(const std::string& path, uint64_t& size, int64_t& time);
+
+// Reads or overwrites the leading header of a cooked file in place
+bool readCookedHeader(const std::string& path, void* header, size_t size);
+bool writeCookedHeader(const std::string& path, const void* header, size_t size);
+
+bool writeMeshCache(const std::string& path, const std::string& sourcePath, uint32_t vertexFormat, uint32_t vertexStride,
+	const std::vector<MeshCacheSource>& meshes,
+	const std::vector<std::vector<MeshCacheTextureRef>>& materials);
+
+// Records the current stamp of the source in the cache, for a source that was touched
+// without changing; false if the cache is missing or in another format
+bool restampMeshCache(const std::string& path, const std::string& sourcePath);
+
+class MeshCacheFile
+{
+public:
+	// Maps the file and validates every table and blob against its size. Fails when
+	// the file is missing, malformed, of another version, vertex format or stride, or stale.
+	bool open(const std::string& path, const std::string& sourcePath, uint32_t vertexFormat, uint32_t vertexStride);
+	void close() { _file.close(); _header = nullptr; }
+
+	uint32_t meshCount() const { return _header->meshCount; }
+	const MeshCacheMesh& mesh(uint32_t i) const { return _meshes[i]; }
+	uint32_t vertexStride() const { return _header->vertexStride; }
+	const void* vertices(uint32_t i) const { return _file.data() + _meshes[i].vertexOffset; }
+	const void* indices(uint32_t i) const { return _file.data() + _meshes[i].indexOffset; }
+
+	uint32_t materialCount() const { return _header->materialCount; }
+	const MeshCacheMaterial& material(uint32_t i) const { return _materials[i]; }
+	const MeshCacheTexture& texture(uint32_t i) const { return _textures[i]; }
+
+	size_t fileSize() const { return _file.size(); }
+
+	// touches every page so a loader thread takes the page faults instead of the uploader
+	void prefetch() const { _file.prefetch(); }
+
+private:
+	AssetFile _file;
+	const MeshCacheHeader* _header = nullptr;
+	const MeshCacheMesh* _meshes = nullptr;
+	const MeshCacheMaterial* _materials = nullptr;
+	const MeshCacheTexture* _textures = nullptr;
+};
+
+#endif
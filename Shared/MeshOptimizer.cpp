@@ -0,0 +1,536 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// Forsyth's scoring: the cache the scores model, independent of the real one
+	const int SCORE_CACHE_SIZE = 32;
+	const int MAX_VALENCE = 32;
+
+	struct ScoreTables {
+		float cache[SCORE_CACHE_SIZE];
+		float valence[MAX_VALENCE];
+
+		ScoreTables()
+		{
+			for (int i = 0; i < SCORE_CACHE_SIZE; i++)
+				cache[i] = i < 3 ? 0.75f : powf(1.0f - (i - 3) / float(SCORE_CACHE_SIZE - 3), 1.5f);
+			for (int i = 0; i < MAX_VALENCE; i++)
+				valence[i] = i ? 2.0f * powf((float)i, -0.5f) : 0.0f;
+		}
+	};
+
+	// built once, safe to reach from several asset workers
+	const ScoreTables& scoreTables()
+	{
+		static ScoreTables tables;
+		return tables;
+	}
+
+	float vertexScore(int cachePosition, uint32_t liveTriangles)
+	{
+		if (liveTriangles == 0)
+			return -1.0f;
+		const ScoreTables& tables = scoreTables();
+		float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+		return score + tables.valence[std::min(liveTriangles, (uint32_t)MAX_VALENCE - 1)];
+	}
+
+	// FIFO post-transform cache as the hardware models it: a vertex stays cached
+	// for the next `size` misses
+	struct FifoCache {
+		std::vector<size_t> stamp; // insertion number + 1, 0 when never inserted
+		size_t insertions = 0;
+		unsigned size;
+
+		FifoCache(size_t vertexCount, unsigned size) : stamp(vertexCount, 0), size(size) {}
+
+		// true on a miss
+		bool touch(uint32_t vertex)
+		{
+			if (stamp[vertex] && insertions + 1 - stamp[vertex] <= size)
+				return false;
+			stamp[vertex] = ++insertions;
+			return true;
+		}
+
+		void flush() { insertions += size; }
+	};
+
+	void readPosition(const MeshOptimizerInput& input, uint32_t vertex, float position[3])
+	{
+		memcpy(position, input.vertices + vertex * input.vertexStride + input.positionOffset, sizeof(float) * 3);
+	}
+
+	void readAttributes(const MeshOptimizerInput& input, uint32_t vertex, float normal[3], float texCoords[2])
+	{
+		const uint8_t* source = input.vertices + vertex * input.vertexStride;
+		memcpy(normal, source + input.normalOffset, sizeof(float) * 3);
+		memcpy(texCoords, source + input.texCoordOffset, sizeof(float) * 2);
+	}
+
+	uint16_t quantizeUnorm16(float value, float offset, float scale)
+	{
+		if (scale <= 0.0f)
+			return 0;
+		float normalized = std::min(1.0f, std::max(0.0f, (value - offset) / scale));
+		return (uint16_t)(normalized * 65535.0f + 0.5f);
+	}
+}
+
+uint32_t vertexFormatStride(VertexFormat format, uint32_t fullStride)
+{
+	switch (format)
+	{
+	case VertexFormat::Packed: return sizeof(PackedVertex);
+	case VertexFormat::Quantized: return sizeof(QuantizedVertex);
+	default: return fullStride;
+	}
+}
+
+const char* vertexFormatName(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::Packed: return "packed";
+	case VertexFormat::Quantized: return "quantized";
+	default: return "full";
+	}
+}
+
+size_t vertexCacheMisses(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize)
+{
+	FifoCache cache(vertexCount, cacheSize);
+	size_t misses = 0;
+	for (size_t i = 0; i < indexCount; i++)
+		misses += cache.touch(indices[i]) ? 1 : 0;
+	return misses;
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+
+	// triangles of each vertex; the first live[v] entries are the ones not emitted yet
+	std::vector<uint32_t> live(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		live[indices[i]]++;
+	std::vector<uint32_t> first(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		first[v + 1] = first[v] + live[v];
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> score(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		score[v] = vertexScore(-1, live[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	int best = -1;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+		if (best < 0 || triangleScore[t] > triangleScore[best])
+			best = (int)t;
+	}
+
+	std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+	std::vector<uint32_t> cache, next;
+	cache.reserve(SCORE_CACHE_SIZE + 3);
+	next.reserve(SCORE_CACHE_SIZE + 3);
+	size_t cursor = 0;
+
+	for (size_t out = 0; out < triangleCount; out++)
+	{
+		if (best < 0)
+		{
+			// nothing in the cache has live triangles left, continue in input order
+			while (emitted[cursor])
+				cursor++;
+			best = (int)cursor;
+		}
+
+		const uint32_t* triangle = &source[best * 3];
+		memcpy(indices + out * 3, triangle, sizeof(uint32_t) * 3);
+		emitted[best] = true;
+
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = triangle[k];
+			uint32_t* list = &adjacency[first[v]];
+			uint32_t* found = std::find(list, list + live[v], (uint32_t)best);
+			if (found != list + live[v])
+			{
+				std::swap(*found, list[live[v] - 1]);
+				live[v]--;
+			}
+		}
+
+		// the triangle's vertices move to the front, everything else shifts back
+		next.clear();
+		for (int k = 0; k < 3; k++)
+			if (std::find(next.begin(), next.end(), triangle[k]) == next.end())
+				next.push_back(triangle[k]);
+		for (uint32_t v : cache)
+			if (std::find(next.begin(), next.end(), v) == next.end())
+				next.push_back(v);
+		for (size_t i = SCORE_CACHE_SIZE; i < next.size(); i++)
+		{
+			cachePosition[next[i]] = -1;
+			score[next[i]] = vertexScore(-1, live[next[i]]);
+		}
+		if (next.size() > SCORE_CACHE_SIZE)
+			next.resize(SCORE_CACHE_SIZE);
+		cache.swap(next);
+
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			cachePosition[cache[i]] = (int)i;
+			score[cache[i]] = vertexScore((int)i, live[cache[i]]);
+		}
+
+		// rescore the live triangles around the cache and pick the best of them
+		best = -1;
+		for (uint32_t v : cache)
+		{
+			for (uint32_t i = 0; i < live[v]; i++)
+			{
+				uint32_t t = adjacency[first[v] + i];
+				triangleScore[t] = score[source[t * 3]] + score[source[t * 3 + 1]] + score[source[t * 3 + 2]];
+				if (best < 0 || triangleScore[t] > triangleScore[best])
+					best = (int)t;
+			}
+		}
+	}
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshOptimizerInput& input, float threshold)
+{
+	const unsigned CACHE_SIZE = 16;
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2)
+		return;
+
+	// hard boundaries where the cache order starts over: a triangle with three misses
+	std::vector<size_t> hard;
+	{
+		FifoCache cache(input.vertexCount, CACHE_SIZE);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			int misses = 0;
+			for (int k = 0; k < 3; k++)
+				misses += cache.touch(indices[t * 3 + k]) ? 1 : 0;
+			if (t == 0 || misses == 3)
+				hard.push_back(t);
+		}
+		hard.push_back(triangleCount);
+	}
+
+	// soft boundaries: split a hard cluster where its ACMR so far is within threshold
+	// of the whole cluster's, so splitting costs little cache efficiency
+	std::vector<size_t> clusters;
+	FifoCache cache(input.vertexCount, CACHE_SIZE);
+	for (size_t h = 0; h + 1 < hard.size(); h++)
+	{
+		size_t begin = hard[h], end = hard[h + 1];
+		cache.flush();
+		size_t clusterMisses = 0;
+		for (size_t i = begin * 3; i < end * 3; i++)
+			clusterMisses += cache.touch(indices[i]) ? 1 : 0;
+		double limit = (double)clusterMisses / (end - begin) * threshold;
+
+		cache.flush();
+		size_t start = begin, misses = 0;
+		clusters.push_back(begin);
+		for (size_t t = begin; t < end; t++)
+		{
+			for (int k = 0; k < 3; k++)
+				misses += cache.touch(indices[t * 3 + k]) ? 1 : 0;
+			if (t + 1 < end && (double)misses / (t + 1 - start) <= limit)
+			{
+				clusters.push_back(t + 1);
+				start = t + 1;
+				misses = 0;
+				cache.flush();
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+	size_t clusterCount = clusters.size() - 1;
+	if (clusterCount < 2)
+		return;
+
+	// area weighted centroid and normal of each cluster and of the whole mesh
+	std::vector<float> centroids(clusterCount * 3, 0.0f), normals(clusterCount * 3, 0.0f);
+	float meshCentroid[3] = {}, meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float area = 0.0f;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			float p0[3], p1[3], p2[3];
+			readPosition(input, indices[t * 3], p0);
+			readPosition(input, indices[t * 3 + 1], p1);
+			readPosition(input, indices[t * 3 + 2], p2);
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float a = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; k++)
+			{
+				centroids[c * 3 + k] += (p0[k] + p1[k] + p2[k]) / 3.0f * a;
+				normals[c * 3 + k] += n[k];
+			}
+			area += a;
+		}
+		for (int k = 0; k < 3; k++)
+			meshCentroid[k] += centroids[c * 3 + k];
+		meshArea += area;
+		for (int k = 0; k < 3; k++)
+			centroids[c * 3 + k] = area > 0.0f ? centroids[c * 3 + k] / area : 0.0f;
+	}
+	for (int k = 0; k < 3; k++)
+		meshCentroid[k] = meshArea > 0.0f ? meshCentroid[k] / meshArea : 0.0f;
+
+	// clusters facing away from the center are the likely occluders, draw them first
+	std::vector<float> sortKey(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		const float* n = &normals[c * 3];
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		float dot = 0.0f;
+		for (int k = 0; k < 3; k++)
+			dot += (centroids[c * 3 + k] - meshCentroid[k]) * n[k];
+		sortKey[c] = length > 0.0f ? dot / length : 0.0f;
+	}
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+	std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+	size_t out = 0;
+	for (size_t c : order)
+	{
+		size_t count = (clusters[c + 1] - clusters[c]) * 3;
+		memcpy(indices + out, &source[clusters[c] * 3], count * sizeof(uint32_t));
+		out += count;
+	}
+}
+
+size_t optimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>& remap)
+{
+	remap.assign(vertexCount, ~0u);
+	uint32_t next = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t& mapped = remap[indices[i]];
+		if (mapped == ~0u)
+			mapped = next++;
+		indices[i] = mapped;
+	}
+	return next;
+}
+
+void optimizeMesh(const MeshOptimizerInput& input, VertexFormat format, OptimizedMesh& mesh, MeshOptimizerReport* report)
+{
+	size_t indexCount = input.indexCount / 3 * 3;
+	std::vector<uint32_t> indices(input.indices, input.indices + indexCount);
+	size_t missesBefore = vertexCacheMisses(indices.data(), indexCount, input.vertexCount);
+
+	optimizeVertexCache(indices.data(), indexCount, input.vertexCount);
+	optimizeOverdraw(indices.data(), indexCount, input, 1.05f);
+	std::vector<uint32_t> remap;
+	size_t vertexCount = optimizeVertexFetch(indices.data(), indexCount, input.vertexCount, remap);
+
+	mesh.format = format;
+	mesh.vertexStride = vertexFormatStride(format, (uint32_t)input.vertexStride);
+	mesh.vertexCount = (uint32_t)vertexCount;
+	mesh.indexCount = (uint32_t)indexCount;
+	mesh.vertices.assign(vertexCount * mesh.vertexStride, 0);
+	for (int k = 0; k < 3; k++)
+	{
+		mesh.positionScale[k] = 1.0f;
+		mesh.positionOffset[k] = 0.0f;
+	}
+
+	if (format == VertexFormat::Quantized && vertexCount)
+	{
+		float lower[3] = { INFINITY, INFINITY, INFINITY }, upper[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (size_t v = 0; v < input.vertexCount; v++)
+		{
+			if (remap[v] == ~0u)
+				continue;
+			float p[3];
+			readPosition(input, (uint32_t)v, p);
+			for (int k = 0; k < 3; k++)
+			{
+				lower[k] = std::min(lower[k], p[k]);
+				upper[k] = std::max(upper[k], p[k]);
+			}
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			mesh.positionOffset[k] = lower[k];
+			mesh.positionScale[k] = upper[k] - lower[k];
+		}
+	}
+
+	for (size_t v = 0; v < input.vertexCount; v++)
+	{
+		if (remap[v] == ~0u)
+			continue;
+		uint8_t* target = &mesh.vertices[remap[v] * mesh.vertexStride];
+		if (format == VertexFormat::Full)
+		{
+			memcpy(target, input.vertices + v * input.vertexStride, input.vertexStride);
+			continue;
+		}
+
+		float position[3], normal[3], texCoords[2];
+		readPosition(input, (uint32_t)v, position);
+		readAttributes(input, (uint32_t)v, normal, texCoords);
+		if (format == VertexFormat::Packed)
+		{
+			PackedVertex packed;
+			memcpy(packed.position, position, sizeof(position));
+			encodeOctahedral(normal, packed.normal);
+			packed.texCoords[0] = floatToHalf(texCoords[0]);
+			packed.texCoords[1] = floatToHalf(texCoords[1]);
+			memcpy(target, &packed, sizeof(packed));
+		}
+		else
+		{
+			QuantizedVertex quantized;
+			for (int k = 0; k < 3; k++)
+				quantized.position[k] = quantizeUnorm16(position[k], mesh.positionOffset[k], mesh.positionScale[k]);
+			quantized.position[3] = 0;
+			encodeOctahedral(normal, quantized.normal);
+			quantized.texCoords[0] = floatToHalf(texCoords[0]);
+			quantized.texCoords[1] = floatToHalf(texCoords[1]);
+			memcpy(target, &quantized, sizeof(quantized));
+		}
+	}
+
+	mesh.indexSize = vertexCount <= 65536 ? 2 : 4;
+	mesh.indices.resize(indexCount * mesh.indexSize);
+	if (mesh.indexSize == 2)
+	{
+		uint16_t* target = reinterpret_cast<uint16_t*>(mesh.indices.data());
+		for (size_t i = 0; i < indexCount; i++)
+			target[i] = (uint16_t)indices[i];
+	}
+	else if (indexCount)
+		memcpy(mesh.indices.data(), indices.data(), indexCount * sizeof(uint32_t));
+
+	if (report)
+	{
+		report->meshes++;
+		report->triangles += indexCount / 3;
+		report->vertexBytesBefore += input.vertexCount * input.vertexStride;
+		report->vertexBytesAfter += mesh.vertices.size();
+		report->indexBytesBefore += input.indexCount * sizeof(uint32_t);
+		report->indexBytesAfter += mesh.indices.size();
+		report->missesBefore += missesBefore;
+		report->missesAfter += vertexCacheMisses(indices.data(), indexCount, vertexCount);
+	}
+}
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t biased = (bits >> 23) & 0xff;
+	uint32_t mantissa = bits & 0x7fffff;
+	if (biased == 0xff)
+		return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+	int exponent = (int)biased - 127 + 15;
+	if (exponent >= 31)
+		return (uint16_t)(sign | 0x7c00);
+	if (exponent <= 0)
+	{
+		// subnormal half, rounded to nearest even
+		if (exponent < -10)
+			return (uint16_t)sign;
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1)))
+			half++;
+		return (uint16_t)(sign | half);
+	}
+
+	// a carry out of the mantissa correctly bumps the exponent
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+		half++;
+	return (uint16_t)(sign | half);
+}
+
+float halfToFloat(uint16_t value)
+{
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+	if (exponent == 0)
+	{
+		float magnitude = ldexpf((float)mantissa, -24);
+		return sign ? -magnitude : magnitude;
+	}
+	uint32_t bits = exponent == 31 ? sign | 0x7f800000 | (mantissa << 13)
+		: sign | ((exponent + 112) << 23) | (mantissa << 13);
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+void encodeOctahedral(const float normal[3], int16_t encoded[2])
+{
+	float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+	float x = length > 0.0f ? normal[0] / length : 0.0f;
+	float y = length > 0.0f ? normal[1] / length : 0.0f;
+	if (normal[2] < 0.0f)
+	{
+		// fold the lower hemisphere over the diagonals
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+	encoded[0] = (int16_t)lroundf(std::min(1.0f, std::max(-1.0f, x)) * 32767.0f);
+	encoded[1] = (int16_t)lroundf(std::min(1.0f, std::max(-1.0f, y)) * 32767.0f);
+}
+
+void decodeOctahedral(const int16_t encoded[2], float normal[3])
+{
+	float x = std::max(-1.0f, encoded[0] / 32767.0f);
+	float y = std::max(-1.0f, encoded[1] / 32767.0f);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	if (z < 0.0f)
+	{
+		float unfoldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float unfoldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+	float length = sqrtf(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
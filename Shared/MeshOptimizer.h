@@ -0,0 +1,101 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Offline mesh optimization run on every imported mesh before it is uploaded or
+// cooked. Pure functions over plain arrays, no GL or glm, so they can be checked
+// offline.
+//
+//   1. triangle order for the post-transform vertex cache (Forsyth)
+//   2. clusters of that order sorted outside-in, against overdraw (Sander et al.)
+//   3. vertices renumbered in first use order, for the pre-transform cache
+//   4. attributes packed into the VertexFormat, 16 bit indices when they fit
+
+// Vertex layouts a Mesh can be uploaded in; Mesh::setupMesh sets the matching
+// attribute pointers and Mesh::Draw the uniforms shader.vert decodes them with.
+enum class VertexFormat : uint32_t {
+	Full = 0,		// the 56 byte Vertex as imported, tangent and bitangent included
+	Packed = 1,		// PackedVertex
+	Quantized = 2,	// QuantizedVertex
+};
+
+// float position, octahedral normal as two snorm16, half float UVs: 20 bytes
+struct PackedVertex {
+	float position[3];
+	int16_t normal[2];
+	uint16_t texCoords[2];
+};
+
+// as PackedVertex, but the position as unorm16 within the mesh bounds (w is padding): 16 bytes
+struct QuantizedVertex {
+	uint16_t position[4];
+	int16_t normal[2];
+	uint16_t texCoords[2];
+};
+
+uint32_t vertexFormatStride(VertexFormat format, uint32_t fullStride);
+const char* vertexFormatName(VertexFormat format);
+
+// Imported attributes, read through a stride so the Vertex struct can be passed as is
+struct MeshOptimizerInput {
+	const uint8_t* vertices;
+	size_t vertexStride;
+	size_t vertexCount;
+	size_t positionOffset;	// 3 floats
+	size_t normalOffset;	// 3 floats
+	size_t texCoordOffset;	// 2 floats
+	const uint32_t* indices;
+	size_t indexCount;
+};
+
+// An optimized mesh, ready to upload or cook
+struct OptimizedMesh {
+	VertexFormat format = VertexFormat::Full;
+	uint32_t vertexStride = 0;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+	uint32_t indexSize = 4;	// 2 when every index fits 16 bits
+	// position = offset + attribute * scale; identity unless Quantized
+	float positionScale[3] = { 1.0f, 1.0f, 1.0f };
+	float positionOffset[3] = { 0.0f, 0.0f, 0.0f };
+	std::vector<uint8_t> vertices;
+	std::vector<uint8_t> indices;
+};
+
+// Totals over every optimized mesh, printed by --cook
+struct MeshOptimizerReport {
+	size_t meshes = 0;
+	size_t triangles = 0;
+	size_t vertexBytesBefore = 0;
+	size_t vertexBytesAfter = 0;
+	size_t indexBytesBefore = 0;
+	size_t indexBytesAfter = 0;
+	size_t missesBefore = 0;	// of a 16 entry FIFO post-transform cache
+	size_t missesAfter = 0;
+
+	double acmrBefore() const { return triangles ? (double)missesBefore / triangles : 0.0; }
+	double acmrAfter() const { return triangles ? (double)missesAfter / triangles : 0.0; }
+};
+
+void optimizeMesh(const MeshOptimizerInput& input, VertexFormat format, OptimizedMesh& mesh,
+	MeshOptimizerReport* report = nullptr);
+
+// The steps on their own. Indices are rewritten in place.
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+// expects a cache optimized order; threshold is the ACMR a cluster may lose to splitting
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshOptimizerInput& input, float threshold = 1.05f);
+// remap[old] = new, ~0u for unreferenced vertices; returns the new vertex count
+size_t optimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>& remap);
+
+// post-transform cache misses of a FIFO cache; divided by the triangle count it is the ACMR
+size_t vertexCacheMisses(const uint32_t* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = 16);
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+void encodeOctahedral(const float normal[3], int16_t encoded[2]);
+void decodeOctahedral(const int16_t encoded[2], float normal[3]);
+
+#endif
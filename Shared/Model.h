@@ -8,35 +8,192 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include "stb_image.h"
 #include <assimp/Importer.hpp>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "ObjLoader.h"
+#include "AssetArchive.h"
+#include "AssetManager.h"
+#include "ResourceCache.h"
+#include "TextureContainer.h"
 
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 #include <map>
+#include <memory>
+#include <set>
+#include <thread>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// A texture read from disk, not uploaded yet: either its cooked BCn levels, mapped,
+// or pixels decoded by stb_image
+struct ImageData {
+	int width = 0;
+	int height = 0;
+	int components = 0;
+	shared_ptr<TextureContainerFile> compressed;
+	shared_ptr<unsigned char> pixels; // freed with stbi_image_free
+	uint64_t hash = 0; // of the contents, the texture's content key
+
+	bool valid() const { return compressed || pixels; }
+
+	// what the texture takes on the GPU; uncompressed with a full mip chain is about 4/3 of the base level
+	size_t gpuBytes() const
+	{
+		return compressed ? compressed->dataBytes() : (size_t)width * height * components * 4 / 3;
+	}
+};
+
+// A texture shared through the resource cache, deleted with its last handle
+struct GpuTexture {
+	unsigned int id;
+	size_t bytes;
+
+	GpuTexture(unsigned int id, size_t bytes) : id(id), bytes(bytes) {}
+	~GpuTexture() { glDeleteTextures(1, &id); }
+	GpuTexture(const GpuTexture&) = delete;
+	GpuTexture& operator=(const GpuTexture&) = delete;
+
+	size_t memoryBytes() const { return bytes; }
+};
+
+ImageData ImageFromFile(const char *path, const string &directory, bool allowCooked = true);
+unsigned int TextureFromImage(const ImageData &image, const char *path);
+// offline: transcodes an image into its BCn container next to it, see TextureContainer.h
+bool CookTexture(const string &path);
+
+// CPU side of one mesh as produced by the importer, before it is uploaded or cooked
+struct MeshData {
+	OptimizedMesh optimized; // in Model::vertexFormat(), see MeshOptimizer.h
+	unsigned int material;
+};
+
+// Everything a Model reads from disk, filled in by Model::decode without touching GL
+struct ModelData {
+	string path;
+	std::chrono::steady_clock::time_point requested;
+	bool ok = false;
+	const char* importer = "Assimp";	// what read the source when there is no cache
+	unique_ptr<MeshCacheFile> cache;	// the mapped mesh cache, null when imported with Assimp
+	vector<MeshData> meshes;			// the imported meshes when there is no cache
+	vector<vector<MeshCacheTextureRef>> materials;
+	map<string, ImageData> images;		// decoded textures by path
+};
+
+// Lets Assimp read the OBJ and its MTL libraries through the asset file system, so a
+// packed model imports from the mounted archive like any other asset
+class AssetIOStream : public Assimp::IOStream
+{
+public:
+	AssetIOStream(unique_ptr<AssetFile> file) : file(std::move(file)) {}
+
+	size_t Read(void *buffer, size_t size, size_t count) override
+	{
+		if (!size)
+			return 0;
+		count = std::min(count, (file->size() - position) / size);
+		memcpy(buffer, file->data() + position, size * count);
+		position += size * count;
+		return count;
+	}
+	size_t Write(const void *, size_t, size_t) override { return 0; }
+	aiReturn Seek(size_t offset, aiOrigin origin) override
+	{
+		// negative offsets arrive wrapped around, unsigned addition undoes that
+		size_t target = origin == aiOrigin_SET ? offset : (origin == aiOrigin_CUR ? position : file->size()) + offset;
+		if (target > file->size())
+			return aiReturn_FAILURE;
+		position = target;
+		return aiReturn_SUCCESS;
+	}
+	size_t Tell() const override { return position; }
+	size_t FileSize() const override { return file->size(); }
+	void Flush() override {}
+
+private:
+	unique_ptr<AssetFile> file;
+	size_t position = 0;
+};
+
+class AssetIOSystem : public Assimp::IOSystem
+{
+public:
+	bool Exists(const char *path) const override { return assetFileExists(path); }
+	char getOsSeparator() const override { return '/'; }
+	Assimp::IOStream *Open(const char *path, const char *mode = "rb") override
+	{
+		unique_ptr<AssetFile> file(new AssetFile());
+		if (strchr(mode, 'w') || !file->open(path))
+			return nullptr;
+		return new AssetIOStream(std::move(file));
+	}
+	void Close(Assimp::IOStream *stream) override { delete stream; }
+};
+
 class Model
 {
 public:
 	/*  Model Data */
-	vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+	vector<shared_ptr<GpuTexture>> textureHandles;	// keeps the cached textures the meshes use alive
 	vector<Mesh> meshes;
 	string directory;
 	bool gammaCorrection;
+	bool fromMeshCache = false;
 
 	/*  Functions   */
-	// constructor, expects a filepath to a 3D model.
+	// constructor, expects a filepath to a 3D model. Loads synchronously.
 	Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
 	{
-		loadModel(path);
+		ModelData data;
+		decode(path, data);
+		upload(data);
+	}
+
+	// streaming constructor: returns an empty model right away, which draws nothing until
+	// the asset workers have decoded it and AssetManager::pumpUploads has uploaded it.
+	// The model must stay at this address until then.
+	Model(AssetManager &manager, string const &path, bool gamma = false) : gammaCorrection(gamma)
+	{
+		shared_ptr<ModelData> data = make_shared<ModelData>();
+		manager.load([data, path] { decode(path, *data); }, [this, data] { upload(*data); });
+	}
+
+	~Model()
+	{
+		for (Mesh& mesh : meshes)
+			mesh.release();
+	}
+
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+
+	// shared model from the process-wide resource cache: a file already loaded (or still
+	// streaming) under any spelling of its path is handed out again instead of re-parsed
+	static shared_ptr<Model> load(AssetManager &manager, string const &path, bool gamma = false);
+	static shared_ptr<Model> load(string const &path, bool gamma = false);
+
+	// GPU memory of the meshes; textures are accounted in the texture cache
+	size_t memoryBytes() const
+	{
+		size_t bytes = 0;
+		for (const Mesh& mesh : meshes)
+			bytes += mesh.bufferBytes;
+		return bytes;
 	}
 
 	// draws the model, and thus all its meshes
@@ -46,29 +203,401 @@ public:
 			meshes[i].Draw(shader);
 	}
 
+	// true once the meshes and textures are on the GPU
+	bool isReady() const { return ready; }
+
+	// set to false to always go through Assimp and stb_image, e.g. to compare startup
+	// and memory against the mesh cache and the compressed textures
+	static bool& useCookedAssets()
+	{
+		static bool enabled = true;
+		return enabled;
+	}
+
+	// set to false to read OBJ files with Assimp too, e.g. to compare against ObjLoader
+	static bool& useObjLoader()
+	{
+		static bool enabled = true;
+		return enabled;
+	}
+
+	// the vertex layout meshes are optimized into; shader.vert reads all of them.
+	// Cooked files in another format are ignored.
+	static VertexFormat& vertexFormat()
+	{
+		static VertexFormat format = VertexFormat::Quantized;
+		return format;
+	}
+
+	// offline cook step: imports and optimizes the model and writes its mesh cache next
+	// to it. Needs no GL context; --cook cooks the textures it references as jobs of their own.
+	static bool cook(string const &path)
+	{
+		vector<MeshData> data;
+		vector<vector<MeshCacheTextureRef>> materials;
+		MeshOptimizerReport report;
+		if (!import(path, data, materials, &report))
+			return false;
+		cout << path << ": " << report.meshes << " meshes, " << report.triangles << " triangles, "
+			<< vertexFormatName(vertexFormat()) << " vertices " << report.vertexBytesBefore / 1024.0 << " -> "
+			<< report.vertexBytesAfter / 1024.0 << " KB, indices " << report.indexBytesBefore / 1024.0 << " -> "
+			<< report.indexBytesAfter / 1024.0 << " KB, ACMR " << report.acmrBefore() << " -> " << report.acmrAfter() << endl;
+
+		vector<MeshCacheSource> sources;
+		for (const MeshData& mesh : data)
+		{
+			const OptimizedMesh& optimized = mesh.optimized;
+			MeshCacheSource source = { optimized.vertices.data(), optimized.vertexCount, optimized.indices.data(),
+				optimized.indexCount, optimized.indexSize, mesh.material, optimized.positionScale, optimized.positionOffset };
+			sources.push_back(source);
+		}
+		return writeMeshCache(meshCachePath(path), path, (uint32_t)vertexFormat(),
+			vertexFormatStride(vertexFormat(), sizeof(Vertex)), sources, materials);
+	}
+
+	// --obj-check: reads an OBJ with ObjLoader and with ASSIMP and compares them per material
+	// name. The vertex sets, triangle counts and surface areas must agree; ASSIMP may split a
+	// polygon along another diagonal, so identical triangles are only reported.
+	static bool checkObjLoader(string const &path)
+	{
+		typedef array<int64_t, 8> VertexKey;
+		struct Side {
+			set<VertexKey> vertices;
+			multiset<array<VertexKey, 3>> triangles;
+			double area = 0.0;
+		};
+		// on a binary grid, which decimal OBJ values practically never straddle
+		auto key = [](const float *position, const float *normal, const float *texCoords)
+		{
+			const float* values[8] = { &position[0], &position[1], &position[2], &normal[0], &normal[1], &normal[2], &texCoords[0], &texCoords[1] };
+			VertexKey k;
+			for (int i = 0; i < 8; i++)
+				k[i] = (int64_t)std::floor(*values[i] * 16384.0 + 0.5);
+			return k;
+		};
+		auto addTriangle = [](Side &side, const VertexKey (&corners)[3], const glm::vec3 (&positions)[3])
+		{
+			// rotated so the smallest corner leads, winding kept
+			int first = (int)(min_element(corners, corners + 3) - corners);
+			array<VertexKey, 3> triangle = { { corners[first], corners[(first + 1) % 3], corners[(first + 2) % 3] } };
+			side.triangles.insert(triangle);
+			side.area += 0.5 * glm::length(glm::cross(positions[1] - positions[0], positions[2] - positions[0]));
+			side.vertices.insert(corners, corners + 3);
+		};
+
+		map<string, Side> ours, theirs;
+		ObjModel obj;
+		if (!loadObj(path, obj))
+			return false;
+		for (const ObjMesh& mesh : obj.meshes)
+		{
+			Side& side = ours[obj.materials[mesh.material].name];
+			for (size_t i = 0; i < mesh.indices.size(); i += 3)
+			{
+				VertexKey corners[3];
+				glm::vec3 positions[3];
+				for (int c = 0; c < 3; c++)
+				{
+					const ObjVertex& v = mesh.vertices[mesh.indices[i + c]];
+					corners[c] = key(v.position, v.normal, v.texCoords);
+					positions[c] = glm::vec3(v.position[0], v.position[1], v.position[2]);
+				}
+				addTriangle(side, corners, positions);
+			}
+		}
+
+		Assimp::Importer importer;
+		const aiScene* scene = readAssimp(importer, path);
+		if (!scene || !scene->mRootNode)
+		{
+			cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+			return false;
+		}
+		for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+		{
+			const aiMesh* mesh = scene->mMeshes[m];
+			aiString name;
+			scene->mMaterials[mesh->mMaterialIndex]->Get(AI_MATKEY_NAME, name);
+			Side& side = theirs[name.C_Str()];
+			for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+			{
+				const aiFace& face = mesh->mFaces[f];
+				if (face.mNumIndices != 3)
+					continue;
+				VertexKey corners[3];
+				glm::vec3 positions[3];
+				for (int c = 0; c < 3; c++)
+				{
+					unsigned int i = face.mIndices[c];
+					float position[3] = { mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z };
+					float normal[3] = { mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z };
+					float texCoords[2] = { 0.0f, 0.0f };
+					if (mesh->mTextureCoords[0])
+					{
+						texCoords[0] = mesh->mTextureCoords[0][i].x;
+						texCoords[1] = mesh->mTextureCoords[0][i].y;
+					}
+					corners[c] = key(position, normal, texCoords);
+					positions[c] = glm::vec3(position[0], position[1], position[2]);
+				}
+				addTriangle(side, corners, positions);
+			}
+		}
+
+		bool ok = ours.size() == theirs.size();
+		for (const auto& entry : ours)
+		{
+			auto other = theirs.find(entry.first);
+			if (other == theirs.end())
+			{
+				cout << "  " << path << " [" << entry.first << "]: no ASSIMP mesh with this material" << endl;
+				ok = false;
+				continue;
+			}
+			const Side& a = entry.second;
+			const Side& b = other->second;
+			size_t identical = 0;
+			for (auto triangle = a.triangles.begin(); triangle != a.triangles.end(); triangle = a.triangles.upper_bound(*triangle))
+				identical += std::min(a.triangles.count(*triangle), b.triangles.count(*triangle));
+			bool same = a.vertices == b.vertices && a.triangles.size() == b.triangles.size()
+				&& std::abs(a.area - b.area) <= 1e-4 * std::max(1.0, b.area);
+			cout << "  " << path << " [" << entry.first << "]: " << a.triangles.size() << " / " << b.triangles.size()
+				<< " triangles (" << identical << " identical), " << a.vertices.size() << " / " << b.vertices.size()
+				<< " vertices, area " << a.area << " / " << b.area << (same ? "" : "  MISMATCH") << endl;
+			ok = ok && same;
+		}
+		return ok;
+	}
+
+	// --obj-benchmark: parse throughput of ObjLoader on 1..N threads and of ASSIMP, best of runs
+	static void benchmarkObjLoader(string const &path, int runs)
+	{
+		auto best = [runs](const std::function<bool()> &load)
+		{
+			double fastest = 1e30;
+			for (int i = 0; i < runs; i++)
+			{
+				auto start = std::chrono::steady_clock::now();
+				if (!load())
+					return 0.0;
+				fastest = std::min(fastest, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+			}
+			return fastest;
+		};
+
+		AssetFile file;
+		if (!file.open(path))
+			return;
+		double megabytes = file.size() / (1024.0 * 1024.0);
+		cout << path << " (" << file.size() / 1024 << " KB):";
+		unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned int threads = 1; threads <= hardware; threads *= 2)
+		{
+			unsigned int chunks = 1;
+			double seconds = best([&] { ObjModel obj; bool ok = loadObj(path, obj, threads); chunks = obj.threads; return ok; });
+			cout << " ObjLoader " << threads << " thread(s) " << (seconds > 0.0 ? megabytes / seconds : 0.0) << " MB/s ("
+				<< chunks << " chunks),";
+		}
+		double seconds = best([&] { Assimp::Importer importer; return readAssimp(importer, path) != nullptr; });
+		cout << " ASSIMP " << (seconds > 0.0 ? megabytes / seconds : 0.0) << " MB/s" << endl;
+	}
+
+	// reads everything the model needs from disk: maps its mesh cache if there is a current
+	// one, otherwise imports it with ASSIMP, and decodes its textures. Safe on any thread.
+	static void decode(string const &path, ModelData &data)
+	{
+		static_assert(sizeof(Vertex) % 4 == 0 && sizeof(unsigned int) == sizeof(uint32_t), "mesh cache layout");
+		VertexFormat format = vertexFormat();
+		data.path = path;
+		data.requested = std::chrono::steady_clock::now();
+		string directory = path.substr(0, path.find_last_of('/'));
+
+		if (useCookedAssets())
+		{
+			data.cache.reset(new MeshCacheFile());
+			if (data.cache->open(meshCachePath(path), path, (uint32_t)format, vertexFormatStride(format, sizeof(Vertex))))
+			{
+				// fault the pages in here rather than in glBufferData on the GL thread
+				data.cache->prefetch();
+				for (uint32_t i = 0; i < data.cache->materialCount(); i++)
+				{
+					const MeshCacheMaterial& material = data.cache->material(i);
+					data.materials.push_back(vector<MeshCacheTextureRef>());
+					for (uint32_t t = 0; t < material.textureCount; t++)
+					{
+						const MeshCacheTexture& texture = data.cache->texture(material.firstTexture + t);
+						data.materials.back().push_back({ texture.type, texture.path });
+					}
+				}
+			}
+			else
+				data.cache.reset();
+		}
+		if (!data.cache && !import(path, data.meshes, data.materials, nullptr, &data.importer))
+			return;
+
+		// decode only what isn't cached yet, the upload looks the rest up again
+		for (const auto& material : data.materials)
+			for (const MeshCacheTextureRef& ref : material)
+				if (data.images.find(ref.path) == data.images.end() && !findTexture(directory, ref.path))
+					data.images[ref.path] = ImageFromFile(ref.path.c_str(), directory);
+		data.ok = true;
+	}
+
 private:
+	bool ready = false;
+
 	/*  Functions   */
-	// loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-	void loadModel(string const &path)
+	// GL thread: creates the buffers and textures from decoded data and stores the
+	// resulting meshes in the meshes vector
+	void upload(ModelData &data)
 	{
-		// read file via ASSIMP
+		// retrieve the directory path of the filepath
+		directory = data.path.substr(0, data.path.find_last_of('/'));
+		fromMeshCache = data.cache != nullptr;
+
+		if (data.ok && data.cache)
+		{
+			// uploads every mesh straight from the mapping
+			for (uint32_t i = 0; i < data.cache->meshCount(); i++)
+			{
+				const MeshCacheMesh& mesh = data.cache->mesh(i);
+				MeshBuffers buffers = { vertexFormat(), data.cache->vertexStride(), data.cache->vertices(i), mesh.vertexCount,
+					data.cache->indices(i), mesh.indexCount, mesh.indexSize,
+					glm::vec3(mesh.positionScale[0], mesh.positionScale[1], mesh.positionScale[2]),
+					glm::vec3(mesh.positionOffset[0], mesh.positionOffset[1], mesh.positionOffset[2]) };
+				meshes.push_back(Mesh(buffers, loadMaterialTextures(data.materials[mesh.material], data.images)));
+			}
+		}
+		else if (data.ok)
+		{
+			for (const MeshData& mesh : data.meshes)
+			{
+				const OptimizedMesh& optimized = mesh.optimized;
+				MeshBuffers buffers = { optimized.format, optimized.vertexStride, optimized.vertices.data(), optimized.vertexCount,
+					optimized.indices.data(), optimized.indexCount, optimized.indexSize,
+					glm::vec3(optimized.positionScale[0], optimized.positionScale[1], optimized.positionScale[2]),
+					glm::vec3(optimized.positionOffset[0], optimized.positionOffset[1], optimized.positionOffset[2]) };
+				meshes.push_back(Mesh(buffers, loadMaterialTextures(data.materials[mesh.material], data.images)));
+			}
+		}
+		ready = true;
+
+		// the GPU has its copy now; unmap and free the CPU side
+		data.cache.reset();
+		data.meshes.clear();
+		data.images.clear();
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - data.requested).count();
+		cout << "Loaded " << data.path << (fromMeshCache ? " from mesh cache" : string(" with ") + data.importer) << " in " << ms << " ms" << endl;
+	}
+
+	// reads a model into optimized vertex and index arrays plus a texture list per material:
+	// OBJ files with ObjLoader, anything it doesn't support and other formats with ASSIMP
+	static bool import(string const &path, vector<MeshData> &meshes, vector<vector<MeshCacheTextureRef>> &materials,
+		MeshOptimizerReport *report = nullptr, const char **importerName = nullptr)
+	{
+		if (useObjLoader() && isObjPath(path))
+		{
+			if (importObj(path, meshes, materials, report))
+			{
+				if (importerName)
+					*importerName = "ObjLoader";
+				return true;
+			}
+			cout << "Falling back to Assimp for " << path << endl;
+		}
+		if (importerName)
+			*importerName = "Assimp";
+
+		// read file via ASSIMP; the OBJ importer emits a vertex per face corner, joining
+		// them is what gives the vertex cache something to reuse. No tangent space, no
+		// shader reads it.
 		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+		const aiScene* scene = readAssimp(importer, path);
 		// check for errors
 		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
 		{
 			cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-			return;
+			return false;
+		}
+
+		// we assume a convention for sampler names in the shaders. Each diffuse texture should be named
+		// as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
+		// Same applies to other texture as the following list summarizes:
+		// diffuse: texture_diffuseN
+		// specular: texture_specularN
+		// normal: texture_normalN
+		materials.resize(scene->mNumMaterials);
+		for (unsigned int i = 0; i < scene->mNumMaterials; i++)
+		{
+			aiMaterial* material = scene->mMaterials[i];
+			// 1. diffuse maps
+			materialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", materials[i]);
+			// 2. specular maps
+			materialTextures(material, aiTextureType_SPECULAR, "texture_specular", materials[i]);
+			// 3. normal maps
+			materialTextures(material, aiTextureType_HEIGHT, "texture_normal", materials[i]);
+			// 4. height maps
+			materialTextures(material, aiTextureType_AMBIENT, "texture_height", materials[i]);
 		}
-		// retrieve the directory path of the filepath
-		directory = path.substr(0, path.find_last_of('/'));
 
 		// process ASSIMP's root node recursively
-		processNode(scene->mRootNode, scene);
+		processNode(scene->mRootNode, scene, meshes, report);
+		return true;
+	}
+
+	static const aiScene* readAssimp(Assimp::Importer &importer, string const &path)
+	{
+		if (mountedAssetArchive())
+			importer.SetIOHandler(new AssetIOSystem());
+		return importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
+	}
+
+	static bool isObjPath(string const &path)
+	{
+		return path.size() > 4 && (path.compare(path.size() - 4, 4, ".obj") == 0 || path.compare(path.size() - 4, 4, ".OBJ") == 0);
+	}
+
+	static bool importObj(string const &path, vector<MeshData> &meshes, vector<vector<MeshCacheTextureRef>> &materials,
+		MeshOptimizerReport *report)
+	{
+		ObjModel obj;
+		if (!loadObj(path, obj))
+			return false;
+		for (const ObjMaterial& material : obj.materials)
+			materials.push_back(material.textures);
+		for (const ObjMesh& mesh : obj.meshes)
+		{
+			meshes.push_back(MeshData());
+			meshes.back().material = mesh.material;
+			MeshOptimizerInput input = { reinterpret_cast<const uint8_t*>(mesh.vertices.data()), sizeof(ObjVertex),
+				mesh.vertices.size(), offsetof(ObjVertex, position), offsetof(ObjVertex, normal), offsetof(ObjVertex, texCoords),
+				mesh.indices.data(), mesh.indices.size() };
+			// the full format is the Vertex struct itself, tangents zeroed as processMesh does
+			vector<Vertex> full;
+			if (vertexFormat() == VertexFormat::Full)
+			{
+				full.resize(mesh.vertices.size());
+				for (size_t i = 0; i < full.size(); i++)
+				{
+					const ObjVertex& vertex = mesh.vertices[i];
+					full[i].Position = glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+					full[i].Normal = glm::vec3(vertex.normal[0], vertex.normal[1], vertex.normal[2]);
+					full[i].TexCoords = glm::vec2(vertex.texCoords[0], vertex.texCoords[1]);
+					full[i].Tangent = glm::vec3(0.0f);
+					full[i].Bitangent = glm::vec3(0.0f);
+				}
+				input.vertices = reinterpret_cast<const uint8_t*>(full.data());
+				input.vertexStride = sizeof(Vertex);
+			}
+			optimizeMesh(input, vertexFormat(), meshes.back().optimized, report);
+		}
+		return true;
 	}
 
 	// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-	void processNode(aiNode *node, const aiScene *scene)
+	static void processNode(aiNode *node, const aiScene *scene, vector<MeshData> &meshes, MeshOptimizerReport *report)
 	{
 		// process each mesh located at the current node
 		for (unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -76,163 +605,269 @@ private:
 			// the node object only contains indices to index the actual objects in the scene. 
 			// the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
 			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			meshes.push_back(processMesh(mesh, scene));
+			meshes.push_back(MeshData());
+			processMesh(mesh, meshes.back(), report);
 		}
 		// after we've processed all of the meshes (if any) we then recursively process each of the children nodes
 		for (unsigned int i = 0; i < node->mNumChildren; i++)
 		{
-			processNode(node->mChildren[i], scene);
+			processNode(node->mChildren[i], scene, meshes, report);
 		}
 
 	}
 
-	Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+	static void processMesh(aiMesh *mesh, MeshData &data, MeshOptimizerReport *report)
 	{
-		// data to fill
-		vector<Vertex> vertices;
+		// Walk through each of the mesh's vertices; the arrays are sized once up front
+		vector<Vertex> vertices(mesh->mNumVertices);
 		vector<unsigned int> indices;
-		vector<Texture> textures;
-
-		// Walk through each of the mesh's vertices
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
 		{
-			Vertex vertex;
-			glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+			Vertex& vertex = vertices[i];
+			// assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we copy the components.
 			// positions
-			vector.x = mesh->mVertices[i].x;
-			vector.y = mesh->mVertices[i].y;
-			vector.z = mesh->mVertices[i].z;
-			vertex.Position = vector;
+			vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
 			// normals
-			vector.x = mesh->mNormals[i].x;
-			vector.y = mesh->mNormals[i].y;
-			vector.z = mesh->mNormals[i].z;
-			vertex.Normal = vector;
+			vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
 			// texture coordinates
+			// a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
+			// use models where a vertex can have multiple texture coordinates so we always take the first set (0).
 			if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
-			{
-				glm::vec2 vec;
-				// a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-				// use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-				vec.x = mesh->mTextureCoords[0][i].x;
-				vec.y = mesh->mTextureCoords[0][i].y;
-				vertex.TexCoords = vec;
-			}
+				vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
 			else
 				vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-			vertices.push_back(vertex);
+			// not used by any shader, zeroed so cooked files are deterministic
+			vertex.Tangent = glm::vec3(0.0f);
+			vertex.Bitangent = glm::vec3(0.0f);
 		}
-		// now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+		// now walk through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+		indices.reserve(mesh->mNumFaces * 3);
 		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
 		{
-			aiFace face = mesh->mFaces[i];
-			// retrieve all indices of the face and store them in the indices vector
-			for (unsigned int j = 0; j < face.mNumIndices; j++)
-				indices.push_back(face.mIndices[j]);
+			const aiFace& face = mesh->mFaces[i];
+			indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
 		}
-		// process materials
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		// we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-		// as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-		// Same applies to other texture as the following list summarizes:
-		// diffuse: texture_diffuseN
-		// specular: texture_specularN
-		// normal: texture_normalN
-
-		// 1. diffuse maps
-		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-		// 2. specular maps
-		vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-		// 3. normal maps
-		std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-		// 4. height maps
-		std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+		data.material = mesh->mMaterialIndex;
 
-		// return a mesh object created from the extracted mesh data
-		return Mesh(vertices, indices, textures);
+		// reorder for the vertex cache and overdraw and pack into the vertex format
+		MeshOptimizerInput input = { reinterpret_cast<const uint8_t*>(vertices.data()), sizeof(Vertex), vertices.size(),
+			offsetof(Vertex, Position), offsetof(Vertex, Normal), offsetof(Vertex, TexCoords), indices.data(), indices.size() };
+		optimizeMesh(input, vertexFormat(), data.optimized, report);
 	}
 
-	// checks all material textures of a given type and loads the textures if they're not loaded yet.
-	// the required info is returned as a Texture struct.
-
-// checks all material textures of a given type and loads the textures if they're not loaded yet.
-// the required info is returned as a Texture struct.
-	vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+	// collects the texture paths of a given type of a material
+	static void materialTextures(aiMaterial *mat, aiTextureType type, const char *typeName, vector<MeshCacheTextureRef> &refs)
 	{
-		vector<Texture> textures;
 		for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 		{
 			aiString str;
 			mat->GetTexture(type, i, &str);
-			// check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-			bool skip = false;
-			for (unsigned int j = 0; j < textures_loaded.size(); j++)
-			{
-				if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-				{
-					textures.push_back(textures_loaded[j]);
-					skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-					break;
-				}
-			}
-			if (!skip)
-			{   // if texture hasn't been loaded already, load it
-				Texture texture;
-				texture.id = TextureFromFile(str.C_Str(), this->directory);
-				texture.type = typeName;
-				texture.path = str.C_Str();
-				textures.push_back(texture);
-				textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-			}
+			refs.push_back({ typeName, str.C_Str() });
+		}
+	}
+
+	static string textureKey(string const &directory, string const &path)
+	{
+		return normalizeResourcePath(directory + '/' + path);
+	}
+
+	static shared_ptr<GpuTexture> findTexture(string const &directory, string const &path);
+
+	// returns the cached texture for a path, or for identical pixels under another path,
+	// and only creates a new one when neither is loaded. Decodes here if the image
+	// wasn't decoded ahead of time.
+	shared_ptr<GpuTexture> acquireTexture(string const &path, const map<string, ImageData> &images);
+
+	// resolves the textures of a material through the resource cache
+	vector<Texture> loadMaterialTextures(const vector<MeshCacheTextureRef> &refs, const map<string, ImageData> &images)
+	{
+		vector<Texture> textures;
+		for (const MeshCacheTextureRef& ref : refs)
+		{
+			shared_ptr<GpuTexture> handle = acquireTexture(ref.path, images);
+			if (find(textureHandles.begin(), textureHandles.end(), handle) == textureHandles.end())
+				textureHandles.push_back(handle);
+
+			Texture texture;
+			texture.id = handle->id;
+			texture.type = ref.type;
+			texture.path = ref.path;
+			textures.push_back(texture);
 		}
 		return textures;
 	}
 };
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+// process-wide caches of models and textures, see ResourceCache.h
+struct Resources {
+	ResourceTable<Model> models;
+	ResourceTable<GpuTexture> textures;
+};
+
+inline Resources& resources()
+{
+	static Resources instance;
+	return instance;
+}
+
+inline shared_ptr<Model> Model::load(AssetManager &manager, string const &path, bool gamma)
+{
+	string key = normalizeResourcePath(path) + (gamma ? "|gamma" : "");
+	return resources().models.getOrCreate(key, [&] { return make_shared<Model>(manager, path, gamma); });
+}
+
+inline shared_ptr<Model> Model::load(string const &path, bool gamma)
+{
+	string key = normalizeResourcePath(path) + (gamma ? "|gamma" : "");
+	return resources().models.getOrCreate(key, [&] { return make_shared<Model>(path, gamma); });
+}
+
+inline shared_ptr<GpuTexture> Model::findTexture(string const &directory, string const &path)
+{
+	return resources().textures.find(textureKey(directory, path));
+}
+
+inline shared_ptr<GpuTexture> Model::acquireTexture(string const &path, const map<string, ImageData> &images)
+{
+	ResourceTable<GpuTexture>& textures = resources().textures;
+	string key = textureKey(directory, path);
+	shared_ptr<GpuTexture> texture = textures.find(key);
+	if (texture)
+		return texture;
+
+	ImageData decoded;
+	auto image = images.find(path);
+	if (image != images.end())
+		decoded = image->second;
+	else
+		decoded = ImageFromFile(path.c_str(), directory);
+
+	string contentKey = contentResourceKey(decoded.hash);
+	if (decoded.valid())
+		texture = textures.find(contentKey);
+	if (!texture)
+	{
+		texture = make_shared<GpuTexture>(TextureFromImage(decoded, path.c_str()), decoded.gpuBytes());
+		if (decoded.valid())
+			textures.insert(contentKey, texture);
+	}
+	textures.insert(key, texture);
+	return texture;
+}
+
+ImageData ImageFromFile(const char *path, const string &directory, bool allowCooked)
 {
 	string filename = string(path);
 	filename = directory + '/' + filename;
 
+	ImageData image;
+	if (allowCooked && Model::useCookedAssets())
+	{
+		shared_ptr<TextureContainerFile> container = make_shared<TextureContainerFile>();
+		if (container->open(textureContainerPath(filename), filename))
+		{
+			image.width = container->width();
+			image.height = container->height();
+			image.components = container->sourceComponents();
+			// hashing reads every page, so the upload doesn't fault them in on the GL thread
+			image.hash = container->contentHash();
+			image.compressed = container;
+			return image;
+		}
+	}
+
+	AssetFile file;
+	unsigned char *data = nullptr;
+	if (file.open(filename))
+		data = stbi_load_from_memory(file.data(), (int)file.size(), &image.width, &image.height, &image.components, 0);
+	if (data)
+	{
+		image.pixels = shared_ptr<unsigned char>(data, stbi_image_free);
+		int header[3] = { image.width, image.height, image.components };
+		image.hash = hashResourceBytes(header, sizeof(header));
+		image.hash = hashResourceBytes(data, (size_t)image.width * image.height * image.components, image.hash);
+	}
+	return image;
+}
+
+unsigned int TextureFromImage(const ImageData &image, const char *path)
+{
 	unsigned int textureID;
 	glGenTextures(1, &textureID);
 
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-	if (data)
+	if (image.compressed)
+	{
+		// every level is precomputed, straight from the mapping
+		const TextureContainerFile& container = *image.compressed;
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		for (uint32_t i = 0; i < container.levelCount(); i++)
+		{
+			const TextureContainerLevel& level = container.level(i);
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, container.glInternalFormat(), level.width, level.height, 0,
+				(GLsizei)level.size, container.levelData(i));
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, container.levelCount() - 1);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	else if (image.pixels)
 	{
 		GLenum format;
-		if (nrComponents == 1)
+		if (image.components == 1)
 			format = GL_RED;
-		else if (nrComponents == 3)
+		else if (image.components == 3)
 			format = GL_RGB;
-		else if (nrComponents == 4)
+		else if (image.components == 4)
 			format = GL_RGBA;
 
 		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
 		glGenerateMipmap(GL_TEXTURE_2D);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
 	}
 	else
 	{
 		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
 	}
 
 	return textureID;
 }
 
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+{
+	return TextureFromImage(ImageFromFile(path, directory), path);
+}
+
+bool CookTexture(const string &path)
+{
+	int width, height, components;
+	unsigned char *data = stbi_load(path.c_str(), &width, &height, &components, 0);
+	if (!data)
+	{
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+		return false;
+	}
+
+	TextureCookReport report;
+	string output = textureContainerPath(path);
+	bool ok = writeTextureContainer(output, path, data, width, height, components, &report);
+	stbi_image_free(data);
+	if (ok)
+	{
+		static const char* formatNames[] = { "", "BC1", "", "BC3", "BC4" };
+		std::cout << "Cooked " << output << ": " << width << "x" << height << " " << formatNames[(int)report.format]
+			<< ", " << report.levels << " levels, " << report.uncompressedBytes / 1024 << " KB -> "
+			<< report.compressedBytes / 1024 << " KB, PSNR " << report.psnr << " dB" << std::endl;
+	}
+	return ok;
+}
+
 #endif
 
@@ -0,0 +1,83 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free queue for many producers and one consumer (Vyukov's ring): every
+// cell carries a sequence number telling whose turn it is, so producers only contend
+// on one compare-exchange of the tail and the consumer on nothing at all. push never
+// blocks or allocates; it fails when the ring is full.
+template<typename T, size_t Capacity>
+class MpscQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	MpscQueue()
+	{
+		for (size_t i = 0; i < Capacity; i++)
+			_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	// Any thread
+	bool push(const T& value)
+	{
+		size_t pos = _tail.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Cell& cell = _cells[pos & (Capacity - 1)];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+			if (diff == 0)
+			{
+				if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					cell.value = value;
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				// the consumer hasn't freed this cell from the previous lap yet
+				return false;
+			}
+			else
+			{
+				pos = _tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// The consumer thread only. False when empty, or when the next value is claimed
+	// but not written yet; it is popped on a later call.
+	bool pop(T& value)
+	{
+		Cell& cell = _cells[_head & (Capacity - 1)];
+		size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		if (sequence != _head + 1)
+			return false;
+		value = cell.value;
+		cell.sequence.store(_head + Capacity, std::memory_order_release);
+		_head++;
+		return true;
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	// producers and the consumer write different cache lines
+	alignas(64) std::atomic<size_t> _tail{ 0 };
+	alignas(64) size_t _head = 0;
+	alignas(64) Cell _cells[Capacity];
+};
+
+#endif
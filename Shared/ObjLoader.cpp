@@ -0,0 +1,631 @@
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+
+#include "AssetArchive.h"
+
+namespace
+{
+	// below this a chunk isn't worth a thread
+	const size_t MIN_CHUNK_BYTES = 64 * 1024;
+	const int32_t NO_INDEX = -1;
+
+	const double POWERS_OF_TEN[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+
+	// one polygon corner, 0 based; vt is NO_INDEX when the face has no texture coordinates
+	// (never confused with a relative index, those are resolved before anything reads vt)
+	struct ObjCorner {
+		int32_t v, vt, vn;
+	};
+
+	// a corner written with negative (relative) indices, counted from the start of its
+	// chunk until the chunks before it are known; fields: 1 v, 2 vt, 4 vn
+	struct ObjRelativeCorner {
+		size_t corner;
+		uint32_t fields;
+	};
+
+	struct ObjMaterialUse {
+		size_t triangle;
+		std::string name;
+	};
+
+	struct ObjChunk {
+		std::vector<float> positions;	// 3 per vertex
+		std::vector<float> texCoords;	// 2 per vertex, v flipped
+		std::vector<float> normals;		// 3 per vertex
+		std::vector<ObjCorner> corners;	// 3 per triangle
+		std::vector<ObjRelativeCorner> relative;
+		std::vector<ObjMaterialUse> materialUses;
+		std::vector<std::string> libraries;
+		std::string error;
+	};
+
+	// triangles [first, last) of a chunk, all in one material
+	struct ObjRange {
+		const ObjChunk* chunk;
+		size_t first;
+		size_t last;
+	};
+
+	bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	bool isDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	void skipSpace(const char*& p, const char* end)
+	{
+		while (p < end && isSpace(*p))
+			p++;
+	}
+
+	std::string token(const char*& p, const char* end)
+	{
+		skipSpace(p, end);
+		const char* start = p;
+		while (p < end && !isSpace(*p))
+			p++;
+		return std::string(start, p);
+	}
+
+	// the rest of the line without surrounding whitespace, for names with spaces
+	std::string rest(const char* p, const char* end)
+	{
+		skipSpace(p, end);
+		while (end > p && isSpace(end[-1]))
+			end--;
+		return std::string(p, end);
+	}
+
+	std::string lastToken(const char* p, const char* end)
+	{
+		std::string name;
+		while (p < end)
+		{
+			std::string next = token(p, end);
+			if (!next.empty())
+				name = next;
+		}
+		return name;
+	}
+
+	const char* parseInt(const char* p, const char* end, int32_t& value)
+	{
+		bool negative = p < end && *p == '-';
+		if (p < end && (*p == '-' || *p == '+'))
+			p++;
+		if (p == end || !isDigit(*p))
+			return nullptr;
+		int64_t result = 0;
+		while (p < end && isDigit(*p))
+		{
+			result = result * 10 + (*p++ - '0');
+			if (result > INT32_MAX)
+				return nullptr;
+		}
+		value = (int32_t)(negative ? -result : result);
+		return p;
+	}
+
+	bool parseFloats(const char* p, const char* end, float* values, int count, int required)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			skipSpace(p, end);
+			if (p == end && i >= required)
+			{
+				values[i] = 0.0f;
+				continue;
+			}
+			p = parseObjFloat(p, end, values[i]);
+			if (!p)
+				return false;
+		}
+		return true;
+	}
+
+	// one v, v/vt, v//vn or v/vt/vn corner; relative indices are resolved against the
+	// counts of this chunk so far, which can leave them negative until the merge
+	const char* parseCorner(const char* p, const char* end, const ObjChunk& chunk, ObjCorner& corner, uint32_t& relative,
+		bool& hasNormal)
+	{
+		int32_t values[3] = { 0, 0, 0 };
+		size_t counts[3] = { chunk.positions.size() / 3, chunk.texCoords.size() / 2, chunk.normals.size() / 3 };
+		relative = 0;
+		for (int field = 0; field < 3; field++)
+		{
+			if (field > 0)
+			{
+				if (p == end || *p != '/')
+					break;
+				p++;
+				// v//vn
+				if (field == 1 && p < end && *p == '/')
+					continue;
+			}
+			p = parseInt(p, end, values[field]);
+			if (!p || values[field] == 0)
+				return nullptr;
+		}
+		hasNormal = values[2] != 0;
+		int32_t* indices[3] = { &corner.v, &corner.vt, &corner.vn };
+		for (int field = 0; field < 3; field++)
+		{
+			if (values[field] > 0)
+				*indices[field] = values[field] - 1;
+			else if (values[field] < 0)
+			{
+				*indices[field] = (int32_t)counts[field] + values[field];
+				relative |= 1u << field;
+			}
+			else
+				*indices[field] = NO_INDEX;
+		}
+		return p;
+	}
+
+	void parseFace(const char* p, const char* end, ObjChunk& chunk)
+	{
+		ObjCorner corners[3];
+		uint32_t relative[3];
+		int count = 0;
+		bool hasNormal;
+		while (true)
+		{
+			skipSpace(p, end);
+			if (p == end)
+				break;
+			int slot = count < 3 ? count : 2;
+			p = parseCorner(p, end, chunk, corners[slot], relative[slot], hasNormal);
+			if (!p || (p < end && !isSpace(*p)))
+			{
+				chunk.error = "a malformed face";
+				return;
+			}
+			if (!hasNormal)
+			{
+				chunk.error = "faces without normals";
+				return;
+			}
+			count++;
+			if (count < 3)
+				continue;
+
+			// fan: the first corner, the previous one and this one
+			for (int i = 0; i < 3; i++)
+			{
+				if (relative[i])
+					chunk.relative.push_back({ chunk.corners.size(), relative[i] });
+				chunk.corners.push_back(corners[i]);
+			}
+			corners[1] = corners[2];
+			relative[1] = relative[2];
+		}
+	}
+
+	void parseChunk(const char* p, const char* end, ObjChunk& chunk)
+	{
+		while (p < end && chunk.error.empty())
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (!lineEnd)
+				lineEnd = end;
+			const char* line = p;
+			p = lineEnd < end ? lineEnd + 1 : end;
+
+			skipSpace(line, lineEnd);
+			if (line == lineEnd || *line == '#')
+				continue;
+			std::string keyword = token(line, lineEnd);
+			if (keyword == "v")
+			{
+				float position[3];
+				if (!parseFloats(line, lineEnd, position, 3, 3))
+					chunk.error = "a malformed vertex";
+				chunk.positions.insert(chunk.positions.end(), position, position + 3);
+			}
+			else if (keyword == "vt")
+			{
+				float texCoords[2];
+				if (!parseFloats(line, lineEnd, texCoords, 2, 1))
+					chunk.error = "a malformed texture coordinate";
+				chunk.texCoords.push_back(texCoords[0]);
+				chunk.texCoords.push_back(1.0f - texCoords[1]);
+			}
+			else if (keyword == "vn")
+			{
+				float normal[3];
+				if (!parseFloats(line, lineEnd, normal, 3, 3))
+					chunk.error = "a malformed normal";
+				chunk.normals.insert(chunk.normals.end(), normal, normal + 3);
+			}
+			else if (keyword == "f")
+				parseFace(line, lineEnd, chunk);
+			else if (keyword == "usemtl")
+				chunk.materialUses.push_back({ chunk.corners.size() / 3, rest(line, lineEnd) });
+			else if (keyword == "mtllib")
+			{
+				while (line < lineEnd)
+				{
+					std::string library = token(line, lineEnd);
+					if (!library.empty())
+						chunk.libraries.push_back(library);
+				}
+			}
+			else if (keyword == "l" || keyword == "p")
+				chunk.error = "lines or points";
+		}
+	}
+
+	// texture maps in the order Model::materialTextures asks Assimp for them
+	enum ObjTextureSlot { DIFFUSE, SPECULAR, NORMAL, HEIGHT, SLOT_COUNT };
+	const char* const OBJ_TEXTURE_TYPES[SLOT_COUNT] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+
+	int textureSlot(std::string keyword)
+	{
+		std::transform(keyword.begin(), keyword.end(), keyword.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+		if (keyword == "map_kd")
+			return DIFFUSE;
+		if (keyword == "map_ks")
+			return SPECULAR;
+		// Assimp reads bump maps as aiTextureType_HEIGHT, which Model calls texture_normal
+		if (keyword == "map_bump" || keyword == "bump")
+			return NORMAL;
+		if (keyword == "map_ka")
+			return HEIGHT;
+		return -1;
+	}
+
+	void loadMaterialLibrary(const std::string& path, std::vector<ObjMaterial>& materials)
+	{
+		AssetFile file;
+		if (!file.open(path))
+		{
+			std::cout << "OBJ loader: material library " << path << " is missing" << std::endl;
+			return;
+		}
+		const char* p = reinterpret_cast<const char*>(file.data());
+		const char* end = p + file.size();
+		std::vector<std::string> slots;
+		auto flush = [&]()
+		{
+			for (int slot = 0; slot < SLOT_COUNT && !materials.empty(); slot++)
+				if (!slots[slot].empty())
+					materials.back().textures.push_back({ OBJ_TEXTURE_TYPES[slot], slots[slot] });
+			slots.assign(SLOT_COUNT, std::string());
+		};
+		slots.assign(SLOT_COUNT, std::string());
+		while (p < end)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (!lineEnd)
+				lineEnd = end;
+			const char* line = p;
+			p = lineEnd < end ? lineEnd + 1 : end;
+
+			std::string keyword = token(line, lineEnd);
+			if (keyword == "newmtl")
+			{
+				flush();
+				materials.push_back({ rest(line, lineEnd), {} });
+			}
+			else
+			{
+				// options like -bm 0.5 come before the file name; a later map of a type replaces the earlier one
+				int slot = textureSlot(keyword);
+				if (slot >= 0)
+					slots[slot] = lastToken(line, lineEnd);
+			}
+		}
+		flush();
+	}
+
+	bool buildMesh(const std::vector<ObjRange>& ranges, const ObjChunk& attributes, ObjMesh& mesh)
+	{
+		size_t cornerCount = 0;
+		for (const ObjRange& range : ranges)
+			cornerCount += (range.last - range.first) * 3;
+
+		// open addressing on the v/vt/vn triple, at most half full
+		size_t capacity = 64;
+		while (capacity < cornerCount * 2)
+			capacity *= 2;
+		std::vector<ObjCorner> keys(capacity);
+		std::vector<uint32_t> slots(capacity, UINT32_MAX);
+		size_t positionCount = attributes.positions.size() / 3;
+		size_t texCoordCount = attributes.texCoords.size() / 2;
+		size_t normalCount = attributes.normals.size() / 3;
+
+		mesh.indices.reserve(cornerCount);
+		for (const ObjRange& range : ranges)
+		{
+			const ObjCorner* corner = range.chunk->corners.data() + range.first * 3;
+			const ObjCorner* last = range.chunk->corners.data() + range.last * 3;
+			for (; corner != last; corner++)
+			{
+				if (corner->v < 0 || (size_t)corner->v >= positionCount || corner->vn < 0 || (size_t)corner->vn >= normalCount
+					|| (corner->vt != NO_INDEX && (corner->vt < 0 || (size_t)corner->vt >= texCoordCount)))
+					return false;
+
+				uint32_t hash = ((uint32_t)corner->v * 73856093u) ^ ((uint32_t)corner->vt * 19349663u) ^ ((uint32_t)corner->vn * 83492791u);
+				size_t slot = (hash * 2654435761u) & (capacity - 1);
+				while (slots[slot] != UINT32_MAX
+					&& (keys[slot].v != corner->v || keys[slot].vt != corner->vt || keys[slot].vn != corner->vn))
+					slot = (slot + 1) & (capacity - 1);
+
+				if (slots[slot] == UINT32_MAX)
+				{
+					keys[slot] = *corner;
+					slots[slot] = (uint32_t)mesh.vertices.size();
+					ObjVertex vertex;
+					memcpy(vertex.position, &attributes.positions[corner->v * 3], sizeof(vertex.position));
+					memcpy(vertex.normal, &attributes.normals[corner->vn * 3], sizeof(vertex.normal));
+					if (corner->vt != NO_INDEX)
+						memcpy(vertex.texCoords, &attributes.texCoords[corner->vt * 2], sizeof(vertex.texCoords));
+					else
+						vertex.texCoords[0] = vertex.texCoords[1] = 0.0f;
+					mesh.vertices.push_back(vertex);
+				}
+				mesh.indices.push_back(slots[slot]);
+			}
+		}
+		return true;
+	}
+}
+
+const char* parseObjFloat(const char* p, const char* end, float& value)
+{
+	const char* start = p;
+	bool negative = p < end && *p == '-';
+	if (p < end && (*p == '-' || *p == '+'))
+		p++;
+
+	// up to 19 significant digits fit the mantissa, the rest only move the exponent
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	bool any = false;
+	bool truncated = false;
+	for (; p < end && isDigit(*p); p++, any = true)
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += mantissa ? 1 : 0;
+		}
+		else
+		{
+			exponent++;
+			truncated |= *p != '0';
+		}
+	}
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && isDigit(*p); p++, any = true)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa ? 1 : 0;
+				exponent--;
+			}
+			else
+				truncated |= *p != '0';
+		}
+	}
+	if (!any)
+		return nullptr;
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* q = p + 1;
+		bool negativeExponent = q < end && *q == '-';
+		if (q < end && (*q == '-' || *q == '+'))
+			q++;
+		if (q < end && isDigit(*q))
+		{
+			int e = 0;
+			for (; q < end && isDigit(*q); q++)
+				e = e < 10000 ? e * 10 + (*q - '0') : e;
+			exponent += negativeExponent ? -e : e;
+			p = q;
+		}
+	}
+
+	// With a mantissa and a power of ten that are both exact doubles, one multiply or
+	// divide rounds the decimal value correctly to double. Rounding that on to float
+	// gives what strtof gives, unless the double landed exactly halfway between two
+	// floats, where the second rounding may go the wrong way. Everything else, and
+	// results in the float subnormal range, goes through strtof itself.
+	if (!truncated && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22)
+	{
+		double result = exponent < 0 ? (double)mantissa / POWERS_OF_TEN[-exponent] : (double)mantissa * POWERS_OF_TEN[exponent];
+		uint64_t bits;
+		memcpy(&bits, &result, sizeof(bits));
+		// the 29 mantissa bits a float drops are exactly one half
+		bool halfway = (bits & ((1ull << 29) - 1)) == (1ull << 28);
+		if (!halfway && (result == 0.0 || result >= FLT_MIN))
+		{
+			value = (float)(negative ? -result : result);
+			return p;
+		}
+	}
+
+	char buffer[64];
+	std::string longNumber;
+	const char* text = buffer;
+	size_t length = (size_t)(p - start);
+	if (length < sizeof(buffer))
+	{
+		memcpy(buffer, start, length);
+		buffer[length] = '\0';
+	}
+	else
+	{
+		longNumber.assign(start, length);
+		text = longNumber.c_str();
+	}
+	value = strtof(text, nullptr);
+	return p;
+}
+
+bool loadObj(const std::string& path, ObjModel& model, unsigned int threads)
+{
+	AssetFile file;
+	if (!file.open(path))
+	{
+		std::cout << "OBJ loader: cannot open " << path << std::endl;
+		return false;
+	}
+	const char* data = reinterpret_cast<const char*>(file.data());
+	const char* end = data + file.size();
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threads, file.size() / MIN_CHUNK_BYTES));
+
+	// chunk boundaries just after a newline
+	std::vector<const char*> bounds(chunkCount + 1, end);
+	bounds[0] = data;
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		const char* p = std::max(bounds[i - 1], data + file.size() * i / chunkCount);
+		const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+		bounds[i] = newline ? newline + 1 : end;
+	}
+
+	std::vector<ObjChunk> chunks(chunkCount);
+	{
+		std::vector<std::future<void>> parsed;
+		for (size_t i = 1; i < chunkCount; i++)
+			parsed.push_back(std::async(std::launch::async, [&, i] { parseChunk(bounds[i], bounds[i + 1], chunks[i]); }));
+		parseChunk(bounds[0], bounds[1], chunks[0]);
+		for (std::future<void>& chunk : parsed)
+			chunk.get();
+	}
+	for (const ObjChunk& chunk : chunks)
+	{
+		if (!chunk.error.empty())
+		{
+			std::cout << "OBJ loader: " << path << " has " << chunk.error << ", not supported" << std::endl;
+			return false;
+		}
+	}
+
+	// chunk 0 becomes the shared attribute arrays; relative indices get the counts of the chunks before them
+	ObjChunk& attributes = chunks[0];
+	int32_t base[3] = { 0, 0, 0 };
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		ObjChunk& chunk = chunks[i];
+		for (const ObjRelativeCorner& relative : chunk.relative)
+		{
+			ObjCorner& corner = chunk.corners[relative.corner];
+			corner.v += (relative.fields & 1) ? base[0] : 0;
+			corner.vt += (relative.fields & 2) ? base[1] : 0;
+			corner.vn += (relative.fields & 4) ? base[2] : 0;
+			// an absent vt stays NO_INDEX, only a relative one can have resolved out of range
+			if (corner.v < 0 || ((relative.fields & 2) && corner.vt < 0) || corner.vn < 0)
+			{
+				std::cout << "OBJ loader: " << path << " has a face index out of range" << std::endl;
+				return false;
+			}
+		}
+		base[0] += (int32_t)(chunk.positions.size() / 3);
+		base[1] += (int32_t)(chunk.texCoords.size() / 2);
+		base[2] += (int32_t)(chunk.normals.size() / 3);
+		if (i == 0)
+			continue;
+		attributes.positions.insert(attributes.positions.end(), chunk.positions.begin(), chunk.positions.end());
+		attributes.texCoords.insert(attributes.texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+		attributes.normals.insert(attributes.normals.end(), chunk.normals.begin(), chunk.normals.end());
+		std::vector<float>().swap(chunk.positions);
+		std::vector<float>().swap(chunk.texCoords);
+		std::vector<float>().swap(chunk.normals);
+	}
+
+	// materials: the default one, then every library in order
+	model = ObjModel();
+	model.bytes = file.size();
+	model.threads = (unsigned int)chunkCount;
+	model.materials.push_back({ "DefaultMaterial", {} });
+	std::string directory = path.substr(0, path.find_last_of('/') + 1);
+	for (const ObjChunk& chunk : chunks)
+		for (const std::string& library : chunk.libraries)
+			loadMaterialLibrary(directory + library, model.materials);
+	std::unordered_map<std::string, uint32_t> materialIndex;
+	for (uint32_t i = (uint32_t)model.materials.size(); i-- > 0;)
+		materialIndex[model.materials[i].name] = i;
+
+	// the triangles of every material, in file order
+	std::vector<std::vector<ObjRange>> ranges;
+	std::vector<uint32_t> meshMaterials;
+	std::unordered_map<uint32_t, size_t> meshOfMaterial;
+	uint32_t material = 0;
+	auto addRange = [&](const ObjChunk& chunk, size_t first, size_t last)
+	{
+		if (first == last)
+			return;
+		auto found = meshOfMaterial.find(material);
+		if (found == meshOfMaterial.end())
+		{
+			found = meshOfMaterial.emplace(material, ranges.size()).first;
+			ranges.push_back(std::vector<ObjRange>());
+			meshMaterials.push_back(material);
+		}
+		ranges[found->second].push_back({ &chunk, first, last });
+	};
+	for (const ObjChunk& chunk : chunks)
+	{
+		size_t first = 0;
+		for (const ObjMaterialUse& use : chunk.materialUses)
+		{
+			addRange(chunk, first, use.triangle);
+			first = use.triangle;
+			auto found = materialIndex.find(use.name);
+			if (found == materialIndex.end())
+			{
+				found = materialIndex.emplace(use.name, (uint32_t)model.materials.size()).first;
+				model.materials.push_back({ use.name, {} });
+			}
+			material = found->second;
+		}
+		addRange(chunk, first, chunk.corners.size() / 3);
+		model.triangles += chunk.corners.size() / 3;
+	}
+
+	// the meshes are independent, deduplicate them side by side
+	model.meshes.resize(ranges.size());
+	std::vector<std::future<bool>> built;
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		model.meshes[i].material = meshMaterials[i];
+		built.push_back(std::async(i + 1 < ranges.size() ? std::launch::async : std::launch::deferred,
+			[&, i] { return buildMesh(ranges[i], attributes, model.meshes[i]); }));
+	}
+	bool ok = true;
+	for (std::future<bool>& mesh : built)
+		ok = mesh.get() && ok;
+	if (!ok)
+	{
+		std::cout << "OBJ loader: " << path << " has a face index out of range" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,59 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MeshCache.h"
+
+// Wavefront OBJ/MTL reader for the models we ship, in place of Assimp's general
+// importer. The file is split at line boundaries into one chunk per thread and the
+// chunks are parsed side by side; then the face corners are renumbered into one
+// vertex and index array per material, deduplicated on their v/vt/vn triple.
+//
+// It reads what Model::import asks Assimp for: polygons fan-triangulated, texture
+// coordinates flipped to GL's origin, one material per usemtl name (unknown names get
+// an empty material, as Assimp does), the MTL texture maps sorted like
+// Model::materialTextures. Faces without normals, lines and points are not supported;
+// loadObj returns false and the caller falls back to Assimp.
+
+// As the first 32 bytes of Vertex; MeshOptimizerInput reads it through its stride
+struct ObjVertex {
+	float position[3];
+	float normal[3];
+	float texCoords[2];
+};
+
+struct ObjMesh {
+	uint32_t material;
+	std::vector<ObjVertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+struct ObjMaterial {
+	std::string name;
+	std::vector<MeshCacheTextureRef> textures;
+};
+
+// meshes in the order their material is first used, materials[0] is the default
+// one used before any usemtl
+struct ObjModel {
+	std::vector<ObjMesh> meshes;
+	std::vector<ObjMaterial> materials;
+	size_t bytes = 0;			// of the OBJ file, for throughput
+	size_t triangles = 0;
+	unsigned int threads = 0;	// chunks the file was parsed in
+};
+
+// threads 0 uses one per hardware thread; small files are parsed in fewer chunks
+bool loadObj(const std::string& path, ObjModel& model, unsigned int threads = 0);
+
+// Parses OBJ float syntax ([sign] digits [. digits] [e [sign] digits]) to the same
+// float strtof gives. Numbers of up to 15 significant digits and exponents up to 22
+// take a fast path without the locale and errno work of strtof; the rare rest falls
+// back to strtof. Returns the end of the number, or nullptr.
+const char* parseObjFloat(const char* p, const char* end, float& value);
+
+#endif
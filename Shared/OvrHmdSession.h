@@ -0,0 +1,160 @@
+#ifndef OVR_HMD_SESSION_H
+#define OVR_HMD_SESSION_H
+
+#include <stdexcept>
+#include <glm/gtc/type_ptr.hpp>
+#include <OVR_CAPI_GL.h>
+#include <Extras/OVR_CAPI_Util.h>
+
+#include "HmdSession.h"
+
+// HmdSession backed by a live Oculus session
+class OvrHmdSession : public HmdSession
+{
+	ovrSession session{ nullptr };
+	ovrGraphicsLuid luid;
+	ovrTextureSwapChain eyeTexture{ nullptr };
+	ovrMirrorTexture mirrorTexture{ nullptr };
+
+public:
+	OvrHmdSession()
+	{
+		if (!OVR_SUCCESS(ovr_Create(&session, &luid)))
+		{
+			throw std::runtime_error("Unable to create HMD session");
+		}
+	}
+
+	~OvrHmdSession()
+	{
+		if (mirrorTexture)
+			ovr_DestroyMirrorTexture(session, mirrorTexture);
+		if (eyeTexture)
+			ovr_DestroyTextureSwapChain(session, eyeTexture);
+		ovr_Destroy(session);
+		session = nullptr;
+	}
+
+	ovrHmdDesc getHmdDesc() override
+	{
+		return ovr_GetHmdDesc(session);
+	}
+
+	ovrEyeRenderDesc getRenderDesc(ovrEyeType eye, const ovrFovPort& fov) override
+	{
+		return ovr_GetRenderDesc(session, eye, fov);
+	}
+
+	ovrSizei getFovTextureSize(ovrEyeType eye, const ovrFovPort& fov, float pixelsPerDisplayPixel) override
+	{
+		return ovr_GetFovTextureSize(session, eye, fov, pixelsPerDisplayPixel);
+	}
+
+	glm::mat4 getProjection(const ovrFovPort& fov, float nearPlane, float farPlane) override
+	{
+		ovrMatrix4f m = ovrMatrix4f_Projection(fov, nearPlane, farPlane, ovrProjection_ClipRangeOpenGL);
+		return glm::transpose(glm::make_mat4(&m.M[0][0]));
+	}
+
+	ovrTrackingState getTrackingState(double absTime) override
+	{
+		return ovr_GetTrackingState(session, absTime, ovrTrue);
+	}
+
+	bool getInputState(ovrInputState* inputState) override
+	{
+		return OVR_SUCCESS(ovr_GetInputState(session, ovrControllerType_Touch, inputState));
+	}
+
+	void getEyePoses(long long frame, const ovrPosef hmdToEyePose[2], ovrPosef outEyePoses[2], double* outSensorSampleTime) override
+	{
+		ovr_GetEyePoses(session, frame, ovrTrue, hmdToEyePose, outEyePoses, outSensorSampleTime);
+	}
+
+	void recenter() override
+	{
+		ovr_RecenterTrackingOrigin(session);
+	}
+
+	bool createSwapChain(int width, int height) override
+	{
+		ovrTextureSwapChainDesc desc = {};
+		desc.Type = ovrTexture_2D;
+		desc.ArraySize = 1;
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = 1;
+		desc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
+		desc.SampleCount = 1;
+		desc.StaticImage = ovrFalse;
+		if (!OVR_SUCCESS(ovr_CreateTextureSwapChainGL(session, &desc, &eyeTexture)))
+			return false;
+
+		int length = 0;
+		if (!OVR_SUCCESS(ovr_GetTextureSwapChainLength(session, eyeTexture, &length)) || !length)
+			return false;
+
+		for (int i = 0; i < length; ++i)
+		{
+			GLuint chainTexId;
+			ovr_GetTextureSwapChainBufferGL(session, eyeTexture, i, &chainTexId);
+			glBindTexture(GL_TEXTURE_2D, chainTexId);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return true;
+	}
+
+	GLuint getCurrentSwapTexture() override
+	{
+		int curIndex;
+		ovr_GetTextureSwapChainCurrentIndex(session, eyeTexture, &curIndex);
+		GLuint curTexId;
+		ovr_GetTextureSwapChainBufferGL(session, eyeTexture, curIndex, &curTexId);
+		return curTexId;
+	}
+
+	void commitSwapChain() override
+	{
+		ovr_CommitTextureSwapChain(session, eyeTexture);
+	}
+
+	void submitFrame(long long frame, const ovrViewScaleDesc* viewScaleDesc, ovrLayerEyeFov* layer) override
+	{
+		layer->ColorTexture[0] = eyeTexture;
+		ovrLayerHeader* headerList = &layer->Header;
+		ovr_SubmitFrame(session, frame, viewScaleDesc, &headerList, 1);
+	}
+
+	bool createMirrorTexture(int width, int height) override
+	{
+		ovrMirrorTextureDesc mirrorDesc;
+		memset(&mirrorDesc, 0, sizeof(mirrorDesc));
+		mirrorDesc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
+		mirrorDesc.Width = width;
+		mirrorDesc.Height = height;
+		return OVR_SUCCESS(ovr_CreateMirrorTextureGL(session, &mirrorDesc, &mirrorTexture));
+	}
+
+	GLuint getMirrorTexture() override
+	{
+		GLuint mirrorTextureId;
+		ovr_GetMirrorTextureBufferGL(session, mirrorTexture, &mirrorTextureId);
+		return mirrorTextureId;
+	}
+
+	bool getFovStencil(const ovrFovStencilDesc* desc, ovrFovStencilMeshBuffer* meshBuffer) override
+	{
+		return OVR_SUCCESS(ovr_GetFovStencil(session, desc, meshBuffer));
+	}
+
+	bool getPerfStats(ovrPerfStats* stats) override
+	{
+		return OVR_SUCCESS(ovr_GetPerfStats(session, stats));
+	}
+};
+
+#endif
@@ -5,59 +5,24 @@
 
 #include "Cube.h"
 #include "Model.h"
-
-#include "rpc/client.h"
-struct PlayerInfo {
-	int dead = 0;
-	int heldWeapon = -1;
-	glm::mat4 headInWorld;
-	glm::mat4 rhandInWorld;
-	glm::mat4 lhandInWorld;
-
-	PlayerInfo() {
-		dead = 0;
-		heldWeapon = -1;
-		headInWorld = glm::mat4(1);
-		rhandInWorld = glm::mat4(1);
-		lhandInWorld = glm::mat4(1);
-	}
-
-
-	MSGPACK_DEFINE_MAP(dead, heldWeapon,
-		headInWorld[0][0], headInWorld[0][1], headInWorld[0][2], headInWorld[0][3],
-		headInWorld[1][0], headInWorld[1][1], headInWorld[1][2], headInWorld[1][3],
-		headInWorld[2][0], headInWorld[2][1], headInWorld[2][2], headInWorld[2][3],
-		headInWorld[3][0], headInWorld[3][1], headInWorld[3][2], headInWorld[3][3],
-
-		rhandInWorld[0][0], rhandInWorld[0][1], rhandInWorld[0][2], rhandInWorld[0][3],
-		rhandInWorld[1][0], rhandInWorld[1][1], rhandInWorld[1][2], rhandInWorld[1][3],
-		rhandInWorld[2][0], rhandInWorld[2][1], rhandInWorld[2][2], rhandInWorld[2][3],
-		rhandInWorld[3][0], rhandInWorld[3][1], rhandInWorld[3][2], rhandInWorld[3][3],
-
-		lhandInWorld[0][0], lhandInWorld[0][1], lhandInWorld[0][2], lhandInWorld[0][3],
-		lhandInWorld[1][0], lhandInWorld[1][1], lhandInWorld[1][2], lhandInWorld[1][3],
-		lhandInWorld[2][0], lhandInWorld[2][1], lhandInWorld[2][2], lhandInWorld[2][3],
-		lhandInWorld[3][0], lhandInWorld[3][1], lhandInWorld[3][2], lhandInWorld[3][3]
-
-	)
-};
+#include "PlayerInfo.h"
 
 class Player
 {
 private:
-	Model* head;
-	Model* handSphere;
+	std::shared_ptr<Model> head;
+	std::shared_ptr<Model> handSphere;
 public:
 
 	bool isMe;
 	
 	int heldWeapon;
-	glm::mat4 weaponToPlayer;
-	glm::mat4 headToPlayer;
-	glm::mat4 rhandToPlayer;
-	glm::mat4 lhandToPlayer;
+	RigidTransform weaponToPlayer;
+	RigidTransform headToPlayer;
+	RigidTransform rhandToPlayer;
+	RigidTransform lhandToPlayer;
 
-	glm::mat4 toWorld;
+	RigidTransform toWorld;
 
 
 	PlayerInfo* info;
@@ -66,22 +31,26 @@ public:
 	float handScale = 0.05;
 	float headScale = 0.2;
 
-	Player(glm::mat4 M, bool isMe, Model* sphere, Model* headModel) {
+	Player(const RigidTransform& M, bool isMe, std::shared_ptr<Model> sphere, std::shared_ptr<Model> headModel) {
 		toWorld = M;
 		this->isMe = isMe;
 		handSphere = sphere;
 		head = headModel;
 		heldWeapon = -1;
-		headToPlayer = glm::mat4(1);
-		rhandToPlayer = glm::translate(glm::mat4(1), glm::vec3(1, -1, 0));
-		lhandToPlayer = glm::translate(glm::mat4(1), glm::vec3(-1, -1, 0));
+		headToPlayer = RigidTransform();
+		rhandToPlayer = RigidTransform(glm::vec3(1, -1, 0));
+		lhandToPlayer = RigidTransform(glm::vec3(-1, -1, 0));
 
 
 		info = new PlayerInfo();
 		getPlayerInfo(); // update info
 	};
 
-	void updatePlayer(glm::mat4 h, glm::mat4 r, glm::mat4 l) {
+	~Player() {
+		delete info;
+	}
+
+	void updatePlayer(const RigidTransform& h, const RigidTransform& r, const RigidTransform& l) {
 		headToPlayer = h;
 		rhandToPlayer = r;
 		lhandToPlayer = l;
@@ -96,30 +65,30 @@ public:
 		//Head 
 		if (!isMe) {
 			glUniform3fv(glGetUniformLocation(shader, "objectColor"), 1, &(glm::vec3(1, 1, 1))[0]);
-			glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, &(getHeadPose() 
+			glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, &(getHeadPose().toMat4()
 				* glm::scale(glm::mat4(1), glm::vec3(headScale)) * glm::rotate(glm::mat4(1), glm::pi<float>(), glm::vec3(0, 1, 0))    )[0][0]);
 			head->Draw(shader);
 		}
 
 		//Left Hand
 		glUniform3fv(glGetUniformLocation(shader, "objectColor"), 1, &(glm::vec3(1, 0, 1))[0]);
-		glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, &(getLHandPose() * glm::scale(glm::mat4(1), glm::vec3(handScale)))[0][0]);
+		glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, &(getLHandPose().toMat4() * glm::scale(glm::mat4(1), glm::vec3(handScale)))[0][0]);
 		handSphere->Draw(shader);
 
 		//Right Hand
 		glUniform3fv(glGetUniformLocation(shader, "objectColor"), 1, &(glm::vec3(1, 1, 0))[0]);
-		glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, &(getRHandPose() * glm::scale(glm::mat4(1), glm::vec3(handScale)))[0][0]);
+		glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, &(getRHandPose().toMat4() * glm::scale(glm::mat4(1), glm::vec3(handScale)))[0][0]);
 		handSphere->Draw(shader);
 	};
 
 
-	glm::mat4 getHeadPose() {
+	RigidTransform getHeadPose() {
 		return toWorld * headToPlayer;
 	};
-	glm::mat4 getLHandPose() {
+	RigidTransform getLHandPose() {
 		return toWorld * lhandToPlayer;
 	};
-	glm::mat4 getRHandPose() {
+	RigidTransform getRHandPose() {
 		return toWorld * rhandToPlayer;
 	};
 
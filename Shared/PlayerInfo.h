@@ -0,0 +1,38 @@
+#ifndef PLAYER_INFO_H
+#define PLAYER_INFO_H
+
+#include "RigidTransform.h"
+#ifndef MINIMALVR_NO_NETWORK
+#include "rpc/msgpack.hpp"
+#endif
+
+// What a client tells the server about its player each frame, and the server sends
+// back about the opponent. No GL in here, the simulation includes it on both sides;
+// builds without the network (MINIMALVR_NO_NETWORK) leave out its msgpack encoding.
+struct PlayerInfo {
+	int dead = 0;
+	int heldWeapon = -1;
+	RigidTransform headInWorld;
+	RigidTransform rhandInWorld;
+	RigidTransform lhandInWorld;
+
+	PlayerInfo() {
+		dead = 0;
+		heldWeapon = -1;
+	}
+
+#ifndef MINIMALVR_NO_NETWORK
+	MSGPACK_DEFINE_MAP(dead, heldWeapon,
+		headInWorld.rotation.x, headInWorld.rotation.y, headInWorld.rotation.z, headInWorld.rotation.w,
+		headInWorld.translation.x, headInWorld.translation.y, headInWorld.translation.z,
+
+		rhandInWorld.rotation.x, rhandInWorld.rotation.y, rhandInWorld.rotation.z, rhandInWorld.rotation.w,
+		rhandInWorld.translation.x, rhandInWorld.translation.y, rhandInWorld.translation.z,
+
+		lhandInWorld.rotation.x, lhandInWorld.rotation.y, lhandInWorld.rotation.z, lhandInWorld.rotation.w,
+		lhandInWorld.translation.x, lhandInWorld.translation.y, lhandInWorld.translation.z
+	)
+#endif
+};
+
+#endif
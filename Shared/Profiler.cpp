@@ -0,0 +1,275 @@
+#include "Profiler.h"
+
+#include <cstdio>
+#include <algorithm>
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+Profiler profiler;
+
+void Profiler::init()
+{
+	for (int i = 0; i < QUERY_FRAMES; i++)
+	{
+		glGenQueries(MAX_ZONES, querySets[i].starts);
+		glGenQueries(MAX_ZONES, querySets[i].ends);
+	}
+	initialized = true;
+}
+
+void Profiler::shutdown()
+{
+	if (!initialized)
+		return;
+	for (int i = 0; i < QUERY_FRAMES; i++)
+	{
+		glDeleteQueries(MAX_ZONES, querySets[i].starts);
+		glDeleteQueries(MAX_ZONES, querySets[i].ends);
+	}
+	initialized = false;
+}
+
+double Profiler::nowUs() const
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - epoch).count();
+}
+
+void Profiler::beginFrame(unsigned int frame)
+{
+	if (!enabled)
+		return;
+
+	// the oldest query set is about to be reused, its results are QUERY_FRAMES frames old by now
+	querySet = (querySet + 1) % QUERY_FRAMES;
+	QuerySet& set = querySets[querySet];
+	resolveQueries(set);
+
+	current = &history[head];
+	current->frame = frame;
+	current->startUs = nowUs();
+	current->endUs = current->startUs;
+	current->zoneCount = 0;
+	depth = 0;
+
+	set.used = 0;
+	set.record = head;
+	set.frame = frame;
+}
+
+void Profiler::endFrame()
+{
+	if (!enabled || !current)
+		return;
+
+	current->endUs = nowUs();
+	current = nullptr;
+	head = (head + 1) % HISTORY;
+	count = std::min(count + 1, (int)HISTORY);
+}
+
+int Profiler::beginZone(const char* name, bool gpu)
+{
+	if (!enabled || !current || current->zoneCount == MAX_ZONES)
+		return -1;
+
+	int index = current->zoneCount++;
+	Zone& zone = current->zones[index];
+	zone.name = name;
+	zone.depth = depth++;
+	zone.gpuMs = -1.0f;
+
+	QuerySet& set = querySets[querySet];
+	set.pair[index] = -1;
+	if (gpu && initialized)
+	{
+		set.pair[index] = set.used;
+		set.zone[set.used] = index;
+		glQueryCounter(set.starts[set.used], GL_TIMESTAMP);
+		set.used++;
+	}
+
+	zone.cpuStartUs = nowUs();
+	return index;
+}
+
+void Profiler::endZone(int index)
+{
+	if (index < 0 || !current)
+		return;
+
+	Zone& zone = current->zones[index];
+	zone.cpuEndUs = nowUs();
+	depth--;
+
+	const QuerySet& set = querySets[querySet];
+	if (set.pair[index] >= 0)
+		glQueryCounter(set.ends[set.pair[index]], GL_TIMESTAMP);
+}
+
+void Profiler::resolveQueries(QuerySet& set)
+{
+	if (set.record < 0)
+		return;
+
+	FrameRecord& record = history[set.record];
+	// the record slot was recycled by a newer frame, drop the results
+	bool valid = (record.frame == set.frame);
+	for (int i = 0; i < set.used && valid; i++)
+	{
+		// QUERY_FRAMES frames are normally plenty; if the GPU is further behind than
+		// that the zone stays unmeasured rather than stalling the frame
+		GLint available = 0;
+		glGetQueryObjectiv(set.ends[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(set.starts[i], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(set.ends[i], GL_QUERY_RESULT, &end);
+		record.zones[set.zone[i]].gpuMs = (end - start) / 1000000.0f;
+	}
+	set.used = 0;
+	set.record = -1;
+}
+
+void Profiler::addThreadZone(const char* thread, const char* name, double startUs, double endUs)
+{
+	if (!enabled)
+		return;
+
+	std::lock_guard<std::mutex> lock(threadZonesMutex);
+	threadZones[threadHead] = { thread, name, startUs, endUs };
+	threadHead = (threadHead + 1) % THREAD_HISTORY;
+	threadCount = std::min(threadCount + 1, (int)THREAD_HISTORY);
+}
+
+const Profiler::FrameRecord* Profiler::getLatestFrame() const
+{
+	if (count == 0)
+		return nullptr;
+	return &history[(head + HISTORY - 1) % HISTORY];
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const
+{
+	FILE* fp = fopen(path.c_str(), "w");
+	if (!fp)
+	{
+		printf("Unable to write trace to %s\n", path.c_str());
+		return false;
+	}
+
+	fprintf(fp, "{\"traceEvents\":[\n");
+	fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n");
+	fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}");
+
+	for (int i = 0; i < count; i++)
+	{
+		const FrameRecord& record = history[(head + HISTORY - count + i) % HISTORY];
+		fprintf(fp, ",\n{\"name\":\"frame %u\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+			record.frame, record.startUs, record.endUs - record.startUs);
+
+		for (int z = 0; z < record.zoneCount; z++)
+		{
+			const Zone& zone = record.zones[z];
+			fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+				zone.name, zone.cpuStartUs, zone.cpuEndUs - zone.cpuStartUs);
+			// GPU work has no CPU-side timestamp, it is drawn from the moment it was issued
+			if (zone.gpuMs > 0.0f)
+			{
+				fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+					zone.name, zone.cpuStartUs, zone.gpuMs * 1000.0f);
+			}
+		}
+	}
+
+	// the other threads after the GPU, a track per name in the order they first show up
+	std::lock_guard<std::mutex> lock(threadZonesMutex);
+	std::vector<const char*> threads;
+	for (int i = 0; i < threadCount; i++)
+	{
+		const ThreadZone& zone = threadZones[(threadHead + THREAD_HISTORY - threadCount + i) % THREAD_HISTORY];
+		size_t track = std::find(threads.begin(), threads.end(), zone.thread) - threads.begin();
+		if (track == threads.size())
+		{
+			threads.push_back(zone.thread);
+			fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				(int)track + 2, zone.thread);
+		}
+		fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+			zone.name, (int)track + 2, zone.startUs, zone.endUs - zone.startUs);
+	}
+
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+	printf("Wrote %d frames to %s\n", count, path.c_str());
+	return true;
+}
+
+void Profiler::drawOverlay(int width, int height, float budgetMs) const
+{
+	if (count == 0)
+		return;
+
+	static const float colors[][3] = {
+		{ 0.9f, 0.3f, 0.3f }, { 0.3f, 0.9f, 0.3f }, { 0.3f, 0.5f, 1.0f },
+		{ 0.9f, 0.9f, 0.3f }, { 0.9f, 0.3f, 0.9f }, { 0.3f, 0.9f, 0.9f },
+	};
+
+	int graphHeight = height / 3;
+	int columns = std::min(count, width / 2);
+	float pixelsPerMs = graphHeight / (2.0f * budgetMs);
+
+	GLfloat clearColor[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+	// scissored clears are the cheapest way to draw solid rectangles without any state setup
+	glEnable(GL_SCISSOR_TEST);
+	for (int c = 0; c < columns; c++)
+	{
+		const FrameRecord& record = history[(head + HISTORY - columns + c) % HISTORY];
+		int x = c * 2;
+		int y = 0;
+
+		// top level zones stacked, CPU time
+		for (int z = 0; z < record.zoneCount; z++)
+		{
+			const Zone& zone = record.zones[z];
+			if (zone.depth != 0)
+				continue;
+			int h = (int)((zone.cpuEndUs - zone.cpuStartUs) / 1000.0 * pixelsPerMs);
+			const float* color = colors[z % 6];
+			glScissor(x, y, 2, std::max(h, 0));
+			glClearColor(color[0], color[1], color[2], 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+			y += h;
+		}
+	}
+
+	// frame budget line
+	glScissor(0, (int)(budgetMs * pixelsPerMs), columns * 2, 1);
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glDisable(GL_SCISSOR_TEST);
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+}
+
+size_t peakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		return (size_t)usage.ru_maxrss * 1024; // kilobytes on Linux
+	return 0;
+#endif
+}
@@ -0,0 +1,149 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/glew.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Frame profiler: scoped CPU markers, optional GPU time per marker (a GL_TIMESTAMP pair),
+// and an in-memory ring of per-frame records that can be dumped as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev) or drawn as bars over the mirror window.
+//
+// GPU markers may nest and may run inside someone else's GL_TIME_ELAPSED query
+// (GlFrameTiming brackets the whole frame with one), timestamps never conflict.
+// Marker names must be string literals, only the pointer is stored.
+//
+// Frame zones belong to the thread running the frame. Other threads (the server
+// exchange) record whole zones with ThreadProfileScope instead, into a ring of their
+// own under a mutex; the trace shows them on a track per thread name.
+class Profiler
+{
+public:
+	static const int MAX_ZONES = 16;
+	// frames of GPU queries in flight before results are read back
+	static const int QUERY_FRAMES = 4;
+	// frames kept for the trace dump and the overlay
+	static const int HISTORY = 300;
+	// zones of other threads kept for the trace dump
+	static const int THREAD_HISTORY = 1024;
+
+	struct Zone {
+		const char* name;
+		int depth;
+		double cpuStartUs;
+		double cpuEndUs;
+		float gpuMs; // negative when not measured or not resolved yet
+	};
+
+	struct FrameRecord {
+		unsigned int frame;
+		double startUs;
+		double endUs;
+		int zoneCount;
+		Zone zones[MAX_ZONES];
+	};
+
+	bool enabled = true;
+	bool showOverlay = false;
+
+	void init();
+	void shutdown();
+
+	void beginFrame(unsigned int frame);
+	void endFrame();
+
+	int beginZone(const char* name, bool gpu);
+	void endZone(int zone);
+
+	// any thread; times from nowUs
+	void addThreadZone(const char* thread, const char* name, double startUs, double endUs);
+	double nowUs() const;
+
+	// writes the whole history as Chrome trace event JSON, returns false when the file can't be opened
+	bool writeChromeTrace(const std::string& path) const;
+
+	// draws the frame history as stacked bars in the bottom-left corner of the bound framebuffer,
+	// one column per frame, full height = 2 frame budgets
+	void drawOverlay(int width, int height, float budgetMs) const;
+
+	const FrameRecord* getLatestFrame() const;
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	Clock::time_point epoch = Clock::now();
+	std::vector<FrameRecord> history = std::vector<FrameRecord>(HISTORY);
+	int head = 0;
+	int count = 0;
+	FrameRecord* current = nullptr;
+	int depth = 0;
+
+	struct ThreadZone {
+		const char* thread;
+		const char* name;
+		double startUs;
+		double endUs;
+	};
+	mutable std::mutex threadZonesMutex;
+	std::vector<ThreadZone> threadZones = std::vector<ThreadZone>(THREAD_HISTORY);
+	int threadHead = 0;
+	int threadCount = 0;
+
+	// GPU timestamps per in-flight frame, a start and an end per zone, each pair
+	// remembers which record/zone it belongs to
+	struct QuerySet {
+		GLuint starts[MAX_ZONES];
+		GLuint ends[MAX_ZONES];
+		int zone[MAX_ZONES];
+		// query pair of each zone of the frame, -1 for CPU only zones
+		int pair[MAX_ZONES];
+		int used = 0;
+		int record = -1;
+		unsigned int frame = 0;
+	};
+	QuerySet querySets[QUERY_FRAMES];
+	int querySet = 0;
+	bool initialized = false;
+
+	void resolveQueries(QuerySet& set);
+};
+
+extern Profiler profiler;
+
+// Peak resident set size of the process in bytes, 0 when the platform can't tell
+size_t peakResidentBytes();
+
+// Scoped marker, ends the zone when it goes out of scope
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name, bool gpu = false)
+	{
+		zone = profiler.beginZone(name, gpu);
+	}
+	~ProfileScope()
+	{
+		profiler.endZone(zone);
+	}
+private:
+	int zone;
+};
+
+// Scoped marker for a thread other than the frame's, thread names a trace track
+class ThreadProfileScope
+{
+public:
+	ThreadProfileScope(const char* thread, const char* name) : thread(thread), name(name), startUs(profiler.nowUs()) {}
+	~ThreadProfileScope()
+	{
+		profiler.addThreadZone(thread, name, startUs, profiler.nowUs());
+	}
+private:
+	const char* thread;
+	const char* name;
+	double startUs;
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "ResolutionGovernor.h"
+#include "FrameTiming.h"
+
+#include <iostream>
+
+namespace
+{
+	struct GovernorRun {
+		float scale;
+		float minScale;
+		float maxScale;
+		// frames of the whole run whose time was over the frame budget
+		int overBudget;
+	};
+
+	// the frame loop of RiftApp::update without GL: the governor picks the scale,
+	// the frame is "rendered" at it and its timings are fed back. minScale and
+	// maxScale cover the last quarter of the run, once the loop had time to settle.
+	GovernorRun runGovernor(ResolutionGovernor& governor, SimulatedFrameTiming& timing, int frames, float compositorHint)
+	{
+		GovernorRun run = { governor.getScale(), governor.maxScale, governor.minScale, 0 };
+		for (int frame = 0; frame < frames; frame++)
+		{
+			float scale = governor.getScale();
+			timing.setScale(scale);
+			timing.beginFrame();
+			timing.endFrame();
+
+			float cpuMs, gpuMs;
+			while (timing.poll(cpuMs, gpuMs))
+			{
+				if (std::max(cpuMs, gpuMs) > governor.getFrameBudgetMs())
+					run.overBudget++;
+				governor.update(cpuMs, gpuMs);
+			}
+			if (compositorHint > 0.0f)
+				governor.applyCompositorHint(compositorHint);
+
+			if (frame >= frames * 3 / 4)
+			{
+				run.minScale = std::min(run.minScale, scale);
+				run.maxScale = std::max(run.maxScale, scale);
+			}
+		}
+		run.scale = governor.getScale();
+		return run;
+	}
+
+	bool report(const char* name, const GovernorRun& run, bool ok)
+	{
+		std::cout << (ok ? "Governor ok: " : "Governor FAILED: ") << name << ", scale " << run.scale
+			<< " (" << run.minScale << " to " << run.maxScale << " over the last quarter), "
+			<< run.overBudget << " frame(s) over budget" << std::endl;
+		return ok;
+	}
+}
+
+bool checkResolutionGovernor()
+{
+	const float budgetMs = 1000.0f / 90.0f;
+	bool ok = true;
+
+	// a GPU too slow for full resolution: the scale drops once, then holds steady under budget
+	{
+		ResolutionGovernor governor(budgetMs);
+		SimulatedFrameTiming timing;
+		timing.gpuMsAtFullScale = 14.0f;
+		GovernorRun run = runGovernor(governor, timing, 2000, 0.0f);
+		ok &= report("steady overload", run, run.scale < 1.0f && run.scale > governor.minScale
+			&& run.maxScale - run.minScale <= governor.increaseStep && run.overBudget <= 1);
+	}
+
+	// plenty of headroom: the scale climbs all the way to the maximum
+	{
+		ResolutionGovernor governor(budgetMs);
+		SimulatedFrameTiming timing;
+		timing.gpuMsAtFullScale = 3.0f;
+		GovernorRun run = runGovernor(governor, timing, 1500, 0.0f);
+		ok &= report("light load", run, run.scale == governor.maxScale && run.overBudget == 0);
+	}
+
+	// short spikes of half again the GPU cost: only the first frame of each spike may miss
+	{
+		ResolutionGovernor governor(budgetMs);
+		SimulatedFrameTiming timing;
+		timing.spikeInterval = 300;
+		timing.spikeLength = 20;
+		timing.spikeFactor = 1.5f;
+		const int frames = 3000;
+		GovernorRun run = runGovernor(governor, timing, frames, 0.0f);
+		ok &= report("load spikes", run, run.scale >= governor.minScale && run.overBudget <= frames / timing.spikeInterval);
+	}
+
+	// the compositor asks for less every frame: the scale settles at its hint instead
+	// of sinking further each time the hint is repeated
+	{
+		ResolutionGovernor governor(budgetMs);
+		SimulatedFrameTiming timing;
+		timing.gpuMsAtFullScale = 3.0f;
+		const float hint = 0.81f;
+		GovernorRun run = runGovernor(governor, timing, 1000, hint);
+		ok &= report("steady compositor hint", run, std::fabs(run.scale - std::sqrt(hint)) < 0.001f
+			&& run.minScale > governor.minScale);
+	}
+
+	return ok;
+}
@@ -0,0 +1,111 @@
+#ifndef RESOLUTION_GOVERNOR_H
+#define RESOLUTION_GOVERNOR_H
+
+#include <algorithm>
+#include <cmath>
+
+// Dynamic resolution control loop. Every frame it is fed the CPU and GPU time of a
+// finished frame and answers with a scale for the per-eye viewport. The swap chain
+// is allocated at maxScale, so changing the scale never reallocates anything.
+//
+// It knows nothing about GL or OVR: the timings come from a FrameTimingSource
+// (see FrameTiming.h), which can be the GL timer queries or a simulated source.
+class ResolutionGovernor
+{
+public:
+	float minScale = 0.6f;
+	float maxScale = 1.2f;
+
+	// fraction of the compositor frame budget we aim for, leaves room for spikes
+	float headroom = 0.85f;
+	// scale goes up only after this many frames comfortably under budget
+	int framesBeforeIncrease = 45;
+	float increaseStep = 0.02f;
+	// exponential smoothing of the frame time, 0 = no smoothing
+	float smoothing = 0.7f;
+
+	ResolutionGovernor(float frameBudgetMs = 1000.0f / 90.0f, float startScale = 1.0f)
+	{
+		budgetMs = frameBudgetMs;
+		scale = startScale;
+	}
+
+	void setFrameBudget(float frameBudgetMs)
+	{
+		budgetMs = frameBudgetMs;
+	}
+
+	// Feeds the timings of one finished frame, returns the scale for the next one
+	float update(float cpuMs, float gpuMs)
+	{
+		float frameMs = std::max(cpuMs, gpuMs);
+		filteredMs = (samples == 0) ? frameMs : smoothing * filteredMs + (1.0f - smoothing) * frameMs;
+		samples++;
+
+		float target = budgetMs * headroom;
+
+		// over budget: drop right away. Pixel count goes with scale squared,
+		// so the square root of the ratio is the scale that would fit
+		if (frameMs > budgetMs || filteredMs > target)
+		{
+			float ratio = target / std::max(frameMs, filteredMs);
+			scale = clampScale(scale * std::sqrt(ratio));
+			framesUnderBudget = 0;
+			return scale;
+		}
+
+		// under budget: creep back up slowly so we do not oscillate
+		if (filteredMs < target * 0.8f)
+		{
+			if (++framesUnderBudget >= framesBeforeIncrease)
+			{
+				scale = clampScale(scale + increaseStep);
+				framesUnderBudget = 0;
+			}
+		}
+		else
+		{
+			framesUnderBudget = 0;
+		}
+		return scale;
+	}
+
+	// The compositor's own suggestion (ovrPerfStats::AdaptiveGpuPerformanceScale),
+	// values below 1 mean the GPU is missing frames. It is a ceiling, not a step:
+	// the same hint arrives every frame until the compositor changes its mind.
+	void applyCompositorHint(float adaptiveGpuScale)
+	{
+		if (adaptiveGpuScale > 0.0f && adaptiveGpuScale < 1.0f)
+		{
+			float ceiling = clampScale(std::sqrt(adaptiveGpuScale));
+			if (scale > ceiling)
+			{
+				scale = ceiling;
+				framesUnderBudget = 0;
+			}
+		}
+	}
+
+	float getScale() const { return scale; }
+	float getFilteredFrameMs() const { return filteredMs; }
+	float getFrameBudgetMs() const { return budgetMs; }
+
+private:
+	float budgetMs;
+	float scale;
+	float filteredMs = 0.0f;
+	int samples = 0;
+	int framesUnderBudget = 0;
+
+	float clampScale(float s) const
+	{
+		return std::min(maxScale, std::max(minScale, s));
+	}
+};
+
+// --governor-check: drives the governor with SimulatedFrameTiming through a steady
+// overload, a light load, load spikes and a steady compositor hint, prints how each
+// ends up and returns false when one does not settle where it should
+bool checkResolutionGovernor();
+
+#endif
@@ -0,0 +1,66 @@
+#include "ResourceCache.h"
+
+#include <cctype>
+#include <cstdio>
+#include <vector>
+
+std::string normalizeResourcePath(const std::string& path)
+{
+	std::string unified = path;
+	for (char& c : unified)
+	{
+		if (c == '\\')
+			c = '/';
+#ifdef _WIN32
+		c = (char)tolower((unsigned char)c);
+#endif
+	}
+
+	bool absolute = !unified.empty() && unified[0] == '/';
+	std::vector<std::string> parts;
+	size_t start = 0;
+	while (start <= unified.size())
+	{
+		size_t end = unified.find('/', start);
+		if (end == std::string::npos)
+			end = unified.size();
+		std::string part = unified.substr(start, end - start);
+		start = end + 1;
+
+		if (part.empty() || part == ".")
+			continue;
+		// "a/../" cancels, leading ".." must stay for relative paths
+		if (part == ".." && !parts.empty() && parts.back() != "..")
+			parts.pop_back();
+		else if (part != ".." || !absolute)
+			parts.push_back(part);
+	}
+
+	std::string normalized = absolute ? "/" : "";
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		if (i)
+			normalized += '/';
+		normalized += parts[i];
+	}
+	return normalized;
+}
+
+uint64_t hashResourceBytes(const void* data, size_t size, uint64_t seed)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::string contentResourceKey(uint64_t hash)
+{
+	char key[20];
+	snprintf(key, sizeof(key), "#%016llx", (unsigned long long)hash);
+	return key;
+}
@@ -0,0 +1,112 @@
+#ifndef RESOURCE_CACHE_H
+#define RESOURCE_CACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Collapses "./", "../" and doubled separators and turns backslashes into slashes
+// (and lower-cases on Windows), so every spelling of a file maps to one key
+std::string normalizeResourcePath(const std::string& path);
+
+// FNV-1a 64 over raw bytes, for keying resources by content
+uint64_t hashResourceBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+// "#<16 hex digits>", a key that can't collide with a normalized path
+std::string contentResourceKey(uint64_t hash);
+
+struct ResourceStats {
+	size_t count = 0;	// live resources, aliases counted once
+	size_t bytes = 0;	// sum of their memoryBytes()
+	size_t hits = 0;
+	size_t misses = 0;
+};
+
+// Process-wide table of shared resources. Entries are weak: a resource lives as long
+// as someone holds its shared_ptr and is rebuilt on the next request after that.
+// Several keys (a path and a content hash) may alias one resource.
+// T must provide size_t memoryBytes() const for the accounting.
+// All members are safe to call from any thread; create runs under the table lock.
+template<typename T>
+class ResourceTable
+{
+public:
+	std::shared_ptr<T> find(const std::string& key)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return findLocked(key);
+	}
+
+	std::shared_ptr<T> getOrCreate(const std::string& key, const std::function<std::shared_ptr<T>()>& create)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		std::shared_ptr<T> resource = findLocked(key);
+		if (resource)
+			return resource;
+		resource = create();
+		if (resource)
+			_entries[key] = resource;
+		return resource;
+	}
+
+	// adds or replaces a key, e.g. an alias for a resource found by content
+	void insert(const std::string& key, const std::shared_ptr<T>& resource)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_entries[key] = resource;
+	}
+
+	ResourceStats stats()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		ResourceStats stats;
+		stats.hits = _hits;
+		stats.misses = _misses;
+		std::unordered_set<const T*> counted;
+		for (auto it = _entries.begin(); it != _entries.end();)
+		{
+			std::shared_ptr<T> resource = it->second.lock();
+			if (!resource)
+			{
+				it = _entries.erase(it);
+				continue;
+			}
+			if (counted.insert(resource.get()).second)
+			{
+				stats.count++;
+				stats.bytes += resource->memoryBytes();
+			}
+			++it;
+		}
+		return stats;
+	}
+
+private:
+	std::shared_ptr<T> findLocked(const std::string& key)
+	{
+		auto it = _entries.find(key);
+		if (it != _entries.end())
+		{
+			std::shared_ptr<T> resource = it->second.lock();
+			if (resource)
+			{
+				_hits++;
+				return resource;
+			}
+			_entries.erase(it);
+		}
+		_misses++;
+		return nullptr;
+	}
+
+	std::mutex _mutex;
+	std::unordered_map<std::string, std::weak_ptr<T>> _entries;
+	size_t _hits = 0;
+	size_t _misses = 0;
+};
+
+#endif
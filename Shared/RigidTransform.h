@@ -0,0 +1,181 @@
+#ifndef RIGID_TRANSFORM_H
+#define RIGID_TRANSFORM_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RIGID_TRANSFORM_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// A pose without scale or shear: a unit quaternion rotation, then a translation. It is
+// 28 bytes where a mat4 is 64, and composing, inverting and moving a point take a
+// fraction of the general matrix math. Poses stay in this form from tracking through
+// the wire and the simulation; toMat4 is for handing a model or view matrix to GL.
+//
+// The SSE2 and the scalar code round the same operations in the same order, so both
+// give the same bits and the simulation stays deterministic (see Deterministic.h).
+struct RigidTransform
+{
+	glm::quat rotation;
+	glm::vec3 translation;
+
+	RigidTransform() : rotation(1, 0, 0, 0), translation(0) {}
+	RigidTransform(const glm::quat& rotation, const glm::vec3& translation) : rotation(rotation), translation(translation) {}
+	explicit RigidTransform(const glm::quat& rotation) : rotation(rotation), translation(0) {}
+	explicit RigidTransform(const glm::vec3& translation) : rotation(1, 0, 0, 0), translation(translation) {}
+
+	// other first, then this: other's frame into this one's parent
+	RigidTransform operator*(const RigidTransform& other) const;
+	RigidTransform inverse() const;
+
+	glm::vec3 transformPoint(const glm::vec3& p) const;
+	glm::vec3 transformVector(const glm::vec3& v) const;
+
+	glm::mat4 toMat4() const;
+
+	bool operator==(const RigidTransform& other) const { return rotation == other.rotation && translation == other.translation; }
+	bool operator!=(const RigidTransform& other) const { return !(*this == other); }
+};
+
+#ifdef RIGID_TRANSFORM_SSE2
+
+namespace rigid_sse2
+{
+	inline __m128 load(const glm::quat& q) { return _mm_setr_ps(q.x, q.y, q.z, q.w); }
+	inline __m128 load(const glm::vec3& v) { return _mm_setr_ps(v.x, v.y, v.z, 0.0f); }
+
+	inline glm::quat storeQuat(__m128 q)
+	{
+		alignas(16) float r[4];
+		_mm_store_ps(r, q);
+		return glm::quat(r[3], r[0], r[1], r[2]);
+	}
+
+	inline glm::vec3 storeVec3(__m128 v)
+	{
+		alignas(16) float r[4];
+		_mm_store_ps(r, v);
+		return glm::vec3(r[0], r[1], r[2]);
+	}
+
+	inline __m128 signs(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+
+	// a.yzx * b.zxy - a.zxy * b.yzx, w ends up 0
+	inline __m128 cross(__m128 a, __m128 b)
+	{
+		__m128 aYzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+		__m128 bZxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+		__m128 aZxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+		__m128 bYzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		return _mm_sub_ps(_mm_mul_ps(aYzx, bZxy), _mm_mul_ps(aZxy, bYzx));
+	}
+
+	// v + w t + u x t with t = 2 (u x v), u the vector part of q
+	inline __m128 rotate(__m128 q, __m128 v)
+	{
+		__m128 u = _mm_and_ps(q, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)));
+		__m128 w = _mm_shuffle_ps(q, q, _MM_SHUFFLE(3, 3, 3, 3));
+		__m128 t = cross(u, v);
+		t = _mm_add_ps(t, t);
+		return _mm_add_ps(_mm_add_ps(v, _mm_mul_ps(w, t)), cross(u, t));
+	}
+
+	// in lanes x y z w: a.w b + a.x (b.w, -b.z, b.y, -b.x) + a.y (b.z, b.w, -b.x, -b.y)
+	// + a.z (-b.y, b.x, b.w, -b.z); the flipped signs are exact
+	inline __m128 multiply(__m128 a, __m128 b)
+	{
+		__m128 r = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)),
+			_mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 2, 3)), signs(1, -1, 1, -1))));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)),
+			_mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2)), signs(1, 1, -1, -1))));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)),
+			_mm_mul_ps(_mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1)), signs(-1, 1, 1, -1))));
+		return r;
+	}
+}
+
+inline RigidTransform RigidTransform::operator*(const RigidTransform& other) const
+{
+	__m128 q = rigid_sse2::load(rotation);
+	__m128 t = _mm_add_ps(rigid_sse2::rotate(q, rigid_sse2::load(other.translation)), rigid_sse2::load(translation));
+	return RigidTransform(rigid_sse2::storeQuat(rigid_sse2::multiply(q, rigid_sse2::load(other.rotation))), rigid_sse2::storeVec3(t));
+}
+
+inline RigidTransform RigidTransform::inverse() const
+{
+	__m128 conjugate = _mm_mul_ps(rigid_sse2::load(rotation), rigid_sse2::signs(-1, -1, -1, 1));
+	__m128 t = _mm_mul_ps(rigid_sse2::rotate(conjugate, rigid_sse2::load(translation)), rigid_sse2::signs(-1, -1, -1, -1));
+	return RigidTransform(rigid_sse2::storeQuat(conjugate), rigid_sse2::storeVec3(t));
+}
+
+inline glm::vec3 RigidTransform::transformPoint(const glm::vec3& p) const
+{
+	return rigid_sse2::storeVec3(_mm_add_ps(rigid_sse2::rotate(rigid_sse2::load(rotation), rigid_sse2::load(p)), rigid_sse2::load(translation)));
+}
+
+inline glm::vec3 RigidTransform::transformVector(const glm::vec3& v) const
+{
+	return rigid_sse2::storeVec3(rigid_sse2::rotate(rigid_sse2::load(rotation), rigid_sse2::load(v)));
+}
+
+#else
+
+namespace rigid_scalar
+{
+	inline glm::vec3 cross(const glm::vec3& a, const glm::vec3& b)
+	{
+		return glm::vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	inline glm::vec3 rotate(const glm::quat& q, const glm::vec3& v)
+	{
+		glm::vec3 u(q.x, q.y, q.z);
+		glm::vec3 t = rigid_scalar::cross(u, v);
+		t = t + t;
+		return (v + q.w * t) + rigid_scalar::cross(u, t);
+	}
+
+	inline glm::quat multiply(const glm::quat& a, const glm::quat& b)
+	{
+		return glm::quat(
+			((a.w * b.w - a.x * b.x) - a.y * b.y) - a.z * b.z,
+			((a.w * b.x + a.x * b.w) + a.y * b.z) - a.z * b.y,
+			((a.w * b.y - a.x * b.z) + a.y * b.w) + a.z * b.x,
+			((a.w * b.z + a.x * b.y) - a.y * b.x) + a.z * b.w);
+	}
+}
+
+inline RigidTransform RigidTransform::operator*(const RigidTransform& other) const
+{
+	return RigidTransform(rigid_scalar::multiply(rotation, other.rotation), rigid_scalar::rotate(rotation, other.translation) + translation);
+}
+
+inline RigidTransform RigidTransform::inverse() const
+{
+	glm::quat conjugate(rotation.w, -rotation.x, -rotation.y, -rotation.z);
+	return RigidTransform(conjugate, -rigid_scalar::rotate(conjugate, translation));
+}
+
+inline glm::vec3 RigidTransform::transformPoint(const glm::vec3& p) const
+{
+	return rigid_scalar::rotate(rotation, p) + translation;
+}
+
+inline glm::vec3 RigidTransform::transformVector(const glm::vec3& v) const
+{
+	return rigid_scalar::rotate(rotation, v);
+}
+
+#endif
+
+inline glm::mat4 RigidTransform::toMat4() const
+{
+	glm::mat4 m = glm::mat4_cast(rotation);
+	m[3] = glm::vec4(translation, 1.0f);
+	return m;
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include "ShaderCompiler.h"
+
+#include <chrono>
+#include <iostream>
+
+#define GLFW_INCLUDE_GLEXT
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#else
+#include <GL/glew.h>
+#endif
+#include <GLFW/glfw3.h>
+
+#include "shader.h"
+
+ShaderCompiler shaderCompiler;
+
+ShaderCompiler::~ShaderCompiler()
+{
+	stop();
+}
+
+bool ShaderCompiler::start(GLFWwindow* share)
+{
+	stop();
+
+	// the window hints of the render window still apply, so both contexts match
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	_context = glfwCreateWindow(1, 1, "shader compiler", nullptr, share);
+	if (!_context)
+	{
+		std::cout << "Shader compiler: no shared context, linking programs on the render thread" << std::endl;
+		return false;
+	}
+	glfwMakeContextCurrent(share);
+
+	_stopping = false;
+	_worker = std::thread(&ShaderCompiler::workerMain, this);
+	return true;
+}
+
+void ShaderCompiler::stop()
+{
+	if (!_worker.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+		for (Job& job : _queue)
+			job.program.set_value(0);
+		_queue.clear();
+	}
+	_jobReady.notify_all();
+	_worker.join();
+	glfwDestroyWindow(_context);
+	_context = nullptr;
+}
+
+std::shared_future<unsigned int> ShaderCompiler::compile(const std::string& vertexPath, const std::string& fragmentPath)
+{
+	Job job;
+	job.vertexPath = vertexPath;
+	job.fragmentPath = fragmentPath;
+	std::shared_future<unsigned int> program = job.program.get_future().share();
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_worker.joinable() && !_stopping)
+		{
+			_queue.push_back(std::move(job));
+			_jobReady.notify_one();
+			return program;
+		}
+	}
+	job.program.set_value(LoadShaders(vertexPath.c_str(), fragmentPath.c_str()));
+	return program;
+}
+
+void ShaderCompiler::finishAll()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this] { return _queue.empty() && !_busy; });
+}
+
+void ShaderCompiler::workerMain()
+{
+	glfwMakeContextCurrent(_context);
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true)
+	{
+		_jobReady.wait(lock, [this] { return _stopping || !_queue.empty(); });
+		if (_stopping)
+			break;
+
+		Job job = std::move(_queue.front());
+		_queue.pop_front();
+		_busy = true;
+
+		lock.unlock();
+		GLuint program = LoadShaders(job.vertexPath.c_str(), job.fragmentPath.c_str());
+		// the render context only sees what this one has finished
+		glFinish();
+		job.program.set_value(program);
+		lock.lock();
+
+		_busy = false;
+		_idle.notify_all();
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
+
+bool PendingProgram::ready()
+{
+	if (!_resolved && _program.valid() && _program.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		get();
+	return _resolved;
+}
+
+unsigned int PendingProgram::get()
+{
+	if (!_resolved && _program.valid())
+	{
+		_id = _program.get();
+		_resolved = true;
+	}
+	return _id;
+}
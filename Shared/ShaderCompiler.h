@@ -0,0 +1,83 @@
+#ifndef SHADER_COMPILER_H
+#define SHADER_COMPILER_H
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct GLFWwindow;
+
+// Links shader programs (LoadShaders, so through the program cache) on a worker
+// thread with a hidden context of its own, shared with the render context. Program
+// names are shared between the two contexts; the worker finishes its GL commands
+// before handing a program over, and the render thread's glUseProgram then sees it
+// fully linked.
+//
+// Without a worker (start() not called or failed) compile() links on the calling
+// thread, as LoadShaders always did.
+class ShaderCompiler
+{
+public:
+	ShaderCompiler() {}
+	~ShaderCompiler();
+
+	ShaderCompiler(const ShaderCompiler&) = delete;
+	ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+	// Main thread (GLFW creates windows there only), with share's context current.
+	// Leaves share's context current again.
+	bool start(GLFWwindow* share);
+
+	// Main thread: drops queued programs (they resolve to 0), waits for the one being
+	// linked and destroys the hidden context; programs already linked stay valid
+	void stop();
+
+	// Any thread. The future holds the program, 0 if its sources can't be read.
+	std::shared_future<unsigned int> compile(const std::string& vertexPath, const std::string& fragmentPath);
+
+	// blocks until every program submitted so far is linked
+	void finishAll();
+
+private:
+	void workerMain();
+
+	struct Job {
+		std::string vertexPath;
+		std::string fragmentPath;
+		std::promise<unsigned int> program;
+	};
+
+	GLFWwindow* _context = nullptr;
+	std::thread _worker;
+	bool _stopping = false;
+	std::mutex _mutex;
+	std::condition_variable _jobReady;	// wakes the worker
+	std::condition_variable _idle;		// wakes finishAll
+	std::deque<Job> _queue;
+	bool _busy = false;
+};
+
+// A program on its way from the ShaderCompiler; holds its name once linked
+class PendingProgram
+{
+public:
+	PendingProgram() {}
+	PendingProgram(std::shared_future<unsigned int> program) : _program(program) {}
+
+	// without blocking, false while the program is still being linked
+	bool ready();
+	// blocks until linked on the first call
+	unsigned int get();
+
+private:
+	std::shared_future<unsigned int> _program;
+	unsigned int _id = 0;
+	bool _resolved = false;
+};
+
+extern ShaderCompiler shaderCompiler;
+
+#endif
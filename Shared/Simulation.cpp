@@ -0,0 +1,164 @@
+#include "Deterministic.h"
+#include "Simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// by weapon id: axes, maces, swords, each player's on its own side of the arena
+	const glm::vec3 WEAPON_SPAWNS[WEAPONS] = {
+		glm::vec3(0.7f, 0.0f, 0.0f), glm::vec3(-0.7f, 0.0f, 0.0f),
+		glm::vec3(0.7f, 0.1f, -0.2f), glm::vec3(-0.7f, 0.1f, -0.2f),
+		glm::vec3(0.7f, 0.1f, 0.2f), glm::vec3(-0.7f, 0.1f, 0.2f)
+	};
+
+	void hash(uint64_t& h, const void* data, size_t bytes)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < bytes; i++)
+		{
+			h ^= p[i];
+			h *= 1099511628211ULL;
+		}
+	}
+}
+
+Simulation::Simulation()
+{
+	spawnWeapons(world, WEAPON_SPAWNS, weapons);
+	for (int i = 0; i < PLAYERS; i++)
+	{
+		heads[i] = spawnPlayer(world);
+		_held[i] = -1;
+	}
+}
+
+void Simulation::applyInput(int player, const PlayerInfo& input)
+{
+	world.transforms.position[world.transforms.slot(heads[player])] = input.headInWorld.translation;
+	releaseWeapons(world, player);
+	_held[player] = input.heldWeapon >= 0 && input.heldWeapon < WEAPONS ? input.heldWeapon : -1;
+	if (_held[player] >= 0)
+		holdWeapon(world, weapons[_held[player]], player, input.rhandInWorld);
+}
+
+SimulationEvents Simulation::step(int player, const PlayerInfo& input)
+{
+	SimulationEvents events;
+	applyInput(player, input);
+	// a handful of colliders, too few for jobs to pay; the server steps it in its push handler
+	updateColliders(world);
+	WeaponContacts contacts = collideWeapons(world, heads);
+
+	// 1P first, as the server always checked
+	for (int p = 0; p < PLAYERS; p++)
+	{
+		if (contacts.hit[p] && _dead[0] == 0 && _dead[1] == 0)
+		{
+			_dead[p] = 1;
+			_dead[1 - p] = -1;
+			events.died[p] = true;
+		}
+	}
+
+	if (contacts.clash)
+		clash(_held[0], _held[1], events);
+	return events;
+}
+
+int Simulation::grab(int player, const glm::vec3& hand) const
+{
+	int grabbed = -1;
+	for (int type = 0; type < WEAPON_TYPES; type++)
+	{
+		int id = weaponId((WeaponType)type, player);
+		glm::vec3 d = hand - gripPosition(world, weapons[id]);
+		if (glm::dot(d, d) < GRAB_DISTANCE * GRAB_DISTANCE)
+			grabbed = id;
+	}
+	return grabbed;
+}
+
+void Simulation::breakWeapon(int weapon, SimulationEvents& events)
+{
+	if (!_broken[weapon])
+		events.broke[weapon] = true;
+	_broken[weapon] = true;
+}
+
+// the same types break each other; otherwise the sword beats the axe, the mace the
+// sword and the axe the mace
+void Simulation::clash(int weapon1, int weapon2, SimulationEvents& events)
+{
+	if (weapon1 == -1 || weapon2 == -1)
+		return;
+	int type1 = weaponType(weapon1);
+	int type2 = weaponType(weapon2);
+	if (type1 == type2)
+	{
+		breakWeapon(weapon1, events);
+		breakWeapon(weapon2, events);
+	}
+	else if (type1 > type2)
+		breakWeapon(type1 - type2 == 2 ? weapon2 : weapon1, events);
+	else
+		breakWeapon(type2 - type1 == 2 ? weapon1 : weapon2, events);
+}
+
+uint64_t Simulation::checksum() const
+{
+	uint64_t h = 14695981039346656037ULL;
+	hash(h, world.transforms.position.data(), world.transforms.position.size() * sizeof(glm::vec3));
+	for (const glm::quat& q : world.transforms.rotation)
+	{
+		const float xyzw[4] = { q.x, q.y, q.z, q.w };
+		hash(h, xyzw, sizeof(xyzw));
+	}
+	hash(h, world.colliders.worldCenter.data(), world.colliders.worldCenter.size() * sizeof(glm::vec3));
+	hash(h, world.holders.heldBy.data(), world.holders.heldBy.size() * sizeof(int));
+	hash(h, _held, sizeof(_held));
+	hash(h, _broken, sizeof(_broken));
+	hash(h, _dead, sizeof(_dead));
+	return h;
+}
+
+uint64_t benchmarkSimulation(int ticks)
+{
+	Simulation sim;
+
+	// the players take turns like their pushes reach the server: head on their side,
+	// the right hand swinging at the other head and back, a new weapon every swing or two
+	PlayerInfo inputs[PLAYERS];
+	// 2P faces 1P, half a turn around y
+	const glm::quat hands[PLAYERS] = { glm::quat(1, 0, 0, 0), glm::quat(0, 0, 1, 0) };
+	const int SWING = 240;
+	int breaks = 0, deaths = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int tick = 0; tick < ticks; tick++)
+	{
+		int p = tick % PLAYERS;
+		float side = p == 0 ? 1.0f : -1.0f;
+		int phase = (tick / PLAYERS) % SWING;
+		float reach = (phase < SWING / 2 ? phase : SWING - phase) / (float)(SWING / 2);
+
+		PlayerInfo& input = inputs[p];
+		input.headInWorld = RigidTransform(glm::vec3(side * 0.5f, 0, 0));
+		input.rhandInWorld = RigidTransform(hands[p], glm::vec3(side * (0.45f - 0.9f * reach), -0.25f, side * 0.15f));
+		input.heldWeapon = weaponId((WeaponType)((tick / (PLAYERS * SWING) + p) % WEAPON_TYPES), p);
+
+		SimulationEvents events = sim.step(p, input);
+		for (int i = 0; i < WEAPONS; i++)
+			breaks += events.broke[i];
+		for (int i = 0; i < PLAYERS; i++)
+			deaths += events.died[i];
+	}
+	double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / std::max(ticks, 1);
+
+	std::cout << "Simulation: " << ticks << " ticks, " << us << " us per tick, " << breaks << " weapon(s) broken, "
+		<< deaths << " death(s), checksum " << std::hex << sim.checksum() << std::dec << std::endl;
+	return sim.checksum();
+}
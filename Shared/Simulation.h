@@ -0,0 +1,63 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <cstdint>
+#include "PlayerInfo.h"
+#include "Weapons.h"
+
+// what one step changed
+struct SimulationEvents {
+	bool broke[WEAPONS] = {};
+	bool died[PLAYERS] = {};
+};
+
+// The fight as the server decides it and the clients show it: where the weapons lie,
+// who holds which, the heads they hit and the rules of clashes. It needs neither GL
+// nor OVR, and steps the same bit for bit on every build (see Deterministic.h), so a
+// client can run it ahead of the server and a recorded input sequence replays exactly.
+// Players are 0 and 1 here, 1P and 2P on the wire.
+class Simulation
+{
+public:
+	Simulation();
+
+	// moves the player's head and puts the weapon the input holds, if any, in its right hand
+	void applyInput(int player, const PlayerInfo& input);
+	// applyInput, then the hits and clashes it causes
+	SimulationEvents step(int player, const PlayerInfo& input);
+
+	// the player's weapon with its grip within reach of the hand, -1 for none; where
+	// grips overlap, the later type wins
+	int grab(int player, const glm::vec3& hand) const;
+
+	bool broken(int weapon) const { return _broken[weapon]; }
+	// as PlayerInfo::dead: 1 dead, -1 won, 0 still fighting; the first death is final
+	int dead(int player) const { return _dead[player]; }
+	// the weapon id the player holds, -1 for none
+	int held(int player) const { return _held[player]; }
+
+	// FNV-1a over the state, to compare two runs or two builds; quaternions go in x y z w
+	// order whatever layout the glm version stores them in
+	uint64_t checksum() const;
+
+	World world;
+	Entity weapons[WEAPONS];
+	Entity heads[PLAYERS];
+
+private:
+	void breakWeapon(int weapon, SimulationEvents& events);
+	void clash(int weapon1, int weapon2, SimulationEvents& events);
+
+	int _held[PLAYERS];
+	bool _broken[WEAPONS] = {};
+	int _dead[PLAYERS] = {};
+};
+
+// how far from the grip a hand picks a weapon up
+const float GRAB_DISTANCE = 0.04f;
+
+// Steps a scripted fight this many ticks, both players swinging every weapon in turn,
+// prints the ticks per second and returns the checksum, which every build must agree on
+uint64_t benchmarkSimulation(int ticks);
+
+#endif
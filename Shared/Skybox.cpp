@@ -9,6 +9,10 @@ Skybox::Skybox(const std::string dir) : TexturedCube(dir)
 {
 }
 
+Skybox::Skybox(AssetManager& assets, const std::string dir) : TexturedCube(assets, dir)
+{
+}
+
 Skybox::~Skybox()
 {
 }
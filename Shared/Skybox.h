@@ -9,6 +9,7 @@ class Skybox : public TexturedCube
 public:
 
   Skybox(const std::string dir);
+  Skybox(AssetManager& assets, const std::string dir);
   ~Skybox();
 
   void draw(unsigned int skyboxShader, const glm::mat4& p, const glm::mat4& v);
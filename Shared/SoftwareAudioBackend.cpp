@@ -0,0 +1,592 @@
+#include "SoftwareAudioBackend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_MIX_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include "AssetArchive.h"
+
+namespace {
+	const int CHANNEL_INDEX_BITS = 8;
+	const uint16_t WAV_FORMAT_PCM = 1;
+	const uint16_t WAV_FORMAT_FLOAT = 3;
+	const uint16_t WAV_FORMAT_EXTENSIBLE = 0xfffe;
+
+	int ChannelId(unsigned int generation, int index)
+	{
+		return (int)(((generation & 0xffffff) << CHANNEL_INDEX_BITS) | (unsigned int)index);
+	}
+
+	uint16_t readU16(const unsigned char* p) { return (uint16_t)(p[0] | p[1] << 8); }
+	uint32_t readU32(const unsigned char* p) { return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24; }
+	void writeU16(unsigned char* p, uint16_t v) { p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); }
+	void writeU32(unsigned char* p, uint32_t v) { writeU16(p, (uint16_t)v); writeU16(p + 2, (uint16_t)(v >> 16)); }
+
+	// the 44 byte header of a 16 bit PCM WAV
+	void wavHeader(unsigned char header[44], size_t frames, int channels, int rate)
+	{
+		uint32_t dataSize = (uint32_t)(frames * channels * sizeof(int16_t));
+		memcpy(header, "RIFF", 4);
+		writeU32(header + 4, 36 + dataSize);
+		memcpy(header + 8, "WAVEfmt ", 8);
+		writeU32(header + 16, 16);
+		writeU16(header + 20, WAV_FORMAT_PCM);
+		writeU16(header + 22, (uint16_t)channels);
+		writeU32(header + 24, (uint32_t)rate);
+		writeU32(header + 28, (uint32_t)(rate * channels * sizeof(int16_t)));
+		writeU16(header + 32, (uint16_t)(channels * sizeof(int16_t)));
+		writeU16(header + 34, 16);
+		memcpy(header + 36, "data", 4);
+		writeU32(header + 40, dataSize);
+	}
+
+	// PCM 8/16/24/32 bit or float to interleaved floats
+	bool decodeWav(const std::string& path, const unsigned char* data, size_t size,
+		std::vector<float>& samples, int& channels, int& rate)
+	{
+		if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+		{
+			std::cout << "Software audio: " << path << " is not a WAV file" << std::endl;
+			return false;
+		}
+		uint16_t format = 0;
+		int bits = 0;
+		channels = 0;
+		rate = 0;
+		const unsigned char* pcm = nullptr;
+		size_t pcmSize = 0;
+		for (size_t offset = 12; offset + 8 <= size;)
+		{
+			const unsigned char* chunk = data + offset;
+			size_t chunkSize = readU32(chunk + 4);
+			if (chunkSize > size - offset - 8)
+				chunkSize = size - offset - 8;
+			if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16)
+			{
+				format = readU16(chunk + 8);
+				channels = readU16(chunk + 10);
+				rate = (int)readU32(chunk + 12);
+				bits = readU16(chunk + 22);
+				// the sub format GUID starts with the plain format tag
+				if (format == WAV_FORMAT_EXTENSIBLE && chunkSize >= 26)
+					format = readU16(chunk + 32);
+			}
+			else if (memcmp(chunk, "data", 4) == 0)
+			{
+				pcm = chunk + 8;
+				pcmSize = chunkSize;
+			}
+			// chunks are padded to an even size
+			offset += 8 + chunkSize + (chunkSize & 1);
+		}
+
+		bool supported = (format == WAV_FORMAT_PCM && (bits == 8 || bits == 16 || bits == 24 || bits == 32))
+			|| (format == WAV_FORMAT_FLOAT && bits == 32);
+		if (!pcm || !supported || channels <= 0 || rate <= 0)
+		{
+			std::cout << "Software audio: " << path << " is corrupt or not PCM" << std::endl;
+			return false;
+		}
+
+		int bytes = bits / 8;
+		size_t count = pcmSize / bytes / channels * channels;
+		samples.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			const unsigned char* p = pcm + i * bytes;
+			if (format == WAV_FORMAT_FLOAT)
+			{
+				float value;
+				memcpy(&value, p, sizeof(value));
+				samples[i] = value;
+			}
+			else if (bits == 8)
+				samples[i] = (p[0] - 128) / 128.0f;
+			else if (bits == 16)
+				samples[i] = (int16_t)readU16(p) / 32768.0f;
+			else if (bits == 24)
+				samples[i] = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) / 2147483648.0f;
+			else
+				samples[i] = (int32_t)readU32(p) / 2147483648.0f;
+		}
+		return true;
+	}
+
+	void mixMonoScalar(float* out, const float* in, size_t frames, float left, float right)
+	{
+		for (size_t i = 0; i < frames; i++)
+		{
+			out[2 * i] += in[i] * left;
+			out[2 * i + 1] += in[i] * right;
+		}
+	}
+
+	void mixStereoScalar(float* out, const float* in, size_t frames, float left, float right)
+	{
+		for (size_t i = 0; i < frames; i++)
+		{
+			out[2 * i] += in[2 * i] * left;
+			out[2 * i + 1] += in[2 * i + 1] * right;
+		}
+	}
+
+#ifdef SOFTWARE_MIX_SSE2
+	// four mono samples become two stereo pairs per register
+	void mixMonoSse2(float* out, const float* in, size_t frames, float left, float right)
+	{
+		__m128 gain = _mm_setr_ps(left, right, left, right);
+		size_t i = 0;
+		for (; i + 4 <= frames; i += 4)
+		{
+			__m128 s = _mm_loadu_ps(in + i);
+			__m128 lo = _mm_mul_ps(_mm_unpacklo_ps(s, s), gain);
+			__m128 hi = _mm_mul_ps(_mm_unpackhi_ps(s, s), gain);
+			_mm_storeu_ps(out + 2 * i, _mm_add_ps(_mm_loadu_ps(out + 2 * i), lo));
+			_mm_storeu_ps(out + 2 * i + 4, _mm_add_ps(_mm_loadu_ps(out + 2 * i + 4), hi));
+		}
+		mixMonoScalar(out + 2 * i, in + i, frames - i, left, right);
+	}
+
+	void mixStereoSse2(float* out, const float* in, size_t frames, float left, float right)
+	{
+		__m128 gain = _mm_setr_ps(left, right, left, right);
+		size_t i = 0;
+		for (; i + 4 <= frames; i += 4)
+		{
+			__m128 a = _mm_mul_ps(_mm_loadu_ps(in + 2 * i), gain);
+			__m128 b = _mm_mul_ps(_mm_loadu_ps(in + 2 * i + 4), gain);
+			_mm_storeu_ps(out + 2 * i, _mm_add_ps(_mm_loadu_ps(out + 2 * i), a));
+			_mm_storeu_ps(out + 2 * i + 4, _mm_add_ps(_mm_loadu_ps(out + 2 * i + 4), b));
+		}
+		mixStereoScalar(out + 2 * i, in + 2 * i, frames - i, left, right);
+	}
+#endif
+
+	void mix(float* out, const float* in, int channels, size_t frames, float left, float right)
+	{
+#ifdef SOFTWARE_MIX_SSE2
+		if (SoftwareAudioBackend::useSimd())
+		{
+			if (channels == 1)
+				mixMonoSse2(out, in, frames, left, right);
+			else
+				mixStereoSse2(out, in, frames, left, right);
+			return;
+		}
+#endif
+		if (channels == 1)
+			mixMonoScalar(out, in, frames, left, right);
+		else
+			mixStereoScalar(out, in, frames, left, right);
+	}
+
+	int16_t toPcm16(float sample)
+	{
+		sample = sample < -1.0f ? -1.0f : (sample > 1.0f ? 1.0f : sample);
+		return (int16_t)lrintf(sample * 32767.0f);
+	}
+}
+
+std::string decodedSoundPath(const std::string& path)
+{
+	return path + ".wav";
+}
+
+bool writeWavFile(const std::string& path, const int16_t* samples, size_t frames, int channels, int rate)
+{
+	unsigned char header[44];
+	wavHeader(header, frames, channels, rate);
+
+	// write next to the target and rename, so a half written file is never picked up
+	std::string tmpPath = path + ".tmp";
+	FILE* file = fopen(tmpPath.c_str(), "wb");
+	if (!file)
+	{
+		std::cout << "WAV: cannot write " << tmpPath << std::endl;
+		return false;
+	}
+	size_t count = frames * channels;
+	bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header)
+		&& fwrite(samples, sizeof(int16_t), count, file) == count;
+	ok = (fclose(file) == 0) && ok;
+	if (ok)
+	{
+		remove(path.c_str());
+		ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+	}
+	if (!ok)
+		remove(tmpPath.c_str());
+	return ok;
+}
+
+bool& SoftwareAudioBackend::useSimd()
+{
+#ifdef SOFTWARE_MIX_SSE2
+	static bool use = true;
+#else
+	static bool use = false;
+#endif
+	return use;
+}
+
+SoftwareAudioBackend::SoftwareAudioBackend(int maxChannels)
+	: _listenerPosition(0.0f), _listenerRight(1.0f, 0.0f, 0.0f)
+{
+	_channels.resize(std::min(maxChannels, 1 << CHANNEL_INDEX_BITS));
+}
+
+SoftwareAudioBackend::~SoftwareAudioBackend()
+{
+	finishCapture();
+}
+
+int SoftwareAudioBackend::createSound(const std::string& name, bool b3d, bool bLooping, SoundCache cache)
+{
+	bool wav = name.size() > 4 && name.compare(name.size() - 4, 4, ".wav") == 0;
+	std::string path = wav ? name : decodedSoundPath(name);
+	AssetFile file;
+	if (!file.open(path))
+	{
+		std::cout << "Software audio: " << path << " is missing, --cook decodes " << name << std::endl;
+		return -1;
+	}
+	std::vector<float> samples;
+	int channels = 0;
+	int rate = 0;
+	if (!decodeWav(path, file.data(), file.size(), samples, channels, rate))
+		return -1;
+	return createSoundFromPcm(samples.data(), samples.size() / channels, channels, rate, b3d, bLooping);
+}
+
+int SoftwareAudioBackend::createSoundFromPcm(const float* samples, size_t frames, int channels, int rate, bool b3d, bool bLooping)
+{
+	if (frames == 0 || channels <= 0 || rate <= 0)
+		return -1;
+
+	// 3D sounds are panned as a point, so they are mono; 2D sounds keep up to two channels
+	Sound sound;
+	sound.channels = (b3d || channels == 1) ? 1 : 2;
+	sound.b3d = b3d;
+	sound.looping = bLooping;
+	std::vector<float> downmixed(frames * sound.channels);
+	for (size_t i = 0; i < frames; i++)
+	{
+		const float* frame = samples + i * channels;
+		if (sound.channels == 1)
+		{
+			float sum = 0.0f;
+			for (int c = 0; c < channels; c++)
+				sum += frame[c];
+			downmixed[i] = sum / channels;
+		}
+		else
+		{
+			downmixed[2 * i] = frame[0];
+			downmixed[2 * i + 1] = frame[1];
+		}
+	}
+
+	// linear interpolation to the mix rate
+	if (rate == SOFTWARE_MIX_RATE)
+	{
+		sound.samples.swap(downmixed);
+		sound.frames = frames;
+	}
+	else
+	{
+		sound.frames = std::max<size_t>(1, (size_t)((double)frames * SOFTWARE_MIX_RATE / rate));
+		sound.samples.resize(sound.frames * sound.channels);
+		double step = (double)rate / SOFTWARE_MIX_RATE;
+		for (size_t i = 0; i < sound.frames; i++)
+		{
+			double source = i * step;
+			size_t a = std::min((size_t)source, frames - 1);
+			size_t b = std::min(a + 1, frames - 1);
+			float t = (float)(source - a);
+			for (int c = 0; c < sound.channels; c++)
+			{
+				float sa = downmixed[a * sound.channels + c];
+				float sb = downmixed[b * sound.channels + c];
+				sound.samples[i * sound.channels + c] = sa + (sb - sa) * t;
+			}
+		}
+	}
+
+	_sounds.push_back(std::move(sound));
+	return (int)_sounds.size() - 1;
+}
+
+void SoftwareAudioBackend::releaseSound(int sound)
+{
+	if (sound < 0 || sound >= (int)_sounds.size())
+		return;
+	for (Channel& channel : _channels)
+		if (channel.sound == sound)
+			freeChannel(channel);
+	_sounds[sound] = Sound();
+}
+
+unsigned int SoftwareAudioBackend::soundLengthMs(int sound) const
+{
+	if (sound < 0 || sound >= (int)_sounds.size())
+		return 0;
+	return (unsigned int)((uint64_t)_sounds[sound].frames * 1000 / SOFTWARE_MIX_RATE);
+}
+
+size_t SoftwareAudioBackend::soundMemoryBytes(int sound) const
+{
+	if (sound < 0 || sound >= (int)_sounds.size())
+		return 0;
+	return _sounds[sound].samples.size() * sizeof(float);
+}
+
+SoftwareAudioBackend::Channel* SoftwareAudioBackend::findChannel(int channel)
+{
+	if (channel < 0)
+		return nullptr;
+	int index = channel & ((1 << CHANNEL_INDEX_BITS) - 1);
+	if (index >= (int)_channels.size())
+		return nullptr;
+	Channel& slot = _channels[index];
+	if (slot.sound < 0 || ChannelId(slot.generation, index) != channel)
+		return nullptr;
+	return &slot;
+}
+
+void SoftwareAudioBackend::freeChannel(Channel& channel)
+{
+	channel.sound = -1;
+	channel.generation++;
+}
+
+int SoftwareAudioBackend::play(int sound, const glm::vec3& position, float volume, unsigned int positionMs)
+{
+	if (sound < 0 || sound >= (int)_sounds.size() || _sounds[sound].frames == 0)
+		return -1;
+	for (size_t i = 0; i < _channels.size(); i++)
+	{
+		Channel& channel = _channels[i];
+		if (channel.sound >= 0)
+			continue;
+		const Sound& s = _sounds[sound];
+		size_t frame = (size_t)((uint64_t)positionMs * SOFTWARE_MIX_RATE / 1000);
+		if (frame >= s.frames)
+		{
+			if (!s.looping)
+				return -1;
+			frame %= s.frames;
+		}
+		channel.sound = sound;
+		channel.frame = frame;
+		channel.position = position;
+		channel.volume = volume;
+		return ChannelId(channel.generation, (int)i);
+	}
+	return -1;
+}
+
+bool SoftwareAudioBackend::isPlaying(int channel)
+{
+	return findChannel(channel) != nullptr;
+}
+
+void SoftwareAudioBackend::stop(int channel)
+{
+	Channel* slot = findChannel(channel);
+	if (slot)
+		freeChannel(*slot);
+}
+
+void SoftwareAudioBackend::setPosition(int channel, const glm::vec3& position)
+{
+	Channel* slot = findChannel(channel);
+	if (slot)
+		slot->position = position;
+}
+
+void SoftwareAudioBackend::setVolume(int channel, float volume)
+{
+	Channel* slot = findChannel(channel);
+	if (slot)
+		slot->volume = volume;
+}
+
+void SoftwareAudioBackend::setListener(const glm::vec3& position, const glm::vec3& look, const glm::vec3& up)
+{
+	_listenerPosition = position;
+	glm::vec3 right = glm::cross(look, up);
+	float length = glm::length(right);
+	if (length > 1e-6f)
+		_listenerRight = right / length;
+}
+
+int SoftwareAudioBackend::playingChannels() const
+{
+	int playing = 0;
+	for (const Channel& channel : _channels)
+		playing += channel.sound >= 0 ? 1 : 0;
+	return playing;
+}
+
+void SoftwareAudioBackend::gains(const Channel& channel, float& left, float& right) const
+{
+	if (!_sounds[channel.sound].b3d)
+	{
+		left = right = channel.volume;
+		return;
+	}
+	glm::vec3 offset = channel.position - _listenerPosition;
+	float distance = glm::length(offset);
+	float attenuation = channel.volume / std::max(distance, 1.0f);
+	// -1 hard left .. 1 hard right, a source at the listener is centered
+	float pan = distance > 1e-4f ? glm::dot(offset, _listenerRight) / distance : 0.0f;
+	float angle = (pan + 1.0f) * 0.25f * 3.14159265f;
+	left = attenuation * cosf(angle);
+	right = attenuation * sinf(angle);
+}
+
+void SoftwareAudioBackend::render(float* out, size_t frames)
+{
+	std::fill(out, out + frames * 2, 0.0f);
+	for (size_t block = 0; block < frames; block += SOFTWARE_MIX_BLOCK)
+	{
+		size_t blockFrames = std::min<size_t>(SOFTWARE_MIX_BLOCK, frames - block);
+		for (Channel& channel : _channels)
+		{
+			if (channel.sound < 0)
+				continue;
+			const Sound& sound = _sounds[channel.sound];
+			float left, right;
+			gains(channel, left, right);
+			size_t done = 0;
+			while (done < blockFrames)
+			{
+				size_t count = std::min(blockFrames - done, sound.frames - channel.frame);
+				mix(out + 2 * (block + done), sound.samples.data() + channel.frame * sound.channels, sound.channels,
+					count, left, right);
+				done += count;
+				channel.frame += count;
+				if (channel.frame < sound.frames)
+					continue;
+				if (!sound.looping)
+				{
+					freeChannel(channel);
+					break;
+				}
+				channel.frame = 0;
+			}
+		}
+	}
+	_mixedFrames += frames;
+}
+
+void SoftwareAudioBackend::update()
+{
+	auto now = std::chrono::steady_clock::now();
+	if (!_clockStarted)
+	{
+		_clockStart = now;
+		_clockStarted = true;
+	}
+	size_t target = (size_t)(std::chrono::duration<double>(now - _clockStart).count() * SOFTWARE_MIX_RATE);
+	size_t frames = target - _clockFrames;
+	_clockFrames = target;
+	// a stall is skipped rather than caught up
+	frames = std::min<size_t>(frames, SOFTWARE_MIX_RATE / 4);
+	if (frames == 0)
+		return;
+
+	_mix.resize(frames * 2);
+	render(_mix.data(), frames);
+	if (!_capture)
+		return;
+	_pcm.resize(frames * 2);
+	for (size_t i = 0; i < frames * 2; i++)
+		_pcm[i] = toPcm16(_mix[i]);
+	if (fwrite(_pcm.data(), sizeof(int16_t), _pcm.size(), _capture) != _pcm.size())
+	{
+		std::cout << "Software audio: cannot write " << _capturePath << ", capture stopped" << std::endl;
+		finishCapture();
+		return;
+	}
+	_capturedFrames += frames;
+}
+
+bool SoftwareAudioBackend::capture(const std::string& wavPath)
+{
+	finishCapture();
+	_capture = fopen(wavPath.c_str(), "wb");
+	if (!_capture)
+	{
+		std::cout << "Software audio: cannot write " << wavPath << std::endl;
+		return false;
+	}
+	// the sizes are filled in when the capture ends
+	unsigned char header[44];
+	wavHeader(header, 0, 2, SOFTWARE_MIX_RATE);
+	fwrite(header, 1, sizeof(header), _capture);
+	_capturePath = wavPath;
+	_capturedFrames = 0;
+	return true;
+}
+
+void SoftwareAudioBackend::finishCapture()
+{
+	if (!_capture)
+		return;
+	unsigned char header[44];
+	wavHeader(header, _capturedFrames, 2, SOFTWARE_MIX_RATE);
+	fseek(_capture, 0, SEEK_SET);
+	fwrite(header, 1, sizeof(header), _capture);
+	fclose(_capture);
+	_capture = nullptr;
+	std::cout << "Captured " << _capturedFrames * 1000 / SOFTWARE_MIX_RATE << " ms of audio to " << _capturePath << std::endl;
+}
+
+void benchmarkAudioMixer(int voices, int runs)
+{
+	// a second of noise-ish tone, each voice at its own spot around the listener
+	std::vector<float> tone(SOFTWARE_MIX_RATE);
+	for (size_t i = 0; i < tone.size(); i++)
+		tone[i] = 0.25f * sinf(i * 0.0577f) + 0.05f * sinf(i * 1.37f);
+	std::vector<float> out(SOFTWARE_MIX_RATE * 2);
+
+	const bool simd = SoftwareAudioBackend::useSimd();
+	float reference = 0.0f;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		SoftwareAudioBackend::useSimd() = pass == 0 && simd;
+		SoftwareAudioBackend backend(voices);
+		int sound = backend.createSoundFromPcm(tone.data(), tone.size(), 1, SOFTWARE_MIX_RATE, true, true);
+		for (int v = 0; v < voices; v++)
+		{
+			float angle = v * 2.39996f;
+			backend.play(sound, glm::vec3(cosf(angle), 0.0f, sinf(angle)) * (1.0f + v % 8), 0.5f, (unsigned int)(v * 37 % 1000));
+		}
+
+		backend.render(out.data(), out.size() / 2);	// warm up
+		auto start = std::chrono::steady_clock::now();
+		for (int run = 0; run < runs; run++)
+			backend.render(out.data(), out.size() / 2);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+
+		// the kernels differ only in rounding, a sum shows they mixed the same thing
+		float sum = 0.0f;
+		for (float sample : out)
+			sum += fabsf(sample);
+		if (pass == 0)
+			reference = sum;
+		std::cout << "Audio mixer (" << (SoftwareAudioBackend::useSimd() ? "SSE2" : "scalar") << "): " << voices
+			<< " voices, " << ms << " ms per second of audio, " << voices * 1000.0 / ms << " voice-ms per ms";
+		if (pass == 1)
+			std::cout << ", output differs by " << fabsf(sum - reference) / std::max(reference, 1e-6f) * 100.0f << "%";
+		std::cout << std::endl;
+	}
+	SoftwareAudioBackend::useSimd() = simd;
+}
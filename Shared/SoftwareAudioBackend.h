@@ -0,0 +1,113 @@
+#ifndef SOFTWARE_AUDIO_BACKEND_H
+#define SOFTWARE_AUDIO_BACKEND_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "AudioBackend.h"
+
+const int SOFTWARE_MIX_RATE = 48000;
+const int SOFTWARE_MIX_BLOCK = 256;		// frames mixed per pass, the gains are updated in between
+
+// The PCM WAV the software mixer plays for a shipped sound; --cook decodes the MP3s
+// into these with FMOD, see decodeSoundToWav
+std::string decodedSoundPath(const std::string& path);
+// 16 bit PCM, written next to path and renamed
+bool writeWavFile(const std::string& path, const int16_t* samples, size_t frames, int channels, int rate);
+
+// A mixer in plain C++ for machines and runs without a sound device: headless
+// benchmarks, tests of the voice logic and --audio-wav captures. Sounds are decoded
+// whole when created (WAV only, resampled to SOFTWARE_MIX_RATE, 3D sounds downmixed
+// to mono), so mixing is a multiply-add per sample, SSE2 where the build has it.
+// 3D voices are attenuated by inverse distance with a 1 m minimum, as FMOD's default
+// rolloff, and panned by constant power from the listener's right vector.
+//
+// render() mixes any number of frames into memory; update() mixes the wall clock time
+// since the last update, so engine logic runs against it in real time, and appends it
+// to the capture if there is one.
+class SoftwareAudioBackend : public AudioBackend
+{
+public:
+	explicit SoftwareAudioBackend(int maxChannels);
+	~SoftwareAudioBackend() override;
+
+	const char* name() const override { return "software"; }
+
+	// opens decodedSoundPath(name), or name itself if it is a WAV; every sound is kept
+	// decompressed, whatever the cache asks for
+	int createSound(const std::string& name, bool b3d, bool bLooping, SoundCache cache) override;
+	// interleaved float PCM at any rate, 1 or 2 channels; for tests and the benchmark
+	int createSoundFromPcm(const float* samples, size_t frames, int channels, int rate, bool b3d, bool bLooping);
+	void releaseSound(int sound) override;
+	unsigned int soundLengthMs(int sound) const override;
+	size_t soundMemoryBytes(int sound) const override;
+
+	int play(int sound, const glm::vec3& position, float volume, unsigned int positionMs) override;
+	bool isPlaying(int channel) override;
+	void stop(int channel) override;
+	void setPosition(int channel, const glm::vec3& position) override;
+	void setVolume(int channel, float volume) override;
+
+	void setListener(const glm::vec3& position, const glm::vec3& look, const glm::vec3& up) override;
+	void update() override;
+
+	// interleaved stereo, frames * 2 floats, overwritten
+	void render(float* out, size_t frames);
+	// writes everything update() mixes from now on to a 16 bit WAV, until destroyed
+	bool capture(const std::string& wavPath);
+
+	size_t mixedFrames() const { return _mixedFrames; }
+	int playingChannels() const;
+
+	// the SSE2 kernels, when the build has them; off for the scalar reference
+	static bool& useSimd();
+
+private:
+	struct Sound {
+		std::vector<float> samples;		// interleaved at SOFTWARE_MIX_RATE
+		size_t frames = 0;
+		int channels = 0;				// 1, or 2 for stereo 2D sounds
+		bool b3d = false;
+		bool looping = false;
+	};
+
+	struct Channel {
+		int sound = -1;					// -1 while the slot is free
+		unsigned int generation = 0;	// bumped on free, so old ids miss
+		size_t frame = 0;
+		glm::vec3 position;
+		float volume = 1.0f;
+	};
+
+	Channel* findChannel(int channel);
+	void freeChannel(Channel& channel);
+	// left and right gain of a channel for the current listener
+	void gains(const Channel& channel, float& left, float& right) const;
+	void finishCapture();
+
+	std::vector<Sound> _sounds;
+	std::vector<Channel> _channels;
+
+	glm::vec3 _listenerPosition;
+	glm::vec3 _listenerRight;
+
+	std::chrono::steady_clock::time_point _clockStart;
+	bool _clockStarted = false;
+	size_t _clockFrames = 0;		// mixed by update()
+	size_t _mixedFrames = 0;
+	std::vector<float> _mix;
+	std::vector<int16_t> _pcm;
+
+	FILE* _capture = nullptr;
+	std::string _capturePath;
+	size_t _capturedFrames = 0;
+};
+
+// Mixes a second of `voices` looping 3D voices `runs` times with the SSE2 and the
+// scalar kernels and prints the throughput in voice milliseconds per millisecond
+void benchmarkAudioMixer(int voices, int runs);
+
+#endif
@@ -0,0 +1,338 @@
+#include "TextureContainer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "MeshCache.h"
+#include "ResourceCache.h"
+
+namespace
+{
+	const char TEXTURE_CONTAINER_MAGIC[4] = { 'M', 'V', 'R', 'X' };
+	const uint64_t TEXTURE_CONTAINER_ALIGNMENT = 16;
+	const uint32_t MAX_LEVELS = 16;
+
+	uint64_t alignUp(uint64_t offset)
+	{
+		return (offset + TEXTURE_CONTAINER_ALIGNMENT - 1) & ~(TEXTURE_CONTAINER_ALIGNMENT - 1);
+	}
+
+	bool isOpaque(const uint8_t* pixels, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+			if (pixels[i * 4 + 3] != 255)
+				return false;
+		return true;
+	}
+}
+
+std::string textureContainerPath(const std::string& sourcePath)
+{
+	return sourcePath + ".mvrtex";
+}
+
+bool writeTextureContainer(const std::string& path, const std::string& sourcePath,
+	const uint8_t* pixels, int width, int height, int components, TextureCookReport* report)
+{
+	if (!pixels || width <= 0 || height <= 0 || components == 2 || components < 1 || components > 4)
+	{
+		std::cout << "Texture cook: " << sourcePath << " has an unsupported layout" << std::endl;
+		return false;
+	}
+
+	TextureContainerHeader header = {};
+	memcpy(header.magic, TEXTURE_CONTAINER_MAGIC, sizeof(header.magic));
+	header.version = TEXTURE_CONTAINER_VERSION;
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.sourceComponents = (uint32_t)components;
+	if (!sourceFileStamp(sourcePath, header.sourceSize, header.sourceTime))
+	{
+		std::cout << "Texture cook: cannot stat " << sourcePath << std::endl;
+		return false;
+	}
+
+	std::vector<uint8_t> level;
+	expandToRgba(pixels, width, height, components, level);
+	BlockFormat format = components == 1 ? BlockFormat::BC4
+		: (components == 3 || isOpaque(level.data(), (size_t)width * height)) ? BlockFormat::BC1 : BlockFormat::BC3;
+	header.blockFormat = (uint32_t)format;
+	header.glInternalFormat = glFormatOf(format);
+	std::vector<uint8_t> source = level;
+
+	// full mip chain down to 1x1, built here instead of glGenerateMipmap at load
+	std::vector<std::vector<uint8_t>> blocks;
+	std::vector<TextureContainerLevel> levels;
+	int w = width, h = height;
+	size_t uncompressed = 0;
+	while (levels.size() < MAX_LEVELS)
+	{
+		blocks.push_back(std::vector<uint8_t>());
+		compressImage(level.data(), w, h, format, blocks.back());
+		TextureContainerLevel entry = {};
+		entry.width = (uint32_t)w;
+		entry.height = (uint32_t)h;
+		entry.size = blocks.back().size();
+		levels.push_back(entry);
+		uncompressed += (size_t)w * h * components;
+		if (w == 1 && h == 1)
+			break;
+
+		std::vector<uint8_t> next;
+		downsampleRgba(level.data(), w, h, next);
+		level.swap(next);
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+	}
+	header.levelCount = (uint32_t)levels.size();
+
+	uint64_t offset = alignUp(sizeof(header) + levels.size() * sizeof(TextureContainerLevel));
+	for (auto& entry : levels)
+	{
+		entry.offset = offset;
+		offset = alignUp(offset + entry.size);
+	}
+
+	std::string tmpPath = path + ".tmp";
+	FILE* file = fopen(tmpPath.c_str(), "wb");
+	if (!file)
+	{
+		std::cout << "Texture cook: cannot write " << tmpPath << std::endl;
+		return false;
+	}
+	static const uint8_t zeros[TEXTURE_CONTAINER_ALIGNMENT] = {};
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(levels.data(), sizeof(TextureContainerLevel), levels.size(), file) == levels.size();
+	uint64_t written = sizeof(header) + levels.size() * sizeof(TextureContainerLevel);
+	for (size_t i = 0; ok && i < levels.size(); i++)
+	{
+		size_t pad = (size_t)(levels[i].offset - written);
+		ok = (!pad || fwrite(zeros, 1, pad, file) == pad)
+			&& fwrite(blocks[i].data(), 1, blocks[i].size(), file) == blocks[i].size();
+		written = levels[i].offset + levels[i].size;
+	}
+	ok = (fclose(file) == 0) && ok;
+	if (ok)
+	{
+		remove(path.c_str());
+		ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+	}
+	if (!ok)
+	{
+		std::cout << "Texture cook: failed writing " << path << std::endl;
+		remove(tmpPath.c_str());
+		return false;
+	}
+
+	// read the file back the way the loader does and compare the top level with the source
+	TextureContainerFile check;
+	if (!check.open(path, sourcePath))
+		return false;
+	std::vector<uint8_t> decoded;
+	decompressImage(check.levelData(0), width, height, format, decoded);
+	double psnr = imagePsnr(source.data(), decoded.data(), width, height, format);
+	if (report)
+	{
+		report->format = format;
+		report->levels = check.levelCount();
+		report->uncompressedBytes = uncompressed;
+		report->compressedBytes = check.dataBytes();
+		report->psnr = psnr;
+	}
+	if (psnr < MIN_TEXTURE_PSNR)
+	{
+		std::cout << "Texture cook: " << path << " reads back at " << psnr << " dB, below "
+			<< MIN_TEXTURE_PSNR << " dB" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool restampTextureContainer(const std::string& path, const std::string& sourcePath)
+{
+	TextureContainerHeader header;
+	return readCookedHeader(path, &header, sizeof(header))
+		&& memcmp(header.magic, TEXTURE_CONTAINER_MAGIC, sizeof(header.magic)) == 0 && header.version == TEXTURE_CONTAINER_VERSION
+		&& sourceFileStamp(sourcePath, header.sourceSize, header.sourceTime)
+		&& writeCookedHeader(path, &header, sizeof(header));
+}
+
+namespace
+{
+	const char* const FORMAT_NAMES[] = { "", "BC1", "", "BC3", "BC4" };
+
+	bool reportCheck(const std::string& name, bool ok)
+	{
+		std::cout << (ok ? "Texture check ok: " : "Texture check FAILED: ") << name << std::endl;
+		return ok;
+	}
+
+	// a smooth color ramp with a soft alpha ramp across it, the kind of content
+	// BCn is made for; odd sizes leave partial edge blocks
+	std::vector<uint8_t> gradientImage(int width, int height)
+	{
+		std::vector<uint8_t> rgba((size_t)width * height * 4);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				uint8_t* p = &rgba[((size_t)y * width + x) * 4];
+				p[0] = (uint8_t)(255 * x / std::max(1, width - 1));
+				p[1] = (uint8_t)(255 * y / std::max(1, height - 1));
+				p[2] = (uint8_t)(255 - (p[0] + p[1]) / 2);
+				p[3] = (uint8_t)(64 + 191 * (x + y) / std::max(1, width + height - 2));
+			}
+		}
+		return rgba;
+	}
+}
+
+bool checkTextureCompression()
+{
+	bool ok = true;
+
+	// BC1: red endpoint 0xF800 and blue 0x001F, every pixel on index 0 but the last on 1
+	{
+		const uint8_t block[8] = { 0x00, 0xF8, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x40 };
+		std::vector<uint8_t> rgba;
+		decompressImage(block, 4, 4, BlockFormat::BC1, rgba);
+		const uint8_t red[4] = { 255, 0, 0, 255 }, blue[4] = { 0, 0, 255, 255 };
+		ok &= reportCheck("BC1 block decodes to its endpoints",
+			memcmp(&rgba[0], red, 4) == 0 && memcmp(&rgba[14 * 4], red, 4) == 0 && memcmp(&rgba[15 * 4], blue, 4) == 0);
+	}
+
+	// BC4: endpoints 255 and 0, the second pixel on index 1, every other one on index 0
+	{
+		const uint8_t block[8] = { 255, 0, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00 };
+		std::vector<uint8_t> rgba;
+		decompressImage(block, 4, 4, BlockFormat::BC4, rgba);
+		ok &= reportCheck("BC4 block decodes to its endpoints", rgba[0] == 255 && rgba[4] == 0 && rgba[8] == 255);
+	}
+
+	// every format through the encoder and back
+	const int width = 70, height = 37;
+	std::vector<uint8_t> source = gradientImage(width, height);
+	const BlockFormat formats[] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4 };
+	for (BlockFormat format : formats)
+	{
+		std::vector<uint8_t> blocks, decoded;
+		compressImage(source.data(), width, height, format, blocks);
+		decompressImage(blocks.data(), width, height, format, decoded);
+		double psnr = imagePsnr(source.data(), decoded.data(), width, height, format);
+		ok &= reportCheck(std::string(FORMAT_NAMES[(int)format]) + " round trip at " + std::to_string(psnr) + " dB",
+			blocks.size() == compressedSize(format, width, height) && psnr >= MIN_TEXTURE_PSNR);
+	}
+
+	// a container written from a three channel source and mapped back the way the loader does
+	const std::string sourcePath = "texture-check.raw";
+	const std::string path = textureContainerPath(sourcePath);
+	std::vector<uint8_t> rgb((size_t)width * height * 3);
+	for (size_t i = 0; i < (size_t)width * height; i++)
+		memcpy(&rgb[i * 3], &source[i * 4], 3);
+	FILE* file = fopen(sourcePath.c_str(), "wb");
+	bool written = file && fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+	if (file)
+		written = (fclose(file) == 0) && written;
+
+	TextureCookReport report;
+	TextureContainerFile container;
+	bool roundTrip = written
+		&& writeTextureContainer(path, sourcePath, rgb.data(), width, height, 3, &report)
+		&& container.open(path, sourcePath);
+	if (roundTrip)
+	{
+		std::vector<uint8_t> blocks;
+		compressImage(source.data(), width, height, BlockFormat::BC1, blocks);
+		const TextureContainerLevel& last = container.level(container.levelCount() - 1);
+		roundTrip = container.format() == BlockFormat::BC1 && container.width() == (uint32_t)width
+			&& container.height() == (uint32_t)height && container.sourceComponents() == 3
+			&& container.levelCount() == 7 && last.width == 1 && last.height == 1
+			&& container.level(0).size == blocks.size()
+			&& memcmp(container.levelData(0), blocks.data(), blocks.size()) == 0;
+		container.close();
+	}
+	ok &= reportCheck("container round trip, " + std::to_string(report.levels) + " levels at "
+		+ std::to_string(report.psnr) + " dB", roundTrip);
+	remove(path.c_str());
+	remove(sourcePath.c_str());
+
+	return ok;
+}
+
+bool TextureContainerFile::open(const std::string& path, const std::string& sourcePath)
+{
+	close();
+	if (!_file.open(path))
+		return false;
+
+	uint64_t fileSize = _file.size();
+	const TextureContainerHeader* header = reinterpret_cast<const TextureContainerHeader*>(_file.data());
+	bool valid = fileSize >= sizeof(TextureContainerHeader)
+		&& memcmp(header->magic, TEXTURE_CONTAINER_MAGIC, sizeof(header->magic)) == 0
+		&& header->version == TEXTURE_CONTAINER_VERSION;
+	if (!valid)
+	{
+		std::cout << "Texture container: " << path << " has an unsupported format, ignoring it" << std::endl;
+		_file.close();
+		return false;
+	}
+
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if (assetFileStamp(sourcePath, sourceSize, sourceTime)
+		&& (sourceSize != header->sourceSize || sourceTime != header->sourceTime))
+	{
+		std::cout << "Texture container: " << path << " is stale, re-run --cook" << std::endl;
+		_file.close();
+		return false;
+	}
+
+	BlockFormat format = (BlockFormat)header->blockFormat;
+	valid = (format == BlockFormat::BC1 || format == BlockFormat::BC3 || format == BlockFormat::BC4)
+		&& header->glInternalFormat == glFormatOf(format)
+		&& header->width > 0 && header->height > 0
+		&& header->levelCount > 0 && header->levelCount <= MAX_LEVELS
+		&& sizeof(TextureContainerHeader) + header->levelCount * sizeof(TextureContainerLevel) <= fileSize;
+
+	const TextureContainerLevel* levels = reinterpret_cast<const TextureContainerLevel*>(_file.data() + sizeof(TextureContainerHeader));
+	uint32_t w = header->width, h = header->height;
+	for (uint32_t i = 0; valid && i < header->levelCount; i++)
+	{
+		const TextureContainerLevel& entry = levels[i];
+		valid = entry.width == w && entry.height == h
+			&& entry.size == compressedSize(format, w, h)
+			&& entry.offset % TEXTURE_CONTAINER_ALIGNMENT == 0
+			&& entry.offset <= fileSize && entry.size <= fileSize - entry.offset;
+		w = std::max(1u, w / 2);
+		h = std::max(1u, h / 2);
+	}
+	if (!valid)
+	{
+		std::cout << "Texture container: " << path << " is corrupt, ignoring it" << std::endl;
+		_file.close();
+		return false;
+	}
+
+	_header = header;
+	_levels = levels;
+	return true;
+}
+
+size_t TextureContainerFile::dataBytes() const
+{
+	size_t bytes = 0;
+	for (uint32_t i = 0; i < levelCount(); i++)
+		bytes += (size_t)_levels[i].size;
+	return bytes;
+}
+
+uint64_t TextureContainerFile::contentHash() const
+{
+	uint64_t hash = hashResourceBytes(&_header->glInternalFormat, sizeof(uint32_t) * 4);
+	for (uint32_t i = 0; i < levelCount(); i++)
+		hash = hashResourceBytes(levelData(i), (size_t)_levels[i].size, hash);
+	return hash;
+}
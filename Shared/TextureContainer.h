@@ -0,0 +1,97 @@
+#ifndef TEXTURE_CONTAINER_H
+#define TEXTURE_CONTAINER_H
+
+#include <cstdint>
+#include <string>
+
+#include "BlockCompression.h"
+#include "AssetArchive.h"
+
+// Cooked texture next to its source image (Base_Color.png -> Base_Color.png.mvrtex),
+// laid out like a minimal KTX2: a header, a level index and the BCn data of every
+// mip level, largest first, each level on a 16 byte boundary. The loader maps the
+// file and hands each level to glCompressedTexImage2D.
+// Like the mesh cache it records the source size and modification time and is
+// ignored once the source changes.
+const uint32_t TEXTURE_CONTAINER_VERSION = 1;
+
+// --cook fails a texture whose top level reads back worse than this; the shipped
+// textures are all above 36 dB
+const double MIN_TEXTURE_PSNR = 30.0;
+
+struct TextureContainerHeader {
+	char magic[4]; // "MVRX"
+	uint32_t version;
+	uint32_t glInternalFormat;
+	uint32_t blockFormat; // BlockFormat
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t sourceComponents;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+};
+
+struct TextureContainerLevel {
+	uint64_t offset;
+	uint64_t size;
+	uint32_t width;
+	uint32_t height;
+};
+
+// What the cook did, printed by --cook
+struct TextureCookReport {
+	BlockFormat format = BlockFormat::BC1;
+	uint32_t levels = 0;
+	size_t uncompressedBytes = 0; // source channels with the same mip chain, as uploaded before
+	size_t compressedBytes = 0;
+	double psnr = 0.0; // level 0 read back through TextureContainerFile against the source
+};
+
+std::string textureContainerPath(const std::string& sourcePath);
+
+// Picks the format from the source channels: 1 -> BC4, 3 or opaque 4 -> BC1, 4 -> BC3.
+// Builds the mip chain on the CPU, transcodes and writes every level, then reads the
+// file back to check it and fails below MIN_TEXTURE_PSNR. Two channel images are not
+// supported.
+bool writeTextureContainer(const std::string& path, const std::string& sourcePath,
+	const uint8_t* pixels, int width, int height, int components, TextureCookReport* report = nullptr);
+
+// see restampMeshCache
+bool restampTextureContainer(const std::string& path, const std::string& sourcePath);
+
+// --texture-check: decodes hand-made BCn blocks against their known pixels, encodes
+// synthetic images in every format and checks them against MIN_TEXTURE_PSNR, and
+// writes and reads back a container (texture-check.raw*, removed again). Prints
+// each result, returns false when one fails.
+bool checkTextureCompression();
+
+class TextureContainerFile
+{
+public:
+	// Maps and validates the file; fails when it is missing, malformed or stale
+	bool open(const std::string& path, const std::string& sourcePath);
+	void close() { _file.close(); _header = nullptr; }
+
+	BlockFormat format() const { return (BlockFormat)_header->blockFormat; }
+	uint32_t glInternalFormat() const { return _header->glInternalFormat; }
+	uint32_t width() const { return _header->width; }
+	uint32_t height() const { return _header->height; }
+	uint32_t sourceComponents() const { return _header->sourceComponents; }
+
+	uint32_t levelCount() const { return _header->levelCount; }
+	const TextureContainerLevel& level(uint32_t i) const { return _levels[i]; }
+	const uint8_t* levelData(uint32_t i) const { return _file.data() + _levels[i].offset; }
+
+	// bytes of all levels, what the texture takes on the GPU
+	size_t dataBytes() const;
+	// hash of the level data, the texture's content key
+	uint64_t contentHash() const;
+
+private:
+	AssetFile _file;
+	const TextureContainerHeader* _header = nullptr;
+	const TextureContainerLevel* _levels = nullptr;
+};
+
+#endif
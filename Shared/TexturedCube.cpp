@@ -1,106 +1,244 @@
 ﻿#include "TexturedCube.h"
+#include "AssetManager.h"
+#include "AssetArchive.h"
+#include "CubemapContainer.h"
 #include <GL/glew.h>
+#include <cctype>
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <vector>
 
-unsigned char* loadPPM(const char* filename, int& width, int& height)
+std::vector<std::string> faces
+{
+  "left.ppm",
+  "right.ppm",
+  "up.ppm",
+  "down.ppm",
+  "back.ppm",
+  "front.ppm"
+};
+
+// A binary PPM (P6, maxval 255) parsed in place: pixels points into the mapping (or
+// the archive), nothing is copied until the upload reads it.
+struct MappedPPM
+{
+  AssetFile file;
+  int width = 0;
+  int height = 0;
+  const unsigned char* pixels = nullptr;
+};
+
+// skips whitespace and comments, then reads a decimal number of the header
+static bool readPPMNumber(const unsigned char*& p, const unsigned char* end, int& value)
 {
-  const int BUFSIZE = 128;
-  FILE* fp;
-  unsigned int read;
-  unsigned char* rawData;
-  char buf[3][BUFSIZE];
-  char* retval_fgets;
-  size_t retval_sscanf;
-
-  if ((fp = fopen(filename, "rb")) == NULL)
+  while (p < end && (isspace(*p) || *p == '#'))
   {
-    std::cerr << "error reading ppm file, could not locate " << filename << std::endl;
-    width = 0;
-    height = 0;
-    return NULL;
+    if (*p == '#')
+      while (p < end && *p != '\n')
+        p++;
+    else
+      p++;
   }
+  if (p == end || !isdigit(*p))
+    return false;
+  value = 0;
+  while (p < end && isdigit(*p) && value < 65536)
+    value = value * 10 + (*p++ - '0');
+  return true;
+}
 
-  // Read magic number:
-  retval_fgets = fgets(buf[0], BUFSIZE, fp);
-
-  // Read width and height:
-  do
+bool mapPPM(const std::string& path, MappedPPM& image)
+{
+  if (!image.file.open(path))
   {
-    retval_fgets = fgets(buf[0], BUFSIZE, fp);
+    std::cerr << "error reading ppm file, could not locate " << path << std::endl;
+    return false;
   }
-  while (buf[0][0] == '#');
-  retval_sscanf = sscanf(buf[0], "%s %s", buf[1], buf[2]);
-  width = atoi(buf[1]);
-  height = atoi(buf[2]);
 
-  // Read maxval:
-  do
+  const unsigned char* p = image.file.data();
+  const unsigned char* end = p + image.file.size();
+  int maxval = 0;
+  bool ok = image.file.size() > 2 && p[0] == 'P' && p[1] == '6';
+  p += 2;
+  // a single whitespace character separates maxval from the pixels
+  ok = ok && readPPMNumber(p, end, image.width) && readPPMNumber(p, end, image.height)
+    && readPPMNumber(p, end, maxval) && maxval == 255 && p < end && isspace(*p++)
+    && image.width > 0 && image.height > 0 && (size_t)(end - p) >= (size_t)image.width * image.height * 3;
+  if (!ok)
   {
-    retval_fgets = fgets(buf[0], BUFSIZE, fp);
+    std::cerr << "error parsing ppm file " << path << ", unsupported or incomplete data" << std::endl;
+    image.file.close();
+    image.width = 0;
+    image.height = 0;
+    return false;
   }
-  while (buf[0][0] == '#');
 
-  // Read image data:
-  rawData = new unsigned char[width * height * 3];
-  read = fread(rawData, width * height * 3, 1, fp);
-  fclose(fp);
-  if (read != 1)
+  image.pixels = p;
+  image.file.prefetch();
+  return true;
+}
+
+void facePaths(const std::string& directory, std::string paths[CUBEMAP_FACES])
+{
+  for (unsigned int i = 0; i < CUBEMAP_FACES; i++)
+    paths[i] = directory + faces[i];
+}
+
+// what the upload reads from: the cooked container, or else the six mapped faces
+struct CubemapSource
+{
+  std::string directory;
+  std::chrono::steady_clock::time_point requested = std::chrono::steady_clock::now();
+  bool fromContainer = false;
+  CubemapContainerFile container;
+  MappedPPM faces[CUBEMAP_FACES];
+};
+
+void decodeCubemap(CubemapSource& source)
+{
+  std::string paths[CUBEMAP_FACES];
+  facePaths(source.directory, paths);
+  if (TexturedCube::useContainer() && source.container.open(cubemapContainerPath(source.directory), paths))
   {
-    std::cerr << "error parsing ppm file, incomplete data" << std::endl;
-    delete[] rawData;
-    width = 0;
-    height = 0;
-    return NULL;
+    source.container.prefetch();
+    source.fromContainer = true;
+    return;
   }
 
-  return rawData;
+  // the faces are independent, map and fault them in side by side
+  std::future<bool> mapped[CUBEMAP_FACES];
+  for (unsigned int i = 0; i < CUBEMAP_FACES; i++)
+    mapped[i] = std::async(std::launch::async, [&source, &paths, i] { return mapPPM(paths[i], source.faces[i]); });
+  for (unsigned int i = 0; i < CUBEMAP_FACES; i++)
+  {
+    if (!mapped[i].get())
+    {
+      std::cout << "Cubemap texture failed to load at path: " << faces[i].c_str() << std::endl;
+    }
+  }
 }
 
-unsigned loadCubemap(const std::string directory, std::vector<std::string>& faces)
+unsigned uploadCubemap(const CubemapSource& source)
 {
   unsigned int textureID;
   glGenTextures(1, &textureID);
   glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-  int width, height;
-  for (unsigned int i = 0; i < faces.size(); i++)
+  // rows of the small RGB mips are not 4 byte aligned
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  int levels = 1;
+  if (source.fromContainer)
   {
-    std::string path = directory + faces[i];
-    unsigned char* data = loadPPM(path.c_str(), width, height);
-    if (data)
+    const CubemapContainerFile& container = source.container;
+    levels = container.levelCount();
+    for (unsigned int i = 0; i < CUBEMAP_FACES; i++)
     {
-      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                   0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
-      );
+      for (int level = 0; level < levels; level++)
+      {
+        const CubemapContainerLevel& entry = container.level(level, i);
+        if (container.isCompressed())
+          glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, container.glInternalFormat(),
+                                 entry.faceSize, entry.faceSize, 0, (GLsizei)entry.size, container.data(level, i));
+        else
+          glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, GL_RGB8, entry.faceSize, entry.faceSize, 0,
+                       GL_RGB, GL_UNSIGNED_BYTE, container.data(level, i));
+      }
     }
-    else
+  }
+  else
+  {
+    for (unsigned int i = 0; i < CUBEMAP_FACES; i++)
     {
-      std::cout << "Cubemap texture failed to load at path: " << faces[i].c_str() << std::endl;
+      const MappedPPM& face = source.faces[i];
+      if (face.pixels)
+      {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+                     0, GL_RGB, face.width, face.height, 0, GL_RGB, GL_UNSIGNED_BYTE, face.pixels
+        );
+      }
     }
   }
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
+  // from the request to the finished upload, comparable with --no-cooked-assets
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - source.requested).count();
+  std::cout << "Loaded cubemap " << source.directory << (source.fromContainer ? " from container" : " from PPM faces")
+            << " in " << ms << " ms" << std::endl;
   return textureID;
 }
 
-std::vector<std::string> faces
+bool& TexturedCube::useContainer()
 {
-  "left.ppm",
-  "right.ppm",
-  "up.ppm",
-  "down.ppm",
-  "back.ppm",
-  "front.ppm"
-};
+  static bool use = true;
+  return use;
+}
+
+void TexturedCube::appendFiles(const std::string dir, std::vector<std::string>& files)
+{
+  std::string directory = "./" + dir + "/";
+  std::string paths[CUBEMAP_FACES];
+  facePaths(directory, paths);
+  files.insert(files.end(), paths, paths + CUBEMAP_FACES);
+  files.push_back(cubemapContainerPath(directory));
+}
+
+bool TexturedCube::cook(const std::string dir)
+{
+  std::string directory = "./" + dir + "/";
+  std::string paths[CUBEMAP_FACES];
+  facePaths(directory, paths);
+
+  MappedPPM images[CUBEMAP_FACES];
+  const uint8_t* pixels[CUBEMAP_FACES];
+  for (unsigned int i = 0; i < CUBEMAP_FACES; i++)
+  {
+    if (!mapPPM(paths[i], images[i]))
+      return false;
+    if (images[i].width != images[i].height || images[i].width != images[0].width)
+    {
+      std::cout << "Cubemap cook: the faces of " << directory << " are not square and of equal size" << std::endl;
+      return false;
+    }
+    pixels[i] = images[i].pixels;
+  }
+
+  std::string path = cubemapContainerPath(directory);
+  if (!writeCubemapContainer(path, paths, pixels, images[0].width, true))
+    return false;
+
+  CubemapContainerFile container;
+  if (!container.open(path, paths))
+    return false;
+  std::cout << "Cooked " << path << ": " << CUBEMAP_FACES << " faces " << container.faceSize() << "x" << container.faceSize()
+            << ", " << container.levelCount() << " levels BC1, " << CUBEMAP_FACES * images[0].width * images[0].width * 3 / 1024
+            << " KB -> " << container.dataBytes() / 1024 << " KB" << std::endl;
+  return true;
+}
 
 TexturedCube::TexturedCube(const std::string dir) : Cube()
 {
-  cubeMap = loadCubemap("./" + dir + "/", faces);
+  CubemapSource source;
+  source.directory = "./" + dir + "/";
+  decodeCubemap(source);
+  cubeMap = uploadCubemap(source);
+}
+
+TexturedCube::TexturedCube(AssetManager& assets, const std::string dir) : Cube()
+{
+  cubeMap = 0;
+  std::shared_ptr<CubemapSource> source = std::make_shared<CubemapSource>();
+  source->directory = "./" + dir + "/";
+  assets.load([source] { decodeCubemap(*source); },
+              [this, source] { cubeMap = uploadCubemap(*source); });
 }
 
 TexturedCube::~TexturedCube()
@@ -110,6 +248,9 @@ TexturedCube::~TexturedCube()
 
 void TexturedCube::draw(unsigned shader, const glm::mat4& p, const glm::mat4& v)
 {
+  if (!cubeMap)
+    return;
+
   glUseProgram(shader);
   // ... set view and projection matrix
   uProjection = glGetUniformLocation(shader, "projection");
@@ -3,14 +3,29 @@
 
 #include "Cube.h"
 #include <string>
+#include <vector>
+
+class AssetManager;
 
 class TexturedCube : public Cube
 {
 public:
 
   TexturedCube(const std::string dir);
+  // streaming: the faces are decoded on an asset worker, until they are uploaded
+  // cubeMap is 0 and draw() does nothing. The cube must not move until then.
+  TexturedCube(AssetManager& assets, const std::string dir);
   ~TexturedCube();
 
+  bool isReady() const { return cubeMap != 0; }
+
+  // bakes the six faces of dir into a BC1 cubemap container with mips, see CubemapContainer.h
+  static bool cook(const std::string dir);
+  // load from the container when it is there and up to date, on by default
+  static bool& useContainer();
+  // the files a cube from dir loads, for --pack: the six faces and the container
+  static void appendFiles(const std::string dir, std::vector<std::string>& files);
+
   void draw(unsigned int shader, const glm::mat4& p, const glm::mat4& v);
 
   // These variables are needed for the shader program
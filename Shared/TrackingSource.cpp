@@ -0,0 +1,274 @@
+#include "TrackingSource.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace
+{
+	const char TRACE_MAGIC[4] = { 'M', 'V', 'R', 'T' };
+	const uint32_t TRACE_VERSION = 1;
+
+	struct TraceHeader {
+		char magic[4];
+		uint32_t version;
+		float frameRate;
+		uint32_t reserved;
+	};
+
+#pragma pack(push, 1)
+	struct TracePose {
+		float position[3];
+		int16_t orientation[4];
+	};
+
+	struct TraceRecord {
+		double time;
+		TracePose poses[3]; // head, left hand, right hand
+		uint32_t buttons;
+		uint8_t triggers[4]; // index left/right, hand left/right
+		uint8_t inputValid;
+		uint8_t pad;
+	};
+#pragma pack(pop)
+
+	int16_t packUnit(float v)
+	{
+		return (int16_t)std::lround(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f);
+	}
+
+	float unpackUnit(int16_t v)
+	{
+		return v / 32767.0f;
+	}
+
+	uint8_t packTrigger(float v)
+	{
+		return (uint8_t)std::lround(std::max(0.0f, std::min(1.0f, v)) * 255.0f);
+	}
+
+	void packPose(const ovrPosef& pose, TracePose& out)
+	{
+		out.position[0] = pose.Position.x;
+		out.position[1] = pose.Position.y;
+		out.position[2] = pose.Position.z;
+		out.orientation[0] = packUnit(pose.Orientation.x);
+		out.orientation[1] = packUnit(pose.Orientation.y);
+		out.orientation[2] = packUnit(pose.Orientation.z);
+		out.orientation[3] = packUnit(pose.Orientation.w);
+	}
+
+	void unpackPose(const TracePose& in, ovrPosef& pose)
+	{
+		pose.Position = { in.position[0], in.position[1], in.position[2] };
+		glm::quat q(unpackUnit(in.orientation[3]), unpackUnit(in.orientation[0]), unpackUnit(in.orientation[1]), unpackUnit(in.orientation[2]));
+		q = glm::normalize(q);
+		pose.Orientation = { q.x, q.y, q.z, q.w };
+	}
+
+	ovrPosef interpolatePose(const ovrPosef& a, const ovrPosef& b, float t)
+	{
+		glm::quat qa(a.Orientation.w, a.Orientation.x, a.Orientation.y, a.Orientation.z);
+		glm::quat qb(b.Orientation.w, b.Orientation.x, b.Orientation.y, b.Orientation.z);
+		glm::quat q = glm::slerp(qa, qb, t);
+		ovrPosef result;
+		result.Orientation = { q.x, q.y, q.z, q.w };
+		result.Position.x = a.Position.x + (b.Position.x - a.Position.x) * t;
+		result.Position.y = a.Position.y + (b.Position.y - a.Position.y) * t;
+		result.Position.z = a.Position.z + (b.Position.z - a.Position.z) * t;
+		return result;
+	}
+}
+
+/****
+ * HmdTrackingSource
+ */
+
+bool HmdTrackingSource::next(TrackingSample& sample)
+{
+	ovrTrackingState trackState = hmd->getTrackingState(0.01);
+	sample.time = trackState.HeadPose.TimeInSeconds;
+	sample.headPose = trackState.HeadPose.ThePose;
+	sample.handPoses[ovrHand_Left] = trackState.HandPoses[ovrHand_Left].ThePose;
+	sample.handPoses[ovrHand_Right] = trackState.HandPoses[ovrHand_Right].ThePose;
+
+	ovrInputState inputState;
+	sample.inputValid = hmd->getInputState(&inputState);
+	if (sample.inputValid)
+	{
+		sample.buttons = inputState.Buttons;
+		for (int hand = 0; hand < 2; hand++)
+		{
+			sample.indexTrigger[hand] = inputState.IndexTrigger[hand];
+			sample.handTrigger[hand] = inputState.HandTrigger[hand];
+		}
+	}
+	return true;
+}
+
+/****
+ * TrackingRecorder
+ */
+
+TrackingRecorder::TrackingRecorder(std::unique_ptr<TrackingSource> source, const std::string& path, float frameRate)
+	: source(std::move(source))
+{
+	fp = fopen(path.c_str(), "wb");
+	if (!fp)
+	{
+		std::cerr << "Unable to record tracking to " << path << std::endl;
+		return;
+	}
+
+	TraceHeader header;
+	memcpy(header.magic, TRACE_MAGIC, 4);
+	header.version = TRACE_VERSION;
+	header.frameRate = frameRate;
+	header.reserved = 0;
+	fwrite(&header, sizeof(header), 1, fp);
+}
+
+TrackingRecorder::~TrackingRecorder()
+{
+	if (fp)
+	{
+		fclose(fp);
+		std::cout << "Recorded " << count << " tracking frames" << std::endl;
+	}
+}
+
+bool TrackingRecorder::next(TrackingSample& sample)
+{
+	if (!source->next(sample))
+		return false;
+
+	if (fp)
+	{
+		TraceRecord record;
+		memset(&record, 0, sizeof(record));
+		record.time = sample.time;
+		packPose(sample.headPose, record.poses[0]);
+		packPose(sample.handPoses[ovrHand_Left], record.poses[1]);
+		packPose(sample.handPoses[ovrHand_Right], record.poses[2]);
+		record.buttons = sample.buttons;
+		record.triggers[0] = packTrigger(sample.indexTrigger[ovrHand_Left]);
+		record.triggers[1] = packTrigger(sample.indexTrigger[ovrHand_Right]);
+		record.triggers[2] = packTrigger(sample.handTrigger[ovrHand_Left]);
+		record.triggers[3] = packTrigger(sample.handTrigger[ovrHand_Right]);
+		record.inputValid = sample.inputValid ? 1 : 0;
+		fwrite(&record, sizeof(record), 1, fp);
+		count++;
+	}
+	return true;
+}
+
+/****
+ * TrackingPlayback
+ */
+
+TrackingPlayback::TrackingPlayback(const std::string& path, float speed) : speed(speed)
+{
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (!fp)
+	{
+		std::cerr << "Unable to open tracking trace " << path << std::endl;
+		return;
+	}
+
+	TraceHeader header;
+	if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, TRACE_MAGIC, 4) != 0 || header.version != TRACE_VERSION)
+	{
+		std::cerr << "Not a tracking trace: " << path << std::endl;
+		fclose(fp);
+		return;
+	}
+	if (header.frameRate > 0.0f)
+		frameRate = header.frameRate;
+
+	TraceRecord record;
+	while (fread(&record, sizeof(record), 1, fp) == 1)
+	{
+		TrackingSample sample;
+		sample.time = record.time;
+		unpackPose(record.poses[0], sample.headPose);
+		unpackPose(record.poses[1], sample.handPoses[ovrHand_Left]);
+		unpackPose(record.poses[2], sample.handPoses[ovrHand_Right]);
+		sample.buttons = record.buttons;
+		sample.indexTrigger[ovrHand_Left] = record.triggers[0] / 255.0f;
+		sample.indexTrigger[ovrHand_Right] = record.triggers[1] / 255.0f;
+		sample.handTrigger[ovrHand_Left] = record.triggers[2] / 255.0f;
+		sample.handTrigger[ovrHand_Right] = record.triggers[3] / 255.0f;
+		sample.inputValid = record.inputValid != 0;
+		samples.push_back(sample);
+	}
+	fclose(fp);
+
+	// replay relative to the first record
+	if (!samples.empty())
+	{
+		double start = samples.front().time;
+		for (auto& sample : samples)
+			sample.time -= start;
+	}
+	std::cout << "Loaded " << samples.size() << " tracking frames from " << path << std::endl;
+}
+
+bool TrackingPlayback::next(TrackingSample& sample)
+{
+	if (samples.empty())
+		return false;
+
+	// speed 0 steps through the records one per frame
+	if (speed <= 0.0f)
+	{
+		if (cursor >= samples.size())
+		{
+			if (!loop)
+			{
+				sample = samples.back();
+				return false;
+			}
+			cursor = 0;
+		}
+		sample = samples[cursor++];
+		return true;
+	}
+
+	double duration = samples.back().time;
+	if (clock > duration)
+	{
+		if (!loop || duration <= 0.0)
+		{
+			sample = samples.back();
+			return false;
+		}
+		clock = std::fmod(clock, duration);
+		cursor = 0;
+	}
+
+	while (cursor + 1 < samples.size() && samples[cursor + 1].time <= clock)
+		cursor++;
+
+	const TrackingSample& a = samples[cursor];
+	sample = a;
+	if (cursor + 1 < samples.size())
+	{
+		const TrackingSample& b = samples[cursor + 1];
+		double span = b.time - a.time;
+		float t = span > 0.0 ? (float)((clock - a.time) / span) : 0.0f;
+		sample.headPose = interpolatePose(a.headPose, b.headPose, t);
+		sample.handPoses[0] = interpolatePose(a.handPoses[0], b.handPoses[0], t);
+		sample.handPoses[1] = interpolatePose(a.handPoses[1], b.handPoses[1], t);
+		sample.indexTrigger[0] = a.indexTrigger[0] + (b.indexTrigger[0] - a.indexTrigger[0]) * t;
+		sample.indexTrigger[1] = a.indexTrigger[1] + (b.indexTrigger[1] - a.indexTrigger[1]) * t;
+		sample.handTrigger[0] = a.handTrigger[0] + (b.handTrigger[0] - a.handTrigger[0]) * t;
+		sample.handTrigger[1] = a.handTrigger[1] + (b.handTrigger[1] - a.handTrigger[1]) * t;
+	}
+	sample.time = clock;
+
+	clock += speed / frameRate;
+	return true;
+}
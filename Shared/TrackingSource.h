@@ -0,0 +1,99 @@
+#ifndef TRACKING_SOURCE_H
+#define TRACKING_SOURCE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <OVR_CAPI.h>
+
+#include "HmdSession.h"
+
+// Everything RiftApp::update reads from the runtime in one frame
+struct TrackingSample {
+	double time = 0.0;
+	ovrPosef headPose;
+	ovrPosef handPoses[2];
+
+	bool inputValid = false;
+	uint32_t buttons = 0;
+	float indexTrigger[2] = { 0.0f, 0.0f };
+	float handTrigger[2] = { 0.0f, 0.0f };
+
+	TrackingSample()
+	{
+		ovrPosef identity = { { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+		headPose = handPoses[0] = handPoses[1] = identity;
+	}
+};
+
+// Where head, hand and button data comes from. The live source asks the HmdSession,
+// the playback source replays a trace written by TrackingRecorder.
+class TrackingSource
+{
+public:
+	virtual ~TrackingSource() {}
+
+	// the sample for the next frame, false once a non-looping trace is exhausted
+	virtual bool next(TrackingSample& sample) = 0;
+
+	// true when the head pose must be used for rendering instead of the runtime's eye poses
+	virtual bool overridesHeadPose() const { return false; }
+};
+
+class HmdTrackingSource : public TrackingSource
+{
+public:
+	HmdTrackingSource(HmdSession* hmd) : hmd(hmd) {}
+
+	bool next(TrackingSample& sample) override;
+
+private:
+	HmdSession* hmd;
+};
+
+// Trace file: a small header, then one fixed-size record per frame.
+// Positions are stored as floats, orientations as four int16 (|q| <= 1), triggers as bytes:
+// 78 bytes per frame, about 7 KB per second at 90 Hz.
+class TrackingRecorder : public TrackingSource
+{
+public:
+	// records everything the wrapped source produces
+	TrackingRecorder(std::unique_ptr<TrackingSource> source, const std::string& path, float frameRate);
+	~TrackingRecorder();
+
+	bool next(TrackingSample& sample) override;
+	bool overridesHeadPose() const override { return source->overridesHeadPose(); }
+
+private:
+	std::unique_ptr<TrackingSource> source;
+	FILE* fp;
+	uint32_t count = 0;
+};
+
+// Replays a trace on a virtual clock that advances speed / frameRate seconds per frame,
+// interpolating between records. No wall clock is involved, so a run is reproducible
+// at any speed.
+class TrackingPlayback : public TrackingSource
+{
+public:
+	bool loop = false;
+
+	TrackingPlayback(const std::string& path, float speed = 1.0f);
+
+	bool isLoaded() const { return !samples.empty(); }
+	size_t size() const { return samples.size(); }
+
+	bool next(TrackingSample& sample) override;
+	bool overridesHeadPose() const override { return true; }
+
+private:
+	std::vector<TrackingSample> samples;
+	float frameRate = 90.0f;
+	float speed;
+	double clock = 0.0;
+	size_t cursor = 0;
+};
+
+#endif
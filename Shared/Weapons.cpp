@@ -0,0 +1,233 @@
+#include "Deterministic.h"
+#include "Weapons.h"
+
+#include <glm/gtx/transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "JobSystem.h"
+
+namespace
+{
+	const float HEAD_RADIUS = 0.15f;
+	const int SWORD_SPHERES = 9;
+
+	// how a hand holds a weapon: a quarter turn around y, then 30 degrees around z,
+	// written out so the simulation calls no sin or cos
+	const glm::quat GRIP_ROTATION(0.6830127f, -0.1830127f, -0.6830127f, 0.1830127f);
+
+	// mesh to weapon frame by type, the turns written out for the same reason:
+	// axe 90 degrees around x after 180 around z, scaled to 0.01
+	const glm::mat4 AXE_MODEL(glm::vec4(-0.01f, 0, 0, 0), glm::vec4(0, 0, -0.01f, 0), glm::vec4(0, -0.01f, 0, 0), glm::vec4(0, 0, 0, 1));
+	// mace 90 then 270 degrees around x, a full turn, scaled to 0.7
+	const glm::mat4 MACE_MODEL(glm::vec4(0.7f, 0, 0, 0), glm::vec4(0, 0.7f, 0, 0), glm::vec4(0, 0, 0.7f, 0), glm::vec4(0, 0, 0, 1));
+	// sword -90 degrees around y after 270 around x, scaled to 0.1
+	const glm::mat4 SWORD_MODEL(glm::vec4(0, 0, 0.1f, 0), glm::vec4(0.1f, 0, 0, 0), glm::vec4(0, 0.1f, 0, 0), glm::vec4(0, 0, 0, 1));
+
+	// what every weapon of a type shares
+	struct WeaponArchetype {
+		glm::mat4 model;		// mesh to weapon frame
+		glm::vec3 color;
+		glm::vec3 handle;
+		float gripRadius;
+		glm::vec3 head;			// the first hit sphere; a sword has a row of them up the blade
+		float headRadius;
+		int spheres;
+	};
+
+	WeaponArchetype archetype(WeaponType type)
+	{
+		WeaponArchetype a;
+		switch (type)
+		{
+		case WEAPON_AXE:
+			a.model = AXE_MODEL;
+			a.color = glm::vec3(1, 0, 0);
+			a.handle = glm::vec3(0, -0.1, -0.01);
+			a.gripRadius = 0.04f;
+			a.head = glm::vec3(0, 0.3, 0);
+			a.headRadius = 0.13f;
+			a.spheres = 1;
+			break;
+		case WEAPON_MACE:
+			a.model = MACE_MODEL;
+			a.color = glm::vec3(0, 1, 0);
+			a.handle = glm::vec3(0.005, -0.2, 0);
+			a.gripRadius = 0.03f;
+			a.head = glm::vec3(0, 0.42, 0);
+			a.headRadius = 0.08f;
+			a.spheres = 1;
+			break;
+		default:
+			a.model = SWORD_MODEL;
+			a.color = glm::vec3(0, 0, 1);
+			a.handle = glm::vec3(-0.005, -0.22, 0);
+			a.gripRadius = 0.03f;
+			a.head = glm::vec3(0);
+			a.headRadius = 0.04f;
+			a.spheres = SWORD_SPHERES;
+			break;
+		}
+		return a;
+	}
+}
+
+void spawnWeapons(World& world, const glm::vec3 positions[WEAPONS], Entity weapons[WEAPONS])
+{
+	for (int id = 0; id < WEAPONS; id++)
+	{
+		WeaponType type = weaponType(id);
+		WeaponArchetype a = archetype(type);
+
+		glm::vec3 centers[SWORD_SPHERES];
+		for (int i = 0; i < a.spheres; i++)
+			centers[i] = a.head + glm::vec3(0, i / 15.0f, 0);
+
+		Entity e = world.create();
+		world.transforms.add(e, positions[id]);
+		world.colliders.add(e, centers, a.spheres, a.headRadius);
+		world.renderables.add(e, type, a.model, a.color);
+		world.holders.add(e, a.handle, a.gripRadius, weaponPlayer(id));
+		weapons[id] = e;
+	}
+}
+
+Entity spawnPlayer(World& world)
+{
+	Entity e = world.create();
+	glm::vec3 head(0);
+	world.transforms.add(e, head);
+	world.colliders.add(e, &head, 1, HEAD_RADIUS);
+	return e;
+}
+
+void holdWeapon(World& world, Entity weapon, int player, const RigidTransform& hand)
+{
+	size_t h = world.holders.slot(weapon);
+	size_t t = world.transforms.slot(weapon);
+	RigidTransform grip = hand * RigidTransform(GRIP_ROTATION);
+
+	world.holders.heldBy[h] = player;
+	world.transforms.rotation[t] = grip.rotation;
+	world.transforms.position[t] = hand.translation - grip.transformVector(world.holders.handle[h]);
+}
+
+void releaseWeapons(World& world, int player)
+{
+	std::vector<int>& heldBy = world.holders.heldBy;
+	for (size_t i = 0; i < heldBy.size(); i++)
+		if (heldBy[i] == player)
+			heldBy[i] = -1;
+}
+
+glm::vec3 gripPosition(const World& world, Entity weapon)
+{
+	return world.transforms.pose(world.transforms.slot(weapon)).transformPoint(world.holders.handle[world.holders.slot(weapon)]);
+}
+
+glm::mat4 weaponToWorld(const World& world, Entity weapon)
+{
+	return world.transforms.pose(world.transforms.slot(weapon)).toMat4()
+		* glm::translate(-world.holders.handle[world.holders.slot(weapon)]) * world.renderables.model[world.renderables.slot(weapon)];
+}
+
+glm::mat4 gripToWorld(const World& world, Entity weapon)
+{
+	size_t h = world.holders.slot(weapon);
+	return world.transforms.pose(world.transforms.slot(weapon)).toMat4()
+		* glm::translate(world.holders.handle[h]) * glm::scale(glm::vec3(world.holders.gripRadius[h]));
+}
+
+void updateColliders(World& world, size_t begin, size_t end)
+{
+	Colliders& c = world.colliders;
+	const Transforms& t = world.transforms;
+	for (size_t ci = begin; ci < end; ci++)
+	{
+		Entity e = c.entity(ci);
+		if (!t.has(e))
+			continue;
+		RigidTransform pose = t.pose(t.slot(e));
+		for (uint32_t i = c.first[ci]; i < c.first[ci] + c.count[ci]; i++)
+			c.worldCenter[i] = pose.transformPoint(c.center[i]);
+	}
+}
+
+void updateColliders(World& world)
+{
+	updateColliders(world, 0, world.colliders.size());
+}
+
+void weaponMatrices(const World& world, size_t begin, size_t end, glm::mat4* weapons, glm::mat4* grips)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		Entity e = world.renderables.entity(i);
+		weapons[i] = weaponToWorld(world, e);
+		grips[i] = gripToWorld(world, e);
+	}
+}
+
+WeaponContacts collideWeapons(const World& world, const Entity players[PLAYERS])
+{
+	WeaponContacts contacts;
+	const Holders& h = world.holders;
+	const Colliders& c = world.colliders;
+	for (size_t a = 0; a < h.size(); a++)
+	{
+		if (h.heldBy[a] < 0)
+			continue;
+		size_t ca = c.slot(h.entity(a));
+
+		for (size_t b = a + 1; b < h.size(); b++)
+			if (h.heldBy[b] >= 0 && h.heldBy[b] != h.heldBy[a] && c.overlap(ca, c.slot(h.entity(b))))
+				contacts.clash = true;
+
+		for (int p = 0; p < PLAYERS; p++)
+			if (p != h.heldBy[a] && c.overlap(ca, c.slot(players[p])))
+				contacts.hit[p] = true;
+	}
+	return contacts;
+}
+
+void benchmarkWeaponJobs(size_t weapons, int runs)
+{
+	World world;
+	size_t sets = std::max<size_t>(1, weapons / WEAPONS);
+	for (size_t set = 0; set < sets; set++)
+	{
+		glm::vec3 positions[WEAPONS];
+		for (int id = 0; id < WEAPONS; id++)
+			positions[id] = glm::vec3((float)(set % 64), (float)id, (float)(set / 64));
+		Entity spawned[WEAPONS];
+		spawnWeapons(world, positions, spawned);
+		for (int id = 0; id < WEAPONS; id++)
+			holdWeapon(world, spawned[id], weaponPlayer(id), RigidTransform(glm::normalize(glm::quat(1, set * 0.1f, (float)id, 0.3f)), positions[id]));
+	}
+	size_t count = world.renderables.size();
+	std::vector<glm::mat4> models(count), grips(count);
+
+	// up to the threads of the global pool, which --jobs sets
+	unsigned int most = jobSystem.threads();
+	double single = 0.0;
+	for (unsigned int threads = 1; ; threads = std::min(threads * 2, most))
+	{
+		JobSystem jobs(threads);
+		auto frame = [&] {
+			jobs.parallelFor(world.colliders.size(), WEAPON_JOB_GRAIN, [&](size_t begin, size_t end) { updateColliders(world, begin, end); });
+			jobs.parallelFor(count, WEAPON_JOB_GRAIN, [&](size_t begin, size_t end) { weaponMatrices(world, begin, end, models.data(), grips.data()); });
+		};
+		frame();	// warm up, and start the threads
+		auto start = std::chrono::steady_clock::now();
+		for (int run = 0; run < runs; run++)
+			frame();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+		if (threads == 1)
+			single = ms;
+		std::cout << "Weapon jobs: " << count << " weapons, " << threads << " thread(s) " << ms << " ms per frame, "
+			<< single / ms << "x" << std::endl;
+		if (threads == most)
+			break;
+	}
+}
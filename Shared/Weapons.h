@@ -0,0 +1,55 @@
+#ifndef WEAPONS_H
+#define WEAPONS_H
+
+#include "Ecs.h"
+
+// The arena's weapons as entities. Each player has one of each type; a weapon's id,
+// the one PlayerInfo::heldWeapon and the server's render_weapons use, is
+// type * 2 + player, so types compare in the order the fight rules expect.
+enum WeaponType { WEAPON_AXE, WEAPON_MACE, WEAPON_SWORD, WEAPON_TYPES };
+const int PLAYERS = 2;
+const int WEAPONS = WEAPON_TYPES * PLAYERS;
+
+inline int weaponId(WeaponType type, int player) { return type * PLAYERS + player; }
+inline WeaponType weaponType(int id) { return (WeaponType)(id / PLAYERS); }
+inline int weaponPlayer(int id) { return id % PLAYERS; }
+
+// Creates the weapons at the given positions, by id, with every component: the mesh of
+// a renderable is its WeaponType
+void spawnWeapons(World& world, const glm::vec3 positions[WEAPONS], Entity weapons[WEAPONS]);
+// a player's head, for the weapons to hit
+Entity spawnPlayer(World& world);
+
+// puts the weapon's grip in the hand, turned the way a hand holds it
+void holdWeapon(World& world, Entity weapon, int player, const RigidTransform& hand);
+// whatever the player held is put down where it is
+void releaseWeapons(World& world, int player);
+
+glm::vec3 gripPosition(const World& world, Entity weapon);
+// the renderable's mesh to world
+glm::mat4 weaponToWorld(const World& world, Entity weapon);
+// the grip sphere's model to world
+glm::mat4 gripToWorld(const World& world, Entity weapon);
+
+// moves the spheres of collider slots [begin, end) to world space by their transforms;
+// slots split between jobs never share a sphere
+void updateColliders(World& world, size_t begin, size_t end);
+void updateColliders(World& world);
+// the mesh and grip sphere to world of renderable slots [begin, end), which must be weapons
+void weaponMatrices(const World& world, size_t begin, size_t end, glm::mat4* weapons, glm::mat4* grips);
+// slots a job of the sweeps above takes at least
+const size_t WEAPON_JOB_GRAIN = 256;
+
+struct WeaponContacts {
+	bool clash = false;			// held weapons of two players touch
+	bool hit[PLAYERS] = {};		// a weapon somebody else holds touches the player's head
+};
+
+// checks the held weapons against each other and the heads; update the colliders first
+WeaponContacts collideWeapons(const World& world, const Entity players[PLAYERS]);
+
+// Times a frame of the sweeps above over this many weapons, all held, on 1 to N
+// threads, and prints the speedup over one
+void benchmarkWeaponJobs(size_t weapons, int runs);
+
+#endif
@@ -0,0 +1,10 @@
+#version 410 core
+
+// Color writes are masked off while the hidden area is drawn, only depth matters.
+
+out vec4 fragColor;
+
+void main()
+{
+    fragColor = vec4(0.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,12 @@
+#version 410 core
+
+// Hidden-area mask: positions come from ovr_GetFovStencil in [0,1] eye viewport space
+// (origin at bottom left). They are pushed onto the near plane so the depth test
+// rejects every later fragment in the region the lens never shows.
+
+layout (location = 0) in vec2 position;
+
+void main()
+{
+    gl_Position = vec4(position * 2.0 - 1.0, -1.0, 1.0);
+}
@@ -21,8 +21,11 @@ limitations under the License.
 #include <memory>
 #include <exception>
 #include <algorithm>
+#include <cctype>
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
 #define __STDC_FORMAT_MACROS 1
 
@@ -46,17 +49,94 @@ limitations under the License.
 
 #include <vector>
 #include "shader.h"
+#include "ShaderCompiler.h"
 #include "Cube.h"
 #include "Model.h"
 #include "Player.h"
+#include "Simulation.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
 #include "AudioEngine.h"
+#include "AudioThread.h"
+#include "SoftwareAudioBackend.h"
+#include "FmodAudioBackend.h"
+#include "ResolutionGovernor.h"
+#include "FrameTiming.h"
+#include "Profiler.h"
+#include "AssetManager.h"
+#include "AssetBuild.h"
+#include "CubemapContainer.h"
 
 Player* me;
 Player* oppo;
 
-Model* sphere;
+std::shared_ptr<Model> sphere;
 bool gameOver = false;
+// render through HeadlessHmdSession into an offscreen context, see --headless in main()
+bool headless = false;
+// --expect-no-allocations, see GlfwApp::reportBenchmark
+bool expectNoAllocations = false;
+// --record-tracking / --play-tracking, see main()
+std::string trackingRecordPath;
+std::string trackingPlaybackPath;
+float trackingPlaybackSpeed = 1.0f;
+// GL time per frame spent on uploading streamed assets, see AssetManager
+const double ASSET_UPLOAD_BUDGET_MS = 2.0;
+// every model the client loads, baked by --cook
+const char* const MODEL_PATHS[] = {
+	"../Shared/sphere2.obj",
+	"../Shared/head/asianguy.obj",
+	"../Shared/head/whiteguy.obj",
+	"../Shared/mace/WARROIRS_MACE.obj",
+	"../Shared/fbx/axe.obj",
+	"../Shared/sword/untitled.obj",
+};
+// what --obj-check compares besides the models: OBJ features none of them uses
+const char* const OBJ_CHECK_PATHS[] = {
+	"../Shared/check/relative-no-texcoords.obj",
+};
+// textures shipped without a material referencing them yet, compressed by --cook as well
+const char* const TEXTURE_PATHS[] = {
+	"../Shared/fbx/Base_Color.png",
+	"../Shared/fbx/Normal.png",
+	"../Shared/fbx/Roughness.png",
+	"../Shared/fbx/Metallic.png",
+	"../Shared/fbx/AO.png",
+};
+// shaders, for --pack
+const char* const SHADER_PATHS[] = {
+	"../Shared/hiddenarea.vert",
+	"../Shared/hiddenarea.frag",
+	"../Shared/skybox.vert",
+	"../Shared/skybox.frag",
+	"../Shared/shader.vert",
+	"../Shared/shader.frag",
+};
+// Every sound, preloaded at startup and packed by --pack; --cook decodes them for the
+// software mixer. They are opened by bare name from the working directory. Priority 0
+// is kept longest; collisions can fire every frame, so they are capped. The short
+// effects are decoded up front so a hit starts without decoding, the ambience loop
+// streams.
+const SoundManifestEntry SOUND_MANIFEST[] = {
+	{ "nature.mp3", true, true, SoundCache::Stream, 0, 1 },
+	{ "hold-weapon.mp3", true, false, SoundCache::Decompressed, 64, 2 },
+	{ "weapon-collide.mp3", true, false, SoundCache::Decompressed, 128, 4 },
+	{ "scream.mp3", true, false, SoundCache::Compressed, 0, 1 },
+};
+// what the loaded sounds may hold; over it, sounds are kept compressed or streamed instead
+const size_t SOUND_MEMORY_BUDGET = 4 * 1024 * 1024;
+// what --cook knows about the cooked files, see AssetBuild.h
+const char* const COOK_MANIFEST_PATH = "../Shared/assets.cookdb";
+// written by --pack, mounted at startup unless --no-archive
+const char* const ASSET_ARCHIVE_PATH = "../Shared/assets.mvrpak";
 CAudioEngine aEngine;
+// drives aEngine from its own thread once started, the game posts to it
+AudioThread audioThread;
+// resolved once the manifest is loaded, see main()
+SoundId soundNature = INVALID_SOUND;
+SoundId soundHoldWeapon = INVALID_SOUND;
+SoundId soundWeaponCollide = INVALID_SOUND;
+SoundId soundScream = INVALID_SOUND;
 
 // Import the most commonly used types into the default namespace
 using glm::ivec3;
@@ -74,7 +154,18 @@ enum attach {
 };
 
 attach weapon_p1;
-attach weapon_p2;
+
+// by WeaponType
+const attach WEAPON_ATTACH[WEAPON_TYPES] = { a_axe, a_mace, a_sword };
+
+// the id of the weapon player holds as a, -1 for none
+int attachedWeapon(attach a, int player)
+{
+	for (int type = 0; type < WEAPON_TYPES; type++)
+		if (WEAPON_ATTACH[type] == a)
+			return weaponId((WeaponType)type, player);
+	return -1;
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -174,7 +265,9 @@ bool checkGlError()
 void glDebugCallbackHandler(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* msg,
 	GLvoid* data)
 {
+#ifdef _WIN32
 	OutputDebugStringA(msg);
+#endif
 	std::cout << "debug call: " << msg << std::endl;
 }
 
@@ -211,6 +304,12 @@ protected:
 	GLFWwindow* window{ nullptr };
 	unsigned int frame{ 0 };
 
+	// benchmark mode: stop after this many frames and report frame times, 0 runs until closed
+	unsigned int maxFrames{ 0 };
+	std::vector<float> frameTimes;
+	// heap allocations each benchmark frame made, see FrameArena.h
+	std::vector<size_t> frameAllocations;
+
 public:
 	GlfwApp()
 	{
@@ -250,30 +349,142 @@ public:
 		//connect to client
 		// connect to server
 		//init_server();
-		int player_num = init_client();
+		int player_num = headless ? init_offline_client() : init_client();
 
 		// initialize Players
-		sphere = new Model("../Shared/sphere2.obj");
-		glm::mat4 player1 = glm::rotate(mat4(1), glm::pi<float>() / 2.0f, vec3(0, 1, 0)) * translate(mat4(1), vec3(0, 0, 0.5)) *glm::rotate(mat4(1), glm::pi<float>(), vec3(0, 1, 0));
-		glm::mat4 player2 = glm::rotate(mat4(1), -glm::pi<float>() / 2.0f, vec3(0, 1, 0)) * translate(mat4(1), vec3(0, 0, 0.5)) *glm::rotate(mat4(1), glm::pi<float>(), vec3(0, 1, 0));
+		sphere = Model::load(assets, "../Shared/sphere2.obj");
+		RigidTransform player1 = RigidTransform(glm::angleAxis(glm::pi<float>() / 2.0f, vec3(0, 1, 0))) * RigidTransform(vec3(0, 0, 0.5)) * RigidTransform(glm::angleAxis(glm::pi<float>(), vec3(0, 1, 0)));
+		RigidTransform player2 = RigidTransform(glm::angleAxis(-glm::pi<float>() / 2.0f, vec3(0, 1, 0))) * RigidTransform(vec3(0, 0, 0.5)) * RigidTransform(glm::angleAxis(glm::pi<float>(), vec3(0, 1, 0)));
 		//float playerOffset = (player_num == 1) ? 5.0f : -5.0f;
 		//float playerDir = (player_num == 1) ? glm::pi<float>() / 2.0f : -glm::pi<float>() / 2.0f;
 		me = new Player((player_num == 1) ? player1 : player2,
-			true, sphere,  (player_num == 1) ? new Model("../Shared/head/asianguy.obj") : new Model("../Shared/head/whiteguy.obj"));
+			true, sphere,  (player_num == 1) ? Model::load(assets, "../Shared/head/asianguy.obj") : Model::load(assets, "../Shared/head/whiteguy.obj"));
 		oppo = new Player((player_num == 1) ? player2 : player1,
-			false, sphere, (player_num == 1) ? new Model("../Shared/head/whiteguy.obj") : new Model("../Shared/head/asianguy.obj"));
+			false, sphere, (player_num == 1) ? Model::load(assets, "../Shared/head/whiteguy.obj") : Model::load(assets, "../Shared/head/asianguy.obj"));
+		start_server_exchange();
+
+		if (maxFrames)
+		{
+			frameTimes.reserve(maxFrames);
+			frameAllocations.reserve(maxFrames);
+		}
+		if (headless)
+		{
+			// benchmarks and golden images compare fully loaded frames
+			assets.finishAll();
+			shaderCompiler.finishAll();
+		}
+		bool streaming = true;
 
-		while (!glfwWindowShouldClose(window))
+		while (!glfwWindowShouldClose(window) && (!maxFrames || frame < maxFrames))
 		{
+			double frameStart = glfwGetTime();
 			++frame;
+			// nothing of the last frame's transient data is in use any more
+			frameArena.reset();
+			size_t allocationsStart = heapAllocations();
+			profiler.beginFrame(frame);
 			glfwPollEvents();
-			update();
+			if (streaming)
+			{
+				ProfileScope scope("asset uploads");
+				assets.pumpUploads(ASSET_UPLOAD_BUDGET_MS);
+			}
+			{
+				ProfileScope scope("update");
+				update();
+			}
 			draw();
 			finishFrame();
+			if (maxFrames)
+			{
+				// no compositor waits on the GPU here, so wait for it before stopping the
+				// clock, or the frame time would be the CPU's alone
+				glFinish();
+				frameTimes.push_back((float)((glfwGetTime() - frameStart) * 1000.0));
+			}
+			profiler.endFrame();
+			if (maxFrames)
+			{
+				frameAllocations.push_back(heapAllocations() - allocationsStart);
+			}
+			if (frame == 1)
+			{
+				// everything up to the first presented frame: window, GL, models and textures
+				std::cout << "Startup: " << glfwGetTime() * 1000.0 << " ms to first frame, peak RSS "
+					<< peakResidentBytes() / (1024 * 1024) << " MB, meshes "
+					<< (Model::useCookedAssets() ? "from cooked files where present" : "through Assimp and stb_image") << std::endl;
+			}
+			if (streaming && !assets.pending())
+			{
+				streaming = false;
+				std::cout << "Assets streamed in after " << glfwGetTime() * 1000.0 << " ms, frame " << frame << std::endl;
+				ResourceStats models = resources().models.stats();
+				ResourceStats textures = resources().textures.stats();
+				std::cout << "Resource cache: " << models.count << " models " << models.bytes / 1024 << " KB, "
+					<< textures.count << " textures " << textures.bytes / 1024 << " KB, "
+					<< models.hits + textures.hits << " hits " << models.misses + textures.misses << " misses" << std::endl;
+			}
+		}
+
+		stop_server_exchange();
+
+		int result = 0;
+		if (maxFrames)
+		{
+			result = reportBenchmark();
 		}
 
 		shutdownGl();
 
+		return result;
+	}
+
+	// Prints frame time statistics of a benchmark run, returns the process exit code
+	virtual int reportBenchmark()
+	{
+		if (frameTimes.empty())
+			return 0;
+
+		std::vector<float> sorted(frameTimes);
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (float t : sorted)
+			total += t;
+		auto percentile = [&](float p) { return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))]; };
+
+		printf("frames: %u\n", (unsigned int)sorted.size());
+		printf("frame time ms: min %.3f avg %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f\n",
+			sorted.front(), total / sorted.size(), percentile(0.5f), percentile(0.95f), percentile(0.99f), sorted.back());
+
+		if (!HEAP_ALLOCATIONS_COUNTED)
+		{
+			printf("heap allocations per frame: not counted, build with MINIMALVR_COUNT_ALLOCATIONS\n");
+			if (expectNoAllocations)
+			{
+				printf("--expect-no-allocations needs a build that counts allocations\n");
+				return 1;
+			}
+			return 0;
+		}
+
+		// the second half, once the assets have streamed in and the arena has grown to fit
+		size_t steady = frameAllocations.size() / 2;
+		size_t allocations = 0, most = 0;
+		for (size_t i = steady; i < frameAllocations.size(); i++)
+		{
+			allocations += frameAllocations[i];
+			most = std::max(most, frameAllocations[i]);
+		}
+		size_t frames = std::max<size_t>(1, frameAllocations.size() - steady);
+		printf("heap allocations per frame on the main thread: avg %.2f max %u over the last %u frames, frame arena %u KB of %u KB\n",
+			(double)allocations / frames, (unsigned int)most, (unsigned int)frames,
+			(unsigned int)(frameArena.highWater() / 1024), (unsigned int)(frameArena.capacity() / 1024));
+		if (expectNoAllocations && most > 0)
+		{
+			printf("frames allocated on the heap, expected none\n");
+			return 1;
+		}
 		return 0;
 	}
 
@@ -284,6 +495,17 @@ protected:
 
 	void preCreate()
 	{
+		if (headless)
+		{
+			// no window on screen. GLFW still opens its window through X11 or Wayland with an EGL
+			// context, so a machine without a display needs Xvfb; only OSMesa needs none
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef MINIMALVR_OSMESA
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#else
+			glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+#endif
+		}
 		glfwWindowHint(GLFW_DEPTH_BITS, 16);
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
@@ -317,6 +539,9 @@ protected:
 				//glDebugMessageCallback(glDebugCallbackHandler, this);
 			}
 		}
+
+		// programs are linked beside the render thread from here on
+		shaderCompiler.start(window);
 	}
 
 	virtual void initGl()
@@ -325,6 +550,13 @@ protected:
 
 	virtual void shutdownGl()
 	{
+		// the players and the hand sphere own GL buffers, free them while the context
+		// is current rather than during static destruction
+		delete me;
+		delete oppo;
+		me = oppo = nullptr;
+		sphere.reset();
+		shaderCompiler.stop();
 	}
 
 	virtual void finishFrame()
@@ -394,8 +626,16 @@ private:
 // The Oculus VR C API provides access to information about the HMD
 //
 
+// builds without the LibOVR runtime (Linux build machines) define MINIMALVR_NO_OVR:
+// they use the SDK headers for the types only and run --headless alone
 #include <OVR_CAPI.h>
+#include "HmdSession.h"
+#ifndef MINIMALVR_NO_OVR
 #include <OVR_CAPI_GL.h>
+#include "OvrHmdSession.h"
+#endif
+#include "HeadlessHmdSession.h"
+#include "TrackingSource.h"
 
 namespace ovr
 {
@@ -416,10 +656,12 @@ namespace ovr
 		return glm::transpose(glm::make_mat4(&om.M[0][0]));
 	}
 
+#ifndef MINIMALVR_NO_OVR
 	inline mat4 toGlm(const ovrFovPort& fovport, float nearPlane = 0.01f, float farPlane = 10000.0f)
 	{
 		return toGlm(ovrMatrix4f_Projection(fovport, nearPlane, farPlane, true));
 	}
+#endif
 
 	inline vec3 toGlm(const ovrVector3f& ov)
 	{
@@ -441,11 +683,9 @@ namespace ovr
 		return glm::make_quat(&oq.x);
 	}
 
-	inline mat4 toGlm(const ovrPosef& op)
+	inline RigidTransform toRigid(const ovrPosef& op)
 	{
-		mat4 orientation = glm::mat4_cast(toGlm(op.Orientation));
-		mat4 translation = glm::translate(mat4(), ovr::toGlm(op.Position));
-		return translation * orientation;
+		return RigidTransform(toGlm(op.Orientation), toGlm(op.Position));
 	}
 
 	inline ovrMatrix4f fromGlm(const mat4& m)
@@ -495,36 +735,27 @@ namespace ovr
 class RiftManagerApp
 {
 protected:
-	ovrSession _session;
+	std::unique_ptr<HmdSession> _hmd;
 	ovrHmdDesc _hmdDesc;
-	ovrGraphicsLuid _luid;
 
 public:
 	RiftManagerApp()
 	{
-		if (!OVR_SUCCESS(ovr_Create(&_session, &_luid)))
-		{
-			FAIL("Unable to create HMD session");
-		}
-
-		_hmdDesc = ovr_GetHmdDesc(_session);
-	}
-
-	~RiftManagerApp()
-	{
-		ovr_Destroy(_session);
-		_session = nullptr;
+#ifndef MINIMALVR_NO_OVR
+		if (!headless)
+			_hmd = std::make_unique<OvrHmdSession>();
+		else
+#endif
+			_hmd = std::make_unique<HeadlessHmdSession>();
+
+		_hmdDesc = _hmd->getHmdDesc();
 	}
 };
 
 bool weapon_state[6];
 
-vec3 handPose;
-vec3 oppo_handPose;
-mat4 oppo_rot;
 
 vec3 eyePose;
-mat4 rot;
 bool pressedA = false;
 bool pressedB = false;
 bool pressedX = false;
@@ -542,10 +773,8 @@ public:
 private:
 	GLuint _fbo{ 0 };
 	GLuint _depthBuffer{ 0 };
-	ovrTextureSwapChain _eyeTexture;
 
 	GLuint _mirrorFbo{ 0 };
-	ovrMirrorTexture _mirrorTexture;
 
 	ovrEyeRenderDesc _eyeRenderDescs[2];
 
@@ -557,6 +786,41 @@ private:
 	uvec2 _renderTargetSize;
 	uvec2 _mirrorSize;
 
+	// head, hands and buttons for update(): live, recorded while live, or replayed from a trace
+	std::unique_ptr<TrackingSource> _tracking;
+	TrackingSample _trackingSample;
+
+	// Dynamic resolution: the swap chain is sized for the governor's max scale and
+	// only the per-eye viewport shrinks or grows with the measured frame time
+	ovrSizei _eyeBaseSize[2];
+	ovrSizei _eyeMaxSize[2];
+	ResolutionGovernor _governor;
+	std::unique_ptr<FrameTimingSource> _frameTiming;
+	bool _dynamicResolution{ true };
+
+	// Hidden-area mask: the lens never shows the corners of each eye viewport,
+	// so they are primed in the depth buffer before the scene is drawn
+	PendingProgram _hiddenAreaShader;
+	GLuint _hiddenAreaVao[2]{ 0, 0 };
+	GLuint _hiddenAreaVbo[2]{ 0, 0 };
+	GLuint _hiddenAreaEbo[2]{ 0, 0 };
+	GLsizei _hiddenAreaIndexCount[2]{ 0, 0 };
+	bool _hiddenAreaEnabled{ true };
+
+	// Fill-rate measurement: counts the samples that pass the depth test for both eyes.
+	// The queries go round a ring like GlFrameTiming's, so a frame only reads results
+	// the GPU already has instead of waiting for the one it just issued. A frame that
+	// finds the ring full of unread results goes unmeasured and is counted in _samplesSkipped
+	static const int SAMPLES_QUERIES = 4;
+	GLuint _samplesQueries[SAMPLES_QUERIES]{};
+	int _samplesQueryHead{ 0 };
+	int _samplesQueriesPending{ 0 };
+	bool _samplesQueryIssued{ false };
+	bool _measureFillRate{ false };
+	GLuint64 _samplesPassed{ 0 };
+	unsigned int _samplesFrames{ 0 };
+	unsigned int _samplesSkipped{ 0 };
+
 public:
 
 	RiftApp()
@@ -570,15 +834,14 @@ public:
 
 		ovr::for_each_eye([&](ovrEyeType eye)
 		{
-			ovrEyeRenderDesc& erd = _eyeRenderDescs[eye] = ovr_GetRenderDesc(_session, eye, _hmdDesc.DefaultEyeFov[eye]);
-			ovrMatrix4f ovrPerspectiveProjection =
-				ovrMatrix4f_Projection(erd.Fov, 0.01f, 1000.0f, ovrProjection_ClipRangeOpenGL);
-			_eyeProjections[eye] = ovr::toGlm(ovrPerspectiveProjection);
+			ovrEyeRenderDesc& erd = _eyeRenderDescs[eye] = _hmd->getRenderDesc(eye, _hmdDesc.DefaultEyeFov[eye]);
+			_eyeProjections[eye] = _hmd->getProjection(erd.Fov, 0.01f, 1000.0f);
 			_viewScaleDesc.HmdToEyePose[eye] = erd.HmdToEyePose;
 
 			ovrFovPort& fov = _sceneLayer.Fov[eye] = _eyeRenderDescs[eye].Fov;
-			auto eyeSize = ovr_GetFovTextureSize(_session, eye, fov, 1.0f);
-			_sceneLayer.Viewport[eye].Size = eyeSize;
+			_eyeBaseSize[eye] = _hmd->getFovTextureSize(eye, fov, 1.0f);
+			auto eyeSize = _eyeMaxSize[eye] = _hmd->getFovTextureSize(eye, fov, _governor.maxScale);
+			_sceneLayer.Viewport[eye].Size = _eyeBaseSize[eye];
 			_sceneLayer.Viewport[eye].Pos = { (int)_renderTargetSize.x, 0 };
 
 			_renderTargetSize.y = std::max(_renderTargetSize.y, (uint32_t)eyeSize.h);
@@ -587,36 +850,68 @@ public:
 		// Make the on screen window 1/4 the resolution of the render target
 		_mirrorSize = _renderTargetSize;
 		_mirrorSize /= 4;
+
+		if (_hmdDesc.DisplayRefreshRate > 0.0f)
+			_governor.setFrameBudget(1000.0f / _hmdDesc.DisplayRefreshRate);
+
+		if (!trackingPlaybackPath.empty())
+		{
+			_tracking = std::make_unique<TrackingPlayback>(trackingPlaybackPath, trackingPlaybackSpeed);
+		}
+		else if (!trackingRecordPath.empty())
+		{
+			_tracking = std::make_unique<TrackingRecorder>(std::make_unique<HmdTrackingSource>(_hmd.get()),
+				trackingRecordPath, _hmdDesc.DisplayRefreshRate);
+		}
+		else
+		{
+			_tracking = std::make_unique<HmdTrackingSource>(_hmd.get());
+		}
 	}
 
 protected:
 
 	void update() final override {
 
-		ovrInputState inputState;
-		ovrTrackingState trackState = ovr_GetTrackingState(_session, 0.01, ovrTrue);
-
-		ovrPosef handPoses[2];
-		handPoses[0] = trackState.HandPoses[0].ThePose;
-		handPoses[1] = trackState.HandPoses[1].ThePose;
-		ovrVector3f handPosition[2];
-		handPosition[0] = handPoses[0].Position;
-		handPosition[1] = handPoses[1].Position;
+		if (!_tracking->next(_trackingSample) && !maxFrames)
+		{
+			// a replayed trace ran out
+			glfwSetWindowShouldClose(window, 1);
+		}
 
-		rot = mat4(mat3(me->toWorld)) * glm::toMat4(ovr::toGlm(handPoses[1].Orientation));
-		handPose = me->getRHandPose() * vec4(0, 0, 0, 1);
+		// the newest reply of the exchange thread, if one came in since the last frame;
+		// the frame never waits for the server
+		{
+			ProfileScope scope("take_server_reply");
+			take_server_reply();
+		}
 
-		me->updatePlayer(ovr::toGlm(trackState.HeadPose.ThePose), ovr::toGlm(handPoses[1]), ovr::toGlm(handPoses[0]));
+		{
+			ProfileScope scope("players");
+			ovrPosef handPoses[2];
+			handPoses[0] = _trackingSample.handPoses[0];
+			handPoses[1] = _trackingSample.handPoses[1];
+
+			me->updatePlayer(ovr::toRigid(_trackingSample.headPose), ovr::toRigid(handPoses[1]), ovr::toRigid(handPoses[0]));
+			// the audio thread gets the head by value, it never reads the player
+			RigidTransform head = me->getHeadPose();
+			audioThread.setListener(head.translation, normalize(head.transformVector(vec3(0, 0, -1))),
+				normalize(head.transformVector(vec3(0, 1, 0))));
+			{
+				ProfileScope scope("push_player");
+				push_player(me);
+			}
 
-		std::async(run_client, me, oppo);
-		//run_client(me, oppo);
+			if (op.headInWorld != RigidTransform()) { // when connected to opponent
+				RigidTransform worldToOppo = oppo->toWorld.inverse();
+				oppo->updatePlayer(worldToOppo * op.headInWorld, worldToOppo * op.rhandInWorld, worldToOppo * op.lhandInWorld);
+			}
+		}
 
 		//printf("ME: %d\n", me->heldWeapon);
 		//printf("MYWEAPON: %d\n", weapon_p1);
 		//printf("OPPO: %d\n", op.heldWeapon);
 		//PlayerInfo op = *(oppo->getPlayerInfo());
-		if (op.headInWorld != mat4(1)) // when connected to opponent
-			oppo->updatePlayer(inverse(oppo->toWorld) * op.headInWorld, inverse(oppo->toWorld) * op.rhandInWorld, inverse(oppo->toWorld) * op.lhandInWorld);
 		oppo->info->dead = op.dead;
 		if (op.dead != 0) {
 			if (op.dead > 0)
@@ -624,81 +919,15 @@ protected:
 			else
 				me->info->dead = 1;
 			if (!gameOver) {
-				aEngine.PlaySounds("scream.mp3", vec3(0), aEngine.VolumeTodB(0.5f));
+				GameEventStamp stamp;
+				stamp.detectedUs = death_us;
+				stamp.receivedUs = receive_us;
+				audioThread.play(soundScream, vec3(0), aEngine.VolumeTodB(0.5f), &stamp);
 				gameOver = true;
 			}
 		}
-		oppo_rot = glm::mat3(op.rhandInWorld);
-		oppo_handPose = op.rhandInWorld * vec4(0, 0, 0, 1);
 		oppo->heldWeapon = op.heldWeapon;
-
-		if (player_num == 1) {
-			switch (op.heldWeapon) {
-			case 1:
-				weapon_p2 = a_axe;
-				break;
-			case 3:
-				weapon_p2 = a_mace;
-				break;
-			case 5:
-				weapon_p2 = a_sword;
-				break;
-			case -1:
-				weapon_p2 = a_none;
-				break;
-			}
-		}
-
-		else {
-			switch (op.heldWeapon) {
-			case 0:
-				weapon_p2 = a_axe;
-				break;
-			case 2:
-				weapon_p2 = a_mace;
-				break;
-			case 4:
-				weapon_p2 = a_sword;
-				break;
-			case -1:
-				weapon_p2 = a_none;
-				break;
-			}
-		}
-
-		if (player_num == 1) {
-			switch (weapon_p1) {
-			case a_axe:
-				me->heldWeapon = 0;
-				break;
-			case a_mace:
-				me->heldWeapon = 2;
-				break;
-			case a_sword:
-				me->heldWeapon = 4;
-				break;
-			case a_none:
-				me->heldWeapon = -1;
-				break;
-			}
-		}
-
-		else {
-			switch (weapon_p1) {
-			case a_axe:
-				me->heldWeapon = 1;
-				break;
-			case a_mace:
-				me->heldWeapon = 3;
-				break;
-			case a_sword:
-				me->heldWeapon = 5;
-				break;
-			case a_none:
-				me->heldWeapon = -1;
-				break;
-			}
-		}
+		me->heldWeapon = attachedWeapon(weapon_p1, player_num == 1 ? 0 : 1);
 
 		int playCollisionSound = -1;
 		for (int i = 0; i < 6; i++) {
@@ -710,11 +939,16 @@ protected:
 
 
 		if (playCollisionSound >= 0) {
-			aEngine.PlaySounds("weapon-collide.mp3", vec3(0), aEngine.VolumeTodB(1.0f));
+			// timed from the server seeing the hit, see EventLatency
+			GameEventStamp stamp;
+			if (playCollisionSound < (int)weapon_break_us.size())
+				stamp.detectedUs = weapon_break_us[playCollisionSound];
+			stamp.receivedUs = receive_us;
+			audioThread.play(soundWeaponCollide, vec3(0), aEngine.VolumeTodB(1.0f), &stamp);
 		}
 
 
-		if (OVR_SUCCESS(ovr_GetInputState(_session, ovrControllerType_Touch, &inputState))) {
+		if (_trackingSample.inputValid) {
 			/*if (inputState.HandTrigger[ovrHand_Right] > 0.5f)
 			std::cerr << "right middle trigger pressed" << std::endl;
 			if (inputState.HandTrigger[ovrHand_Left] > 0.5f)
@@ -796,7 +1030,7 @@ protected:
 			}
 			*/
 
-			if (inputState.IndexTrigger[ovrHand_Right] > 0.5f) {
+			if (_trackingSample.indexTrigger[ovrHand_Right] > 0.5f) {
 				if (!pressedRIdx) {
 					std::cerr << "triggered" << std::endl;
 				}
@@ -831,40 +1065,11 @@ protected:
 		// Disable the v-sync for buffer swap
 		glfwSwapInterval(0);
 
-		ovrTextureSwapChainDesc desc = {};
-		desc.Type = ovrTexture_2D;
-		desc.ArraySize = 1;
-		desc.Width = _renderTargetSize.x;
-		desc.Height = _renderTargetSize.y;
-		desc.MipLevels = 1;
-		desc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
-		desc.SampleCount = 1;
-		desc.StaticImage = ovrFalse;
-		ovrResult result = ovr_CreateTextureSwapChainGL(_session, &desc, &_eyeTexture);
-		_sceneLayer.ColorTexture[0] = _eyeTexture;
-		if (!OVR_SUCCESS(result))
+		if (!_hmd->createSwapChain(_renderTargetSize.x, _renderTargetSize.y))
 		{
 			FAIL("Failed to create swap textures");
 		}
 
-		int length = 0;
-		result = ovr_GetTextureSwapChainLength(_session, _eyeTexture, &length);
-		if (!OVR_SUCCESS(result) || !length)
-		{
-			FAIL("Unable to count swap chain textures");
-		}
-		for (int i = 0; i < length; ++i)
-		{
-			GLuint chainTexId;
-			ovr_GetTextureSwapChainBufferGL(_session, _eyeTexture, i, &chainTexId);
-			glBindTexture(GL_TEXTURE_2D, chainTexId);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		}
-		glBindTexture(GL_TEXTURE_2D, 0);
-
 		// Set up the framebuffer object
 		glGenFramebuffers(1, &_fbo);
 		glGenRenderbuffers(1, &_depthBuffer);
@@ -875,16 +1080,173 @@ protected:
 		glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthBuffer);
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
-		ovrMirrorTextureDesc mirrorDesc;
-		memset(&mirrorDesc, 0, sizeof(mirrorDesc));
-		mirrorDesc.Format = OVR_FORMAT_R8G8B8A8_UNORM_SRGB;
-		mirrorDesc.Width = _mirrorSize.x;
-		mirrorDesc.Height = _mirrorSize.y;
-		if (!OVR_SUCCESS(ovr_CreateMirrorTextureGL(_session, &mirrorDesc, &_mirrorTexture)))
+		if (!_hmd->createMirrorTexture(_mirrorSize.x, _mirrorSize.y))
 		{
 			FAIL("Could not create mirror texture");
 		}
 		glGenFramebuffers(1, &_mirrorFbo);
+
+		initHiddenAreaMesh();
+		glGenQueries(SAMPLES_QUERIES, _samplesQueries);
+
+		_frameTiming = std::make_unique<GlFrameTiming>();
+		profiler.init();
+	}
+
+	// Picks this frame's viewport scale from the timings of finished frames and
+	// resizes both eye viewports inside the (oversized) swap chain
+	void updateResolutionScale()
+	{
+		float scale = 1.0f;
+		if (_dynamicResolution)
+		{
+			float cpuMs, gpuMs;
+			while (_frameTiming->poll(cpuMs, gpuMs))
+			{
+				_governor.update(cpuMs, gpuMs);
+			}
+
+			ovrPerfStats perfStats;
+			if (_hmd->getPerfStats(&perfStats) && perfStats.FrameStatsCount > 0)
+			{
+				_governor.applyCompositorHint(perfStats.AdaptiveGpuPerformanceScale);
+			}
+			scale = _governor.getScale();
+		}
+		_frameTiming->setScale(scale);
+
+		ovr::for_each_eye([&](ovrEyeType eye)
+		{
+			ovrSizei& size = _sceneLayer.Viewport[eye].Size;
+			size.w = std::min((int)(_eyeBaseSize[eye].w * scale), _eyeMaxSize[eye].w);
+			size.h = std::min((int)(_eyeBaseSize[eye].h * scale), _eyeMaxSize[eye].h);
+		});
+	}
+
+	void initHiddenAreaMesh()
+	{
+		_hiddenAreaShader = shaderCompiler.compile("../Shared/hiddenarea.vert", "../Shared/hiddenarea.frag");
+
+		ovr::for_each_eye([&](ovrEyeType eye)
+		{
+			ovrFovStencilDesc stencilDesc;
+			memset(&stencilDesc, 0, sizeof(stencilDesc));
+			stencilDesc.StencilType = ovrFovStencil_HiddenArea;
+			stencilDesc.StencilFlags = ovrFovStencilFlag_MeshOriginAtBottomLeft;
+			stencilDesc.Eye = eye;
+			stencilDesc.FovPort = _eyeRenderDescs[eye].Fov;
+			stencilDesc.HmdToEyeRotation = _eyeRenderDescs[eye].HmdToEyePose.Orientation;
+
+			// first call only queries the buffer sizes
+			ovrFovStencilMeshBuffer meshBuffer;
+			memset(&meshBuffer, 0, sizeof(meshBuffer));
+			if (!_hmd->getFovStencil(&stencilDesc, &meshBuffer) || meshBuffer.UsedIndexCount == 0)
+			{
+				std::cerr << "no hidden area mesh for eye " << eye << std::endl;
+				return;
+			}
+
+			std::vector<ovrVector2f> vertices(meshBuffer.UsedVertexCount);
+			std::vector<uint16_t> indices(meshBuffer.UsedIndexCount);
+			meshBuffer.AllocVertexCount = (int)vertices.size();
+			meshBuffer.VertexBuffer = vertices.data();
+			meshBuffer.AllocIndexCount = (int)indices.size();
+			meshBuffer.IndexBuffer = indices.data();
+			if (!_hmd->getFovStencil(&stencilDesc, &meshBuffer))
+			{
+				std::cerr << "failed to read hidden area mesh for eye " << eye << std::endl;
+				return;
+			}
+
+			glGenVertexArrays(1, &_hiddenAreaVao[eye]);
+			glGenBuffers(1, &_hiddenAreaVbo[eye]);
+			glGenBuffers(1, &_hiddenAreaEbo[eye]);
+
+			glBindVertexArray(_hiddenAreaVao[eye]);
+			glBindBuffer(GL_ARRAY_BUFFER, _hiddenAreaVbo[eye]);
+			glBufferData(GL_ARRAY_BUFFER, meshBuffer.UsedVertexCount * sizeof(ovrVector2f), vertices.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _hiddenAreaEbo[eye]);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshBuffer.UsedIndexCount * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ovrVector2f), (void*)0);
+			glBindVertexArray(0);
+
+			_hiddenAreaIndexCount[eye] = meshBuffer.UsedIndexCount;
+		});
+	}
+
+	// Writes the nearest depth over the hidden area of the current eye viewport, so the
+	// regular depth test discards all scene fragments there
+	void drawHiddenArea(ovrEyeType eye)
+	{
+		// the mask only saves fill, so frames go without it until its program is linked
+		if (!_hiddenAreaEnabled || !_hiddenAreaIndexCount[eye] || !_hiddenAreaShader.ready())
+			return;
+
+		GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+		GLint depthFunc = GL_LESS;
+		glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_ALWAYS);
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+		glUseProgram(_hiddenAreaShader.get());
+		glBindVertexArray(_hiddenAreaVao[eye]);
+		glDrawElements(GL_TRIANGLES, _hiddenAreaIndexCount[eye], GL_UNSIGNED_SHORT, 0);
+		glBindVertexArray(0);
+
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glDepthFunc(depthFunc);
+		if (!depthTest)
+			glDisable(GL_DEPTH_TEST);
+	}
+
+	// Accumulates the samples that reached the eye texture of every frame whose query
+	// has finished and prints the per-frame average once per second of frames, toggle
+	// the mask with H to compare
+	void collectFillRate()
+	{
+		while (_samplesQueriesPending)
+		{
+			int oldest = (_samplesQueryHead + SAMPLES_QUERIES - _samplesQueriesPending) % SAMPLES_QUERIES;
+			GLint available = 0;
+			glGetQueryObjectiv(_samplesQueries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				return;
+
+			GLuint64 samples = 0;
+			glGetQueryObjectui64v(_samplesQueries[oldest], GL_QUERY_RESULT, &samples);
+			_samplesQueriesPending--;
+			_samplesPassed += samples;
+			if (++_samplesFrames == 90)
+			{
+				GLuint64 total = (GLuint64)_renderTargetSize.x * _renderTargetSize.y;
+				GLuint64 average = _samplesPassed / _samplesFrames;
+				printf("fill rate (hidden area %s): %llu samples/frame, %.1f%% of render target, %u frame(s) unmeasured with the GPU behind\n",
+					_hiddenAreaEnabled ? "on" : "off", (unsigned long long)average, 100.0 * average / total, _samplesSkipped);
+				_samplesPassed = 0;
+				_samplesFrames = 0;
+				_samplesSkipped = 0;
+			}
+		}
+	}
+
+	void shutdownGl() override
+	{
+		ovr::for_each_eye([&](ovrEyeType eye)
+		{
+			if (_hiddenAreaVao[eye])
+			{
+				glDeleteVertexArrays(1, &_hiddenAreaVao[eye]);
+				glDeleteBuffers(1, &_hiddenAreaVbo[eye]);
+				glDeleteBuffers(1, &_hiddenAreaEbo[eye]);
+			}
+		});
+		_frameTiming.reset();
+		profiler.shutdown();
+		glDeleteQueries(SAMPLES_QUERIES, _samplesQueries);
+		glDeleteProgram(_hiddenAreaShader.get());
+		GlfwApp::shutdownGl();
 	}
 
 	void onKey(int key, int scancode, int action, int mods) override
@@ -893,8 +1255,39 @@ protected:
 			switch (key)
 			{
 			case GLFW_KEY_R:
-				ovr_RecenterTrackingOrigin(_session);
+				_hmd->recenter();
+
+				return;
+
+			case GLFW_KEY_H:
+				_hiddenAreaEnabled = !_hiddenAreaEnabled;
+				std::cerr << "hidden area mask " << (_hiddenAreaEnabled ? "on" : "off") << std::endl;
+				// frames still in flight were drawn with the old setting
+				_samplesQueriesPending = 0;
+				_samplesPassed = 0;
+				_samplesFrames = 0;
+				_samplesSkipped = 0;
+				return;
+
+			case GLFW_KEY_G:
+				_dynamicResolution = !_dynamicResolution;
+				std::cerr << "dynamic resolution " << (_dynamicResolution ? "on" : "off") << std::endl;
+				return;
+
+			case GLFW_KEY_O:
+				profiler.showOverlay = !profiler.showOverlay;
+				return;
+
+			case GLFW_KEY_T:
+				profiler.writeChromeTrace("frame_trace.json");
+				return;
 
+			case GLFW_KEY_F:
+				_measureFillRate = !_measureFillRate;
+				std::cerr << "fill rate measurement " << (_measureFillRate ? "on" : "off") << std::endl;
+				_samplesPassed = 0;
+				_samplesFrames = 0;
+				_samplesSkipped = 0;
 				return;
 			}
 
@@ -904,40 +1297,85 @@ protected:
 	void draw() final override
 	{
 		ovrPosef eyePoses[2];
-		ovr_GetEyePoses(_session, frame, true, _viewScaleDesc.HmdToEyePose, eyePoses, &_sceneLayer.SensorSampleTime);
+		_hmd->getEyePoses(frame, _viewScaleDesc.HmdToEyePose, eyePoses, &_sceneLayer.SensorSampleTime);
+		if (_tracking->overridesHeadPose())
+		{
+			ovr::for_each_eye([&](ovrEyeType eye)
+			{
+				eyePoses[eye] = composePoses(_trackingSample.headPose, _viewScaleDesc.HmdToEyePose[eye]);
+			});
+		}
+
+		updateResolutionScale();
+		_frameTiming->beginFrame();
 
-		int curIndex;
-		ovr_GetTextureSwapChainCurrentIndex(_session, _eyeTexture, &curIndex);
-		GLuint curTexId;
-		ovr_GetTextureSwapChainBufferGL(_session, _eyeTexture, curIndex, &curTexId);
+		GLuint curTexId = _hmd->getCurrentSwapTexture();
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _fbo);
 		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, curTexId, 0);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		_samplesQueryIssued = false;
+		if (_measureFillRate)
+		{
+			// the slot to reuse holds the oldest unread result: read it if it came in since
+			// the last frame, otherwise leave it be and skip this frame
+			if (_samplesQueriesPending == SAMPLES_QUERIES)
+				collectFillRate();
+			if (_samplesQueriesPending < SAMPLES_QUERIES)
+			{
+				glBeginQuery(GL_SAMPLES_PASSED, _samplesQueries[_samplesQueryHead]);
+				_samplesQueryIssued = true;
+			}
+			else
+			{
+				_samplesSkipped++;
+			}
+		}
 		ovr::for_each_eye([&](ovrEyeType eye)
 		{
 			const auto& vp = _sceneLayer.Viewport[eye];
 			glViewport(vp.Pos.x, vp.Pos.y, vp.Size.w, vp.Size.h);
 			_sceneLayer.RenderPose[eye] = eyePoses[eye];
 
+			ProfileScope scope(eye == ovrEye_Left ? "renderScene left" : "renderScene right", true);
+			drawHiddenArea(eye);
+
 			eyePose = ovr::toGlm(eyePoses[eye].Position);
-			renderScene(_eyeProjections[eye], ovr::toGlm(eyePoses[eye]));
+			renderScene(_eyeProjections[eye], ovr::toRigid(eyePoses[eye]));
 		});
+		if (_samplesQueryIssued)
+		{
+			glEndQuery(GL_SAMPLES_PASSED);
+			_samplesQueryHead = (_samplesQueryHead + 1) % SAMPLES_QUERIES;
+			_samplesQueriesPending++;
+		}
+		_frameTiming->endFrame();
 		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-		ovr_CommitTextureSwapChain(_session, _eyeTexture);
-		ovrLayerHeader* headerList = &_sceneLayer.Header;
-		ovr_SubmitFrame(_session, frame, &_viewScaleDesc, &headerList, 1);
+		_hmd->commitSwapChain();
+		{
+			ProfileScope scope("ovr_SubmitFrame");
+			_hmd->submitFrame(frame, &_viewScaleDesc, &_sceneLayer);
+		}
 
-		GLuint mirrorTextureId;
-		ovr_GetMirrorTextureBufferGL(_session, _mirrorTexture, &mirrorTextureId);
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, _mirrorFbo);
-		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mirrorTextureId, 0);
-		glBlitFramebuffer(0, 0, _mirrorSize.x, _mirrorSize.y, 0, _mirrorSize.y, _mirrorSize.x, 0, GL_COLOR_BUFFER_BIT,
-			GL_NEAREST);
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		{
+			ProfileScope scope("mirror blit", true);
+			GLuint mirrorTextureId = _hmd->getMirrorTexture();
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, _mirrorFbo);
+			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mirrorTextureId, 0);
+			glBlitFramebuffer(0, 0, _mirrorSize.x, _mirrorSize.y, 0, _mirrorSize.y, _mirrorSize.x, 0, GL_COLOR_BUFFER_BIT,
+				GL_NEAREST);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		}
+
+		if (profiler.showOverlay)
+		{
+			profiler.drawOverlay(_mirrorSize.x, _mirrorSize.y, _governor.getFrameBudgetMs());
+		}
+
+		collectFillRate();
 	}
 
-	virtual void renderScene(const glm::mat4& projection, const glm::mat4& headPose) = 0;
+	virtual void renderScene(const glm::mat4& projection, const RigidTransform& headPose) = 0;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -957,56 +1395,19 @@ class Scene
 	GLuint instanceCount;
 	GLuint shaderID;
 	GLuint secondShader;
+	PendingProgram skyboxProgram;
+	PendingProgram meshProgram;
 
-	vector<mat4> axes;
-	vector<mat4> swords;
-	vector<mat4> maces;
-
-
-	vector<vec3> axe_pos;
-	vector<vec3> sword_pos;
-	vector<vec3> mace_pos;
-
-	vec3 axe_handle;
-	vec3 mace_handle;
-	vec3 sword_handle;
-
-	mat4 axe_sphere_trans;
-	mat4 mace_sphere_trans;
-	mat4 sword_sphere_trans;
-
-	mat4 axe_collision_trans;
-	mat4 mace_collision_trans;
-	mat4 sword_collision_trans;
-
-	vector<mat4> axe_collision;
-	vector<mat4> mace_collision;
-	vector<mat4> sword_collision;
-
-	vector<mat4> mace_sphere;
-	vector<mat4> axe_sphere;
-	vector<mat4> sword_sphere;
-
-	vec3 mace_head;
-	vec3 axe_head;
-	vec3 sword_head;
-
-	float axe_head_radius;
-	float mace_head_radius;
-	float sword_head_radius;
-
-	vector<mat4> axe_rots;
-	vector<mat4> mace_rots;
-	vector<mat4> sword_rots;
+	// the fight as the server runs it; here it only places the weapons and finds grabs
+	Simulation sim;
 
 	mat4 player_trans;
 
 	float pi = 3.141592653589793;
 
 
-	Model * sword;
-	Model * axe;
-	Model * mace;
+	// by WeaponType, the weapons' renderable mesh
+	std::shared_ptr<Model> weaponModels[WEAPON_TYPES];
 
 
 
@@ -1025,88 +1426,18 @@ public:
 
 		instanceCount = instance_positions.size();
 
-		// Shader Program 
-		shaderID = LoadShaders("../Shared/skybox.vert", "../Shared/skybox.frag");
-		secondShader = LoadShaders("../Shared/shader.vert", "../Shared/shader.frag");
+		// Shader Program, linked while the rest of the scene loads
+		skyboxProgram = shaderCompiler.compile("../Shared/skybox.vert", "../Shared/skybox.frag");
+		meshProgram = shaderCompiler.compile("../Shared/shader.vert", "../Shared/shader.frag");
 
-		cube = std::make_unique<TexturedCube>("../Shared/cube");
+		cube = std::make_unique<TexturedCube>(assets, "../Shared/cube");
 
 		//sphere
-		mace = new Model("../Shared/mace/WARROIRS_MACE.obj");
-		axe = new Model("../Shared/fbx/axe.obj");
-		sword = new Model("../Shared/sword/untitled.obj");
-
-		axe_handle = vec3(0, -0.1, -0.01);
-		mace_handle = vec3(0.005, -0.2, 0);
-		sword_handle = vec3(-0.005, -0.22, 0);
-
-		axe_head = vec3(0, 0.3, 0);
-		mace_head = vec3(0, 0.42, 0);
-
-		axes.push_back(glm::rotate(90 * pi / 180.0f, vec3(1, 0, 0))* glm::rotate(180 * pi / 180.0f, vec3(0, 0, 1)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.01f)) * glm::mat4(1));
-		axes.push_back(glm::rotate(90 * pi / 180.0f, vec3(1, 0, 0))* glm::rotate(180 * pi / 180.0f, vec3(0, 0, 1)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.01f)) * glm::mat4(1));
-
-		maces.push_back(glm::rotate(90 * pi / 180.0f, vec3(1, 0, 0))* glm::rotate(270 * pi / 180.0f, vec3(1, 0, 0)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.7f)) * glm::mat4(1));
-		maces.push_back(glm::rotate(90 * pi / 180.0f, vec3(1, 0, 0))* glm::rotate(270 * pi / 180.0f, vec3(1, 0, 0)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.7f)) * glm::mat4(1));
-
-		swords.push_back(glm::rotate(-90 * pi / 180.0f, vec3(0, 1, 0))* glm::rotate(270 * pi / 180.0f, vec3(1, 0, 0)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.1f)) * glm::mat4(1));
-		swords.push_back(glm::rotate(-90 * pi / 180.0f, vec3(0, 1, 0))* glm::rotate(270 * pi / 180.0f, vec3(1, 0, 0)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.1f)) * glm::mat4(1));
-
-		/*
-		axe_pos.push_back(glm::vec3(0, 0, -0.4));
-		axe_pos.push_back(vec3(0, 0, -0.2));
-		axe_rots.push_back(mat4(1));
-		axe_rots.push_back(mat4(1));
-
-		mace_pos.push_back(glm::vec3(0.3, 0.05, -0.4));
-		mace_pos.push_back(glm::vec3(0.3, 0.05, -0.2));
-		mace_rots.push_back(mat4(1));
-		mace_rots.push_back(mat4(1));
-
-		sword_pos.push_back(glm::vec3(-0.3, 0, -0.4));
-		sword_pos.push_back(glm::vec3(-0.3, 0, -0.2));
-		sword_rots.push_back(mat4(1));
-		sword_rots.push_back(mat4(1));
-		*/
-
-
-		axe_pos.push_back(vec3( glm::rotate(mat4(1), glm::pi<float>() / 2.0f, vec3(0, 1, 0)) * translate(mat4(1), glm::vec3(0, 0.0, 0.7)) * vec4(0, 0, 0, 1)));
-		axe_pos.push_back(vec3(glm::rotate(mat4(1), glm::pi<float>() / 2.0f, vec3(0, 1, 0)) * translate(mat4(1), glm::vec3(0, 0.0, -0.7)) * vec4(0, 0, 0, 1)));
-		axe_rots.push_back(mat4(1));
-		axe_rots.push_back(mat4(1));
-
-		mace_pos.push_back(vec3(glm::rotate(mat4(1), glm::pi<float>() / 2.0f, vec3(0, 1, 0)) * translate(mat4(1), glm::vec3(0.2, 0.10, 0.7)) * vec4(0, 0, 0, 1)));
-		mace_pos.push_back(vec3(glm::rotate(mat4(1), glm::pi<float>() / 2.0f, vec3(0, 1, 0)) * translate(mat4(1), glm::vec3(0.2, 0.10, -0.7)) * vec4(0, 0, 0, 1)));
-		mace_rots.push_back(mat4(1));
-		mace_rots.push_back(mat4(1));
-
-		sword_pos.push_back(vec3(glm::rotate(mat4(1), glm::pi<float>() / 2.0f, vec3(0, 1, 0)) * translate(mat4(1), glm::vec3(-0.2, 0.1, 0.7)) * vec4(0, 0, 0, 1)));
-		sword_pos.push_back(vec3(glm::rotate(mat4(1), glm::pi<float>() / 2.0f, vec3(0, 1, 0)) * translate(mat4(1), glm::vec3(-0.2, 0.1, -0.7)) * vec4(0, 0, 0, 1)));
-		sword_rots.push_back(mat4(1));
-		sword_rots.push_back(mat4(1));
-
-		axe_head_radius = 0.13;
-		axe_sphere_trans = glm::translate(axe_handle) *  glm::scale(glm::mat4(1.0f), glm::vec3(0.04f)) * glm::mat4(1);
-		axe_collision_trans = (glm::translate(axe_head) * glm::scale(vec3(axe_head_radius)));
-
-		mace_head_radius = 0.08;
-		mace_sphere_trans = glm::translate(mace_handle) *  glm::scale(glm::mat4(1.0f), glm::vec3(0.03f)) * glm::mat4(1);
-		mace_collision_trans = (glm::translate(mace_head) * glm::scale(vec3(mace_head_radius)));
-
-		sword_sphere_trans = glm::translate(sword_handle) *  glm::scale(glm::mat4(1.0f), glm::vec3(0.03f)) * glm::mat4(1);
+		weaponModels[WEAPON_MACE] = Model::load(assets, "../Shared/mace/WARROIRS_MACE.obj");
+		weaponModels[WEAPON_AXE] = Model::load(assets, "../Shared/fbx/axe.obj");
+		weaponModels[WEAPON_SWORD] = Model::load(assets, "../Shared/sword/untitled.obj");
 
 		weapon_p1 = a_none;
-		weapon_p2 = a_none;
-
-		for (int i = 0; i < 2; i++) {
-			axe_collision.push_back(mat4(1));
-			mace_collision.push_back(mat4(1));
-			sword_collision.push_back(mat4(1));
-
-			mace_sphere.push_back(mat4(1));
-			axe_sphere.push_back(mat4(1));
-			sword_sphere.push_back(mat4(1));
-		}
 
 		for (int i = 0; i < 6; i++) {
 			weapon_state[i] = true;
@@ -1114,12 +1445,16 @@ public:
 
 
 		// 10m wide sky box: size doesn't matter though
-		skybox = std::make_unique<Skybox>("../Shared/skybox");
+		skybox = std::make_unique<Skybox>(assets, "../Shared/skybox");
 		skybox->toWorld = glm::scale(glm::mat4(1.0f), glm::vec3(5.0f));
 	}
 
 	void render(const glm::mat4& projection, const glm::mat4& view)
 	{
+		// waits for the programs on the first frame only
+		shaderID = skyboxProgram.get();
+		secondShader = meshProgram.get();
+
 		// Render two cubes
 		for (int i = 0; i < instanceCount; i++)
 		{
@@ -1141,66 +1476,16 @@ public:
 		skybox->draw(shaderID, projection, view);
 
 
-		glm::mat4 sphereToWorld;
-
-		if (weapon_p1 == a_axe) {
-			axe_rots[(player_num == 1 ? 0 : 1)] = rot * glm::rotate(-90 * pi / 180.0f, vec3(0, 1, 0)) * glm::rotate(30 * pi / 180.0f, vec3(0, 0, 1));
-			axe_pos[(player_num == 1 ? 0 : 1)] = handPose - (mat3(axe_rots[player_num == 1 ? 0 : 1]) * axe_handle);
-		}
-
-		else if (weapon_p1 == a_mace) {
-			mace_rots[(player_num == 1 ? 0 : 1)] = rot * glm::rotate(-90 * pi / 180.0f, vec3(0, 1, 0)) * glm::rotate(30 * pi / 180.0f, vec3(0, 0, 1));
-			mace_pos[(player_num == 1 ? 0 : 1)] = handPose - (mat3(mace_rots[player_num == 1 ? 0 : 1]) * mace_handle);
-			/*
-			int i = (player_num == 1 ? 0 : 1);
-
-			vec3 macecollisionpos = glm::translate(mace_pos[i]) * mace_rots[i] * mace_collision_trans * vec4(0,0,0,1);
-			float dist = glm::distance(vec3(op.headInWorld * vec4(0,0,0,1)), macecollisionpos);
-			
-			printf("%f\n", dist);*/
-
-		}
-
-		else if (weapon_p1 == a_sword) {
-			sword_rots[(player_num == 1 ? 0 : 1)] = rot * glm::rotate(-90 * pi / 180.0f, vec3(0, 1, 0)) * glm::rotate(30 * pi / 180.0f, vec3(0, 0, 1));
-			sword_pos[(player_num == 1 ? 0 : 1)] = handPose - (mat3(sword_rots[player_num == 1 ? 0 : 1]) * sword_handle);
-		}
-
-		if (weapon_p2 == a_axe) {
-			axe_rots[(player_num == 1 ? 1 : 0)] = oppo_rot * glm::rotate(-90 * pi / 180.0f, vec3(0, 1, 0)) * glm::rotate(30 * pi / 180.0f, vec3(0, 0, 1));
-			axe_pos[(player_num == 1 ? 1 : 0)] = oppo_handPose - (mat3(axe_rots[player_num == 1 ? 1 : 0]) * axe_handle);
-		}
-
-		else if (weapon_p2 == a_mace) {
-			mace_rots[(player_num == 1 ? 1 : 0)] = oppo_rot * glm::rotate(-90 * pi / 180.0f, vec3(0, 1, 0)) * glm::rotate(30 * pi / 180.0f, vec3(0, 0, 1));
-			mace_pos[(player_num == 1 ? 1 : 0)] = oppo_handPose - (mat3(mace_rots[player_num == 1 ? 1 : 0]) * mace_handle);
-		}
-
-		else if (weapon_p2 == a_sword) {
-			sword_rots[(player_num == 1 ? 1 : 0)] = oppo_rot * glm::rotate(-90 * pi / 180.0f, vec3(0, 1, 0)) * glm::rotate(30 * pi / 180.0f, vec3(0, 0, 1));
-			sword_pos[(player_num == 1 ? 1 : 0)] = oppo_handPose - (mat3(sword_rots[player_num == 1 ? 1 : 0]) * sword_handle);
-		}
+		// the held weapons follow the hands, as on the server
+		int mine = (player_num == 1 ? 0 : 1);
+		sim.applyInput(mine, *me->getPlayerInfo());
+		sim.applyInput(1 - mine, op);
 
 		if (!prev_frame_idx && pressedRIdx) {
-			float dist = glm::distance(handPose, vec3(axe_sphere[(player_num == 1 ? 0 : 1)] * vec4(0.0f, 0.0f, 0.0f, 1.0f)));
-			if (dist < 0.04) {
-				weapon_p1 = a_axe;
-				aEngine.PlaySounds("hold-weapon.mp3", vec3(axe_sphere[(player_num == 1 ? 0 : 1)] * vec4(0.0f, 0.0f, 0.0f, 1.0f)), aEngine.VolumeTodB(1.0f));
-			}
-
-			dist = glm::distance(handPose, vec3(mace_sphere[(player_num == 1 ? 0 : 1)] * vec4(0.0f, 0.0f, 0.0f, 1.0f)));
-			//printf("%f\n", dist);
-			if (dist < 0.04) {
-				weapon_p1 = a_mace;
-				aEngine.PlaySounds("hold-weapon.mp3", vec3(mace_sphere[(player_num == 1 ? 0 : 1)] * vec4(0.0f, 0.0f, 0.0f, 1.0f)), aEngine.VolumeTodB(1.0f));
-
-			}
-
-			dist = glm::distance(handPose, vec3(sword_sphere[(player_num == 1 ? 0 : 1)] * vec4(0.0f, 0.0f, 0.0f, 1.0f)));
-			if (dist < 0.04) {
-				weapon_p1 = a_sword;
-				aEngine.PlaySounds("hold-weapon.mp3", vec3(sword_sphere[(player_num == 1 ? 0 : 1)] * vec4(0.0f, 0.0f, 0.0f, 1.0f)), aEngine.VolumeTodB(1.0f));
-
+			int grabbed = sim.grab(mine, me->getRHandPose().translation);
+			if (grabbed >= 0) {
+				weapon_p1 = WEAPON_ATTACH[weaponType(grabbed)];
+				audioThread.play(soundHoldWeapon, gripPosition(sim.world, sim.weapons[grabbed]), aEngine.VolumeTodB(1.0f));
 			}
 		}
 		else if (!pressedRIdx) {
@@ -1227,145 +1512,34 @@ public:
 
 
 
-		//Drawing the weapons
+		//Drawing the weapons, one sweep over the renderables
 		glUseProgram(secondShader);
 
 		vec3 sphereColor = vec3(0.5, 0.5, 1);
-
-		//axe
-		if (weapon_state[0] == true) {
-			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &(vec3(1, 0, 0))[0]);
-			sphereToWorld = glm::translate(glm::mat4(1.0), axe_pos[0]) * axe_rots[0] * glm::translate(-axe_handle) * axes[0];
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(sphereToWorld)[0][0]);
-			axe->Draw(secondShader);
-
-
-			//Axe sphere
-			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &sphereColor[0]);
-			axe_sphere[0] = glm::translate(axe_pos[0]) * axe_rots[0] * axe_sphere_trans;
-			glUniform1i(glGetUniformLocation(secondShader, "transparent"), 1);
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(axe_sphere[0])[0][0]);
-			sphere->Draw(secondShader);
-			glUniform1i(glGetUniformLocation(secondShader, "transparent"), 0); 
-			glDisable(GL_BLEND);
-
-			//Axe collision
-			axe_collision[0] = glm::translate(axe_pos[0]) * axe_rots[0] * axe_collision_trans;
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(axe_collision[0])[0][0]);
-			//sphere->Draw(secondShader);
-
-		}
-		if (weapon_state[1] == true) {
-			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &(vec3(1, 0, 0))[0]);
-			sphereToWorld = glm::translate(glm::mat4(1.0), axe_pos[1]) * axe_rots[1] * glm::translate(-axe_handle) * axes[1];
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(sphereToWorld)[0][0]);
-			axe->Draw(secondShader);
-
-			//Axe sphere
-			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &sphereColor[0]);
-			axe_sphere[1] = glm::translate(axe_pos[1]) * axe_rots[1] * axe_sphere_trans;
-			glUniform1i(glGetUniformLocation(secondShader, "transparent"), 1);
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(axe_sphere[1])[0][0]);
-			sphere->Draw(secondShader);
-			glUniform1i(glGetUniformLocation(secondShader, "transparent"), 0);
-			glDisable(GL_BLEND);
-
-			//Axe collision
-			axe_collision[1] = glm::translate(axe_pos[1]) * axe_rots[1] * axe_collision_trans;
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(axe_collision[1])[0][0]);
-			//sphere->Draw(secondShader);
-		}
-
-		//mace
-		if (weapon_state[2] == true) {
-			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &(vec3(0, 1, 0))[0]);
-			sphereToWorld = glm::translate(glm::mat4(1.0), mace_pos[0]) * mace_rots[0] * glm::translate(-mace_handle) * maces[0];
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(sphereToWorld)[0][0]);
-			mace->Draw(secondShader);
-
-			//Mace sphere
-			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &sphereColor[0]);
-			mace_sphere[0] = glm::translate(mace_pos[0]) * mace_rots[0] * mace_sphere_trans;
-			glUniform1i(glGetUniformLocation(secondShader, "transparent"), 1);
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(mace_sphere[0])[0][0]);
-			sphere->Draw(secondShader);
-			glUniform1i(glGetUniformLocation(secondShader, "transparent"), 0);
-			glDisable(GL_BLEND);
-
-
-			//Mace collision
-			mace_collision[0] = glm::translate(mace_pos[0]) * mace_rots[0] * mace_collision_trans;
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(mace_collision[0])[0][0]);
-			//sphere->Draw(secondShader);
-		}
-		if (weapon_state[3] == true) {
-			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &(vec3(0, 1, 0))[0]);
-			sphereToWorld = glm::translate(glm::mat4(1.0), mace_pos[1]) * mace_rots[1] * glm::translate(-mace_handle) * maces[1];
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(sphereToWorld)[0][0]);
-			mace->Draw(secondShader);
-
-			//Mace sphere
-			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &sphereColor[0]);
-			mace_sphere[1] = glm::translate(mace_pos[1]) * mace_rots[1] * mace_sphere_trans;
-			glUniform1i(glGetUniformLocation(secondShader, "transparent"), 1);
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(mace_sphere[1])[0][0]);
-			sphere->Draw(secondShader);
-			glUniform1i(glGetUniformLocation(secondShader, "transparent"), 0);
-			glDisable(GL_BLEND);
-
-			//Mace collision
-			mace_collision[1] = glm::translate(mace_pos[1]) * mace_rots[1] * mace_collision_trans;
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(mace_collision[1])[0][0]);
-			//sphere->Draw(secondShader);
-		}
-
-		//sword
-		if (weapon_state[4] == true) {
-			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &(vec3(0, 0, 1))[0]);
-			sphereToWorld = glm::translate(glm::mat4(1.0), sword_pos[0]) * sword_rots[0] * glm::translate(-sword_handle) * swords[0];
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(sphereToWorld)[0][0]);
-			sword->Draw(secondShader);
-
-			//Sword sphere
+		Renderables& renderables = sim.world.renderables;
+		for (int i = 0; i < WEAPONS; i++)
+			renderables.visible[renderables.slot(sim.weapons[i])] = weapon_state[i];
+		// by renderable slot, in the frame arena: they are gone before the next frame
+		ArenaVector<mat4> weaponModelMatrices(renderables.size());
+		ArenaVector<mat4> gripModelMatrices(renderables.size());
+		weaponMatrices(sim.world, 0, renderables.size(), weaponModelMatrices.data(), gripModelMatrices.data());
+
+		for (size_t i = 0; i < renderables.size(); i++) {
+			if (!renderables.visible[i])
+				continue;
+			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &(renderables.color[i])[0]);
+			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(weaponModelMatrices[i])[0][0]);
+			weaponModels[renderables.mesh[i]]->Draw(secondShader);
+
+			//Grip sphere
 			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &sphereColor[0]);
-			sword_sphere[0] = glm::translate(sword_pos[0]) * sword_rots[0] * sword_sphere_trans;
 			glUniform1i(glGetUniformLocation(secondShader, "transparent"), 1);
 			glEnable(GL_BLEND);
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(sword_sphere[0])[0][0]);
+			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(gripModelMatrices[i])[0][0]);
 			sphere->Draw(secondShader);
 			glUniform1i(glGetUniformLocation(secondShader, "transparent"), 0);
 			glDisable(GL_BLEND);
-
-			//Sword collision
-
-		}
-
-		if (weapon_state[5] == true) {
-			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &(vec3(0, 0, 1))[0]);
-			sphereToWorld = glm::translate(glm::mat4(1.0), sword_pos[1]) * sword_rots[1] * glm::translate(-sword_handle) * swords[1];
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(sphereToWorld)[0][0]);
-			sword->Draw(secondShader);
-
-			//Sword sphere
-			glUniform3fv(glGetUniformLocation(secondShader, "objectColor"), 1, &sphereColor[0]);
-			sword_sphere[1] = glm::translate(sword_pos[1]) * sword_rots[1] * sword_sphere_trans;
-			glUniform1i(glGetUniformLocation(secondShader, "transparent"), 1);
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glUniformMatrix4fv(glGetUniformLocation(secondShader, "model"), 1, GL_FALSE, &(sword_sphere[1])[0][0]);
-			sphere->Draw(secondShader);
-			glUniform1i(glGetUniformLocation(secondShader, "transparent"), 0);
-			glDisable(GL_BLEND);
-			//Sword collision
 		}
 
 		prev_frame_idx = pressedRIdx;
@@ -1379,83 +1553,542 @@ class ExampleApp : public RiftApp
 	std::shared_ptr<Scene> scene;
 
 public:
+	// expected image checksum of a headless benchmark run, empty to only print it
+	std::string goldenChecksum;
+
 	ExampleApp()
 	{
 	}
 
+	void setBenchmark(unsigned int frames, const std::string& golden)
+	{
+		maxFrames = frames;
+		goldenChecksum = golden;
+	}
+
 protected:
 	void initGl() override
 	{
 		RiftApp::initGl();
 		glClearColor(0.2f, 0.2f, 0.2f, 0.0f);
 		glEnable(GL_DEPTH_TEST);
-		ovr_RecenterTrackingOrigin(_session);
+		_hmd->recenter();
 		scene = std::shared_ptr<Scene>(new Scene());
 	}
 
 	void shutdownGl() override
 	{
+		// uploads still queued point into the scene
+		assets.cancelAll();
 		scene.reset();
+		RiftApp::shutdownGl();
 	}
 
-	void renderScene(const glm::mat4& projection, const glm::mat4& headPose) override
+	// Adds a checksum of the last rendered eye texture to the frame statistics, so a
+	// headless run can be compared against a golden image from an earlier run
+	int reportBenchmark() override
 	{
-		scene->render(projection, glm::inverse(me->toWorld * headPose));
-	}
-};
+		int result = RiftApp::reportBenchmark();
+
+		HeadlessHmdSession* headlessHmd = dynamic_cast<HeadlessHmdSession*>(_hmd.get());
+		std::vector<unsigned char> pixels;
+		int width, height;
+		if (!headlessHmd || !headlessHmd->readLastFrame(pixels, width, height))
+			return result;
 
-void AudioUpdate(CAudioEngine* engine) {
-	while (1) {
-		//engine->Update();
-		if (me != nullptr) {
-			vec3 listenerPos = vec3(me->getHeadPose() * vec4(0, 0, 0, 1));
-			vec3 listenerDir = normalize(vec3(me->getHeadPose() * vec4(0, 0, -1, 0))); // need to be normalized
-			engine->Set3dListenerAndOrientation(listenerPos, listenerDir, vec3(0, 1, 0));
+		// FNV-1a 64
+		unsigned long long hash = 14695981039346656037ULL;
+		for (unsigned char b : pixels)
+		{
+			hash ^= b;
+			hash *= 1099511628211ULL;
+		}
+		printf("image checksum: %016llx (%dx%d)\n", hash, width, height);
+
+		if (!goldenChecksum.empty())
+		{
+			if (strtoull(goldenChecksum.c_str(), nullptr, 16) != hash)
+			{
+				printf("image checksum does not match golden %s\n", goldenChecksum.c_str());
+				return 1;
+			}
+			printf("image checksum matches golden\n");
 		}
+		return result;
 	}
-}
+
+	void renderScene(const glm::mat4& projection, const RigidTransform& headPose) override
+	{
+		// the view is the only matrix a pose becomes
+		scene->render(projection, (me->toWorld * headPose).inverse().toMat4());
+	}
+};
 
 // Execute our example class
+//
+//   Minimal.exe                                    play on the Rift
+//   Minimal.exe --headless [frames] [--golden X]   render offline with a fake HMD, no server,
+//                                                  print frame times and an image checksum; on
+//                                                  Linux it needs an X or Wayland display (Xvfb
+//                                                  will do) unless built with MINIMALVR_OSMESA
+//   --record-tracking FILE                         record head, hands and buttons while playing
+//   --play-tracking FILE [speed]                   replay a recorded trace instead of the tracker,
+//                                                  speed 0 steps one record per frame
+//   --cook                                         write the mesh cache of every model, the
+//                                                  compressed textures, the skybox container and
+//                                                  the sounds decoded to WAV, in parallel and only
+//                                                  those whose sources or settings changed since
+//                                                  the last cook, then exit
+//   --recook                                       --cook everything
+//   --no-cooked-assets                             load through Assimp, stb_image and the PPM faces
+//                                                  even if cooked
+//   --vertex-format full|packed|quantized          mesh vertex layout (default quantized), for
+//                                                  --cook and loading alike
+//   --pack [archive]                               pack every model with its materials and cooked
+//                                                  files, the textures, skybox, shaders and sounds
+//                                                  into one archive (default ../Shared/assets.mvrpak),
+//                                                  after --cook if both are given, then exit
+//   --no-archive                                   read loose files even if the archive is there
+//   --no-shader-cache                              always compile shaders, never load or write the
+//                                                  program binaries next to them (*.mvrprog)
+//   --no-obj-loader                                import OBJ files with Assimp instead of ObjLoader
+//   --obj-check                                    compare ObjLoader against Assimp on every model
+//                                                  and the OBJ files in check/, then exit
+//   --texture-check                                encode and decode every BCn format and round-trip
+//                                                  a texture container, fail below the PSNR floor,
+//                                                  then exit
+//   --obj-benchmark [runs]                         OBJ parse throughput in MB/s, ObjLoader on 1..N
+//                                                  threads and Assimp, best of runs (default 10)
+//   --audio fmod|software                          play through FMOD (default) or mix in software,
+//                                                  which --headless defaults to
+//   --audio-wav FILE                               mix in software and write what is heard to FILE
+//   --audio-benchmark [voices]                     software mixer throughput in voice-ms per ms with
+//                                                  SSE2 and scalar kernels (default 64 voices), then exit
+//   --jobs N                                       the most threads --job-benchmark scales to, the
+//                                                  main one included (default: the hardware threads)
+//   --job-benchmark [weapons]                      frame time of the weapon sweeps as jobs on 1..N
+//                                                  threads (default 60000 weapons), then exit
+//   --sim-benchmark [ticks]                        step a scripted fight in the shared simulation
+//                                                  (default 100000 ticks), print the time per tick
+//                                                  and the state checksum every build must match,
+//                                                  then exit
+//   --expect-checksum X                            with --sim-benchmark, fail unless the state
+//                                                  checksum is X (hex)
+//   --governor-check                               run the dynamic resolution governor against
+//                                                  simulated frame timings, then exit
+//   --expect-no-allocations                        with --headless, fail if the main thread
+//                                                  allocated on the heap in a frame of the second
+//                                                  half; only builds with MINIMALVR_COUNT_ALLOCATIONS
+//                                                  (Debug) count them, other threads never
 int main(int argc, char** argv)
 {
 	int result = -1;
-	
-	aEngine.Init();
+	unsigned int benchmarkFrames = 0;
+	std::string golden;
+	bool cook = false;
+	bool recook = false;
+	std::string packPath;
+	bool mountArchive = true;
+	bool objCheck = false;
+	bool textureCheck = false;
+	int objBenchmarkRuns = 0;
+	std::string audioBackend;
+	std::string audioWav;
+	int audioBenchmarkVoices = 0;
+	size_t jobBenchmarkWeapons = 0;
+	int simulationBenchmarkTicks = 0;
+	std::string expectedSimulationChecksum;
+	bool governorCheck = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--headless")
+		{
+			headless = true;
+			benchmarkFrames = 600;
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				benchmarkFrames = atoi(argv[++i]);
+		}
+		else if (arg == "--golden" && i + 1 < argc)
+		{
+			golden = argv[++i];
+		}
+		else if (arg == "--record-tracking" && i + 1 < argc)
+		{
+			trackingRecordPath = argv[++i];
+		}
+		else if (arg == "--play-tracking" && i + 1 < argc)
+		{
+			trackingPlaybackPath = argv[++i];
+			if (i + 1 < argc && (isdigit(argv[i + 1][0]) || argv[i + 1][0] == '.'))
+				trackingPlaybackSpeed = (float)atof(argv[++i]);
+		}
+		else if (arg == "--cook")
+		{
+			cook = true;
+		}
+		else if (arg == "--recook")
+		{
+			cook = true;
+			recook = true;
+		}
+		else if (arg == "--pack")
+		{
+			packPath = ASSET_ARCHIVE_PATH;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				packPath = argv[++i];
+		}
+		else if (arg == "--no-archive")
+		{
+			mountArchive = false;
+		}
+		else if (arg == "--no-shader-cache")
+		{
+			useProgramCache() = false;
+		}
+		else if (arg == "--no-obj-loader")
+		{
+			Model::useObjLoader() = false;
+		}
+		else if (arg == "--obj-check")
+		{
+			objCheck = true;
+		}
+		else if (arg == "--texture-check")
+		{
+			textureCheck = true;
+		}
+		else if (arg == "--obj-benchmark")
+		{
+			objBenchmarkRuns = 10;
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				objBenchmarkRuns = std::max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--audio" && i + 1 < argc)
+		{
+			audioBackend = argv[++i];
+			if (audioBackend != "fmod" && audioBackend != "software")
+			{
+				std::cout << "Unknown audio backend " << audioBackend << ", using the default" << std::endl;
+				audioBackend.clear();
+			}
+		}
+		else if (arg == "--audio-wav" && i + 1 < argc)
+		{
+			audioWav = argv[++i];
+		}
+		else if (arg == "--audio-benchmark")
+		{
+			audioBenchmarkVoices = 64;
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				audioBenchmarkVoices = std::max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--jobs" && i + 1 < argc)
+		{
+			jobSystem.setThreads((unsigned int)std::max(1, atoi(argv[++i])));
+		}
+		else if (arg == "--sim-benchmark")
+		{
+			simulationBenchmarkTicks = 100000;
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				simulationBenchmarkTicks = std::max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--expect-checksum" && i + 1 < argc)
+		{
+			expectedSimulationChecksum = argv[++i];
+		}
+		else if (arg == "--governor-check")
+		{
+			governorCheck = true;
+		}
+		else if (arg == "--expect-no-allocations")
+		{
+			expectNoAllocations = true;
+		}
+		else if (arg == "--job-benchmark")
+		{
+			jobBenchmarkWeapons = 60000;
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				jobBenchmarkWeapons = (size_t)std::max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--no-cooked-assets")
+		{
+			Model::useCookedAssets() = false;
+			TexturedCube::useContainer() = false;
+		}
+		else if (arg == "--vertex-format" && i + 1 < argc)
+		{
+			std::string format = argv[++i];
+			if (format == "full")
+				Model::vertexFormat() = VertexFormat::Full;
+			else if (format == "packed")
+				Model::vertexFormat() = VertexFormat::Packed;
+			else if (format == "quantized")
+				Model::vertexFormat() = VertexFormat::Quantized;
+			else
+				std::cout << "Unknown vertex format " << format << ", using "
+					<< vertexFormatName(Model::vertexFormat()) << std::endl;
+		}
+	}
+
+	if (objCheck || objBenchmarkRuns)
+	{
+		int failed = 0;
+		for (const char* path : MODEL_PATHS)
+		{
+			if (objCheck)
+			{
+				bool ok = Model::checkObjLoader(path);
+				std::cout << (ok ? "Matches Assimp: " : "Differs from Assimp: ") << path << std::endl;
+				failed += ok ? 0 : 1;
+			}
+			if (objBenchmarkRuns)
+				Model::benchmarkObjLoader(path, objBenchmarkRuns);
+		}
+		if (objCheck)
+		{
+			for (const char* path : OBJ_CHECK_PATHS)
+			{
+				bool ok = Model::checkObjLoader(path);
+				std::cout << (ok ? "Matches Assimp: " : "Differs from Assimp: ") << path << std::endl;
+				failed += ok ? 0 : 1;
+			}
+		}
+		return failed ? 1 : 0;
+	}
+
+	if (textureCheck)
+		return checkTextureCompression() ? 0 : 1;
+
+	if (audioBenchmarkVoices)
+	{
+		benchmarkAudioMixer(audioBenchmarkVoices, 10);
+		return 0;
+	}
+
+	if (jobBenchmarkWeapons)
+	{
+		benchmarkWeaponJobs(jobBenchmarkWeapons, 20);
+		return 0;
+	}
+
+	if (simulationBenchmarkTicks)
+	{
+		uint64_t checksum = benchmarkSimulation(simulationBenchmarkTicks);
+		if (!expectedSimulationChecksum.empty())
+		{
+			if (strtoull(expectedSimulationChecksum.c_str(), nullptr, 16) != checksum)
+			{
+				printf("state checksum does not match the expected %s\n", expectedSimulationChecksum.c_str());
+				return 1;
+			}
+			printf("state checksum matches the expected one\n");
+		}
+		return 0;
+	}
+
+	if (governorCheck)
+		return checkResolutionGovernor() ? 0 : 1;
+
+	if (cook)
+	{
+		// a job per cooked file: the mesh cache of every model is made from the OBJ and its
+		// MTL libraries, the texture maps the MTLs name are jobs of their own
+		std::vector<CookJob> jobs;
+		std::set<std::string> textures(std::begin(TEXTURE_PATHS), std::end(TEXTURE_PATHS));
+		std::string meshSettings = "mesh cache v" + std::to_string(MESH_CACHE_VERSION) + " "
+			+ vertexFormatName(Model::vertexFormat()) + (Model::useObjLoader() ? " ObjLoader" : " Assimp");
+		for (const char* path : MODEL_PATHS)
+		{
+			std::vector<std::string> references;
+			appendAssetDependencies(path, references);
+			CookJob job;
+			job.output = meshCachePath(path);
+			job.inputs.push_back(path);
+			for (const std::string& reference : references)
+			{
+				if (reference.size() > 4 && reference.compare(reference.size() - 4, 4, ".mtl") == 0)
+					job.inputs.push_back(reference);
+				else
+					textures.insert(reference);
+			}
+			job.settings = meshSettings;
+			std::string source = path;
+			job.cook = [source] { return Model::cook(source); };
+			job.restamp = [source] { return restampMeshCache(meshCachePath(source), source); };
+			jobs.push_back(job);
+		}
+		for (const std::string& texture : textures)
+		{
+			CookJob job;
+			job.output = textureContainerPath(texture);
+			job.inputs.push_back(texture);
+			job.settings = "texture container v" + std::to_string(TEXTURE_CONTAINER_VERSION);
+			job.cook = [texture] { return CookTexture(texture); };
+			job.restamp = [texture] { return restampTextureContainer(textureContainerPath(texture), texture); };
+			jobs.push_back(job);
+		}
+		{
+			// the six faces, then the container
+			std::vector<std::string> files;
+			TexturedCube::appendFiles("../Shared/skybox", files);
+			CookJob job;
+			job.output = files.back();
+			job.inputs.assign(files.begin(), files.end() - 1);
+			job.settings = "cubemap container v" + std::to_string(CUBEMAP_CONTAINER_VERSION) + " BC1";
+			job.cook = [] { return TexturedCube::cook("../Shared/skybox"); };
+			job.restamp = [files]
+			{
+				std::string faces[CUBEMAP_FACES];
+				std::copy(files.begin(), files.begin() + CUBEMAP_FACES, faces);
+				return restampCubemapContainer(files.back(), faces);
+			};
+			jobs.push_back(job);
+		}
+#ifndef MINIMALVR_NO_FMOD
+		// the software mixer plays PCM, FMOD decodes the shipped sounds for it
+		for (const SoundManifestEntry& sound : SOUND_MANIFEST)
+		{
+			const char* path = sound.strName;
+			uint64_t size;
+			int64_t time;
+			if (!sourceFileStamp(path, size, time))
+				continue;
+			CookJob job;
+			job.output = decodedSoundPath(path);
+			job.inputs.push_back(path);
+			job.settings = "decoded sound PCM16";
+			std::string source = path;
+			job.cook = [source] { return decodeSoundToWav(source, decodedSoundPath(source)); };
+			jobs.push_back(job);
+		}
+#endif
+
+		CookReport report;
+		bool ok = runCookJobs(COOK_MANIFEST_PATH, jobs, recook, 0, report);
+		std::cout << "Cook: " << report.cooked << " cooked, " << report.restamped << " restamped, " << report.upToDate
+			<< " up to date, " << report.failed << " failed in " << report.ms << " ms" << std::endl;
+		if (!ok || packPath.empty())
+			return ok ? 0 : 1;
+	}
 
-	aEngine.LoadSound("nature.mp3", true, true); 
-	aEngine.LoadSound("hold-weapon.mp3", true);
-	aEngine.LoadSound("weapon-collide.mp3", true);
-	aEngine.LoadSound("scream.mp3", true);
+	if (!packPath.empty())
+	{
+		std::vector<std::string> files;
+		for (const char* path : MODEL_PATHS)
+		{
+			size_t first = files.size();
+			files.push_back(path);
+			files.push_back(meshCachePath(path));
+			appendAssetDependencies(path, files);
+			// the texture maps the materials name, with their compressed containers
+			for (size_t i = first + 2, count = files.size(); i < count; i++)
+				if (files[i].compare(files[i].size() - 4, 4, ".mtl") != 0)
+					files.push_back(textureContainerPath(files[i]));
+		}
+		for (const char* path : TEXTURE_PATHS)
+		{
+			files.push_back(path);
+			files.push_back(textureContainerPath(path));
+		}
+		TexturedCube::appendFiles("../Shared/skybox", files);
+		files.insert(files.end(), std::begin(SHADER_PATHS), std::end(SHADER_PATHS));
+		for (const SoundManifestEntry& sound : SOUND_MANIFEST)
+		{
+			files.push_back(sound.strName);
+			files.push_back(decodedSoundPath(sound.strName));
+		}
 
-	aEngine.PlaySounds("nature.mp3", vec3(0), aEngine.VolumeTodB(0.5f));
+		AssetPackReport report;
+		if (!writeAssetArchive(packPath, files, &report))
+			return 1;
+		std::cout << "Packed " << packPath << ": " << report.files << " files, " << report.compressedFiles
+			<< " compressed, " << report.bytes / 1024 << " KB -> " << report.storedBytes / 1024 << " KB" << std::endl;
+		return 0;
+	}
 
-	future<void> audioFuture = async(AudioUpdate, &aEngine);
+	// one archive for every asset, so a cold start opens a single file
+	if (mountArchive && mountAssetArchive(ASSET_ARCHIVE_PATH))
+	{
+		const AssetArchive* archive = mountedAssetArchive();
+		std::cout << "Mounted " << ASSET_ARCHIVE_PATH << ": " << archive->entryCount() << " entries, "
+			<< archive->fileSize() / (1024 * 1024) << " MB" << std::endl;
+	}
+
+#ifdef MINIMALVR_NO_OVR
+	if (!headless)
+	{
+		std::cout << "Built without LibOVR, only --headless runs" << std::endl;
+		return 1;
+	}
+#endif
+
+	// headless runs mix in software, so they neither need a sound device nor make noise
+	bool softwareAudio = audioBackend == "software" || !audioWav.empty() || (headless && audioBackend != "fmod");
+#ifdef MINIMALVR_NO_FMOD
+	softwareAudio = true;
+#endif
+	if (softwareAudio)
+	{
+		SoftwareAudioBackend* backend = new SoftwareAudioBackend(MAX_REAL_VOICES);
+		if (!audioWav.empty())
+			backend->capture(audioWav);
+		aEngine.Init(backend);
+	}
+	else
+	{
+		aEngine.Init();
+	}
+	std::cout << "Audio: " << aEngine.GetBackendName() << std::endl;
+	eventLatency.setOutputLatencyMs(aEngine.GetOutputLatencyMs());
+
+	aEngine.PreloadSounds(SOUND_MANIFEST, sizeof(SOUND_MANIFEST) / sizeof(SOUND_MANIFEST[0]), SOUND_MEMORY_BUDGET);
+	soundNature = aEngine.FindSound("nature.mp3");
+	soundHoldWeapon = aEngine.FindSound("hold-weapon.mp3");
+	soundWeaponCollide = aEngine.FindSound("weapon-collide.mp3");
+	soundScream = aEngine.FindSound("scream.mp3");
+
+	aEngine.PlaySounds(soundNature, vec3(0), aEngine.VolumeTodB(0.5f));
+
+	audioThread.start(&aEngine);
 	/*
 	string input;
 	while (std::getline(std::cin, input))
 	{
 		if (input.compare("h") == 0)
 		{
-			aEngine.PlaySounds("hold-weapon.mp3", vec3(0), aEngine.VolumeTodB(1.0f));
+			aEngine.PlaySounds(soundHoldWeapon, vec3(0), aEngine.VolumeTodB(1.0f));
 		}
 		else if(input.compare("c") == 0)
 		{
-			aEngine.PlaySounds("weapon-collide.mp3", vec3(0), aEngine.VolumeTodB(1.0f));
+			aEngine.PlaySounds(soundWeaponCollide, vec3(0), aEngine.VolumeTodB(1.0f));
 		}
 		else if (input.compare("s") == 0)
 		{
-			aEngine.PlaySounds("scream.mp3", vec3(0), aEngine.VolumeTodB(0.5f));
+			aEngine.PlaySounds(soundScream, vec3(0), aEngine.VolumeTodB(0.5f));
 		}
 	}
 	*/
 
-	if (!OVR_SUCCESS(ovr_Initialize(nullptr)))
+#ifndef MINIMALVR_NO_OVR
+	if (!headless && !OVR_SUCCESS(ovr_Initialize(nullptr)))
 	{
 		FAIL("Failed to initialize the Oculus SDK");
 	}
-	result = ExampleApp().run();
+#endif
+	{
+		ExampleApp app;
+		app.setBenchmark(benchmarkFrames, golden);
+		result = app.run();
+	}
 
+	audioThread.stop();
+	eventLatency.report();
 	aEngine.Shutdown();
-	ovr_Shutdown();
+#ifndef MINIMALVR_NO_OVR
+	if (!headless)
+		ovr_Shutdown();
+#endif
 	return result;
 }
@@ -4,6 +4,8 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 using namespace std;
 
 #define GLFW_INCLUDE_GLEXT
@@ -15,21 +17,222 @@ using namespace std;
 #include <GLFW/glfw3.h>
 
 #include "shader.h"
+#include "AssetArchive.h"
+#include "MappedFile.h"
+#include "ResourceCache.h"
 
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+namespace
+{
+	const char PROGRAM_CACHE_MAGIC[4] = { 'M', 'V', 'R', 'S' };
+	const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+	struct ProgramCacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceHash;	// vertex then fragment source
+		uint64_t driverHash;	// GL_VENDOR, GL_RENDERER, GL_VERSION
+		uint32_t binaryFormat;
+		uint32_t binarySize;	// the binary follows the header
+	};
+
+	// named after both shaders, programs sharing a vertex shader get files of their own
+	std::string programCachePath(const char* vertex_file_path, const char* fragment_file_path)
+	{
+		std::string fragment(fragment_file_path);
+		size_t slash = fragment.find_last_of("/\\");
+		if (slash != std::string::npos)
+			fragment.erase(0, slash + 1);
+		return std::string(vertex_file_path) + "." + fragment + ".mvrprog";
+	}
+
+	// a driver update changes the version string, a GPU switch the renderer
+	uint64_t driverHash()
+	{
+		uint64_t hash = hashResourceBytes("", 0);
+		for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+		{
+			const char* value = (const char*)glGetString(name);
+			if (value)
+				hash = hashResourceBytes(value, strlen(value) + 1, hash);
+		}
+		return hash;
+	}
+
+	// some drivers (and macOS) support glGetProgramBinary without any format to return
+	bool programBinarySupported()
+	{
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}
+
+	// 0 if there is no usable binary for these sources and this driver
+	GLuint loadProgramBinary(const std::string& path, uint64_t sourceHash, uint64_t driver)
+	{
+		MappedFile file;
+		if (!file.open(path))
+			return 0;
+
+		const ProgramCacheHeader* header = reinterpret_cast<const ProgramCacheHeader*>(file.data());
+		if (file.size() < sizeof(ProgramCacheHeader)
+			|| memcmp(header->magic, PROGRAM_CACHE_MAGIC, sizeof(header->magic)) != 0
+			|| header->version != PROGRAM_CACHE_VERSION
+			|| header->binarySize > file.size() - sizeof(ProgramCacheHeader))
+		{
+			printf("Program cache: %s is corrupt, ignoring it\n", path.c_str());
+			return 0;
+		}
+		if (header->sourceHash != sourceHash || header->driverHash != driver)
+		{
+			printf("Program cache: %s is stale, recompiling\n", path.c_str());
+			return 0;
+		}
+
+		GLuint ProgramID = glCreateProgram();
+		glProgramBinary(ProgramID, header->binaryFormat, file.data() + sizeof(ProgramCacheHeader), header->binarySize);
+		GLint Result = GL_FALSE;
+		glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+		if (Result != GL_TRUE)
+		{
+			// the driver may refuse its own binaries, e.g. after a change it doesn't report in GL_VERSION
+			printf("Program cache: the driver rejected %s, recompiling\n", path.c_str());
+			glDeleteProgram(ProgramID);
+			return 0;
+		}
+		return ProgramID;
+	}
+
+	bool saveProgramBinary(const std::string& path, GLuint ProgramID, uint64_t sourceHash, uint64_t driver)
+	{
+		GLint length = 0;
+		glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return false;
+
+		ProgramCacheHeader header = {};
+		memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+		header.version = PROGRAM_CACHE_VERSION;
+		header.sourceHash = sourceHash;
+		header.driverHash = driver;
+		std::vector<unsigned char> binary(length);
+		GLsizei written = 0;
+		GLenum format = 0;
+		glGetProgramBinary(ProgramID, length, &written, &format, binary.data());
+		if (written <= 0)
+			return false;
+		header.binaryFormat = format;
+		header.binarySize = (uint32_t)written;
+
+		// write next to the target and rename, so a half written file is never picked up
+		std::string tmpPath = path + ".tmp";
+		FILE* file = fopen(tmpPath.c_str(), "wb");
+		if (!file)
+			return false;
+		bool ok = fwrite(&header, 1, sizeof(header), file) == sizeof(header)
+			&& fwrite(binary.data(), 1, header.binarySize, file) == header.binarySize;
+		ok = (fclose(file) == 0) && ok;
+		if (ok)
+		{
+			remove(path.c_str());
+			ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+		}
+		if (!ok)
+			remove(tmpPath.c_str());
+		return ok;
+	}
+
+	GLuint compileProgram(const char * vertex_file_path, const char * fragment_file_path,
+		const std::string& VertexShaderCode, const std::string& FragmentShaderCode, bool retrievable, bool& linked)
+	{
+		// Create the shaders
+		GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+		GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
+		GLint Result = GL_FALSE;
+		int InfoLogLength;
+
+
+		// Compile Vertex Shader
+		printf("Compiling shader : %s\n", vertex_file_path);
+		char const * VertexSourcePointer = VertexShaderCode.c_str();
+		glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
+		glCompileShader(VertexShaderID);
+
+		// Check Vertex Shader
+		glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
+		glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if ( InfoLogLength > 0 ){
+			std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
+			glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
+			printf("%s\n", &VertexShaderErrorMessage[0]);
+		}
+		else {
+			printf("Successfully compiled vertex shader!\n");
+		}
+
+
+
+		// Compile Fragment Shader
+		printf("Compiling shader : %s\n", fragment_file_path);
+		char const * FragmentSourcePointer = FragmentShaderCode.c_str();
+		glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
+		glCompileShader(FragmentShaderID);
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+		// Check Fragment Shader
+		glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
+		glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if ( InfoLogLength > 0 ){
+			std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
+			glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
+			printf("%s\n", &FragmentShaderErrorMessage[0]);
+		}
+		else {
+			printf("Successfully compiled fragment shader!\n");
+		}
+
+
+		// Link the program
+		printf("Linking program\n");
+		GLuint ProgramID = glCreateProgram();
+		if (retrievable)
+			glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glAttachShader(ProgramID, VertexShaderID);
+		glAttachShader(ProgramID, FragmentShaderID);
+		glLinkProgram(ProgramID);
+
+		// Check the program
+		glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+		glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if ( InfoLogLength > 0 ){
+			std::vector<char> ProgramErrorMessage(InfoLogLength+1);
+			glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+			printf("%s\n", &ProgramErrorMessage[0]);
+		}
+		linked = Result == GL_TRUE;
+
+		glDetachShader(ProgramID, VertexShaderID);
+		glDetachShader(ProgramID, FragmentShaderID);
+
+		glDeleteShader(VertexShaderID);
+		glDeleteShader(FragmentShaderID);
+
+		return ProgramID;
+	}
+}
+
+bool& useProgramCache()
+{
+	static bool enabled = true;
+	return enabled;
+}
+
+GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
 
 	// Read the Vertex Shader code from the file
 	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
-		VertexShaderStream.close();
+	AssetFile VertexShaderFile;
+	if(VertexShaderFile.open(vertex_file_path)){
+		VertexShaderCode.assign((const char*)VertexShaderFile.data(), VertexShaderFile.size());
 	}else{
 		printf("Impossible to open %s. Check to make sure the file exists and you passed in the right filepath!\n", vertex_file_path);
 		printf("The current working directory is:");
@@ -44,78 +247,32 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 
 	// Read the Fragment Shader code from the file
 	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
+	AssetFile FragmentShaderFile;
+	if(FragmentShaderFile.open(fragment_file_path)){
+		FragmentShaderCode.assign((const char*)FragmentShaderFile.data(), FragmentShaderFile.size());
 	}
 
-	GLint Result = GL_FALSE;
-	int InfoLogLength;
-
-
-	// Compile Vertex Shader
-	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-	glCompileShader(VertexShaderID);
-
-	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("%s\n", &VertexShaderErrorMessage[0]);
-	}
-	else {
-		printf("Successfully compiled vertex shader!\n");
-	}
-
-
-
-	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-	glCompileShader(FragmentShaderID);
-
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("%s\n", &FragmentShaderErrorMessage[0]);
+	bool cached = useProgramCache() && programBinarySupported();
+	uint64_t sourceHash = 0;
+	uint64_t driver = 0;
+	std::string cachePath = programCachePath(vertex_file_path, fragment_file_path);
+	if (cached)
+	{
+		sourceHash = hashResourceBytes(VertexShaderCode.data(), VertexShaderCode.size());
+		sourceHash = hashResourceBytes(FragmentShaderCode.data(), FragmentShaderCode.size(), sourceHash);
+		driver = driverHash();
+		GLuint ProgramID = loadProgramBinary(cachePath, sourceHash, driver);
+		if (ProgramID)
+		{
+			printf("Loaded program binary : %s\n", cachePath.c_str());
+			return ProgramID;
+		}
 	}
-	else {
-		printf("Successfully compiled fragment shader!\n");
-	}
-
 
-	// Link the program
-	printf("Linking program\n");
-	GLuint ProgramID = glCreateProgram();
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
-
-	// Check the program
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
-		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-		printf("%s\n", &ProgramErrorMessage[0]);
-	}
-	
-	glDetachShader(ProgramID, VertexShaderID);
-	glDetachShader(ProgramID, FragmentShaderID);
-	
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
+	bool linked = false;
+	GLuint ProgramID = compileProgram(vertex_file_path, fragment_file_path, VertexShaderCode, FragmentShaderCode, cached, linked);
+	if (cached && linked && !saveProgramBinary(cachePath, ProgramID, sourceHash, driver))
+		printf("Program cache: failed writing %s\n", cachePath.c_str());
 
 	return ProgramID;
 }
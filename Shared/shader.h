@@ -1,6 +1,16 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+// Compiles and links a program from a vertex and a fragment shader file, or reloads
+// it from the program cache when the same driver linked the same sources before.
+// Any thread with a current context; see ShaderCompiler for linking off the render thread.
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
 
+// The program cache keeps glGetProgramBinary's output next to the vertex shader
+// (<vertex shader>.<fragment shader file name>.mvrprog), keyed by a hash of both sources and of the GL vendor,
+// renderer and version strings. A mismatch, or a driver rejecting its own binary
+// after an update, compiles from source and rewrites the file.
+// --no-shader-cache turns it off.
+bool& useProgramCache();
+
 #endif
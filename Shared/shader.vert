@@ -8,14 +8,30 @@ uniform mat4 projection;
 uniform mat4 model;
 uniform mat4 view;
 
+// set by Mesh::Draw for its vertex format (MeshOptimizer.h): quantized positions
+// arrive as 0..1 within the mesh bounds, packed normals as octahedral in normal.xy
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionOffset = vec3(0.0);
+uniform bool octahedralNormal = false;
+
 out vec3 vertNormal;
 out vec3 vertPosition;
 out vec2 vertTexture;
 
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 void main()
 {
-    vertNormal= mat3(transpose(inverse(model))) * normal;
-	vertPosition = vec3(model * vec4(position.x, position.y, position.z, 1.0));
+    vec3 objectNormal = octahedralNormal ? decodeOctahedral(normal.xy) : normal;
+    vec3 objectPosition = positionOffset + position * positionScale;
+    vertNormal= mat3(transpose(inverse(model))) * objectNormal;
+	vertPosition = vec3(model * vec4(objectPosition, 1.0));
     vertTexture = texture;
 
     gl_Position = projection * view * vec4(vertPosition, 1.0);